@@ -0,0 +1,112 @@
+// World baker: runs the generator over a square of chunk columns and
+// writes the image described in mc_bake.h, for the world partition.
+//
+//   mc_bake [--radius 16] [--origin 0 0] [--out world.bin] [--max-bytes N]
+//
+// The square covers origin-radius .. origin+radius-1 on both axes. Fails
+// if the image outgrows --max-bytes (the partition in partitions.csv by
+// default) or a packed section does not unpack to what was generated.
+// Flash it with
+//   parttool.py write_partition --partition-name world --input world.bin
+// or serve it from the host server with --world world.bin.
+
+#include "mc_bake.h"
+#include "mc_play.h"
+#include "mc_world.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+static constexpr size_t PARTITION_BYTES = 0x4F0000;
+
+static int64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void put16(std::vector<uint8_t>& v, size_t at, uint16_t x) { memcpy(&v[at], &x, 2); }
+static void put32(std::vector<uint8_t>& v, size_t at, uint32_t x) { memcpy(&v[at], &x, 4); }
+
+int main(int argc, char** argv) {
+    int radius = 16, ox = 0, oz = 0;
+    size_t max_bytes = PARTITION_BYTES;
+    const char* out_path = "world.bin";
+    for (int i = 1; i < argc; i++) {
+        const char* k = argv[i];
+        if (!strcmp(k, "--radius") && i + 1 < argc) radius = atoi(argv[++i]);
+        else if (!strcmp(k, "--origin") && i + 2 < argc) { ox = atoi(argv[++i]); oz = atoi(argv[++i]); }
+        else if (!strcmp(k, "--out") && i + 1 < argc) out_path = argv[++i];
+        else if (!strcmp(k, "--max-bytes") && i + 1 < argc) max_bytes = strtoul(argv[++i], nullptr, 0);
+        else {
+            fprintf(stderr, "unknown option %s\n", k);
+            return 2;
+        }
+    }
+    if (radius < 1) radius = 1;
+    const int side = 2 * radius, min_cx = ox - radius, min_cz = oz - radius;
+
+    std::vector<uint8_t> img(BAKE_HEADER + static_cast<size_t>(side) * side * 4);
+    memcpy(&img[0], "MCWB", 4);
+    put16(img, 4, BAKE_VERSION);
+    put16(img, 6, WORLD_SECTIONS);
+    put32(img, 8, static_cast<uint32_t>(min_cx));
+    put32(img, 12, static_cast<uint32_t>(min_cz));
+    put32(img, 16, static_cast<uint32_t>(side));
+
+    uint8_t pis[4096], check[4096], packed[4096 + 4096 / 128 + 1];
+    uint64_t sections = 0, raw = 0;
+    int bad = 0;
+    int64_t t0 = now_ns();
+    for (int z = 0; z < side; z++)
+        for (int x = 0; x < side; x++) {
+            int cx = min_cx + x, cz = min_cz + z;
+            size_t col = img.size();
+            put32(img, BAKE_HEADER + (static_cast<size_t>(z) * side + x) * 4, static_cast<uint32_t>(col));
+            img.resize(col + BAKE_COLUMN_HEAD + WORLD_SECTIONS * 4);
+
+            int sky_h[16][16];
+            gen_sky_heights(cx, cz, sky_h);
+            for (int bz = 0; bz < 16; bz++)
+                for (int bx = 0; bx < 16; bx++)
+                    put16(img, col + (bx + bz * 16) * 2, static_cast<uint16_t>(sky_h[bx][bz]));
+
+            for (int si = 0; si < WORLD_SECTIONS; si++) {
+                size_t entry = col + BAKE_COLUMN_HEAD + si * 4;
+                int n = gen_section_at(pis, cx, cz, si);
+                put16(img, entry, static_cast<uint16_t>(n));
+                put16(img, entry + 2, 0);
+                if (n == 0) continue;
+                size_t len = bake_pack(pis, sizeof(pis), packed);
+                bad += !bake_unpack(packed, len, check, sizeof(check)) || memcmp(check, pis, sizeof(pis)) != 0;
+                put16(img, entry + 2, static_cast<uint16_t>(len));
+                img.insert(img.end(), packed, packed + len);
+                sections++;
+                raw += sizeof(pis);
+            }
+        }
+    double secs = (now_ns() - t0) / 1e9;
+    put32(img, 20, static_cast<uint32_t>(img.size()));
+
+    printf("area       %dx%d chunks from %d,%d, %llu sections with blocks\n", side, side, min_cx, min_cz,
+           static_cast<unsigned long long>(sections));
+    printf("image      %zu bytes, %.0f per chunk, blocks packed %.1fx, %.1f s to bake\n", img.size(),
+           static_cast<double>(img.size()) / (side * side), sections ? static_cast<double>(raw) / img.size() : 0.0,
+           secs);
+    if (bad) {
+        fprintf(stderr, "%d sections do not unpack to the generated blocks\n", bad);
+        return 1;
+    }
+    if (img.size() > max_bytes) {
+        fprintf(stderr, "image is %zu bytes, over the %zu the partition holds\n", img.size(), max_bytes);
+        return 1;
+    }
+    FILE* f = fopen(out_path, "wb");
+    if (!f || fwrite(img.data(), 1, img.size(), f) != img.size() || fclose(f) != 0) {
+        perror(out_path);
+        return 1;
+    }
+    printf("wrote      %s\n", out_path);
+    return 0;
+}
@@ -0,0 +1,652 @@
+// Headless load generator: N bots join over the real protocol and move
+// along scripted paths while the tool records join latency, time to first
+// frame, chunk rate, bytes per chunk, keep-alives and the server's own loop
+// time.
+//
+//   mc_bench_bots [--host 127.0.0.1] [--port 25565] [--metrics-port 25566]
+//                 [--bots 4] [--seconds 30] [--path walk|fly|teleport|mix]
+//                 [--delay-ms 0] [--kbps 0] [--chat-ms 0] [--dig-ms 0]
+//                 [--move-ms 50] [--slot-ms 0] [--stall 0]
+//
+// --delay-ms / --kbps shape each bot's link in both directions to
+// approximate the Wi-Fi hop to the ESP32. --chat-ms makes every bot chat
+// at that interval, exercising the broadcast path. --dig-ms makes every
+// bot break the block under its feet at that interval, exercising block
+// ticks, relighting and the block change and light packets. --move-ms
+// sets how often every bot sends its position (a vanilla client sends up
+// to every 50 ms); the server applies the latest once per game tick.
+// --slot-ms makes every bot set a creative hotbar slot at that interval to
+// an item carrying custom data and a custom name, both NBT. --stall opens
+// that many extra connections first that send half a Handshake frame and
+// go quiet: the bots must still join around them, and the server should
+// close each once the handshake deadline passes.
+//
+// A Transfer packet (sharded servers) is followed like a vanilla client
+// does: the bot reconnects to the given node with the transfer intent and
+// logs in again. Handoff latency runs from the Transfer to the new node's
+// position packet.
+
+#include "config.h"
+#include "mc_types.h"
+#include "mc_packet.h"
+#include "mc_nbt.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <netdb.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+enum class PathKind { WALK, FLY, TELEPORT };
+
+struct Options {
+    const char* host = "127.0.0.1";
+    int port = MC_PORT;
+    int metrics_port = MC_METRICS_PORT;
+    int bots = 4;
+    int seconds = 30;
+    const char* path = "mix";
+    int delay_ms = 0;
+    int kbps = 0;
+    int chat_ms = 0;
+    int dig_ms = 0;
+    int move_ms = 50;
+    int slot_ms = 0;
+    int stall = 0;
+};
+
+struct BotStats {
+    bool joined = false;
+    bool rejected = false;
+    double join_ms = 0;
+    double frame_ms = 0;    // position and the chunk under it both received
+    uint64_t chunks = 0;
+    uint64_t chunk_bytes = 0;
+    uint64_t bytes_in = 0;
+    uint32_t keepalives = 0;
+    uint32_t moves = 0;
+    uint32_t unloads = 0;
+    uint32_t chats_sent = 0;
+    uint32_t chats_seen = 0;
+    uint32_t digs = 0;
+    uint32_t dig_acks = 0;
+    uint32_t slots = 0;
+    uint32_t block_updates = 0;     // Block Update and Update Section Blocks
+    uint32_t light_updates = 0;     // Update Light
+    uint32_t handoffs = 0;
+    double handoff_ms = 0;  // summed over handoffs
+    double handoff_max_ms = 0;
+};
+
+static Options opt;
+
+static int64_t now_us() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static int tcp_connect(const char* host, int port) {
+    addrinfo hints{}, *res = nullptr;
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    char port_str[8];
+    snprintf(port_str, sizeof(port_str), "%d", port);
+    if (getaddrinfo(host, port_str, &hints, &res) != 0) return -1;
+    int sock = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+    if (sock >= 0 && connect(sock, res->ai_addr, res->ai_addrlen) < 0) {
+        close(sock);
+        sock = -1;
+    }
+    freeaddrinfo(res);
+    if (sock >= 0) {
+        int one = 1;
+        setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+    return sock;
+}
+
+// Relays bytes between the bot and the server, releasing each read only
+// after the configured one-way delay and at no more than the configured rate.
+struct LinkShaper {
+    struct Pending { int64_t release_us; std::vector<uint8_t> bytes; };
+    struct Direction {
+        int from, to;
+        std::deque<Pending> queue;
+        int64_t next_free_us = 0;
+    };
+
+    Direction dir[2];
+    std::thread thread;
+
+    void start(int server_sock, int bot_side) {
+        dir[0].from = server_sock; dir[0].to = bot_side;
+        dir[1].from = bot_side;    dir[1].to = server_sock;
+        thread = std::thread([this] { run(); });
+    }
+
+    void run() {
+        uint8_t buf[16384];
+        bool open = true;
+        while (open) {
+            int64_t now = now_us();
+            int timeout_ms = 50;
+            for (auto& d : dir)
+                if (!d.queue.empty()) {
+                    int64_t wait = (d.queue.front().release_us - now) / 1000;
+                    timeout_ms = std::min<int64_t>(timeout_ms, std::max<int64_t>(wait, 0));
+                }
+
+            pollfd fds[2] = {{dir[0].from, POLLIN, 0}, {dir[1].from, POLLIN, 0}};
+            poll(fds, 2, timeout_ms);
+            now = now_us();
+
+            for (int i = 0; i < 2; i++) {
+                if (!(fds[i].revents & (POLLIN | POLLHUP))) continue;
+                ssize_t r = recv(dir[i].from, buf, sizeof(buf), 0);
+                if (r <= 0) { open = false; break; }
+                int64_t release = now + opt.delay_ms * 1000LL;
+                if (opt.kbps > 0) {
+                    release = std::max(release, dir[i].next_free_us);
+                    dir[i].next_free_us = release + r * 8000LL / opt.kbps;
+                }
+                dir[i].queue.push_back({release, std::vector<uint8_t>(buf, buf + r)});
+            }
+
+            for (auto& d : dir)
+                while (!d.queue.empty() && d.queue.front().release_us <= now) {
+                    auto& p = d.queue.front();
+                    if (send(d.to, p.bytes.data(), p.bytes.size(), MSG_NOSIGNAL) < 0) open = false;
+                    d.queue.pop_front();
+                }
+        }
+        shutdown(dir[0].from, SHUT_RDWR);
+        shutdown(dir[1].from, SHUT_RDWR);
+    }
+};
+
+static void write_move(PacketBuf& out, double x, double y, double z, float yaw) {
+    out.reset();
+    pkt_write_varint(out, 0x1D);
+    pkt_write_f64(out, x);
+    pkt_write_f64(out, y);
+    pkt_write_f64(out, z);
+    pkt_write_f32(out, yaw);
+    pkt_write_f32(out, 0.0f);
+    pkt_write_byte(out, 0x01);
+}
+
+static void write_chat(PacketBuf& out, const char* msg) {
+    out.reset();
+    pkt_write_varint(out, 0x07);
+    pkt_write_string(out, msg);
+    pkt_write_i64(out, 0);       // timestamp
+    pkt_write_i64(out, 0);       // salt
+    pkt_write_bool(out, false);  // unsigned
+    pkt_write_varint(out, 0);    // acknowledged message count
+    uint8_t acked[3] = {0, 0, 0};
+    out.append(acked, sizeof(acked));
+}
+
+// Set Creative Mode Slot: a written book with custom data (its pages and
+// author) and a custom name
+static void write_creative_slot(PacketBuf& out, int slot, uint32_t n) {
+    out.reset();
+    pkt_write_varint(out, 0x36);
+    pkt_write_i16(out, static_cast<int16_t>(slot));
+    pkt_write_varint(out, 1);       // count
+    pkt_write_varint(out, 1);       // item
+    pkt_write_varint(out, 2);       // components added
+    pkt_write_varint(out, 0);       // components removed
+    pkt_write_varint(out, 0);       // custom_data
+    const char* pages[] = {"first page", "second page", "third page"};
+    nbt_begin(out);
+    nbt_string_list(out, "pages", pages, 3);
+    nbt_compound(out, "meta");
+    nbt_int(out, "copy", static_cast<int32_t>(n));
+    nbt_end(out);
+    nbt_string(out, "author", "bench");
+    nbt_end(out);
+    pkt_write_varint(out, 5);       // custom_name
+    nbt_text(out, "Ledger");
+}
+
+// Position along the scripted path t seconds after spawning
+static void path_at(PathKind kind, int bot, double t, double& x, double& z, float& yaw) {
+    double phase = bot * 0.7;
+    switch (kind) {
+    case PathKind::WALK: {
+        // 64-block square at sprint-free walking speed
+        double d = fmod(t * 4.317 + bot * 16.0, 256.0);
+        int side = static_cast<int>(d / 64.0);
+        double s = fmod(d, 64.0);
+        static const double sx[4] = {0, 64, 64, 0}, sz[4] = {0, 0, 64, 64};
+        static const double dx[4] = {1, 0, -1, 0}, dz[4] = {0, 1, 0, -1};
+        x = sx[side] + dx[side] * s;
+        z = sz[side] + dz[side] * s;
+        yaw = static_cast<float>(atan2(-dx[side], dz[side]) * 57.29578);
+        break;
+    }
+    case PathKind::FLY: {
+        // Creative flying speed around a 200-block circle
+        double a = t * 10.92 / 200.0 + phase;
+        x = cos(a) * 200.0;
+        z = sin(a) * 200.0;
+        yaw = static_cast<float>(a * 57.29578);
+        break;
+    }
+    case PathKind::TELEPORT: {
+        // Jump 320 blocks every five seconds
+        int hop = static_cast<int>(t / 5.0);
+        x = hop * 320.0 + bot * 32.0;
+        z = (hop & 1) ? 320.0 : 0.0;
+        yaw = 0.0f;
+        break;
+    }
+    }
+}
+
+static void run_bot(int id, PathKind kind, BotStats& st) {
+    int64_t t0 = now_us();
+    char host[64];
+    snprintf(host, sizeof(host), "%s", opt.host);
+    int port = opt.port;
+    int server_sock = tcp_connect(host, port);
+    if (server_sock < 0) { fprintf(stderr, "bot%d: connect failed\n", id); return; }
+
+    int sock = server_sock;
+    LinkShaper shaper;
+    bool shaped = opt.delay_ms > 0 || opt.kbps > 0;
+    auto shape = [&] {
+        if (!shaped) return;
+        int pair[2];
+        socketpair(AF_UNIX, SOCK_STREAM, 0, pair);
+        shaper.start(server_sock, pair[1]);
+        sock = pair[0];
+    };
+    auto disconnect = [&] {
+        close(sock);
+        if (shaped) {
+            close(server_sock);
+            shaper.thread.join();
+            for (auto& d : shaper.dir) d.queue.clear();
+        }
+    };
+    shape();
+
+    PacketBuf in, out;
+    in.init(65536);
+    out.init();
+
+    char name[17];
+    snprintf(name, sizeof(name), "bot%d", id);
+
+    // Handshake (intent 2 login, 3 transfer) and Login Start
+    auto login = [&](int intent) {
+        out.reset();
+        pkt_write_varint(out, 0x00);
+        pkt_write_varint(out, MC_PROTOCOL_VERSION);
+        pkt_write_string(out, host);
+        pkt_write_u16(out, static_cast<uint16_t>(port));
+        pkt_write_varint(out, intent);
+        out.send_packet(sock);
+
+        out.reset();
+        pkt_write_varint(out, 0x00);
+        pkt_write_string(out, name);
+        pkt_write_uuid(out, 0xB0B0000000000000ULL | id, static_cast<uint64_t>(id));
+        out.send_packet(sock);
+    };
+    login(2);
+
+    enum { LOGIN, CONFIG, PLAY } state = LOGIN;
+    double x = 0.5, y = 0.0, z = 0.5;
+    int64_t spawn_us = 0, next_move_us = 0, next_chat_us = 0, next_dig_us = 0, next_slot_us = 0;
+    std::vector<std::pair<int32_t, int32_t>> early_chunks;   // received before the position
+    std::pair<int32_t, int32_t> ground;                       // chunk under the spawn position
+    bool have_ground = false;
+    int64_t transfer_us = 0;                                  // Transfer received, not yet placed
+    int64_t end_us = t0 + opt.seconds * 1000000LL;
+
+    while (now_us() < end_us) {
+        pollfd pfd = {sock, POLLIN, 0};
+        int wait_ms = spawn_us && state == PLAY ? std::max<int64_t>(0, (next_move_us - now_us()) / 1000) : 100;
+        if (poll(&pfd, 1, static_cast<int>(wait_ms)) > 0) {
+            if (!in.recv_packet(sock)) break;
+            st.bytes_in += in.len;
+            int32_t pid = pkt_read_varint(in);
+
+            if (state == LOGIN) {
+                if (pid == 0x02) {
+                    out.reset();
+                    pkt_write_varint(out, 0x03);
+                    out.send_packet(sock);
+                    state = CONFIG;
+                } else if (pid == 0x00) {
+                    st.rejected = true;
+                    break;
+                }
+            } else if (state == CONFIG) {
+                if (pid == 0x03) {
+                    out.reset();
+                    pkt_write_varint(out, 0x03);
+                    out.send_packet(sock);
+                    state = PLAY;
+                }
+            } else if (pid == 0x28) {
+                st.chunks++;
+                st.chunk_bytes += in.len;
+                int32_t cx = pkt_read_i32(in);
+                int32_t cz = pkt_read_i32(in);
+                if (!spawn_us) early_chunks.push_back({cx, cz});
+                else if (std::make_pair(cx, cz) == ground) have_ground = true;
+            } else if (pid == 0x22) {
+                st.unloads++;
+            } else if (pid == 0x73) {
+                st.chats_seen++;
+            } else if (pid == 0x05) {
+                st.dig_acks++;
+            } else if (pid == 0x09 || pid == 0x4E) {
+                st.block_updates++;
+            } else if (pid == 0x2B) {
+                st.light_updates++;
+            } else if (pid == 0x27) {
+                int64_t ka = pkt_read_i64(in);
+                out.reset();
+                pkt_write_varint(out, 0x1A);
+                pkt_write_i64(out, ka);
+                out.send_packet(sock);
+                st.keepalives++;
+            } else if (pid == 0x7A) {
+                pkt_read_string(in, host, sizeof(host));
+                port = pkt_read_varint(in);
+                transfer_us = now_us();
+                disconnect();
+                server_sock = tcp_connect(host, port);
+                if (server_sock < 0) {
+                    fprintf(stderr, "bot%d: transfer to %s:%d failed\n", id, host, port);
+                    sock = -1;
+                    break;
+                }
+                sock = server_sock;
+                shape();
+                login(3);
+                state = LOGIN;
+            } else if (pid == 0x42) {
+                int32_t tp = pkt_read_varint(in);
+                x = pkt_read_f64(in);
+                y = pkt_read_f64(in);
+                z = pkt_read_f64(in);
+                out.reset();
+                pkt_write_varint(out, 0x00);
+                pkt_write_varint(out, tp);
+                out.send_packet(sock);
+                if (transfer_us) {
+                    double ms = (now_us() - transfer_us) / 1000.0;
+                    st.handoffs++;
+                    st.handoff_ms += ms;
+                    st.handoff_max_ms = std::max(st.handoff_max_ms, ms);
+                    transfer_us = 0;
+                    next_move_us = now_us();
+                }
+                if (!spawn_us) {
+                    spawn_us = now_us();
+                    next_move_us = spawn_us;
+                    next_chat_us = spawn_us + opt.chat_ms * 1000LL;
+                    next_dig_us = spawn_us + opt.dig_ms * 1000LL;
+                    next_slot_us = spawn_us + opt.slot_ms * 1000LL;
+                    st.joined = true;
+                    st.join_ms = (spawn_us - t0) / 1000.0;
+                    ground = {static_cast<int32_t>(floor(x)) >> 4, static_cast<int32_t>(floor(z)) >> 4};
+                    for (const auto& c : early_chunks) have_ground |= c == ground;
+                }
+            }
+            // The client leaves the loading screen once it has its position
+            // and the chunk it stands in
+            if (!st.frame_ms && spawn_us && have_ground) st.frame_ms = (now_us() - t0) / 1000.0;
+        }
+
+        if (state != PLAY) continue;
+        if (spawn_us && now_us() >= next_move_us) {
+            float yaw = 0.0f;
+            path_at(kind, id, (now_us() - spawn_us) / 1e6, x, z, yaw);
+            write_move(out, x, y, z, yaw);
+            if (!out.send_packet(sock)) break;
+            st.moves++;
+            next_move_us += opt.move_ms * 1000LL;
+        }
+
+        if (spawn_us && opt.chat_ms > 0 && now_us() >= next_chat_us) {
+            char msg[32];
+            snprintf(msg, sizeof(msg), "hello %u from %s", st.chats_sent, name);
+            write_chat(out, msg);
+            if (!out.send_packet(sock)) break;
+            st.chats_sent++;
+            next_chat_us += opt.chat_ms * 1000LL;
+        }
+
+        if (spawn_us && opt.dig_ms > 0 && now_us() >= next_dig_us) {
+            // Creative players break blocks on the first hit
+            out.reset();
+            pkt_write_varint(out, 0x27);
+            pkt_write_varint(out, 0);
+            pkt_write_position(out, static_cast<int>(floor(x)), static_cast<int>(floor(y)) - 1,
+                               static_cast<int>(floor(z)));
+            pkt_write_byte(out, 1);
+            pkt_write_varint(out, static_cast<int32_t>(++st.digs));
+            if (!out.send_packet(sock)) break;
+            next_dig_us += opt.dig_ms * 1000LL;
+        }
+
+        if (spawn_us && opt.slot_ms > 0 && now_us() >= next_slot_us) {
+            write_creative_slot(out, 36 + st.slots % 9, st.slots);
+            if (!out.send_packet(sock)) break;
+            st.slots++;
+            next_slot_us += opt.slot_ms * 1000LL;
+        }
+    }
+
+    if (sock >= 0) disconnect();
+    in.free();
+    out.free();
+}
+
+// Sends the length prefix and half of a Handshake frame, then waits
+// without another byte; ms until the server closed the socket, -1 if it
+// was still open at the end of the run
+static double run_stalled(int64_t end_us) {
+    int sock = tcp_connect(opt.host, opt.port);
+    if (sock < 0) return -1;
+    PacketBuf body, frame;
+    body.init();
+    frame.init();
+    pkt_write_varint(body, 0x00);
+    pkt_write_varint(body, MC_PROTOCOL_VERSION);
+    pkt_write_string(body, opt.host);
+    pkt_write_u16(body, static_cast<uint16_t>(opt.port));
+    pkt_write_varint(body, 2);
+    pkt_write_varint(frame, static_cast<int32_t>(body.len));
+    frame.append(body.data, body.len / 2);
+    int64_t t0 = now_us();
+    double closed_ms = -1;
+    if (send(sock, frame.data, frame.len, MSG_NOSIGNAL) == static_cast<ssize_t>(frame.len)) {
+        while (now_us() < end_us) {
+            pollfd pfd = {sock, POLLIN, 0};
+            if (poll(&pfd, 1, 50) <= 0) continue;
+            uint8_t b;
+            if (recv(sock, &b, 1, 0) <= 0) {
+                closed_ms = (now_us() - t0) / 1000.0;
+                break;
+            }
+        }
+    }
+    close(sock);
+    body.free();
+    frame.free();
+    return closed_ms;
+}
+
+// Pulls the metrics endpoint; returns the body or an empty string
+static std::string fetch_metrics() {
+    int sock = tcp_connect(opt.host, opt.metrics_port);
+    if (sock < 0) return "";
+    const char req[] = "GET /metrics HTTP/1.0\r\n\r\n";
+    send(sock, req, sizeof(req) - 1, MSG_NOSIGNAL);
+    std::string body;
+    char buf[4096];
+    ssize_t r;
+    while ((r = recv(sock, buf, sizeof(buf), 0)) > 0) body.append(buf, r);
+    close(sock);
+    return body;
+}
+
+static double metric_value(const std::string& body, const std::string& key) {
+    size_t p = body.find(key + " ");
+    if (p == std::string::npos) return -1;
+    return atof(body.c_str() + p + key.size() + 1);
+}
+
+static PathKind parse_path(const char* s, int bot) {
+    if (!strcmp(s, "walk")) return PathKind::WALK;
+    if (!strcmp(s, "fly")) return PathKind::FLY;
+    if (!strcmp(s, "teleport")) return PathKind::TELEPORT;
+    return static_cast<PathKind>(bot % 3);
+}
+
+int main(int argc, char** argv) {
+    for (int i = 1; i + 1 < argc; i += 2) {
+        const char* k = argv[i];
+        const char* v = argv[i + 1];
+        if (!strcmp(k, "--host")) opt.host = v;
+        else if (!strcmp(k, "--port")) opt.port = atoi(v);
+        else if (!strcmp(k, "--metrics-port")) opt.metrics_port = atoi(v);
+        else if (!strcmp(k, "--bots")) opt.bots = atoi(v);
+        else if (!strcmp(k, "--seconds")) opt.seconds = atoi(v);
+        else if (!strcmp(k, "--path")) opt.path = v;
+        else if (!strcmp(k, "--delay-ms")) opt.delay_ms = atoi(v);
+        else if (!strcmp(k, "--kbps")) opt.kbps = atoi(v);
+        else if (!strcmp(k, "--chat-ms")) opt.chat_ms = atoi(v);
+        else if (!strcmp(k, "--dig-ms")) opt.dig_ms = atoi(v);
+        else if (!strcmp(k, "--move-ms")) opt.move_ms = std::max(1, atoi(v));
+        else if (!strcmp(k, "--slot-ms")) opt.slot_ms = atoi(v);
+        else if (!strcmp(k, "--stall")) opt.stall = atoi(v);
+        else { fprintf(stderr, "unknown option %s\n", k); return 2; }
+    }
+
+    std::string before = fetch_metrics();
+    int64_t t_start = now_us();
+
+    std::vector<double> stall_ms(opt.stall);
+    std::vector<std::thread> stalled;
+    for (int i = 0; i < opt.stall; i++)
+        stalled.emplace_back([&, i] { stall_ms[i] = run_stalled(t_start + opt.seconds * 1000000LL); });
+
+    std::vector<BotStats> stats(opt.bots);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < opt.bots; i++) {
+        threads.emplace_back(run_bot, i, parse_path(opt.path, i), std::ref(stats[i]));
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+
+    // Sample the server while the bots are still online so their RTTs show
+    std::this_thread::sleep_until(std::chrono::steady_clock::now() +
+        std::chrono::microseconds(t_start + opt.seconds * 1000000LL - 500000 - now_us()));
+    double wall_s = (now_us() - t_start) / 1e6;
+    std::string after = fetch_metrics();
+    for (auto& t : threads) t.join();
+    for (auto& t : stalled) t.join();
+
+    std::vector<double> joins, frames;
+    uint64_t chunks = 0, chunk_bytes = 0, bytes_in = 0, unloads = 0;
+    uint32_t kas = 0, chats_sent = 0, chats_seen = 0, handoffs = 0, digs = 0, dig_acks = 0, slots = 0,
+             block_updates = 0, light_updates = 0, moves = 0;
+    double handoff_ms = 0, handoff_max_ms = 0;
+    int rejected = 0;
+    for (int i = 0; i < opt.bots; i++) {
+        const BotStats& s = stats[i];
+        printf("bot%-3d %-8s join=%7.1fms frame=%7.1fms chunks=%5llu unloads=%5llu bytes/chunk=%6.0f keepalives=%u\n",
+               i, s.joined ? "joined" : (s.rejected ? "rejected" : "failed"), s.join_ms, s.frame_ms,
+               static_cast<unsigned long long>(s.chunks), static_cast<unsigned long long>(s.unloads),
+               s.chunks ? static_cast<double>(s.chunk_bytes) / s.chunks : 0.0, s.keepalives);
+        if (s.joined) joins.push_back(s.join_ms);
+        if (s.frame_ms) frames.push_back(s.frame_ms);
+        if (s.rejected) rejected++;
+        chunks += s.chunks;
+        chunk_bytes += s.chunk_bytes;
+        bytes_in += s.bytes_in;
+        unloads += s.unloads;
+        kas += s.keepalives;
+        moves += s.moves;
+        chats_sent += s.chats_sent;
+        chats_seen += s.chats_seen;
+        digs += s.digs;
+        dig_acks += s.dig_acks;
+        slots += s.slots;
+        block_updates += s.block_updates;
+        light_updates += s.light_updates;
+        handoffs += s.handoffs;
+        handoff_ms += s.handoff_ms;
+        handoff_max_ms = std::max(handoff_max_ms, s.handoff_max_ms);
+    }
+    std::sort(joins.begin(), joins.end());
+    std::sort(frames.begin(), frames.end());
+
+    printf("\nbots=%d joined=%zu rejected=%d wall=%.1fs shaping=%dms/%dkbps\n",
+           opt.bots, joins.size(), rejected, wall_s, opt.delay_ms, opt.kbps);
+    if (!joins.empty())
+        printf("join latency   p50=%.1fms max=%.1fms\n", joins[joins.size() / 2], joins.back());
+    if (!frames.empty())
+        printf("first frame    p50=%.1fms max=%.1fms\n", frames[frames.size() / 2], frames.back());
+    printf("chunks         %llu (%.1f/s), %llu unloads\n", static_cast<unsigned long long>(chunks),
+           chunks / wall_s, static_cast<unsigned long long>(unloads));
+    printf("bytes/chunk    %.0f\n", chunks ? static_cast<double>(chunk_bytes) / chunks : 0.0);
+    printf("downlink       %.1f KiB/s\n", bytes_in / wall_s / 1024.0);
+    printf("keep-alives    %u answered\n", kas);
+    printf("moves          %u sent, %.0f/s per bot\n", moves, moves / wall_s / std::max(1, opt.bots));
+    if (opt.chat_ms > 0)
+        printf("chat           %u sent, %u system lines received\n", chats_sent, chats_seen);
+    if (opt.dig_ms > 0)
+        printf("digs           %u sent, %u acknowledged, %u block change and %u light packets received\n", digs,
+               dig_acks, block_updates, light_updates);
+    if (opt.slot_ms > 0) printf("slots          %u creative slots set\n", slots);
+    if (opt.stall > 0) {
+        int open = 0;
+        double max_ms = 0;
+        for (double ms : stall_ms) {
+            if (ms < 0) open++;
+            else max_ms = std::max(max_ms, ms);
+        }
+        printf("stalled        %d mid-frame, %d closed by the server (last after %.0fms), %d still open\n", opt.stall,
+               opt.stall - open, max_ms, open);
+    }
+    if (handoffs)
+        printf("handoffs       %u, mean=%.1fms max=%.1fms\n", handoffs, handoff_ms / handoffs, handoff_max_ms);
+
+    if (after.empty()) {
+        printf("server metrics unavailable on port %d\n", opt.metrics_port);
+        return 0;
+    }
+    const char* loop_key = "mc_stage_us_sum{stage=\"loop\"}";
+    double busy_us = metric_value(after, loop_key) - std::max(0.0, metric_value(before, loop_key));
+    // Busy time per 50 ms game tick, comparable to vanilla MSPT
+    printf("server mspt    %.2f\n", busy_us / 1000.0 / (wall_s * 20.0));
+    const char* move_key = "mc_stage_us_sum{stage=\"move\"}";
+    double move_us = metric_value(after, move_key) - std::max(0.0, metric_value(before, move_key));
+    if (move_us >= 0) printf("server move    %.1f us/tick applying movement\n", move_us / (wall_s * 20.0));
+    for (int i = 0; i < opt.bots; i++) {
+        char key[64];
+        snprintf(key, sizeof(key), "mc_keepalive_rtt_ms{player=\"bot%d\"}", i);
+        double rtt = metric_value(after, key);
+        if (rtt >= 0) printf("keep-alive rtt bot%d %.0fms\n", i, rtt);
+    }
+    return 0;
+}
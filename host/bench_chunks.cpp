@@ -0,0 +1,211 @@
+// Chunk generation benchmark: builds a grid of Chunk Data packets into a
+// null sink and reports throughput, bytes per chunk and the send_chunk
+// stage breakdown. Every chunk's bytes are hashed (FNV-1a 64) so changes
+// to the generator or encoders can be checked against a golden file.
+//
+//   mc_bench_chunks [--radius 8] [--origin 0 0] [--reps 3] [--world world.bin]
+//                   [--check chunks.golden] [--write chunks.golden]
+//
+// --world reads the chunks an mc_bake image covers from it instead of
+// generating them; the bytes must come out the same. The low-detail chunks
+// of the ring beyond the view distance are timed over the same grid, and
+// so is the generator with its cave and ore stage turned off.
+// The grid covers origin-radius .. origin+radius-1 on both axes. --check
+// exits non-zero if any chunk differs from the golden file.
+
+#include "mc_packet.h"
+#include "mc_play.h"
+#include "mc_metrics.h"
+#include "mc_shared.h"
+#include "mc_bake.h"
+#include "esp_partition.h"
+#include "config.h"
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <utility>
+
+static constexpr int BLOCKS_PER_CHUNK = 16 * 16 * 384;
+
+struct ChunkHash {
+    uint64_t hash;
+    uint32_t bytes;
+};
+
+using HashMap = std::map<std::pair<int, int>, ChunkHash>;
+
+// Over the packet's pieces in order, as they would go out
+static uint64_t fnv1a64(const PacketBuf& pkt) {
+    NetSeg segs[PACKET_SEGS];
+    int n = pkt.segments(segs, pkt.data);
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (int s = 0; s < n; s++) {
+        auto* p = static_cast<const uint8_t*>(segs[s].data);
+        for (size_t i = 0; i < segs[s].len; i++) {
+            h ^= p[i];
+            h *= 0x100000001b3ULL;
+        }
+    }
+    return h;
+}
+
+static int64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static bool load_golden(const char* path, HashMap& golden) {
+    FILE* f = fopen(path, "r");
+    if (!f) { perror(path); return false; }
+    char line[128];
+    while (fgets(line, sizeof(line), f)) {
+        if (line[0] == '#') continue;
+        int cx, cz;
+        unsigned bytes;
+        uint64_t hash;
+        if (sscanf(line, "%d %d %u %" SCNx64, &cx, &cz, &bytes, &hash) == 4)
+            golden[{cx, cz}] = {hash, bytes};
+    }
+    fclose(f);
+    return true;
+}
+
+static bool write_golden(const char* path, const HashMap& hashes) {
+    FILE* f = fopen(path, "w");
+    if (!f) { perror(path); return false; }
+    fprintf(f, "# mc_bench_chunks: cx cz bytes fnv1a64\n");
+    for (auto& [pos, h] : hashes)
+        fprintf(f, "%d %d %u %016" PRIx64 "\n", pos.first, pos.second, h.bytes, h.hash);
+    fclose(f);
+    return true;
+}
+
+int main(int argc, char** argv) {
+    int radius = 8, ox = 0, oz = 0, reps = 3;
+    const char* check_path = nullptr;
+    const char* write_path = nullptr;
+    for (int i = 1; i < argc; i++) {
+        const char* k = argv[i];
+        if (!strcmp(k, "--radius") && i + 1 < argc) radius = atoi(argv[++i]);
+        else if (!strcmp(k, "--origin") && i + 2 < argc) { ox = atoi(argv[++i]); oz = atoi(argv[++i]); }
+        else if (!strcmp(k, "--reps") && i + 1 < argc) reps = atoi(argv[++i]);
+        else if (!strcmp(k, "--check") && i + 1 < argc) check_path = argv[++i];
+        else if (!strcmp(k, "--write") && i + 1 < argc) write_path = argv[++i];
+        else if (!strcmp(k, "--world") && i + 1 < argc) {
+            if (!host_partition_file(MC_WORLD_PARTITION, argv[++i]) || !bake_open()) {
+                fprintf(stderr, "cannot use %s as the world image\n", argv[i]);
+                return 1;
+            }
+        }
+        else {
+            fprintf(stderr, "unknown option %s\n", k);
+            return 2;
+        }
+    }
+    if (radius < 1) radius = 1;
+    if (reps < 1) reps = 1;
+
+    PacketBuf out;
+    out.init(64 * 1024);
+
+    // Untimed pass: warms caches and produces the hashes
+    HashMap hashes;
+    for (int cz = oz - radius; cz < oz + radius; cz++)
+        for (int cx = ox - radius; cx < ox + radius; cx++) {
+            build_chunk(out, cx, cz);
+            hashes[{cx, cz}] = {fnv1a64(out), static_cast<uint32_t>(out.total())};
+        }
+
+#if MC_METRICS
+    metrics_stage_reset();
+#endif
+    uint64_t chunks = 0, bytes = 0;
+    int64_t t0 = now_ns();
+    for (int r = 0; r < reps; r++)
+        for (int cz = oz - radius; cz < oz + radius; cz++)
+            for (int cx = ox - radius; cx < ox + radius; cx++) {
+                build_chunk(out, cx, cz);
+                chunks++;
+                bytes += out.total();
+            }
+    double secs = (now_ns() - t0) / 1e9;
+
+    // The same grid from the heightmap alone, without caves or ores
+    gen_set_caves(false);
+    t0 = now_ns();
+    for (int r = 0; r < reps; r++)
+        for (int cz = oz - radius; cz < oz + radius; cz++)
+            for (int cx = ox - radius; cx < ox + radius; cx++) build_chunk(out, cx, cz);
+    double flat_secs = (now_ns() - t0) / 1e9;
+    gen_set_caves(true);
+
+    uint64_t lod_bytes = 0;
+    t0 = now_ns();
+    for (int r = 0; r < reps; r++)
+        for (int cz = oz - radius; cz < oz + radius; cz++)
+            for (int cx = ox - radius; cx < ox + radius; cx++) {
+                build_lod_chunk(out, cx, cz);
+                lod_bytes += out.total();
+            }
+    double lod_secs = (now_ns() - t0) / 1e9;
+
+#if MC_METRICS
+    // Bytes memcpy'd building each chunk and queueing it to a connection
+    size_t copied = metrics_copy_bytes.load(std::memory_order_relaxed);
+    for (int cz = oz - radius; cz < oz + radius; cz++)
+        for (int cx = ox - radius; cx < ox + radius; cx++) {
+            build_chunk(out, cx, cz);
+            SharedPacket* p = shared_packet(out);
+            if (p) shared_release(p);
+        }
+    copied = metrics_copy_bytes.load(std::memory_order_relaxed) - copied;
+#endif
+
+    int side = 2 * radius;
+    printf("grid       %dx%d chunks at (%d, %d), %d reps\n", side, side, ox, oz, reps);
+    printf("chunks/s   %.1f\n", chunks / secs);
+    printf("us/chunk   %.1f\n", secs * 1e6 / chunks);
+    printf("2d only    %.1f chunks/s, %.1f us/chunk without caves and ores\n", chunks / flat_secs,
+           flat_secs * 1e6 / chunks);
+    printf("ns/block   %.2f\n", secs * 1e9 / (static_cast<double>(chunks) * BLOCKS_PER_CHUNK));
+    printf("bytes      %.0f per chunk\n", static_cast<double>(bytes) / chunks);
+    printf("low detail %.1f us/chunk, %.0f bytes per chunk\n", lod_secs * 1e6 / chunks,
+           static_cast<double>(lod_bytes) / chunks);
+#if MC_METRICS
+    printf("copied     %.0f bytes per chunk, built and queued\n", static_cast<double>(copied) / (side * side));
+    for (int s = STAGE_HEIGHTMAP; s <= STAGE_SKYLIGHT; s++) {
+        uint32_t count;
+        uint64_t total_us;
+        metrics_stage_total(s, count, total_us);
+        if (count)
+            printf("  %-9s %8.1f us/chunk\n", metrics_stage_name(s), static_cast<double>(total_us) / count);
+    }
+#endif
+
+    int status = 0;
+    if (check_path) {
+        HashMap golden;
+        if (!load_golden(check_path, golden)) return 1;
+        int checked = 0, differ = 0;
+        for (auto& [pos, h] : hashes) {
+            auto it = golden.find(pos);
+            if (it == golden.end()) continue;
+            checked++;
+            if (it->second.hash == h.hash && it->second.bytes == h.bytes) continue;
+            if (differ++ < 10)
+                printf("  differs  (%d, %d): %u bytes %016" PRIx64 ", golden %u bytes %016" PRIx64 "\n",
+                       pos.first, pos.second, h.bytes, h.hash, it->second.bytes, it->second.hash);
+        }
+        printf("golden     %d checked, %d differ, %d not in %s\n",
+               checked, differ, static_cast<int>(hashes.size()) - checked, check_path);
+        if (differ || !checked) status = 1;
+    }
+    if (write_path) {
+        if (!write_golden(write_path, hashes)) return 1;
+        printf("golden     wrote %d chunks to %s\n", static_cast<int>(hashes.size()), write_path);
+    }
+    return status;
+}
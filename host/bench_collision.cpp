@@ -0,0 +1,178 @@
+// Collision query benchmark: players random-walk over generated terrain and
+// every 20 Hz tick each one moves with three axis sweeps, checks its box for
+// solid and fluid blocks and casts a 5-block reach ray, all against the
+// occupancy masks. The same box test done block by block through the
+// generator is timed as the baseline, and a sample of blocks is compared
+// between masks and generator.
+//
+//   mc_bench_collision [--players 100] [--ticks 200] [--radius 40] [--verify 20000]
+//
+// --radius is the half-size in blocks of the area players walk in. The area
+// plus a reach margin must fit in MC_WORLD_COLUMNS, or the run measures
+// column regeneration instead of queries.
+
+#include "mc_world.h"
+#include "mc_play.h"
+#include "config.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+static constexpr float TICK_S = 0.05f;
+static constexpr float HALF_WIDTH = 0.3f;
+static constexpr float HEIGHT = 1.8f;
+static constexpr float REACH = 5.0f;
+static constexpr int MARGIN = 8;
+
+static int64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+struct Player {
+    Aabb box;
+    float vx, vy, vz;
+    float yaw, pitch;
+};
+
+static Aabb box_at(float x, float y, float z) {
+    return {{x - HALF_WIDTH, y, z - HALF_WIDTH}, {x + HALF_WIDTH, y + HEIGHT, z + HALF_WIDTH}};
+}
+
+static bool naive_box_solid(const Aabb& b) {
+    for (int y = static_cast<int>(floorf(b.min[1])); y < b.max[1]; y++)
+        for (int z = static_cast<int>(floorf(b.min[2])); z < b.max[2]; z++)
+            for (int x = static_cast<int>(floorf(b.min[0])); x < b.max[0]; x++)
+                if (gen_block_occ(x, y, z) == OCC_SOLID) return true;
+    return false;
+}
+
+int main(int argc, char** argv) {
+    int players = 100, ticks = 200, radius = 40, verify = 20000;
+    for (int i = 1; i < argc; i++) {
+        const char* k = argv[i];
+        if (!strcmp(k, "--players") && i + 1 < argc) players = atoi(argv[++i]);
+        else if (!strcmp(k, "--ticks") && i + 1 < argc) ticks = atoi(argv[++i]);
+        else if (!strcmp(k, "--radius") && i + 1 < argc) radius = atoi(argv[++i]);
+        else if (!strcmp(k, "--verify") && i + 1 < argc) verify = atoi(argv[++i]);
+        else {
+            fprintf(stderr, "unknown option %s\n", k);
+            return 2;
+        }
+    }
+    if (players < 1) players = 1;
+    if (ticks < 1) ticks = 1;
+    if (radius < 1) radius = 1;
+
+    // Warm the column cache over the area and everything a ray can reach
+    int c0 = (-radius - MARGIN) >> 4, c1 = (radius + MARGIN - 1) >> 4;
+    if ((c1 - c0 + 1) * (c1 - c0 + 1) > MC_WORLD_COLUMNS)
+        fprintf(stderr, "warning: %d columns needed, cache holds %d\n", (c1 - c0 + 1) * (c1 - c0 + 1),
+                MC_WORLD_COLUMNS);
+    int columns = 0, mixed = 0, full = 0;
+    int64_t t0 = now_ns();
+    for (int cz = c0; cz <= c1; cz++)
+        for (int cx = c0; cx <= c1; cx++) {
+            const WorldColumn* c = world_column(cx, cz);
+            if (!c) continue;
+            columns++;
+            for (int s = 0; s < WORLD_SECTIONS; s++) {
+                mixed += c->kind[s] == SECTION_MIXED;
+                full += c->kind[s] == SECTION_FULL;
+            }
+        }
+    int64_t gen_ns = now_ns() - t0;
+    printf("world      %d columns (cache %d), %.2f ms/column, %d mixed + %d full sections, %zu KB masks\n",
+           columns, MC_WORLD_COLUMNS, columns ? gen_ns / 1e6 / columns : 0.0, mixed, full,
+           mixed * sizeof(SectionMask) / 1024);
+
+    std::mt19937 rng(4321);
+    std::uniform_real_distribution<float> pos(-radius + 1.0f, radius - 1.0f), unit(-1.0f, 1.0f);
+
+    int differ = 0;
+    for (int i = 0; i < verify; i++) {
+        int x = static_cast<int>(floorf(pos(rng))), z = static_cast<int>(floorf(pos(rng)));
+        int y = WORLD_MIN_Y + static_cast<int>(rng() % 96);
+        if (world_block(x, y, z) != gen_block_occ(x, y, z)) {
+            if (differ < 5) fprintf(stderr, "mismatch at %d %d %d\n", x, y, z);
+            differ++;
+        }
+    }
+    printf("verify     %d blocks, %d differ\n", verify, differ);
+
+    std::vector<Player> ps(players);
+    for (auto& p : ps) {
+        p.box = box_at(pos(rng), 40.0f, pos(rng));
+        p.vx = p.vy = p.vz = 0.0f;
+        p.yaw = unit(rng) * 3.14159f;
+        p.pitch = unit(rng) * 0.8f;
+    }
+
+    int64_t move_ns = 0, box_ns = 0, ray_ns = 0;
+    uint64_t blocked = 0, stuck = 0, hits = 0, in_fluid = 0;
+    for (int tick = 0; tick < ticks; tick++) {
+        int64_t a = now_ns();
+        for (auto& p : ps) {
+            if (rng() % 20 == 0) p.yaw = unit(rng) * 3.14159f;
+            p.vx = cosf(p.yaw) * 4.3f * TICK_S;
+            p.vz = sinf(p.yaw) * 4.3f * TICK_S;
+            p.vy -= 0.08f;
+            float dy = world_sweep(p.box, 1, p.vy);
+            if (dy != p.vy) p.vy = 0.0f;
+            // Step up one block when walking into a wall, as a client would
+            bool bx = world_sweep(p.box, 0, p.vx) != p.vx;
+            bool bz = world_sweep(p.box, 2, p.vz) != p.vz;
+            if (bx || bz) {
+                blocked++;
+                p.vy = 0.42f;
+            }
+            // Keep walkers inside the cached area
+            float cx = (p.box.min[0] + p.box.max[0]) * 0.5f, cz = (p.box.min[2] + p.box.max[2]) * 0.5f;
+            if (fabsf(cx) > radius - 2 || fabsf(cz) > radius - 2) p.yaw += 3.14159f;
+        }
+        int64_t b = now_ns();
+        for (auto& p : ps) {
+            stuck += world_box_solid(p.box);
+            in_fluid += world_box_fluid(p.box);
+        }
+        int64_t c = now_ns();
+        for (auto& p : ps) {
+            float eye[3] = {(p.box.min[0] + p.box.max[0]) * 0.5f, p.box.min[1] + 1.62f,
+                            (p.box.min[2] + p.box.max[2]) * 0.5f};
+            float dir[3] = {cosf(p.yaw) * cosf(p.pitch), -sinf(p.pitch), sinf(p.yaw) * cosf(p.pitch)};
+            int hit[3];
+            hits += world_raycast(eye, dir, REACH, hit);
+        }
+        int64_t d = now_ns();
+        move_ns += b - a;
+        box_ns += c - b;
+        ray_ns += d - c;
+    }
+
+    double n = static_cast<double>(players) * ticks;
+    double tick_ns = (move_ns + box_ns + ray_ns) / n;
+    printf("%d players, %d ticks: %.1f%% rays hit, %.1f%% ticks in fluid, %llu blocked moves, %llu in walls\n",
+           players, ticks, 100.0 * hits / n, 100.0 * in_fluid / n, static_cast<unsigned long long>(blocked),
+           static_cast<unsigned long long>(stuck));
+    printf("%-10s %9s %12s\n", "query", "ns", "per s");
+    printf("%-10s %9.1f %12.0f\n", "sweep", move_ns / (n * 3), n * 3 / (move_ns / 1e9));
+    printf("%-10s %9.1f %12.0f\n", "box", box_ns / (n * 2), n * 2 / (box_ns / 1e9));
+    printf("%-10s %9.1f %12.0f\n", "raycast", ray_ns / n, n / (ray_ns / 1e9));
+    printf("%-10s %9.1f %12.0f   (6 queries; per-player ticks per second)\n", "tick", tick_ns, 1e9 / tick_ns);
+
+    // Baseline: the box test done by asking the generator for each block
+    int samples = players < 200 ? players * 5 : 1000;
+    int64_t e = now_ns();
+    uint64_t naive_hits = 0;
+    for (int i = 0; i < samples; i++) naive_hits += naive_box_solid(ps[i % players].box);
+    int64_t naive_ns = now_ns() - e;
+    printf("%-10s %9.1f %12.0f   (generator per block, %llu hits)\n", "naive box", naive_ns / (double)samples,
+           samples / (naive_ns / 1e9), static_cast<unsigned long long>(naive_hits));
+
+    world_clear();
+    return differ ? 1 : 0;
+}
@@ -0,0 +1,124 @@
+// Entity store benchmark: fills a store with a mix of mobs, item drops and
+// players, then times each system over a run of 20 Hz ticks at several
+// population sizes. Churn adds and removes entities every tick, so the cost
+// of keeping the arrays dense is included.
+//
+//   mc_bench_entities [--ticks 200] [--counts 1000,2000,5000,10000] [--churn 1]
+//
+// --churn is the percentage of entities replaced each tick.
+
+#include "mc_entity.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+static constexpr float TICK_S = 0.05f;
+static constexpr int TRACK_RADIUS = 4;
+static constexpr int PLAYERS = 5;
+
+static int64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+struct Timing {
+    int64_t physics = 0, track = 0, despawn = 0, churn = 0;
+};
+
+static EntityType random_type(std::mt19937& rng) {
+    return rng() % 3 == 0 ? ENTITY_ITEM : ENTITY_ZOMBIE;
+}
+
+static EntityId spawn(EntityStore& s, std::mt19937& rng, uint32_t tick) {
+    std::uniform_real_distribution<float> pos(-256.0f, 256.0f), vel(-4.0f, 4.0f);
+    float x = pos(rng), z = pos(rng);
+    EntityId id = entity_add(s, random_type(rng), x, 80.0f, z, 64.0f, tick);
+    int i = entity_index(s, id);
+    if (i >= 0) {
+        s.vx[i] = vel(rng);
+        s.vy[i] = vel(rng);
+        s.vz[i] = vel(rng);
+    }
+    return id;
+}
+
+static void run(int count, int ticks, int churn_pct) {
+    EntityStore s;
+    if (!entity_store_init(s, count + PLAYERS + 1)) {
+        fprintf(stderr, "store of %d entities failed\n", count);
+        return;
+    }
+    std::mt19937 rng(1234);
+    std::vector<EntityId> ids;
+    for (int p = 0; p < PLAYERS; p++)
+        entity_add(s, ENTITY_PLAYER, p * 64.0f, 70.0f, p * 32.0f, 70.0f, 0);
+    // Births are spread over one lifetime so despawns arrive steadily
+    for (int i = 0; i < count; i++) ids.push_back(spawn(s, rng, 0));
+
+    std::vector<EntityId> tracked(s.cap);
+    Timing t;
+    uint64_t seen = 0;
+    int despawned = 0;
+    int churn = count * churn_pct / 100;
+
+    for (int tick = 1; tick <= ticks; tick++) {
+        int64_t t0 = now_ns();
+        entity_physics(s, TICK_S);
+        int64_t t1 = now_ns();
+        for (int p = 0; p < PLAYERS; p++)
+            seen += entity_track(s, p * 4, p * 2, TRACK_RADIUS, tracked.data(), static_cast<int>(tracked.size()));
+        int64_t t2 = now_ns();
+        despawned += entity_despawn(s, static_cast<uint32_t>(tick) * 60);
+        int64_t t3 = now_ns();
+        for (int c = 0; c < churn; c++) {
+            size_t k = rng() % ids.size();
+            entity_remove(s, ids[k]);
+            ids[k] = spawn(s, rng, tick * 60);
+        }
+        int64_t t4 = now_ns();
+        t.physics += t1 - t0;
+        t.track += t2 - t1;
+        t.despawn += t3 - t2;
+        t.churn += t4 - t3;
+    }
+
+    double per_tick = 1.0 / ticks;
+    double n = count;
+    printf("%6d  %8.1f %7.2f  %8.1f %7.2f  %8.1f  %8.1f  %8.1f  %6.1f  %7.1f\n", count,
+           t.physics * per_tick / 1000.0, t.physics * per_tick / n,
+           t.track * per_tick / 1000.0, t.track * per_tick / (n * PLAYERS),
+           t.despawn * per_tick / 1000.0, t.churn * per_tick / 1000.0,
+           (t.physics + t.track + t.despawn + t.churn) * per_tick / 1000.0,
+           static_cast<double>(seen) / (ticks * PLAYERS),
+           static_cast<double>(despawned) / ticks);
+    entity_store_free(s);
+}
+
+int main(int argc, char** argv) {
+    int ticks = 200, churn = 1;
+    std::vector<int> counts = {1000, 2000, 5000, 10000};
+    for (int i = 1; i < argc; i++) {
+        const char* k = argv[i];
+        if (!strcmp(k, "--ticks") && i + 1 < argc) ticks = atoi(argv[++i]);
+        else if (!strcmp(k, "--churn") && i + 1 < argc) churn = atoi(argv[++i]);
+        else if (!strcmp(k, "--counts") && i + 1 < argc) {
+            counts.clear();
+            for (char* p = strtok(argv[++i], ","); p; p = strtok(nullptr, ",")) counts.push_back(atoi(p));
+        } else {
+            fprintf(stderr, "unknown option %s\n", k);
+            return 2;
+        }
+    }
+    if (ticks < 1) ticks = 1;
+
+    printf("store      %u bytes per entity, %d ticks, %d%% churn per tick, %d players tracking r=%d\n",
+           entity_bytes_each(), ticks, churn, PLAYERS, TRACK_RADIUS);
+    printf("%6s  %8s %7s  %8s %7s  %8s  %8s  %8s  %6s  %7s\n", "count", "phys us", "ns/ent",
+           "track us", "ns/ent", "desp us", "churn us", "tick us", "seen", "desp/t");
+    for (int c : counts)
+        if (c > 0 && c < 65000) run(c, ticks, churn);
+    return 0;
+}
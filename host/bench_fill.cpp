@@ -0,0 +1,213 @@
+// Region edit benchmark: on open plains, fills a 2 x 2 chunk box two
+// sections high with stone, clears it to air, and blasts a sphere out of
+// the ground, each done once block by block through tick_set_block and
+// once as a region edit, from the same starting blocks. Reports the time
+// of the edits and their flush, the packets and bytes a viewer of the
+// chunks would get, and the light work.
+//
+//   mc_bench_fill [--radius 7]
+//
+// Fails if the two ways leave different light or blocks, if the collision
+// masks disagree with the blocks, or if putting the original blocks back
+// with a region edit does not bring back the original light.
+
+#include "mc_tick.h"
+#include "mc_light.h"
+#include "mc_play.h"
+#include "mc_world.h"
+#include "config.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+static constexpr int SEA_Y = -52;
+static constexpr int MARGIN = 16;   // light checked this far around the box
+
+static int64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+struct Box { int x0, y0, z0, x1, y1, z1; };
+
+// Blocks and both light channels over the box and MARGIN around it
+struct Snapshot {
+    std::vector<uint8_t> blocks, light;
+};
+
+static Snapshot snapshot(const Box& b) {
+    Snapshot s;
+    for (int y = b.y0 - MARGIN; y <= b.y1 + MARGIN; y++)
+        for (int z = b.z0 - MARGIN; z <= b.z1 + MARGIN; z++)
+            for (int x = b.x0 - MARGIN; x <= b.x1 + MARGIN; x++) {
+                s.blocks.push_back(tick_block(x, y, z));
+                s.light.push_back(static_cast<uint8_t>(light_get(LIGHT_SKY, x, y, z) << 4 |
+                                                       light_get(LIGHT_BLOCK, x, y, z)));
+            }
+    return s;
+}
+
+static int differ(const std::vector<uint8_t>& a, const std::vector<uint8_t>& b) {
+    int n = 0;
+    for (size_t i = 0; i < a.size(); i++) n += a[i] != b[i];
+    return n;
+}
+
+// Blocks whose collision mask disagrees with the tick engine
+static int mask_errors(const Box& b) {
+    int n = 0;
+    for (int y = b.y0 > WORLD_MIN_Y ? b.y0 - 1 : b.y0; y <= b.y1 + 1; y++)
+        for (int z = b.z0 - 1; z <= b.z1 + 1; z++)
+            for (int x = b.x0 - 1; x <= b.x1 + 1; x++) n += world_block(x, y, z) != block_occ(tick_block(x, y, z));
+    return n;
+}
+
+// The blocks of a snapshot put back, for a region edit
+struct Restore {
+    const Box* box;
+    const Snapshot* snap;
+};
+
+static uint8_t restore_block(int x, int y, int z, uint8_t, void* arg) {
+    const auto* r = static_cast<const Restore*>(arg);
+    const Box& b = *r->box;
+    int w = b.x1 - b.x0 + 1 + 2 * MARGIN, d = b.z1 - b.z0 + 1 + 2 * MARGIN;
+    size_t i = (static_cast<size_t>(y - b.y0 + MARGIN) * d + (z - b.z0 + MARGIN)) * w + (x - b.x0 + MARGIN);
+    return r->snap->blocks[i];
+}
+
+struct Sphere { int x, y, z, r; };
+
+static bool in_sphere(const Sphere& s, int x, int y, int z) {
+    int dx = x - s.x, dy = y - s.y, dz = z - s.z;
+    return dx * dx + dy * dy + dz * dz <= s.r * s.r;
+}
+
+static uint8_t blast(int x, int y, int z, uint8_t old, void* arg) {
+    return in_sphere(*static_cast<const Sphere*>(arg), x, y, z) ? static_cast<uint8_t>(PI_AIR) : old;
+}
+
+struct Run {
+    int changes = 0;
+    int64_t ns = 0;
+    TickStats tick_before{}, tick_after{};
+    LightStats light_before{}, light_after{};
+};
+
+enum Shape { FILL, CLEAR, CRATER };
+
+static Run run(Shape shape, bool region, const Box& box, const Sphere& sphere) {
+    Run r;
+    tick_stats(r.tick_before);
+    light_stats(r.light_before);
+    int64_t t0 = now_ns();
+    if (region) {
+        if (shape == CRATER)
+            r.changes = tick_edit_region(sphere.x - sphere.r, sphere.y - sphere.r, sphere.z - sphere.r,
+                                         sphere.x + sphere.r, sphere.y + sphere.r, sphere.z + sphere.r, blast,
+                                         const_cast<Sphere*>(&sphere));
+        else
+            r.changes = tick_fill(box.x0, box.y0, box.z0, box.x1, box.y1, box.z1, shape == FILL ? PI_STONE : PI_AIR);
+    } else if (shape == CRATER) {
+        for (int y = sphere.y - sphere.r; y <= sphere.y + sphere.r; y++)
+            for (int z = sphere.z - sphere.r; z <= sphere.z + sphere.r; z++)
+                for (int x = sphere.x - sphere.r; x <= sphere.x + sphere.r; x++)
+                    if (in_sphere(sphere, x, y, z) && tick_block(x, y, z) != PI_AIR)
+                        r.changes += tick_set_block(x, y, z, PI_AIR);
+    } else {
+        uint8_t pi = shape == FILL ? PI_STONE : PI_AIR;
+        for (int y = box.y0; y <= box.y1; y++)
+            for (int z = box.z0; z <= box.z1; z++)
+                for (int x = box.x0; x <= box.x1; x++)
+                    if (tick_block(x, y, z) != pi) r.changes += tick_set_block(x, y, z, pi);
+    }
+    tick_flush();
+    r.ns = now_ns() - t0;
+    tick_stats(r.tick_after);
+    light_stats(r.light_after);
+    return r;
+}
+
+static void report(const char* shape, const char* method, const Run& r) {
+    const TickStats &a = r.tick_before, &b = r.tick_after;
+    printf("%-7s %-7s %6d blocks %8.2f ms %4u+%-4u+%-2u packets %8u bytes %5u relights %7u light cells %7u light "
+           "bytes\n",
+           shape, method, r.changes, r.ns / 1e6, b.block_updates - a.block_updates,
+           b.section_updates - a.section_updates, b.chunks - a.chunks, b.bytes - a.bytes,
+           r.light_after.relights - r.light_before.relights, r.light_after.cells - r.light_before.cells,
+           r.light_after.bytes - r.light_before.bytes);
+}
+
+int main(int argc, char** argv) {
+    int radius = 7;
+    for (int i = 1; i < argc; i++) {
+        const char* k = argv[i];
+        if (!strcmp(k, "--radius") && i + 1 < argc) radius = atoi(argv[++i]);
+        else {
+            fprintf(stderr, "unknown option %s\n", k);
+            return 2;
+        }
+    }
+    if (radius < 1) radius = 1;
+    if (radius > 15) radius = 15;
+
+    // Dry land over a 2 x 2 chunk square, surface within one section pair
+    int scx = 0, scz = 0, lo_h = 0;
+    bool found = false;
+    for (int r = 0; r < 64 && !found; r++)
+        for (int cz = -r; cz <= r && !found; cz++)
+            for (int cx = -r; cx <= r && !found; cx++) {
+                int lo = 1000, hi = -1000;
+                for (int z = cz * 16; z < cz * 16 + 32; z++)
+                    for (int x = cx * 16; x < cx * 16 + 32; x++) {
+                        int h = spawn_height(x, z) - 1;
+                        if (h < lo) lo = h;
+                        if (h > hi) hi = h;
+                    }
+                if (lo < SEA_Y + 2 || hi - lo > 8) continue;
+                scx = cx;
+                scz = cz;
+                lo_h = lo;
+                found = true;
+            }
+    if (!found) {
+        fprintf(stderr, "no site found\n");
+        return 1;
+    }
+    // Two whole sections from just under the surface up
+    int y0 = ((lo_h - 4 - WORLD_MIN_Y) & ~15) + WORLD_MIN_Y;
+    Box box{scx * 16, y0, scz * 16, scx * 16 + 31, y0 + 31, scz * 16 + 31};
+    Sphere sphere{box.x0 + 16, spawn_height(box.x0 + 16, box.z0 + 16) - 1, box.z0 + 16, radius};
+    printf("site     chunks %d,%d to %d,%d, blocks y %d to %d, surface from y %d; crater radius %d at %d %d %d\n\n",
+           scx, scz, scx + 1, scz + 1, box.y0, box.y1, lo_h, radius, sphere.x, sphere.y, sphere.z);
+
+    Snapshot original = snapshot(box);
+    Restore restore{&box, &original};
+    int light_diff = 0, block_diff = 0, masks = 0, restored = 0;
+    const char* names[] = {"fill", "clear", "crater"};
+    for (int shape = FILL; shape <= CRATER; shape++) {
+        Snapshot after[2];
+        for (int region = 0; region <= 1; region++) {
+            Run r = run(static_cast<Shape>(shape), region, box, sphere);
+            report(names[shape], region ? "region" : "blocks", r);
+            after[region] = snapshot(box);
+            masks += mask_errors(box);
+            tick_edit_region(box.x0 - MARGIN, box.y0 - MARGIN, box.z0 - MARGIN, box.x1 + MARGIN, box.y1 + MARGIN,
+                             box.z1 + MARGIN, restore_block, &restore);
+            tick_flush();
+            Snapshot back = snapshot(box);
+            restored += differ(back.blocks, original.blocks) + differ(back.light, original.light);
+        }
+        light_diff += differ(after[0].light, after[1].light);
+        block_diff += differ(after[0].blocks, after[1].blocks);
+    }
+
+    LightStats st;
+    light_stats(st);
+    printf("\ncheck    %d cells lit differently, %d blocks differ, %d mask errors, %d differ after restoring\n",
+           light_diff, block_diff, masks, restored);
+    printf("light    %u overflowed, %u refused\n", st.overflow, st.full);
+    return light_diff || block_diff || masks || restored || st.overflow || st.full ? 1 : 0;
+}
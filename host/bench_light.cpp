@@ -0,0 +1,276 @@
+// Light benchmark: on a stretch of open plains, digs shafts down from the
+// surface, joins their bottoms with a tunnel across a chunk border, puts a
+// light source in the tunnel and takes it away, then covers the shafts
+// again. Reports the relight cost per block change, the cells it visited
+// and the Update Light bytes it produced, next to the least a chunk-wide
+// relight would pay: the column's sky light worked out afresh for its
+// sections, straight down and then breadth first.
+//
+//   mc_bench_light [--shafts 8] [--depth 8] [--torch 14]
+//
+// Fails if, after any phase, a cell holds light nothing supplies or less
+// light than a neighbour passes it, or if block light is left behind once
+// the light source is gone.
+
+#include "mc_light.h"
+#include "mc_tick.h"
+#include "mc_play.h"
+#include "mc_world.h"
+#include "config.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+static constexpr int SEA_Y = -52;
+
+static int64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static bool clear(uint8_t pi) { return pi == PI_AIR || pi == PI_TALLGRASS; }
+
+struct Phase {
+    int changes = 0;
+    int64_t total_ns = 0, max_ns = 0;
+    LightStats before{};
+    LightStats after{};
+};
+
+static void begin(Phase& p) { light_stats(p.before); }
+
+static void timed_set(Phase& p, int x, int y, int z, uint8_t pi) {
+    int64_t t0 = now_ns();
+    tick_set_block(x, y, z, pi);
+    int64_t ns = now_ns() - t0;
+    p.changes++;
+    p.total_ns += ns;
+    if (ns > p.max_ns) p.max_ns = ns;
+}
+
+static void timed_emit(Phase& p, int x, int y, int z, int lv) {
+    int64_t t0 = now_ns();
+    light_set_emission(x, y, z, lv);
+    int64_t ns = now_ns() - t0;
+    p.changes++;
+    p.total_ns += ns;
+    if (ns > p.max_ns) p.max_ns = ns;
+}
+
+static void end(Phase& p) {
+    light_flush();
+    light_stats(p.after);
+}
+
+static void report(const char* name, const Phase& p) {
+    int n = p.changes ? p.changes : 1;
+    printf("%-8s %4d changes %7.1f us/change (max %7.1f) %6.0f cells/change %4u updates %7.0f bytes/change\n",
+           name, p.changes, p.total_ns / 1e3 / n, p.max_ns / 1e3,
+           static_cast<double>(p.after.cells - p.before.cells) / n, p.after.updates - p.before.updates,
+           static_cast<double>(p.after.bytes - p.before.bytes) / n);
+}
+
+// Light a clear cell should hold given its neighbours and emission
+static int expected(LightChannel ch, int x, int y, int z) {
+    static const int D[6][3] = {{1, 0, 0}, {-1, 0, 0}, {0, 0, 1}, {0, 0, -1}, {0, 1, 0}, {0, -1, 0}};
+    int best = 0;
+    for (int d = 0; d < 6; d++) {
+        int nl = light_get(ch, x + D[d][0], y + D[d][1], z + D[d][2]);
+        int v = ch == LIGHT_SKY && d == 4 && nl == 15 ? 15 : nl - 1;
+        if (v > best) best = v;
+    }
+    return best;
+}
+
+struct Box { int x0, x1, y0, y1, z0, z1; };
+
+// Clear cells whose light differs from what their neighbours give them:
+// too bright is unsupported, too dark is unlit
+static void verify(const Box& b, int emit_x, int emit_y, int emit_z, int emit, int& bright, int& dark) {
+    bright = dark = 0;
+    for (int y = b.y0; y <= b.y1; y++)
+        for (int z = b.z0; z <= b.z1; z++)
+            for (int x = b.x0; x <= b.x1; x++) {
+                if (!clear(tick_block(x, y, z))) continue;
+                for (int c = LIGHT_SKY; c <= LIGHT_BLOCK; c++) {
+                    auto ch = static_cast<LightChannel>(c);
+                    int want = expected(ch, x, y, z);
+                    if (ch == LIGHT_BLOCK && x == emit_x && y == emit_y && z == emit_z && emit > want) want = emit;
+                    int have = light_get(ch, x, y, z);
+                    bright += have > want;
+                    dark += have < want;
+                }
+            }
+}
+
+// Sky light of one chunk column worked out from its blocks alone
+static int64_t full_relight_ns(int cx, int cz, int top_si) {
+    const int H = (top_si + 1) * 16;
+    std::vector<uint8_t> pis(static_cast<size_t>(H) * 256), sky(pis.size());
+    for (int si = 0; si <= top_si; si++) {
+        gen_section_at(&pis[si * 4096], cx, cz, si);
+        tick_apply_edits(cx, cz, si, &pis[si * 4096], 1);
+    }
+    std::vector<int> queue;
+    queue.reserve(pis.size());
+    int64_t t0 = now_ns();
+    std::fill(sky.begin(), sky.end(), 0);
+    for (int col = 0; col < 256; col++)
+        for (int y = H - 1; y >= 0 && clear(pis[col + y * 256]); y--) {
+            sky[col + y * 256] = 15;
+            queue.push_back(col + y * 256);
+        }
+    for (size_t head = 0; head < queue.size(); head++) {
+        int i = queue[head];
+        int x = i & 15, z = (i >> 4) & 15, y = i >> 8;
+        int lv = sky[i] - 1;
+        if (lv <= 0) continue;
+        const int n[4][2] = {{x + 1, z}, {x - 1, z}, {x, z + 1}, {x, z - 1}};
+        for (const auto& c : n) {
+            if (c[0] < 0 || c[0] > 15 || c[1] < 0 || c[1] > 15) continue;
+            int j = c[0] + c[1] * 16 + y * 256;
+            if (clear(pis[j]) && sky[j] < lv) {
+                sky[j] = static_cast<uint8_t>(lv);
+                queue.push_back(j);
+            }
+        }
+        if (y > 0 && clear(pis[i - 256]) && sky[i - 256] < lv) {
+            sky[i - 256] = static_cast<uint8_t>(lv);
+            queue.push_back(i - 256);
+        }
+    }
+    return now_ns() - t0;
+}
+
+int main(int argc, char** argv) {
+    int shafts = 8, depth = 8, torch = 14;
+    for (int i = 1; i < argc; i++) {
+        const char* k = argv[i];
+        if (!strcmp(k, "--shafts") && i + 1 < argc) shafts = atoi(argv[++i]);
+        else if (!strcmp(k, "--depth") && i + 1 < argc) depth = atoi(argv[++i]);
+        else if (!strcmp(k, "--torch") && i + 1 < argc) torch = atoi(argv[++i]);
+        else {
+            fprintf(stderr, "unknown option %s\n", k);
+            return 2;
+        }
+    }
+    if (shafts < 2) shafts = 2;
+    if (depth < 2) depth = 2;
+    const int spacing = 3, length = (shafts - 1) * spacing;
+
+    // Dry land with no tree near the line of shafts, crossing a chunk
+    // border along x
+    int sx = 0, sz = 0;
+    bool found = false;
+    for (int r = 0; r < 2048 && !found; r += 16)
+        for (int z = -r; z <= r && !found; z += 16)
+            for (int x = -r; x <= r && !found; x += 16) {
+                int bx = x + 16 - length / 2;
+                bool ok = true;
+                for (int dz = -4; dz <= 4 && ok; dz++)
+                    for (int dx = -4; dx <= length + 4 && ok; dx++) {
+                        int h = spawn_height(bx + dx, z + dz) - 1;
+                        ok = h >= SEA_Y + 3 && h - depth - 2 >= WORLD_MIN_Y;
+                        for (int y = h + 1; y <= h + 6 && ok; y++) ok = clear(tick_block(bx + dx, y, z + dz));
+                    }
+                if (!ok) continue;
+                sx = bx;
+                sz = z;
+                found = true;
+            }
+    if (!found) {
+        fprintf(stderr, "no site found\n");
+        return 1;
+    }
+    int floor_y = 1000;
+    for (int i = 0; i <= length; i++) {
+        int h = spawn_height(sx + i, sz) - 1;
+        if (h < floor_y) floor_y = h;
+    }
+    floor_y -= depth;
+    printf("site       %d shafts %d apart from %d %d, tunnel at y %d\n", shafts, spacing, sx, sz, floor_y);
+
+    Box box{sx - 3, sx + length + 3, floor_y - 2, floor_y + depth + 24, sz - 3, sz + 3};
+    int bright = 0, dark = 0, bad = 0;
+    verify(box, 0, 0, 0, 0, bright, dark);
+    int bright0 = bright, dark0 = dark;
+    int worst_bright = 0, worst_dark = 0;
+    auto check = [&](int ex, int ey, int ez, int emit) {
+        verify(box, ex, ey, ez, emit, bright, dark);
+        if (bright > worst_bright) worst_bright = bright;
+        if (dark > worst_dark) worst_dark = dark;
+        bad += bright + dark;
+    };
+
+    // Shafts from the surface to the tunnel floor
+    Phase p_dig;
+    begin(p_dig);
+    for (int s = 0; s < shafts; s++) {
+        int x = sx + s * spacing;
+        for (int y = spawn_height(x, sz) - 1; y >= floor_y; y--) timed_set(p_dig, x, y, sz, PI_AIR);
+    }
+    end(p_dig);
+    check(0, 0, 0, 0);
+
+    // Tunnel joining the shaft bottoms
+    Phase p_tunnel;
+    begin(p_tunnel);
+    for (int i = 0; i <= length; i++)
+        for (int y = floor_y; y <= floor_y + 1; y++)
+            if (!clear(tick_block(sx + i, y, sz))) timed_set(p_tunnel, sx + i, y, sz, PI_AIR);
+    end(p_tunnel);
+    check(0, 0, 0, 0);
+
+    // A light source in the middle of the tunnel, then gone
+    int tx = sx + shafts / 2 * spacing + 1;
+    Phase p_torch;
+    begin(p_torch);
+    timed_emit(p_torch, tx, floor_y, sz, torch);
+    end(p_torch);
+    check(tx, floor_y, sz, torch);
+    int lit = 0;
+    for (int i = 0; i <= length; i++) lit += light_get(LIGHT_BLOCK, sx + i, floor_y + 1, sz) > 0;
+    timed_emit(p_torch, tx, floor_y, sz, 0);
+    end(p_torch);
+    check(0, 0, 0, 0);
+    int left = 0;
+    for (int y = box.y0; y <= box.y1; y++)
+        for (int z = box.z0; z <= box.z1; z++)
+            for (int x = box.x0; x <= box.x1; x++) left += light_get(LIGHT_BLOCK, x, y, z) > 0;
+
+    // Shafts covered at the surface
+    Phase p_cover;
+    begin(p_cover);
+    for (int s = 0; s < shafts; s++) {
+        int x = sx + s * spacing;
+        timed_set(p_cover, x, spawn_height(x, sz) - 1, sz, PI_DIRT);
+    }
+    end(p_cover);
+    check(0, 0, 0, 0);
+
+    // Baseline over the chunk holding the middle of the tunnel
+    int top_si = (box.y1 - WORLD_MIN_Y) >> 4;
+    int64_t full_ns = 0;
+    for (int rep = 0; rep < 10; rep++) full_ns += full_relight_ns(tx >> 4, sz >> 4, top_si);
+    full_ns /= 10;
+
+    printf("\n");
+    report("dig", p_dig);
+    report("tunnel", p_tunnel);
+    report("torch", p_torch);
+    report("cover", p_cover);
+    printf("%-8s %4d changes %7.1f us/change (sky of one chunk, %d sections, from its blocks)\n", "column", 1,
+           full_ns / 1e3, top_si + 1);
+
+    LightStats st;
+    light_stats(st);
+    printf("\nlight      %u sections relit, %u relights took at most %u us, %u overflowed, %u refused\n",
+           st.sections, st.relights, st.max_us, st.overflow, st.full);
+    printf("torch      lit %d of %d tunnel cells, %d cells with block light after removal\n", lit, length + 1,
+           left);
+    printf("check      at worst %d unsupported, %d unlit after a phase (generated light: %d, %d)\n", worst_bright,
+           worst_dark, bright0, dark0);
+    return bad || bright0 || dark0 || left || !lit || st.overflow || st.full ? 1 : 0;
+}
@@ -0,0 +1,391 @@
+// Navigation benchmark: on a stretch each of plains, mountains and ocean,
+// mobs ask for paths between random places to stand up to --range blocks
+// apart, and the searches advance MC_NAV_BUDGET cells per game tick.
+// Reports paths per second, cells expanded and game ticks per path, cold
+// (walkability worked out on the way) and warm, next to a plain A* over
+// world_block with the same moves. Then --mobs mobs chase one target and
+// share its search, and a wall built across a path must send the next one
+// around it.
+//
+//   mc_bench_nav [--paths 200] [--range 24] [--mobs 16] [--seed 1]
+//
+// Fails if a path costs other than the plain search's best, takes a move
+// the rules do not allow, or goes through the wall, or if a terrain yields
+// no path at all.
+
+#include "mc_nav.h"
+#include "mc_tick.h"
+#include "mc_play.h"
+#include "mc_world.h"
+#include "config.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <queue>
+#include <unordered_map>
+#include <vector>
+
+static constexpr int SEA_Y = -52;
+static constexpr int WORLD_TOP = WORLD_MIN_Y + WORLD_SECTIONS * 16;
+static constexpr int MAX_PATH = 4096;
+
+static int64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static uint32_t rng = 1;
+static int rand_in(int lo, int hi) {
+    rng = rng * 1664525u + 1013904223u;
+    return lo + static_cast<int>((rng >> 8) % static_cast<uint32_t>(hi - lo + 1));
+}
+
+// ---- The same moves over world_block ----
+
+static bool open_at(int x, int y, int z) {
+    if (y >= WORLD_TOP) return true;
+    return y >= WORLD_MIN_Y && world_block(x, y, z) != OCC_SOLID;
+}
+
+static bool stand_at(int x, int y, int z) {
+    if (y < WORLD_MIN_Y || y >= WORLD_TOP) return false;
+    BlockOcc feet = world_block(x, y, z);
+    return feet != OCC_SOLID && world_block(x, y + 1, z) == OCC_EMPTY &&
+           (feet == OCC_FLUID || world_block(x, y - 1, z) == OCC_SOLID);
+}
+
+static int cost_of(const NavPos& a, const NavPos& b) {
+    int dx = b.x - a.x, dz = b.z - a.z, dh = b.y - a.y;
+    if (abs(dx) > 1 || abs(dz) > 1 || (!dx && !dz)) return -1;
+    bool diag = dx && dz;
+    int cost;
+    if (dh == 0) {
+        if (diag && !(open_at(b.x, a.y, a.z) && open_at(b.x, a.y + 1, a.z) && open_at(a.x, a.y, b.z) &&
+                      open_at(a.x, a.y + 1, b.z)))
+            return -1;
+        cost = diag ? 14 : 10;
+    } else if (dh == 1) {
+        if (diag || !open_at(a.x, a.y + 2, a.z)) return -1;
+        cost = 20;
+    } else {
+        if (diag || dh < -3) return -1;
+        for (int y = b.y + 2; y <= a.y + 1; y++)
+            if (!open_at(b.x, y, b.z)) return -1;
+        cost = 10 - 4 * dh;
+    }
+    return world_block(b.x, b.y, b.z) == OCC_FLUID ? cost * 2 : cost;
+}
+
+static uint64_t key_of(int x, int y, int z) {
+    return (static_cast<uint64_t>(x & 0xFFFFFF) << 40) | (static_cast<uint64_t>(z & 0xFFFFFF) << 16) |
+           static_cast<uint64_t>(y & 0xFFFF);
+}
+
+// Least cost from a to b, forward A*; -1 if none within `limit` cells
+static int plain_astar(const NavPos& a, const NavPos& b, int limit, int& expanded) {
+    struct Open { uint32_t f; int g; NavPos p; };
+    auto cmp = [](const Open& l, const Open& r) { return l.f > r.f; };
+    std::priority_queue<Open, std::vector<Open>, decltype(cmp)> open(cmp);
+    std::unordered_map<uint64_t, int> best;
+    auto h = [&](const NavPos& p) {
+        int dx = abs(p.x - b.x), dz = abs(p.z - b.z);
+        return static_cast<uint32_t>(dx > dz ? 10 * dx + 4 * dz : 10 * dz + 4 * dx);
+    };
+    static const int D[8][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}, {1, 1}, {1, -1}, {-1, 1}, {-1, -1}};
+    expanded = 0;
+    open.push({h(a), 0, a});
+    best[key_of(a.x, a.y, a.z)] = 0;
+    while (!open.empty() && expanded < limit) {
+        Open o = open.top();
+        open.pop();
+        if (o.g > best[key_of(o.p.x, o.p.y, o.p.z)]) continue;
+        if (o.p.x == b.x && o.p.y == b.y && o.p.z == b.z) return o.g;
+        expanded++;
+        for (const auto& d : D)
+            for (int ny = o.p.y + 1; ny >= o.p.y - 3; ny--) {
+                NavPos n{o.p.x + d[0], ny, o.p.z + d[1]};
+                if (!stand_at(n.x, n.y, n.z)) continue;
+                int c = cost_of(o.p, n);
+                if (c < 0) continue;
+                int g = o.g + c;
+                auto it = best.find(key_of(n.x, n.y, n.z));
+                if (it != best.end() && it->second <= g) continue;
+                best[key_of(n.x, n.y, n.z)] = g;
+                open.push({g + h(n), g, n});
+            }
+    }
+    return -1;
+}
+
+// ---- Runs ----
+
+struct Pair { NavPos from, to; };
+
+struct Run {
+    int paths = 0, found = 0, none = 0, bad = 0;
+    int64_t total_ns = 0, max_ns = 0;
+    uint64_t ticks = 0, expanded = 0;
+};
+
+static NavPos path_buf[MAX_PATH];
+
+// Cost of a path along the rules, -1 if any step breaks them
+static int path_cost(const NavPos& from, const NavPos* path, int len) {
+    if (len == 0 || path[0].x != from.x || path[0].y != from.y || path[0].z != from.z) return -1;
+    int total = 0;
+    for (int i = 1; i < len; i++) {
+        int c = cost_of(path[i - 1], path[i]);
+        if (c < 0) return -1;
+        total += c;
+    }
+    return total;
+}
+
+// Asks for a path once per game tick until it is settled
+static NavStatus request(const NavPos& from, const NavPos& to, int& len, uint64_t& ticks) {
+    NavStatus st;
+    while ((st = nav_path(from, to, path_buf, MAX_PATH, len)) == NAV_PENDING) {
+        nav_tick();
+        ticks++;
+    }
+    return st;
+}
+
+static Run run_pairs(const std::vector<Pair>& pairs, std::vector<int>* costs) {
+    Run r;
+    NavStats before, after;
+    nav_stats(before);
+    for (const Pair& p : pairs) {
+        int len = 0;
+        int64_t t0 = now_ns();
+        NavStatus st = request(p.from, p.to, len, r.ticks);
+        int64_t ns = now_ns() - t0;
+        r.paths++;
+        r.total_ns += ns;
+        if (ns > r.max_ns) r.max_ns = ns;
+        int cost = -1;
+        if (st == NAV_FOUND) {
+            r.found++;
+            cost = path_cost(p.from, path_buf, len);
+            if (cost < 0 || path_buf[len - 1].x != p.to.x || path_buf[len - 1].y != p.to.y ||
+                path_buf[len - 1].z != p.to.z)
+                r.bad++;
+        } else {
+            r.none++;
+        }
+        if (costs) costs->push_back(cost);
+    }
+    nav_stats(after);
+    r.expanded = after.expanded - before.expanded;
+    return r;
+}
+
+static void report(const char* name, const Run& r) {
+    int n = r.paths ? r.paths : 1;
+    printf("  %-8s %8.0f paths/s %8.1f us/path (max %8.1f) %6.0f cells/path %5.2f ticks/path %4d found %3d none\n",
+           name, r.total_ns ? r.paths / (r.total_ns / 1e9) : 0.0, r.total_ns / 1e3 / n, r.max_ns / 1e3,
+           static_cast<double>(r.expanded) / n, static_cast<double>(r.ticks) / n, r.found, r.none);
+}
+
+// A feet cell to stand at in column (x, z), or false
+static bool place_at(int x, int z, NavPos& p) {
+    int y = spawn_height(x, z);
+    if (y <= SEA_Y) y = SEA_Y + 1;
+    for (int d = 0; d <= 3; d++)
+        if (nav_standable(x, y - d, z)) {
+            p = {x, y - d, z};
+            return true;
+        }
+    return false;
+}
+
+static std::vector<Pair> make_pairs(int ox, int oz, int range, int count) {
+    std::vector<Pair> pairs;
+    while (static_cast<int>(pairs.size()) < count) {
+        Pair p;
+        int half = range / 2;
+        if (!place_at(ox + rand_in(-half, half), oz + rand_in(-half, half), p.from)) continue;
+        if (!place_at(p.from.x + rand_in(-range, range), p.from.z + rand_in(-range, range), p.to)) continue;
+        pairs.push_back(p);
+    }
+    return pairs;
+}
+
+// Collision masks around a site first, so timings cover only navigation
+static void warm_columns(int sx, int sz, int range) {
+    for (int cz = (sz - 2 * range) >> 4; cz <= (sz + 2 * range) >> 4; cz++)
+        for (int cx = (sx - 2 * range) >> 4; cx <= (sx + 2 * range) >> 4; cx++) world_column(cx, cz);
+}
+
+enum Terrain { PLAINS, MOUNTAINS, OCEAN };
+
+// Whether every column of the square around (x, z) is of the terrain
+static bool site_is(Terrain t, int x, int z, int half) {
+    for (int dz = -half; dz <= half; dz += 4)
+        for (int dx = -half; dx <= half; dx += 4) {
+            int h = spawn_height(x + dx, z + dz) - 1;
+            bool ok = t == PLAINS ? h >= SEA_Y && h <= -44
+                    : t == MOUNTAINS ? h >= -42
+                    : h <= SEA_Y - 4;
+            if (!ok) return false;
+        }
+    return true;
+}
+
+static bool find_site(Terrain t, int half, int& sx, int& sz) {
+    for (int r = 0; r < 4096; r += 32)
+        for (int z = -r; z <= r; z += 32)
+            for (int x = -r; x <= r; x += 32) {
+                if (abs(x) != r && abs(z) != r) continue;
+                if (!site_is(t, x, z, half)) continue;
+                sx = x;
+                sz = z;
+                return true;
+            }
+    return false;
+}
+
+int main(int argc, char** argv) {
+    int paths = 200, range = 24, mobs = 16;
+    for (int i = 1; i < argc; i++) {
+        const char* k = argv[i];
+        if (!strcmp(k, "--paths") && i + 1 < argc) paths = atoi(argv[++i]);
+        else if (!strcmp(k, "--range") && i + 1 < argc) range = atoi(argv[++i]);
+        else if (!strcmp(k, "--mobs") && i + 1 < argc) mobs = atoi(argv[++i]);
+        else if (!strcmp(k, "--seed") && i + 1 < argc) rng = static_cast<uint32_t>(atoi(argv[++i]));
+        else {
+            fprintf(stderr, "unknown option %s\n", k);
+            return 2;
+        }
+    }
+    if (paths < 1) paths = 1;
+    if (range < 4) range = 4;
+    if (mobs < 1) mobs = 1;
+
+    static const char* NAMES[3] = {"plains", "mountains", "ocean"};
+    int failed = 0;
+    std::vector<Pair> wall_pairs;
+    for (int t = PLAINS; t <= OCEAN; t++) {
+        int sx, sz;
+        if (!find_site(static_cast<Terrain>(t), range, sx, sz)) {
+            fprintf(stderr, "no %s found\n", NAMES[t]);
+            return 1;
+        }
+        warm_columns(sx, sz, range);
+        nav_clear();
+        std::vector<Pair> cold_pairs = make_pairs(sx, sz, range, paths);
+        nav_clear();
+        NavStats st0;
+        nav_stats(st0);
+        Run cold = run_pairs(cold_pairs, nullptr);
+        NavStats st1;
+        nav_stats(st1);
+
+        std::vector<Pair> warm_pairs = make_pairs(sx, sz, range, paths);
+        std::vector<int> costs;
+        Run warm = run_pairs(warm_pairs, &costs);
+
+        // The plain search, given room to find what the cached one can
+        Run plain;
+        int worse = 0, beyond = 0;
+        for (size_t i = 0; i < warm_pairs.size(); i++) {
+            int expanded = 0;
+            int64_t t0 = now_ns();
+            int cost = plain_astar(warm_pairs[i].from, warm_pairs[i].to, 4 * MC_NAV_NODES, expanded);
+            int64_t ns = now_ns() - t0;
+            plain.paths++;
+            plain.total_ns += ns;
+            if (ns > plain.max_ns) plain.max_ns = ns;
+            plain.expanded += expanded;
+            if (cost >= 0) plain.found++;
+            else plain.none++;
+            if (costs[i] >= 0 && cost >= 0 && costs[i] != cost) worse++;
+            if (costs[i] < 0 && cost >= 0) beyond++;
+        }
+
+        printf("%-10s at %d %d, %d paths up to %d blocks apart\n", NAMES[t], sx, sz, paths, range);
+        report("cold", cold);
+        report("warm", warm);
+        report("plain", plain);
+        printf("  %-8s %u sections worked out cold, %d costs differ from the plain search, "
+               "%d found only by it, %d bad paths\n",
+               "check", st1.derived - st0.derived, worse, beyond, cold.bad + warm.bad);
+        failed += worse + cold.bad + warm.bad + (warm.found == 0);
+        if (t == PLAINS) wall_pairs = warm_pairs;
+    }
+
+    // Mobs around one target, all asking each tick until every one has a path
+    {
+        int sx, sz;
+        find_site(PLAINS, range, sx, sz);
+        warm_columns(sx, sz, range);
+        NavPos target;
+        place_at(sx, sz, target);
+        std::vector<NavPos> starts;
+        while (static_cast<int>(starts.size()) < mobs) {
+            NavPos p;
+            if (place_at(sx + rand_in(-range, range), sz + rand_in(-range, range), p)) starts.push_back(p);
+        }
+        nav_clear();
+        NavStats a, b;
+        nav_stats(a);
+        std::vector<bool> done(mobs, false);
+        int left = mobs, ticks = 0, found = 0;
+        int64_t t0 = now_ns();
+        while (left > 0 && ticks < 1000) {
+            for (int m = 0; m < mobs; m++) {
+                if (done[m]) continue;
+                int len;
+                NavStatus st = nav_path(starts[m], target, path_buf, MAX_PATH, len);
+                if (st == NAV_PENDING) continue;
+                done[m] = true;
+                left--;
+                found += st == NAV_FOUND;
+            }
+            if (left > 0) {
+                nav_tick();
+                ticks++;
+            }
+        }
+        int64_t ns = now_ns() - t0;
+        nav_stats(b);
+        int separate = 0;
+        for (const NavPos& s : starts) {
+            int e = 0;
+            plain_astar(s, target, 4 * MC_NAV_NODES, e);
+            separate += e;
+        }
+        printf("\nchase      %d mobs, one target: %d found in %d ticks, %.1f us, %u cells expanded "
+               "(%d searched one by one), %u paths reused\n",
+               mobs, found, ticks, ns / 1e3, b.expanded - a.expanded, separate, b.reused - a.reused);
+        failed += found == 0;
+    }
+
+    // A wall across the middle of a plains path
+    int walled = 0, through = 0, wall_worse = 0;
+    for (const Pair& p : wall_pairs) {
+        int len = 0;
+        uint64_t ticks = 0;
+        if (request(p.from, p.to, len, ticks) != NAV_FOUND || len < 5) continue;
+        NavPos mid = path_buf[len / 2];
+        for (int dy = 0; dy <= 2; dy++) tick_set_block(mid.x, mid.y + dy, mid.z, PI_DIRT);
+        int e = 0;
+        int want = plain_astar(p.from, p.to, 4 * MC_NAV_NODES, e);
+        NavStatus st = request(p.from, p.to, len, ticks);
+        if (st == NAV_FOUND) {
+            for (int i = 0; i < len; i++)
+                through += path_buf[i].x == mid.x && path_buf[i].z == mid.z && path_buf[i].y == mid.y;
+            wall_worse += path_cost(p.from, path_buf, len) != want;
+        }
+        walled++;
+        if (walled == 8) break;
+    }
+    NavStats st;
+    nav_stats(st);
+    printf("wall       %d paths walled, %d still through the wall, %d costs differ; %u sections dropped, "
+           "%u searches restarted\n", walled, through, wall_worse, st.dropped, st.resets);
+    printf("nav        longest tick %u us, %u sections cached\n", st.max_us, st.sections);
+    failed += through + wall_worse + (walled == 0);
+    return failed ? 1 : 0;
+}
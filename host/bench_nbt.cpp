@@ -0,0 +1,220 @@
+// NBT reader benchmark: builds the kind of item payload a creative client
+// sends (a written book's pages, a list of enchantment compounds, arrays,
+// a few nested compounds) and times skipping it whole, pulling two fields
+// out of it, and visiting every tag. Counts heap allocations made while
+// reading, which should be none.
+//
+//   mc_bench_nbt [--pages 100] [--reps 2000]
+//
+// Fails if the reader allocates, finds the wrong values, or accepts any
+// truncated or over-deep payload.
+
+#include "mc_nbt.h"
+#include "mc_types.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <vector>
+
+static size_t allocations;
+
+void* operator new(size_t n) {
+    allocations++;
+    if (void* p = malloc(n ? n : 1)) return p;
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+static int64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void name(PacketBuf& b, const char* n) {
+    pkt_write_u16(b, static_cast<uint16_t>(strlen(n)));
+    b.append(reinterpret_cast<const uint8_t*>(n), strlen(n));
+}
+
+static void list_header(PacketBuf& b, const char* n, uint8_t elem, int32_t count) {
+    pkt_write_byte(b, NBT_LIST);
+    name(b, n);
+    pkt_write_byte(b, elem);
+    pkt_write_i32(b, count);
+}
+
+// Custom data of a written book with the two fields a server would want
+// ("author", "generation") after everything else
+static void build_item(PacketBuf& b, int pages) {
+    b.reset();
+    nbt_begin(b);
+    nbt_compound(b, "display");
+    nbt_string(b, "Name", "{\"text\":\"Ledger\"}");
+    const char* lore[] = {"first line of lore", "second line of lore", "third"};
+    nbt_string_list(b, "Lore", lore, 3);
+    nbt_end(b);
+    char page[220];
+    memset(page, 'a', sizeof(page) - 1);
+    page[sizeof(page) - 1] = '\0';
+    list_header(b, "pages", NBT_STRING, pages);
+    for (int i = 0; i < pages; i++) {
+        pkt_write_u16(b, sizeof(page) - 1);
+        b.append(reinterpret_cast<const uint8_t*>(page), sizeof(page) - 1);
+    }
+    list_header(b, "Enchantments", NBT_COMPOUND, 40);
+    for (int i = 0; i < 40; i++) {
+        nbt_string(b, "id", "minecraft:unbreaking");
+        nbt_int(b, "lvl", i);
+        nbt_end(b);
+    }
+    int64_t longs[64] = {};
+    nbt_long_array(b, "Seen", longs, 64);
+    nbt_compound(b, "nested");
+    nbt_compound(b, "deeper");
+    nbt_double(b, "x", 1.5);
+    nbt_float(b, "y", 2.5f);
+    nbt_end(b);
+    nbt_end(b);
+    nbt_string(b, "author", "Notch");
+    nbt_int(b, "generation", 2);
+    nbt_end(b);
+}
+
+// Lists nested depth deep inside the root compound
+static void build_deep(PacketBuf& b, int depth) {
+    b.reset();
+    nbt_begin(b);
+    list_header(b, "l", NBT_LIST, 1);
+    for (int i = 1; i < depth; i++) {
+        pkt_write_byte(b, NBT_LIST);
+        pkt_write_i32(b, 1);
+    }
+    pkt_write_byte(b, NBT_END);
+    pkt_write_i32(b, 0);
+    nbt_end(b);
+}
+
+static bool skip_all(const PacketBuf& b) {
+    PacketBuf in = b;
+    in.pos = 0;
+    NbtReader r;
+    nbt_read_begin(r, in);
+    nbt_skip_any(r);
+    return nbt_read_end(r, in) && in.pos == in.len;
+}
+
+static bool find_fields(const PacketBuf& b, NbtView& author, int64_t& generation) {
+    NbtReader r;
+    nbt_read_begin(r, b);
+    uint8_t type;
+    if (!nbt_root(r) || !nbt_find(r, "author", type) || type != NBT_STRING || !nbt_get_string(r, author))
+        return false;
+    return nbt_find(r, "generation", type) && nbt_get_int(r, type, generation);
+}
+
+static int visit(NbtReader& r, uint8_t type);
+
+// Tags of the compound already entered, through to its end
+static int visit_compound(NbtReader& r) {
+    int n = 0;
+    uint8_t t;
+    NbtView nm;
+    while (nbt_next(r, t, nm)) {
+        int k = visit(r, t);
+        if (k < 0) return -1;
+        n += 1 + k;
+    }
+    return r.ok ? n : -1;
+}
+
+// Every tag through nbt_next, compounds entered rather than skipped
+static int visit(NbtReader& r, uint8_t type) {
+    if (type == NBT_COMPOUND) return nbt_enter(r) ? visit_compound(r) : -1;
+    if (type == NBT_LIST) {
+        uint8_t elem;
+        int32_t count;
+        if (!nbt_get_list(r, elem, count)) return -1;
+        int n = 0;
+        for (int32_t i = 0; i < count; i++) {
+            int k = visit(r, elem);
+            if (k < 0) return -1;
+            n += 1 + k;
+        }
+        return n;
+    }
+    return nbt_skip(r, type) ? 0 : -1;
+}
+
+int main(int argc, char** argv) {
+    int pages = 100, reps = 2000;
+    for (int i = 1; i < argc; i++) {
+        const char* k = argv[i];
+        if (!strcmp(k, "--pages") && i + 1 < argc) pages = atoi(argv[++i]);
+        else if (!strcmp(k, "--reps") && i + 1 < argc) reps = atoi(argv[++i]);
+        else {
+            fprintf(stderr, "unknown option %s\n", k);
+            return 2;
+        }
+    }
+    if (reps < 1) reps = 1;
+
+    PacketBuf item;
+    item.init(64 * 1024);
+    build_item(item, pages);
+    if (item.len > MC_NBT_MAX_BYTES) {
+        fprintf(stderr, "payload of %zu bytes is over MC_NBT_MAX_BYTES\n", item.len);
+        return 1;
+    }
+
+    size_t allocs = allocations;
+    bool ok = true;
+    int64_t t0 = now_ns();
+    for (int i = 0; i < reps; i++) ok &= skip_all(item);
+    int64_t skip_ns = (now_ns() - t0) / reps;
+
+    NbtView author{};
+    int64_t generation = 0;
+    t0 = now_ns();
+    for (int i = 0; i < reps; i++) ok &= find_fields(item, author, generation);
+    int64_t find_ns = (now_ns() - t0) / reps;
+    ok &= author.is("Notch") && generation == 2;
+
+    int tags = 0;
+    t0 = now_ns();
+    for (int i = 0; i < reps; i++) {
+        NbtReader r;
+        nbt_read_begin(r, item);
+        tags = nbt_root(r) ? visit_compound(r) : -1;
+        ok &= tags > 0;
+    }
+    int64_t visit_ns = (now_ns() - t0) / reps;
+    allocs = allocations - allocs;
+
+    // Every cut short of the end, and nesting past the limit, must fail
+    int accepted = 0;
+    PacketBuf cut = item;
+    for (size_t n = 0; n < item.len; n++) {
+        cut.len = n;
+        accepted += skip_all(cut);
+    }
+    PacketBuf deep;
+    deep.init(8192);
+    build_deep(deep, MC_NBT_MAX_DEPTH - 2);
+    bool deep_ok = skip_all(deep);
+    build_deep(deep, MC_NBT_MAX_DEPTH + 1);
+    bool too_deep = skip_all(deep);
+    build_deep(deep, 4000);
+    too_deep |= skip_all(deep);
+
+    printf("payload    %zu bytes, %d tags, %d pages\n", item.len, tags, pages);
+    printf("skip       %7.2f us (%.0f MB/s)\n", skip_ns / 1e3, item.len * 1e3 / (skip_ns ? skip_ns : 1));
+    printf("find       %7.2f us for author and generation, at the end\n", find_ns / 1e3);
+    printf("visit      %7.2f us entering every compound and list\n", visit_ns / 1e3);
+    printf("heap       %zu allocations while reading\n", allocs);
+    printf("limits     %d of %zu truncations accepted, depth %d %s, depth %d+ %s\n", accepted, item.len,
+           MC_NBT_MAX_DEPTH - 2, deep_ok ? "read" : "refused", MC_NBT_MAX_DEPTH + 1,
+           too_deep ? "read" : "refused");
+    return ok && allocs == 0 && accepted == 0 && deep_ok && !too_deep ? 0 : 1;
+}
@@ -0,0 +1,168 @@
+// Stress test for the network/simulation link rings. The main thread plays
+// the network task: it pushes timestamped NetCmds onto each link's inbound
+// ring and wakes the simulation thread the way the server does. The
+// simulation thread pops them and echoes the timestamp back on the link's
+// outbound ring. Reports throughput plus one-way and round-trip latency.
+//
+//   mc_bench_queues [--links 5] [--seconds 3] [--rate 2000] [--spin]
+//
+// --rate is commands per second per link, 0 for as fast as the rings go.
+// --spin busy-polls instead of sleeping on a task notification, which
+// separates the queue cost from the wake-up cost. Build with
+// -DMC_HOST_TSAN=ON to run it under ThreadSanitizer.
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "config.h"
+#include "mc_link.h"
+#include "mc_spsc.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+static constexpr int MAX_LINKS = 16;
+static constexpr int BUCKET_NS = 25;
+static constexpr int BUCKETS = 8000;     // 200 us; slower samples go in the last bucket
+
+struct Hist {
+    uint64_t buckets[BUCKETS + 1] = {};
+    uint64_t count = 0;
+    uint64_t max_ns = 0;
+
+    void add(int64_t ns) {
+        if (ns < 0) ns = 0;
+        int b = static_cast<int>(ns / BUCKET_NS);
+        buckets[b < BUCKETS ? b : BUCKETS]++;
+        count++;
+        if (static_cast<uint64_t>(ns) > max_ns) max_ns = ns;
+    }
+
+    uint64_t percentile(double p) const {
+        uint64_t want = static_cast<uint64_t>(count * p), seen = 0;
+        for (int b = 0; b <= BUCKETS; b++) {
+            seen += buckets[b];
+            if (seen > want) return b < BUCKETS ? static_cast<uint64_t>(b + 1) * BUCKET_NS : max_ns;
+        }
+        return max_ns;
+    }
+
+    void print(const char* name) const {
+        printf("%-10s p50 %6llu  p99 %6llu  p99.9 %6llu  max %8llu ns\n", name,
+               static_cast<unsigned long long>(percentile(0.5)),
+               static_cast<unsigned long long>(percentile(0.99)),
+               static_cast<unsigned long long>(percentile(0.999)),
+               static_cast<unsigned long long>(max_ns));
+    }
+};
+
+struct BenchLink {
+    SpscRing<NetCmd, MC_LINK_IN_LEN> cmds;
+    SpscRing<int64_t, MC_LINK_OUT_LEN> out;
+};
+
+static BenchLink links[MAX_LINKS];
+static int link_count = 5;
+static bool spin = false;
+static std::atomic<bool> stop{false};
+static std::atomic<bool> sim_done{false};
+static Hist one_way;
+static uint64_t echo_drops = 0;
+
+static int64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void sim_main(void*) {
+    while (!stop.load(std::memory_order_relaxed)) {
+        if (!spin) ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(1));
+        bool idle = true;
+        for (int i = 0; i < link_count; i++) {
+            NetCmd cmd;
+            while (links[i].cmds.pop(cmd)) {
+                one_way.add(now_ns() - cmd.value);
+                if (!links[i].out.push(cmd.value)) echo_drops++;
+                idle = false;
+            }
+        }
+        // Spinning still yields, so the test also runs on a single core
+        if (spin && idle) std::this_thread::yield();
+    }
+    sim_done.store(true);
+}
+
+int main(int argc, char** argv) {
+    double seconds = 3;
+    int rate = 2000;
+    for (int i = 1; i < argc; i++) {
+        const char* k = argv[i];
+        if (!strcmp(k, "--links") && i + 1 < argc) link_count = atoi(argv[++i]);
+        else if (!strcmp(k, "--seconds") && i + 1 < argc) seconds = atof(argv[++i]);
+        else if (!strcmp(k, "--rate") && i + 1 < argc) rate = atoi(argv[++i]);
+        else if (!strcmp(k, "--spin")) spin = true;
+        else {
+            fprintf(stderr, "unknown option %s\n", k);
+            return 2;
+        }
+    }
+    link_count = std::max(1, std::min(link_count, MAX_LINKS));
+
+    TaskHandle_t sim = nullptr;
+    xTaskCreatePinnedToCore(sim_main, "mc_sim", MC_SIM_STACK, nullptr, 5, &sim, MC_SIM_CORE);
+
+    Hist round_trip;
+    int64_t period = rate > 0 ? 1000000000LL / rate : 0;
+    int64_t due[MAX_LINKS];
+    int64_t start = now_ns(), end = start + static_cast<int64_t>(seconds * 1e9);
+    for (int i = 0; i < link_count; i++) due[i] = start + period * i / link_count;
+    uint64_t sent = 0, full = 0;
+
+    NetCmd cmd;
+    memset(&cmd, 0, sizeof(cmd));
+    cmd.kind = CMD_KEEPALIVE;
+
+    for (int64_t now = start; now < end; now = now_ns()) {
+        bool pushed = false;
+        for (int i = 0; i < link_count; i++) {
+            if (period && due[i] > now) continue;
+            // Same rule as the server: one slot stays free for CMD_CLOSE
+            if (links[i].cmds.room() < 2) {
+                full++;
+                continue;
+            }
+            cmd.value = now_ns();
+            links[i].cmds.push(cmd);
+            due[i] += period;
+            sent++;
+            pushed = true;
+        }
+        if (pushed && !spin) xTaskNotifyGive(sim);
+
+        int64_t echoed;
+        for (int i = 0; i < link_count; i++)
+            while (links[i].out.pop(echoed)) round_trip.add(now_ns() - echoed);
+        if (period || !pushed) std::this_thread::yield();
+    }
+
+    stop.store(true);
+    if (!spin) xTaskNotifyGive(sim);
+    while (!sim_done.load()) std::this_thread::yield();
+    int64_t echoed;
+    for (int i = 0; i < link_count; i++)
+        while (links[i].out.pop(echoed)) round_trip.add(now_ns() - echoed);
+
+    double secs = (now_ns() - start) / 1e9;
+    printf("links      %d, %.1f s, %s, %s wake-up\n", link_count, secs,
+           rate > 0 ? "paced" : "flat out", spin ? "spin" : "notify");
+    if (rate > 0) printf("rate       %d commands/s per link\n", rate);
+    printf("commands   %llu (%.0f/s), ring full %llu times, %llu echoes dropped\n",
+           static_cast<unsigned long long>(sent), sent / secs,
+           static_cast<unsigned long long>(full), static_cast<unsigned long long>(echo_drops));
+    one_way.print("one-way");
+    round_trip.print("round trip");
+    return 0;
+}
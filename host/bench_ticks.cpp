@@ -0,0 +1,194 @@
+// Block tick benchmark: a player stands on a shore while the tick engine
+// runs idle (random ticks only), then a trench is dug inland from the sea
+// and the water runs into it, then the trench mouth is sealed and the
+// water drains. Reports per-tick cost for each phase, the scheduled-tick
+// and packet counts, and the least a scan-based engine would pay: one pass
+// over every block of the simulated chunks, already in memory, looking for
+// water.
+//
+//   mc_bench_ticks [--idle 200] [--length 12] [--settle 400]
+//
+// Fails if flowing water is left without a supply after either phase
+// settles, if the water never settles, or if the collision masks disagree
+// with the engine's blocks.
+
+#include "mc_tick.h"
+#include "mc_play.h"
+#include "mc_world.h"
+#include "config.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+static constexpr int SEA_Y = -52;
+
+static int64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static bool is_water(uint8_t pi) { return pi == PI_WATER || pi >= PI_FLOW; }
+
+static int level(uint8_t pi) { return pi >= PI_FLOW && pi < PI_FALLING ? pi - PI_FLOW + 1 : 0; }
+
+struct Phase {
+    int ticks = 0;
+    int64_t total_ns = 0, max_ns = 0;
+    TickStats before{};
+    TickStats after{};
+};
+
+static int center[1][2];
+
+// Ticks until no scheduled tick is waiting (or limit), timing each
+static Phase run(int limit, bool until_quiet) {
+    Phase p;
+    tick_stats(p.before);
+    for (int i = 0; i < limit; i++) {
+        int64_t t0 = now_ns();
+        tick_run(center, 1);
+        int64_t ns = now_ns() - t0;
+        p.ticks++;
+        p.total_ns += ns;
+        if (ns > p.max_ns) p.max_ns = ns;
+        TickStats st;
+        tick_stats(st);
+        if (until_quiet && st.pending == 0) break;
+    }
+    tick_stats(p.after);
+    return p;
+}
+
+static void report(const char* name, const Phase& p) {
+    printf("%-8s %5d ticks %8.1f us/tick (max %7.1f) %6u scheduled %6u random %5u changes %4u+%-4u packets\n",
+           name, p.ticks, p.total_ns / 1e3 / p.ticks, p.max_ns / 1e3, p.after.scheduled - p.before.scheduled,
+           p.after.random - p.before.random, p.after.changes - p.before.changes,
+           p.after.block_updates - p.before.block_updates, p.after.section_updates - p.before.section_updates);
+}
+
+// Flowing water with nothing feeding it, around (x0..x1, z0..z1)
+static int unsupported(int x0, int x1, int z0, int z1) {
+    int bad = 0;
+    for (int y = SEA_Y - 6; y <= SEA_Y + 1; y++)
+        for (int z = z0; z <= z1; z++)
+            for (int x = x0; x <= x1; x++) {
+                uint8_t b = tick_block(x, y, z);
+                if (!is_water(b) || b == PI_WATER) continue;
+                if (is_water(tick_block(x, y + 1, z))) continue;
+                if (b == PI_FALLING) { bad++; continue; }
+                static const int D[4][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+                bool fed = false;
+                for (const auto& d : D) {
+                    uint8_t n = tick_block(x + d[0], y, z + d[1]);
+                    fed |= is_water(n) && level(n) < level(b);
+                }
+                bad += !fed;
+            }
+    return bad;
+}
+
+int main(int argc, char** argv) {
+    int idle = 200, length = 12, settle = 400;
+    for (int i = 1; i < argc; i++) {
+        const char* k = argv[i];
+        if (!strcmp(k, "--idle") && i + 1 < argc) idle = atoi(argv[++i]);
+        else if (!strcmp(k, "--length") && i + 1 < argc) length = atoi(argv[++i]);
+        else if (!strcmp(k, "--settle") && i + 1 < argc) settle = atoi(argv[++i]);
+        else {
+            fprintf(stderr, "unknown option %s\n", k);
+            return 2;
+        }
+    }
+    if (idle < 1) idle = 1;
+    if (length < 1) length = 1;
+
+    // A sea block at sea level with land east of it, and no other water
+    // along the trench, so sealing the mouth cuts the supply
+    int sx = 0, sz = 0;
+    bool found = false;
+    for (int r = 0; r < 512 && !found; r += 4)
+        for (int z = -r; z <= r && !found; z += 4)
+            for (int x = -r; x <= r && !found; x++) {
+                if (tick_block(x, SEA_Y, z) != PI_WATER || is_water(tick_block(x + 1, SEA_Y, z)) ||
+                    tick_block(x + 1, SEA_Y, z) == PI_AIR)
+                    continue;
+                bool dry = true;
+                for (int i = 1; i <= length + 1 && dry; i++)
+                    for (int dz = -1; dz <= 1 && dry; dz++)
+                        for (int y = SEA_Y - 2; y <= SEA_Y && dry; y++)
+                            dry = (i == 1 && dz == 0) || !is_water(tick_block(x + i, y, z + dz));
+                if (!dry) continue;
+                sx = x;
+                sz = z;
+                found = true;
+            }
+    if (!found) {
+        fprintf(stderr, "no shore found\n");
+        return 1;
+    }
+    center[0][0] = (sx + length / 2) >> 4;
+    center[0][1] = sz >> 4;
+    printf("shore      water at %d %d %d, trench %d blocks east, simulated chunks around %d,%d\n", sx, SEA_Y, sz,
+           length, center[0][0], center[0][1]);
+
+    // Surface sections load a few columns a tick
+    int side = 2 * MC_SIM_DISTANCE + 1;
+    Phase p_load = run((side * side + MC_TICK_LOADS - 1) / MC_TICK_LOADS, false);
+    Phase p_idle = run(idle, false);
+    TickStats st;
+    tick_stats(st);
+    printf("sections   %u loaded\n", st.sections);
+
+    // Baseline: every block of the simulated chunks in one flat array
+    std::vector<uint8_t> area(static_cast<size_t>(side) * side * WORLD_SECTIONS * 4096);
+    for (int c = 0; c < side * side; c++)
+        for (int si = 0; si < WORLD_SECTIONS; si++)
+            gen_section_at(&area[(static_cast<size_t>(c) * WORLD_SECTIONS + si) * 4096],
+                           center[0][0] - MC_SIM_DISTANCE + c % side, center[0][1] - MC_SIM_DISTANCE + c / side, si);
+    int64_t t0 = now_ns();
+    int water = 0;
+    for (int rep = 0; rep < 10; rep++)
+        for (uint8_t b : area) water += is_water(b);
+    int64_t scan_ns = (now_ns() - t0) / 10;
+    water /= 10;
+
+    for (int i = 1; i <= length; i++) {
+        tick_set_block(sx + i, SEA_Y, sz, PI_AIR);
+        tick_set_block(sx + i, SEA_Y - 1, sz, PI_AIR);
+    }
+    Phase p_flood = run(settle, true);
+    int bad = unsupported(sx - 2, sx + length + 2, sz - 2, sz + 2);
+    int wet = 0;
+    for (int i = 1; i <= length; i++)
+        wet += is_water(tick_block(sx + i, SEA_Y, sz)) || is_water(tick_block(sx + i, SEA_Y - 1, sz));
+
+    tick_set_block(sx + 1, SEA_Y, sz, PI_SAND);
+    tick_set_block(sx + 1, SEA_Y - 1, sz, PI_SAND);
+    Phase p_drain = run(settle, true);
+    bad += unsupported(sx - 2, sx + length + 2, sz - 2, sz + 2);
+    int left = 0;
+    for (int i = 2; i <= length; i++)
+        left += is_water(tick_block(sx + i, SEA_Y, sz)) || is_water(tick_block(sx + i, SEA_Y - 1, sz));
+
+    int differ = 0;
+    for (int y = SEA_Y - 3; y <= SEA_Y + 1; y++)
+        for (int z = sz - 2; z <= sz + 2; z++)
+            for (int x = sx - 2; x <= sx + length + 2; x++)
+                differ += world_block(x, y, z) != block_occ(tick_block(x, y, z));
+
+    printf("\n");
+    report("load", p_load);
+    report("idle", p_idle);
+    report("flood", p_flood);
+    report("drain", p_drain);
+    printf("%-8s %5d ticks %8.1f us/tick (one pass over %zu blocks of %d chunks, %d water)\n", "scan", 1,
+           scan_ns / 1e3, area.size(), side * side, water);
+
+    tick_stats(st);
+    printf("\nwater      %d of %d trench columns wet, %d after sealing, %d unsupported, "
+           "%u dropped\n", wet, length, left, bad, st.dropped);
+    printf("masks      %d blocks differ from the engine\n", differ);
+    return bad || left || differ || p_flood.after.pending || p_drain.after.pending ? 1 : 0;
+}
@@ -0,0 +1,120 @@
+// Shard coordinator: hands out the band table and carries player poses
+// between nodes. One request line per connection, answered and closed.
+//
+//   mc_coordinator [--port 25580] [--nodes 2] [--band 2] [--base-port 25565]
+//                  [--host 127.0.0.1]
+//
+// Node i owns chunk columns x in [i*band, (i+1)*band - 1], with the first
+// and last bands running out to the edges of the world. It serves clients
+// on base-port + i and chunk requests on base-port + 100 + i.
+//
+//   MAP                              -> NODES n, then n lines
+//                                       "host port peer_port cx_min cx_max"
+//   PUT hi lo x y z yaw pitch health food mode  -> OK
+//   TAKE hi lo                       -> POSE x y z yaw pitch health food mode
+//                                       or NONE
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <climits>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <utility>
+
+int main(int argc, char** argv) {
+    int port = 25580, nodes = 2, band = 2, base_port = 25565;
+    const char* host = "127.0.0.1";
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 >= argc) break;
+        if (!strcmp(argv[i], "--port")) port = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--nodes")) nodes = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--band")) band = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--base-port")) base_port = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--host")) host = argv[++i];
+    }
+    if (nodes < 1 || band < 1) {
+        fprintf(stderr, "need at least one node and a band of one column\n");
+        return 1;
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    int listen_sock = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(listen_sock, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<uint16_t>(port));
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (bind(listen_sock, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || listen(listen_sock, 16) < 0) {
+        perror("coordinator");
+        return 1;
+    }
+    printf("coordinator on %d: %d nodes, band %d columns\n", port, nodes, band);
+    fflush(stdout);
+
+    // Poses waiting for their player to reach the next node, by UUID
+    std::map<std::pair<unsigned long long, unsigned long long>, std::string> handoffs;
+    unsigned long puts = 0, takes = 0;
+
+    while (true) {
+        int sock = accept(listen_sock, nullptr, nullptr);
+        if (sock < 0) continue;
+        timeval tv = {1, 0};
+        setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+        char line[512];
+        size_t n = 0;
+        while (n + 1 < sizeof(line)) {
+            ssize_t r = recv(sock, line + n, sizeof(line) - 1 - n, 0);
+            if (r <= 0) break;
+            n += r;
+            if (memchr(line, '\n', n)) break;
+        }
+        line[n] = '\0';
+
+        std::string reply;
+        unsigned long long hi, lo;
+        int used = 0;
+        if (!strncmp(line, "MAP", 3)) {
+            reply = "NODES " + std::to_string(nodes) + "\n";
+            for (int i = 0; i < nodes; i++) {
+                long long lo_cx = i == 0 ? INT32_MIN : static_cast<long long>(i) * band;
+                long long hi_cx = i == nodes - 1 ? INT32_MAX : static_cast<long long>(i + 1) * band - 1;
+                char row[128];
+                snprintf(row, sizeof(row), "%s %d %d %lld %lld\n", host, base_port + i, base_port + 100 + i, lo_cx,
+                         hi_cx);
+                reply += row;
+            }
+        } else if (sscanf(line, "PUT %llx %llx %n", &hi, &lo, &used) == 2 && used > 0) {
+            std::string pose(line + used);
+            while (!pose.empty() && (pose.back() == '\n' || pose.back() == '\r')) pose.pop_back();
+            handoffs[{hi, lo}] = pose;
+            puts++;
+            reply = "OK\n";
+        } else if (sscanf(line, "TAKE %llx %llx", &hi, &lo) == 2) {
+            auto it = handoffs.find({hi, lo});
+            if (it == handoffs.end()) {
+                reply = "NONE\n";
+            } else {
+                reply = "POSE " + it->second + "\n";
+                handoffs.erase(it);
+                takes++;
+            }
+        } else {
+            reply = "ERR\n";
+        }
+        send(sock, reply.data(), reply.size(), 0);
+        close(sock);
+
+        if (line[0] == 'P' || line[0] == 'T') {
+            printf("handoffs: %lu left, %lu taken, %zu waiting\n", puts, takes, handoffs.size());
+            fflush(stdout);
+        }
+    }
+}
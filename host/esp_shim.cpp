@@ -0,0 +1,82 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_heap_caps.h"
+#include "esp_cpu.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+
+// Per-task state behind a TaskHandle_t: the notification count
+struct HostTask {
+    std::mutex m;
+    std::condition_variable cv;
+    uint32_t notify = 0;
+};
+
+static thread_local HostTask* self = nullptr;
+
+static HostTask& current_task() {
+    if (!self) self = new HostTask;   // threads not made by xTaskCreatePinnedToCore
+    return *self;
+}
+
+void vTaskDelete(TaskHandle_t) {
+    // Task functions return right after this, which ends the thread
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char*, uint32_t,
+                                   void* arg, UBaseType_t, TaskHandle_t* handle, BaseType_t) {
+    auto* task = new HostTask;   // lives as long as the process, like the thread
+    std::thread([fn, arg, task] {
+        self = task;
+        fn(arg);
+    }).detach();
+    if (handle) *handle = task;
+    return pdPASS;
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t) {
+    return 0;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t handle) {
+    auto* task = static_cast<HostTask*>(handle);
+    {
+        std::lock_guard<std::mutex> guard(task->m);
+        task->notify++;
+    }
+    task->cv.notify_one();
+    return pdPASS;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks) {
+    HostTask& task = current_task();
+    std::unique_lock<std::mutex> guard(task.m);
+    task.cv.wait_for(guard, std::chrono::milliseconds(ticks), [&] { return task.notify > 0; });
+    uint32_t n = task.notify;
+    if (n) task.notify = clear_on_exit ? 0 : n - 1;
+    return n;
+}
+
+void* heap_caps_malloc(size_t size, uint32_t) {
+    return malloc(size);
+}
+
+void heap_caps_free(void* ptr) {
+    free(ptr);
+}
+
+size_t heap_caps_get_free_size(uint32_t) {
+    return 0;
+}
+
+size_t heap_caps_get_minimum_free_size(uint32_t) {
+    return 0;
+}
+
+esp_cpu_cycle_count_t esp_cpu_get_cycle_count() {
+    return static_cast<esp_cpu_cycle_count_t>(
+        std::chrono::steady_clock::now().time_since_epoch() / std::chrono::nanoseconds(1));
+}
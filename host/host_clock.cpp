@@ -0,0 +1,22 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include <chrono>
+#include <thread>
+
+// Wall clock for the host runtime; the replay tool links a virtual one
+
+static const auto start_time = std::chrono::steady_clock::now();
+
+int64_t esp_timer_get_time() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start_time).count();
+}
+
+TickType_t xTaskGetTickCount() {
+    return static_cast<TickType_t>(esp_timer_get_time() / 1000);
+}
+
+void vTaskDelay(TickType_t ticks) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ticks));
+}
@@ -0,0 +1,82 @@
+// Linux build of the server: same dispatch loop as the ESP32, no Wi-Fi.
+//   mc_host_server [port] [--capture file.mcap] [--nvs file] [--world file]
+//                  [--shard ID --coordinator host:port]
+//
+// --nvs keeps player records across runs; without it they last until exit.
+// --world serves chunks from an image made by mc_bake, as the world
+// partition does on the ESP32.
+// --shard runs this process as node ID of an mc_coordinator's table; the
+// port defaults to the one the table gives the node.
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "nvs.h"
+#include "esp_partition.h"
+#include "config.h"
+#include "mc_server.h"
+#include "mc_metrics.h"
+#include "mc_capture.h"
+#include "mc_shard.h"
+#include "mc_trace.h"
+#include "mc_bake.h"
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+
+static const char* TAG = "host_server";
+
+int main(int argc, char** argv) {
+    uint16_t port = 0;
+    int shard = -1;
+    char coord_host[40] = "127.0.0.1";
+    uint16_t coord_port = MC_SHARD_COORD_PORT;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--capture") && i + 1 < argc) {
+#if MC_CAPTURE
+            if (!capture_start_file(argv[++i])) return 1;
+#else
+            ESP_LOGE(TAG, "Built without MC_CAPTURE");
+            return 1;
+#endif
+        } else if (!strcmp(argv[i], "--nvs") && i + 1 < argc) {
+            if (!host_nvs_file(argv[++i])) {
+                ESP_LOGE(TAG, "Cannot read %s", argv[i]);
+                return 1;
+            }
+        } else if (!strcmp(argv[i], "--world") && i + 1 < argc) {
+            if (!host_partition_file(MC_WORLD_PARTITION, argv[++i]) || !bake_open()) {
+                ESP_LOGE(TAG, "Cannot use %s as the world image", argv[i]);
+                return 1;
+            }
+        } else if (!strcmp(argv[i], "--shard") && i + 1 < argc) {
+            shard = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--coordinator") && i + 1 < argc) {
+            const char* arg = argv[++i];
+            const char* colon = strrchr(arg, ':');
+            size_t len = colon ? static_cast<size_t>(colon - arg) : strlen(arg);
+            if (len >= sizeof(coord_host)) len = sizeof(coord_host) - 1;
+            memcpy(coord_host, arg, len);
+            coord_host[len] = '\0';
+            if (colon) coord_port = static_cast<uint16_t>(atoi(colon + 1));
+        } else {
+            port = static_cast<uint16_t>(atoi(argv[i]));
+        }
+    }
+
+    // A client vanishing mid-send must not kill the process
+    signal(SIGPIPE, SIG_IGN);
+
+    ESP_LOGI(TAG, "Host Minecraft Server");
+    trace_init();
+    if (shard >= 0) {
+        if (!shard_start(coord_host, coord_port, shard)) return 1;
+        if (!port) port = shard_node(shard).port;
+    }
+    if (!port) port = MC_PORT;
+#if MC_METRICS
+    xTaskCreatePinnedToCore(metrics_server_task, "metrics", 4096, nullptr, 3, nullptr, 0);
+#endif
+    server_run(port);
+    return 1;
+}
@@ -0,0 +1,4 @@
+#pragma once
+
+// Memory placement attributes; the host has one kind of memory
+#define __NOINIT_ATTR
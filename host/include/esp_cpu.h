@@ -0,0 +1,10 @@
+#pragma once
+
+#include <cstdint>
+
+// Host "cycles" are nanoseconds of the steady clock, truncated like the
+// 32-bit CCOUNT register; every thread reports core 0
+typedef uint32_t esp_cpu_cycle_count_t;
+
+esp_cpu_cycle_count_t esp_cpu_get_cycle_count();
+inline int esp_cpu_get_core_id() { return 0; }
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdint>
+
+int64_t esp_timer_get_time();
+
+#define ESP_HOST_LOG(level, tag, fmt, ...) \
+    fprintf(stderr, level " (%lld) %s: " fmt "\n", \
+            static_cast<long long>(esp_timer_get_time() / 1000), tag, ##__VA_ARGS__)
+
+#define ESP_LOGE(tag, fmt, ...) ESP_HOST_LOG("E", tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGW(tag, fmt, ...) ESP_HOST_LOG("W", tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGI(tag, fmt, ...) ESP_HOST_LOG("I", tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGD(tag, fmt, ...) do {} while (0)
@@ -0,0 +1,6 @@
+#pragma once
+
+#include <cstdint>
+
+// Matches the nanosecond cycle counter in esp_cpu.h
+inline uint32_t esp_rom_get_cpu_ticks_per_us() { return 1000; }
@@ -0,0 +1,17 @@
+#pragma once
+
+// Host stand-in for the FreeRTOS types the server uses
+
+#include <cstdint>
+
+typedef uint32_t TickType_t;
+typedef uint32_t UBaseType_t;
+typedef int BaseType_t;
+typedef void* TaskHandle_t;
+typedef void (*TaskFunction_t)(void*);
+
+#define portTICK_PERIOD_MS 1
+#define pdMS_TO_TICKS(ms)  (static_cast<TickType_t>(ms))
+#define pdPASS             1
+#define pdTRUE             1
+#define pdFALSE            0
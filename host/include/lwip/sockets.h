@@ -0,0 +1,17 @@
+#pragma once
+
+// BSD sockets stand in for lwIP on the host
+
+#include <arpa/inet.h>
+#include <cerrno>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+inline char* inet_ntoa_r(struct in_addr addr, char* buf, int len) {
+    return const_cast<char*>(inet_ntop(AF_INET, &addr, buf, len));
+}
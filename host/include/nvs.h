@@ -0,0 +1,40 @@
+#pragma once
+
+#include "esp_err.h"
+#include <cstddef>
+#include <cstdint>
+
+// Emulated NVS: blobs only, held in memory. host_nvs_file() makes commits
+// also write the whole store to a file and loads it back at start.
+
+typedef uint32_t nvs_handle_t;
+typedef struct HostNvsIter* nvs_iterator_t;
+
+typedef enum { NVS_READONLY, NVS_READWRITE } nvs_open_mode_t;
+typedef enum { NVS_TYPE_BLOB = 0x42, NVS_TYPE_ANY = 0xff } nvs_type_t;
+
+typedef struct {
+    char namespace_name[16];
+    char key[16];
+    nvs_type_t type;
+} nvs_entry_info_t;
+
+#define NVS_DEFAULT_PART_NAME "nvs"
+#define ESP_ERR_NVS_NOT_FOUND          0x1102
+#define ESP_ERR_NVS_INVALID_LENGTH     0x110c
+#define ESP_ERR_NVS_NOT_ENOUGH_SPACE   0x1105
+
+esp_err_t nvs_open(const char* name, nvs_open_mode_t mode, nvs_handle_t* out);
+void nvs_close(nvs_handle_t handle);
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char* key, void* out, size_t* length);
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char* key, const void* value, size_t length);
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char* key);
+esp_err_t nvs_commit(nvs_handle_t handle);
+
+esp_err_t nvs_entry_find(const char* part, const char* ns, nvs_type_t type, nvs_iterator_t* out);
+esp_err_t nvs_entry_next(nvs_iterator_t* it);
+esp_err_t nvs_entry_info(const nvs_iterator_t it, nvs_entry_info_t* out);
+void nvs_release_iterator(nvs_iterator_t it);
+
+// Host only: file backing the store, loaded now and rewritten on commit
+bool host_nvs_file(const char* path);
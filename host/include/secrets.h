@@ -0,0 +1,5 @@
+#pragma once
+
+// Host builds have no Wi-Fi; include/secrets.h takes precedence when present
+#define WIFI_SSID     ""
+#define WIFI_PASSWORD ""
@@ -0,0 +1,155 @@
+#include "nvs.h"
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+using NvsKey = std::pair<std::string, std::string>;    // namespace, key
+
+static std::map<NvsKey, std::vector<uint8_t>> blobs;
+static std::vector<std::string> spaces;                // handle - 1 indexes this
+static std::string file_path;
+static std::mutex lock;
+
+struct HostNvsIter {
+    std::vector<NvsKey> keys;
+    size_t pos;
+};
+
+static bool save() {
+    if (file_path.empty()) return true;
+    FILE* f = fopen(file_path.c_str(), "wb");
+    if (!f) return false;
+    for (const auto& kv : blobs) {
+        uint8_t ns_len = static_cast<uint8_t>(kv.first.first.size());
+        uint8_t key_len = static_cast<uint8_t>(kv.first.second.size());
+        uint32_t len = static_cast<uint32_t>(kv.second.size());
+        fwrite(&ns_len, 1, 1, f);
+        fwrite(kv.first.first.data(), 1, ns_len, f);
+        fwrite(&key_len, 1, 1, f);
+        fwrite(kv.first.second.data(), 1, key_len, f);
+        fwrite(&len, sizeof(len), 1, f);
+        fwrite(kv.second.data(), 1, len, f);
+    }
+    return fclose(f) == 0;
+}
+
+bool host_nvs_file(const char* path) {
+    std::lock_guard<std::mutex> guard(lock);
+    file_path = path;
+    FILE* f = fopen(path, "rb");
+    if (!f) return true;    // created on the first commit
+    uint8_t n;
+    while (fread(&n, 1, 1, f) == 1) {
+        std::string ns(n, '\0'), key;
+        uint32_t len = 0;
+        bool ok = fread(&ns[0], 1, n, f) == n && fread(&n, 1, 1, f) == 1;
+        if (ok) {
+            key.resize(n);
+            ok = fread(&key[0], 1, n, f) == n && fread(&len, sizeof(len), 1, f) == 1;
+        }
+        std::vector<uint8_t> data(len);
+        if (!ok || fread(data.data(), 1, len, f) != len) {
+            fclose(f);
+            return false;
+        }
+        blobs[{ns, key}] = std::move(data);
+    }
+    fclose(f);
+    return true;
+}
+
+esp_err_t nvs_open(const char* name, nvs_open_mode_t, nvs_handle_t* out) {
+    std::lock_guard<std::mutex> guard(lock);
+    if (!name || strlen(name) > 15) return ESP_ERR_INVALID_ARG;
+    for (size_t i = 0; i < spaces.size(); i++)
+        if (spaces[i] == name) {
+            *out = static_cast<nvs_handle_t>(i + 1);
+            return ESP_OK;
+        }
+    spaces.push_back(name);
+    *out = static_cast<nvs_handle_t>(spaces.size());
+    return ESP_OK;
+}
+
+void nvs_close(nvs_handle_t) {}
+
+static const std::string* space_of(nvs_handle_t handle) {
+    return handle >= 1 && handle <= spaces.size() ? &spaces[handle - 1] : nullptr;
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char* key, void* out, size_t* length) {
+    std::lock_guard<std::mutex> guard(lock);
+    const std::string* ns = space_of(handle);
+    if (!ns) return ESP_ERR_INVALID_ARG;
+    auto it = blobs.find({*ns, key});
+    if (it == blobs.end()) return ESP_ERR_NVS_NOT_FOUND;
+    if (!out) {
+        *length = it->second.size();
+        return ESP_OK;
+    }
+    if (*length < it->second.size()) return ESP_ERR_NVS_INVALID_LENGTH;
+    memcpy(out, it->second.data(), it->second.size());
+    *length = it->second.size();
+    return ESP_OK;
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char* key, const void* value, size_t length) {
+    std::lock_guard<std::mutex> guard(lock);
+    const std::string* ns = space_of(handle);
+    if (!ns || strlen(key) > 15) return ESP_ERR_INVALID_ARG;
+    const auto* p = static_cast<const uint8_t*>(value);
+    blobs[{*ns, key}].assign(p, p + length);
+    return ESP_OK;
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char* key) {
+    std::lock_guard<std::mutex> guard(lock);
+    const std::string* ns = space_of(handle);
+    if (!ns) return ESP_ERR_INVALID_ARG;
+    return blobs.erase({*ns, key}) ? ESP_OK : ESP_ERR_NVS_NOT_FOUND;
+}
+
+esp_err_t nvs_commit(nvs_handle_t) {
+    std::lock_guard<std::mutex> guard(lock);
+    return save() ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t nvs_entry_find(const char*, const char* ns, nvs_type_t, nvs_iterator_t* out) {
+    std::lock_guard<std::mutex> guard(lock);
+    auto* it = new HostNvsIter{{}, 0};
+    for (const auto& kv : blobs)
+        if (!ns || kv.first.first == ns) it->keys.push_back(kv.first);
+    if (it->keys.empty()) {
+        delete it;
+        *out = nullptr;
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    *out = it;
+    return ESP_OK;
+}
+
+esp_err_t nvs_entry_next(nvs_iterator_t* it) {
+    if (!*it) return ESP_ERR_INVALID_ARG;
+    if (++(*it)->pos < (*it)->keys.size()) return ESP_OK;
+    delete *it;
+    *it = nullptr;
+    return ESP_ERR_NVS_NOT_FOUND;
+}
+
+esp_err_t nvs_entry_info(const nvs_iterator_t it, nvs_entry_info_t* out) {
+    if (!it) return ESP_ERR_INVALID_ARG;
+    const NvsKey& k = it->keys[it->pos];
+    memset(out, 0, sizeof(*out));
+    strncpy(out->namespace_name, k.first.c_str(), sizeof(out->namespace_name) - 1);
+    strncpy(out->key, k.second.c_str(), sizeof(out->key) - 1);
+    out->type = NVS_TYPE_BLOB;
+    return ESP_OK;
+}
+
+void nvs_release_iterator(nvs_iterator_t it) {
+    delete it;
+}
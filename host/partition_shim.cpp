@@ -0,0 +1,54 @@
+#include "esp_partition.h"
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// One file-backed partition is all the host server needs
+static esp_partition_t part;
+static int part_fd = -1;
+static void* mapped;
+static size_t mapped_len;
+
+bool host_partition_file(const char* label, const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) { perror(path); return false; }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return false;
+    }
+    if (part_fd >= 0) close(part_fd);
+    part_fd = fd;
+    part.type = ESP_PARTITION_TYPE_DATA;
+    part.address = 0;
+    part.size = static_cast<uint32_t>(st.st_size);
+    snprintf(part.label, sizeof(part.label), "%s", label);
+    return true;
+}
+
+const esp_partition_t* esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t,
+                                                const char* label) {
+    if (part_fd < 0 || type != part.type || (label && strcmp(label, part.label) != 0)) return nullptr;
+    return &part;
+}
+
+esp_err_t esp_partition_mmap(const esp_partition_t* partition, size_t offset, size_t size,
+                             esp_partition_mmap_memory_t, const void** out_ptr,
+                             esp_partition_mmap_handle_t* out_handle) {
+    if (partition != &part || offset + size > part.size || mapped) return ESP_ERR_INVALID_ARG;
+    void* p = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, part_fd, static_cast<off_t>(offset));
+    if (p == MAP_FAILED) return ESP_FAIL;
+    mapped = p;
+    mapped_len = size;
+    *out_ptr = p;
+    *out_handle = 1;
+    return ESP_OK;
+}
+
+void esp_partition_munmap(esp_partition_mmap_handle_t) {
+    if (mapped) munmap(mapped, mapped_len);
+    mapped = nullptr;
+}
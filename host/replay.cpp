@@ -0,0 +1,234 @@
+// Replays a capture from mc_host_server --capture (or the ESP32 /capture
+// endpoint) through the server logic without sockets. Inbound frames are fed
+// to the dispatcher, and outbound bytes are checked against the recording.
+// Handling cost is reported per inbound packet id.
+//
+//   mc_replay capture.mcap [--realtime]
+//
+// The clock is virtual: it jumps to each record's timestamp, and polls run
+// where the recording has them, so timer driven packets such as keep-alives
+// come out byte-identical. The harness is the network task as well: after
+// every record it drains what the simulation queued on each link.
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "mc_types.h"
+#include "mc_net.h"
+#include "mc_capture.h"
+#include "mc_server.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <thread>
+#include <vector>
+
+static int64_t virt_us = 0;
+
+int64_t esp_timer_get_time() { return virt_us; }
+TickType_t xTaskGetTickCount() { return static_cast<TickType_t>(virt_us / 1000); }
+void vTaskDelay(TickType_t) {}
+
+struct ReplayConn {
+    int slot = -1;
+    std::vector<uint8_t> actual;     // bytes the server wrote this run
+    std::vector<uint8_t> expected;   // bytes the recording says it wrote
+};
+
+static std::map<int, ReplayConn> conns;
+
+int net_recv(int, void*, size_t) { return -1; }
+int net_try_recv(int, void*, size_t) { return -1; }
+
+int net_send(int sock, const void* buf, size_t len) {
+    auto* p = static_cast<const uint8_t*>(buf);
+    conns[sock].actual.insert(conns[sock].actual.end(), p, p + len);
+    return static_cast<int>(len);
+}
+
+int net_try_send(int sock, const void* buf, size_t len) {
+    return net_send(sock, buf, len);
+}
+
+int net_try_sendv(int sock, const NetSeg* segs, int count) {
+    int n = 0;
+    for (int i = 0; i < count; i++) n += net_send(sock, segs[i].data, segs[i].len);
+    return n;
+}
+
+void net_close(int) {}
+
+struct IdCost {
+    uint32_t count = 0;
+    uint64_t total_ns = 0;
+    uint64_t max_ns = 0;
+};
+
+static int64_t wall_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+struct Reader {
+    const uint8_t* p;
+    const uint8_t* end;
+
+    bool varint(int32_t& v) {
+        int n = mc_read_varint(p, end - p, v);
+        if (n < 0) return false;
+        p += n;
+        return true;
+    }
+};
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s capture.mcap [--realtime]\n", argv[0]);
+        return 2;
+    }
+    bool realtime = argc > 2 && !strcmp(argv[2], "--realtime");
+
+    FILE* f = fopen(argv[1], "rb");
+    if (!f) { perror(argv[1]); return 1; }
+    std::vector<uint8_t> file;
+    uint8_t chunk[65536];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0) file.insert(file.end(), chunk, chunk + n);
+    fclose(f);
+
+    if (file.size() < 13 || memcmp(file.data(), "MCAP", 4) || file[4] != CAPTURE_VERSION) {
+        fprintf(stderr, "%s: not a version %d capture\n", argv[1], CAPTURE_VERSION);
+        return 1;
+    }
+    virt_us = mc_read_i64(file.data() + 5);
+    int64_t cap_start = virt_us;
+    int64_t wall_start = wall_ns();
+
+    IdCost in_cost[256];
+    IdCost poll_cost, timer_cost, tick_cost;
+    uint32_t frames_in = 0, frames_out = 0, mismatched = 0, missing = 0;
+    uint32_t mismatch_by_id[256] = {};
+
+    Reader r{file.data() + 13, file.data() + file.size()};
+    int64_t replay_start = wall_ns();
+
+    while (r.p < r.end) {
+        uint8_t kind = *r.p++;
+        int32_t conn, dt, len = 0;
+        if (!r.varint(conn) || !r.varint(dt)) break;
+        const uint8_t* frame = nullptr;
+        if (kind == CAPTURE_IN || kind == CAPTURE_OUT || kind == CAPTURE_TIMER) {
+            if (!r.varint(len) || r.end - r.p < len) break;
+            frame = r.p;
+            r.p += len;
+        }
+        virt_us += dt;
+        for (int slot = 0; slot < MC_MAX_CONNS; slot++) server_conn_drain(slot);
+
+        if (realtime) {
+            int64_t due = wall_start + (virt_us - cap_start) * 1000;
+            int64_t wait = due - wall_ns();
+            if (wait > 0) std::this_thread::sleep_for(std::chrono::nanoseconds(wait));
+        }
+
+        if (kind == CAPTURE_TICK) {
+            int64_t t0 = wall_ns();
+            server_tick();
+            uint64_t ns = wall_ns() - t0;
+            tick_cost.count++;
+            tick_cost.total_ns += ns;
+            if (ns > tick_cost.max_ns) tick_cost.max_ns = ns;
+            continue;
+        }
+
+        if (kind == CAPTURE_OPEN) {
+            conns[conn] = ReplayConn();
+            conns[conn].slot = server_conn_open(conn);
+            continue;
+        }
+
+        auto it = conns.find(conn);
+        if (it == conns.end()) continue;
+        ReplayConn& rc = it->second;
+        // Frames queued just before the server closed still count
+        if (rc.slot < 0 && kind != CAPTURE_OUT) continue;
+
+        if (kind == CAPTURE_CLOSE) {
+            server_conn_close(rc.slot);
+            rc.slot = -1;
+            continue;
+        }
+
+        if (kind != CAPTURE_OUT) {
+            int32_t id = 0;
+            if (kind == CAPTURE_IN) {
+                frames_in++;
+                mc_read_varint(frame, len, id);
+            }
+            IdCost& cost = kind == CAPTURE_IN ? in_cost[id & 0xFF]
+                         : kind == CAPTURE_POLL ? poll_cost : timer_cost;
+            int64_t t0 = wall_ns();
+            bool ok;
+            if (kind == CAPTURE_IN) ok = server_conn_packet(rc.slot, frame, len);
+            else if (kind == CAPTURE_POLL) ok = server_conn_poll(rc.slot);
+            else ok = len < 1 || server_conn_timer(rc.slot, frame[0]);
+            uint64_t ns = wall_ns() - t0;
+            cost.count++;
+            cost.total_ns += ns;
+            if (ns > cost.max_ns) cost.max_ns = ns;
+            if (!ok) rc.slot = -1;
+            continue;
+        }
+
+        // Outbound: by now the server has queued this frame too
+        frames_out++;
+        uint8_t hdr[5];
+        int hdr_len = mc_write_varint(hdr, len);
+        size_t begin = rc.expected.size();
+        rc.expected.insert(rc.expected.end(), hdr, hdr + hdr_len);
+        rc.expected.insert(rc.expected.end(), frame, frame + len);
+
+        int32_t id = 0;
+        mc_read_varint(frame, len, id);
+        if (rc.actual.size() < rc.expected.size()) {
+            missing++;
+            mismatch_by_id[id & 0xFF]++;
+        } else if (memcmp(rc.actual.data() + begin, rc.expected.data() + begin, rc.expected.size() - begin)) {
+            mismatched++;
+            mismatch_by_id[id & 0xFF]++;
+        }
+    }
+
+    double replay_ms = (wall_ns() - replay_start) / 1e6;
+    double span_ms = (virt_us - cap_start) / 1000.0;
+
+    for (auto& [sock, rc] : conns)
+        if (rc.slot >= 0) server_conn_close(rc.slot);
+
+    printf("capture    %s: %.1f ms recorded, replayed in %.1f ms (%s)\n",
+           argv[1], span_ms, replay_ms, realtime ? "original timing" : "as fast as possible");
+    printf("frames     %u in, %u out, %u mismatched, %u missing\n", frames_in, frames_out, mismatched, missing);
+    for (int id = 0; id < 256; id++)
+        if (mismatch_by_id[id]) printf("  diff     id 0x%02x x%u\n", id, mismatch_by_id[id]);
+
+    printf("\n%-8s %8s %12s %10s %10s\n", "in id", "count", "total us", "avg ns", "max ns");
+    for (int id = 0; id < 256; id++) {
+        const IdCost& c = in_cost[id];
+        if (!c.count) continue;
+        printf("0x%02x     %8u %12.1f %10llu %10llu\n", id, c.count, c.total_ns / 1000.0,
+               static_cast<unsigned long long>(c.total_ns / c.count),
+               static_cast<unsigned long long>(c.max_ns));
+    }
+    const IdCost* periodic[] = {&poll_cost, &timer_cost, &tick_cost};
+    const char* periodic_names[] = {"poll", "timer", "tick"};
+    for (int i = 0; i < 3; i++) {
+        const IdCost& c = *periodic[i];
+        if (!c.count) continue;
+        printf("%-8s %8u %12.1f %10llu %10llu\n", periodic_names[i], c.count, c.total_ns / 1000.0,
+               static_cast<unsigned long long>(c.total_ns / c.count),
+               static_cast<unsigned long long>(c.max_ns));
+    }
+
+    return (mismatched || missing) ? 1 : 0;
+}
@@ -0,0 +1,266 @@
+// Renders a flight recorder dump (src/mc_trace.h) as a timeline.
+//
+//   curl -s localhost:25566/trace > t.mctr        (or /trace/saved)
+//   mc_timeline t.mctr [--conn SOCK] [--chrome t.json] [--quiet]
+//   mc_timeline --bench [--events N]
+//
+// Prints one line per event with its time since the first event, pairs
+// chunk begin/end into build times, then summarises packets per kind,
+// chunk builds, send stalls, loop overruns, allocation failures and error
+// closes. --chrome also writes Chrome trace JSON for chrome://tracing or
+// Perfetto, one track per core and per connection. --bench times trace()
+// itself on this machine.
+
+#include "config.h"
+#include "mc_trace.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <vector>
+
+static const char* KIND_NAMES[TRACE_KIND_COUNT] = {
+    "clock", "pkt_in", "pkt_out", "chunk_begin", "chunk_end", "send_stall", "overrun", "alloc_fail", "open", "close",
+};
+
+static const char* MEM_TAGS[] = {"packet", "scratch", "cache", "entity", "other"};
+
+struct Timed {
+    TraceEvent e;
+    TraceKind kind;
+    int core;
+    double us;      // since the first event
+};
+
+// Puts every event on the esp_timer clock using the latest clock anchor of
+// its core. Events before a core's first anchor use that anchor, so they
+// come out as negative offsets from it.
+static std::vector<Timed> place(const std::vector<TraceEvent>& events, uint32_t cycles_per_us) {
+    struct Anchor { uint32_t cycles; double us; };
+    std::vector<Anchor> first(2, {0, -1}), cur(2, {0, -1});
+    double us_base = 0;
+    uint32_t last_us32 = 0;
+    bool any_anchor = false;
+
+    // Anchor microseconds are 32 bits too; unwrap them in order
+    std::vector<double> anchor_us(events.size(), -1);
+    for (size_t i = 0; i < events.size(); i++) {
+        const TraceEvent& e = events[i];
+        if ((e.kind & ~TRACE_CORE_BIT) != TRACE_CLOCK) continue;
+        if (any_anchor && e.b < last_us32) us_base += 4294967296.0;
+        last_us32 = e.b;
+        any_anchor = true;
+        anchor_us[i] = us_base + e.b;
+        int core = e.kind & TRACE_CORE_BIT ? 1 : 0;
+        if (first[core].us < 0) first[core] = {e.cycles, anchor_us[i]};
+    }
+
+    std::vector<Timed> out;
+    out.reserve(events.size());
+    uint32_t raw_base = events.empty() ? 0 : events[0].cycles;
+    for (size_t i = 0; i < events.size(); i++) {
+        const TraceEvent& e = events[i];
+        Timed t{e, static_cast<TraceKind>(e.kind & ~TRACE_CORE_BIT), e.kind & TRACE_CORE_BIT ? 1 : 0, 0};
+        if (anchor_us[i] >= 0) cur[t.core] = {e.cycles, anchor_us[i]};
+        const Anchor& a = cur[t.core].us >= 0 ? cur[t.core] : first[t.core];
+        if (a.us >= 0)
+            t.us = a.us + static_cast<int32_t>(e.cycles - a.cycles) / static_cast<double>(cycles_per_us);
+        else    // no anchor on this core at all: raw cycles
+            t.us = static_cast<int32_t>(e.cycles - raw_base) / static_cast<double>(cycles_per_us);
+        out.push_back(t);
+    }
+    if (!out.empty()) {
+        double t0 = out[0].us;
+        for (const auto& t : out) t0 = std::min(t0, t.us);
+        for (auto& t : out) t.us -= t0;
+    }
+    return out;
+}
+
+static double percentile(std::vector<double> v, double p) {
+    if (v.empty()) return 0;
+    std::sort(v.begin(), v.end());
+    return v[std::min(v.size() - 1, static_cast<size_t>(v.size() * p))];
+}
+
+static int bench(int n) {
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < n; i++) trace(TRACE_PKT_OUT, 3, 0x28, static_cast<uint32_t>(i));
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+    // On the ESP32 the cycle counter is one register read; here it is a
+    // clock call, so report it separately
+    volatile uint32_t sink = 0;
+    auto t1 = std::chrono::steady_clock::now();
+    for (int i = 0; i < n; i++) sink = sink + trace_cycles();
+    double clock_ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t1).count();
+    printf("trace()  %d events, %.1f ns/event, %.1f ns of it reading the host clock\n", n, ns / n, clock_ns / n);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    const char* path = nullptr;
+    const char* chrome = nullptr;
+    int only_conn = -1;
+    bool quiet = false;
+    int bench_events = 0;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--chrome") && i + 1 < argc) chrome = argv[++i];
+        else if (!strcmp(argv[i], "--conn") && i + 1 < argc) only_conn = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--quiet")) quiet = true;
+        else if (!strcmp(argv[i], "--bench")) bench_events = bench_events ? bench_events : 10000000;
+        else if (!strcmp(argv[i], "--events") && i + 1 < argc) bench_events = atoi(argv[++i]);
+        else path = argv[i];
+    }
+    if (bench_events) return bench(bench_events);
+    if (!path) {
+        fprintf(stderr, "usage: mc_timeline dump.mctr [--conn SOCK] [--chrome out.json] [--quiet]\n");
+        return 2;
+    }
+
+    FILE* f = fopen(path, "rb");
+    if (!f) { perror(path); return 1; }
+    std::vector<uint8_t> bytes;
+    uint8_t buf[65536];
+    size_t r;
+    while ((r = fread(buf, 1, sizeof(buf), f)) > 0) bytes.insert(bytes.end(), buf, buf + r);
+    fclose(f);
+
+    // Skip an HTTP header if the dump was saved with it
+    size_t off = 0;
+    for (size_t i = 0; i + 4 <= bytes.size() && i < 512; i++)
+        if (!memcmp(&bytes[i], "MCTR", 4)) { off = i; break; }
+    TraceHeader hdr;
+    if (bytes.size() < off + sizeof(hdr) || memcmp(&bytes[off], "MCTR", 4)) {
+        fprintf(stderr, "%s: not a trace dump\n", path);
+        return 1;
+    }
+    memcpy(&hdr, &bytes[off], sizeof(hdr));
+    if (hdr.version != TRACE_VERSION || !hdr.cycles_per_us) {
+        fprintf(stderr, "%s: unsupported version %u\n", path, hdr.version);
+        return 1;
+    }
+    size_t avail = (bytes.size() - off - sizeof(hdr)) / sizeof(TraceEvent);
+    std::vector<TraceEvent> events(std::min<size_t>(hdr.count, avail));
+    if (!events.empty()) memcpy(events.data(), &bytes[off + sizeof(hdr)], events.size() * sizeof(TraceEvent));
+    if (events.size() < hdr.count) fprintf(stderr, "dump truncated: %zu of %u events\n", events.size(), hdr.count);
+
+    std::vector<Timed> tl = place(events, hdr.cycles_per_us);
+    auto cycles_us = [&](uint32_t c) { return c / static_cast<double>(hdr.cycles_per_us); };
+
+    std::map<std::pair<int, int>, double> open_chunks;   // (cx, cz) -> begin time
+    std::vector<double> builds, stalls;
+    uint32_t counts[TRACE_KIND_COUNT] = {};
+    uint64_t bytes_in = 0, bytes_out = 0;
+    int overruns = 0, alloc_fails = 0, error_closes = 0;
+    double overrun_max = 0;
+
+    FILE* json = chrome ? fopen(chrome, "w") : nullptr;
+    if (chrome && !json) { perror(chrome); return 1; }
+    if (json) fprintf(json, "{\"traceEvents\":[\n");
+    bool first_json = true;
+    auto emit = [&](const char* ph, const char* name, int pid, int tid, double ts, double dur, const char* args) {
+        if (!json) return;
+        fprintf(json, "%s{\"ph\":\"%s\",\"name\":\"%s\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f", first_json ? "" : ",\n",
+                ph, name, pid, tid, ts);
+        if (dur >= 0) fprintf(json, ",\"dur\":%.3f", dur);
+        if (*ph == 'i') fprintf(json, ",\"s\":\"t\"");
+        fprintf(json, ",\"args\":{%s}}", args);
+        first_json = false;
+    };
+
+    if (!quiet) printf("%zu events, %u cycles/us\n", tl.size(), hdr.cycles_per_us);
+    for (const Timed& t : tl) {
+        if (t.kind >= TRACE_KIND_COUNT) continue;
+        const TraceEvent& e = t.e;
+        counts[t.kind]++;
+        bool conn_event = t.kind == TRACE_PKT_IN || t.kind == TRACE_PKT_OUT || t.kind == TRACE_OPEN ||
+                          t.kind == TRACE_CLOSE || t.kind == TRACE_SEND_STALL;
+        char detail[96] = "";
+        char args[96] = "";
+        switch (t.kind) {
+        case TRACE_CLOCK:
+            snprintf(detail, sizeof(detail), "esp_timer %u us", e.b);
+            break;
+        case TRACE_PKT_IN:
+        case TRACE_PKT_OUT:
+            (t.kind == TRACE_PKT_IN ? bytes_in : bytes_out) += e.b;
+            snprintf(detail, sizeof(detail), "id 0x%02X  %u B", e.a, e.b);
+            snprintf(args, sizeof(args), "\"id\":%u,\"bytes\":%u", e.a, e.b);
+            emit("i", t.kind == TRACE_PKT_IN ? "in" : "out", 1, e.conn, t.us, -1, args);
+            break;
+        case TRACE_CHUNK_BEGIN:
+            open_chunks[{static_cast<int16_t>(e.a), static_cast<int32_t>(e.b)}] = t.us;
+            snprintf(detail, sizeof(detail), "%d,%d", static_cast<int16_t>(e.a), static_cast<int32_t>(e.b));
+            break;
+        case TRACE_CHUNK_END: {
+            auto it = open_chunks.find({static_cast<int16_t>(e.a), static_cast<int32_t>(e.b)});
+            double d = it != open_chunks.end() ? t.us - it->second : -1;
+            if (d >= 0) {
+                builds.push_back(d);
+                snprintf(args, sizeof(args), "\"cx\":%d,\"cz\":%d", static_cast<int16_t>(e.a),
+                         static_cast<int32_t>(e.b));
+                emit("X", "chunk", 0, t.core, it->second, d, args);
+                open_chunks.erase(it);
+            }
+            snprintf(detail, sizeof(detail), "%d,%d  %.3f ms", static_cast<int16_t>(e.a), static_cast<int32_t>(e.b),
+                     d / 1000.0);
+            break;
+        }
+        case TRACE_SEND_STALL: {
+            double d = cycles_us(e.b);
+            stalls.push_back(d);
+            snprintf(detail, sizeof(detail), "slot %u blocked %.3f ms", e.conn, d / 1000.0);
+            emit("X", "send stall", 2, e.conn, t.us - d, d, "");
+            break;
+        }
+        case TRACE_OVERRUN: {
+            double d = cycles_us(e.b);
+            overruns++;
+            overrun_max = std::max(overrun_max, d);
+            snprintf(detail, sizeof(detail), "loop pass %.3f ms", d / 1000.0);
+            emit("X", "overrun", 0, t.core, t.us - d, d, "");
+            break;
+        }
+        case TRACE_ALLOC_FAIL:
+            alloc_fails++;
+            snprintf(detail, sizeof(detail), "%s %u B", e.a < 5 ? MEM_TAGS[e.a] : "?", e.b);
+            emit("i", "alloc fail", 0, t.core, t.us, -1, "");
+            break;
+        case TRACE_OPEN:
+            emit("i", "open", 1, e.conn, t.us, -1, "");
+            break;
+        case TRACE_CLOSE:
+            error_closes += e.a != 0;
+            snprintf(detail, sizeof(detail), "%s", e.a ? "error" : "");
+            emit("i", e.a ? "close (error)" : "close", 1, e.conn, t.us, -1, "");
+            break;
+        default:
+            break;
+        }
+        if (quiet || (only_conn >= 0 && (!conn_event || (t.kind == TRACE_SEND_STALL ? -1 : e.conn) != only_conn)))
+            continue;
+        char who[16] = "";
+        if (conn_event && t.kind != TRACE_SEND_STALL) snprintf(who, sizeof(who), "sock %u", e.conn);
+        printf("%12.3f ms  c%d  %-8s %-12s %s\n", t.us / 1000.0, t.core, who, KIND_NAMES[t.kind], detail);
+    }
+    if (json) {
+        fprintf(json, "\n]}\n");
+        fclose(json);
+    }
+
+    printf("\nspan           %.1f ms, %zu events\n", tl.empty() ? 0.0 : tl.back().us / 1000.0, tl.size());
+    printf("packets        %u in (%llu B), %u out (%llu B)\n", counts[TRACE_PKT_IN],
+           static_cast<unsigned long long>(bytes_in), counts[TRACE_PKT_OUT],
+           static_cast<unsigned long long>(bytes_out));
+    printf("chunk builds   %zu, p50=%.3fms max=%.3fms\n", builds.size(), percentile(builds, 0.5) / 1000.0,
+           builds.empty() ? 0.0 : *std::max_element(builds.begin(), builds.end()) / 1000.0);
+    printf("send stalls    %zu, p50=%.3fms max=%.3fms\n", stalls.size(), percentile(stalls, 0.5) / 1000.0,
+           stalls.empty() ? 0.0 : *std::max_element(stalls.begin(), stalls.end()) / 1000.0);
+    printf("overruns       %d, max=%.3fms\n", overruns, overrun_max / 1000.0);
+    printf("alloc fails    %d\n", alloc_fails);
+    printf("connections    %u opened, %u closed, %d on an error\n", counts[TRACE_OPEN], counts[TRACE_CLOSE],
+           error_closes);
+    return 0;
+}
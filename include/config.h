@@ -4,9 +4,105 @@
 
 // Settings
 #define MC_PORT          25565
-#define MC_MAX_PLAYERS   1
+#define MC_MAX_PLAYERS   5
+#define MC_MAX_CONNS     (MC_MAX_PLAYERS + 1)   // one spare for status pings
 #define MC_VIEW_DISTANCE 2
 #define MC_SIM_DISTANCE  2
+#define MC_CHUNK_BUDGET  4     // chunks streamed per PLAY loop pass
+#define MC_LOD_DISTANCE  6     // low-detail chunks out to here once the view is in
+#define MC_LOD_BUDGET    8     // low-detail chunks streamed per PLAY loop pass
+#define MC_MAX_ENTITIES  4096  // entity store capacity (PSRAM, ~60 bytes each)
+#define MC_ITEM_LIFETIME 6000  // ticks before an item drop despawns (5 min)
+#define MC_WORLD_COLUMNS 64    // chunk columns with cached collision masks
+
+// Block ticks (water flow, grass) in chunks within MC_SIM_DISTANCE of a
+// player, every MC_TICK_MS while anyone is in play
+#define MC_TICK_MS            50
+#define MC_TICK_RANDOM        3       // random ticks per section per game tick
+#define MC_TICK_BUDGET        2048    // scheduled ticks run per game tick; the rest wait
+#define MC_TICK_SCHEDULED     4096    // scheduled ticks waiting (PSRAM, 16 bytes each)
+#define MC_TICK_COLUMNS       128     // chunk columns tracked (PSRAM)
+#define MC_TICK_LOADS         2       // new columns whose surface loads per game tick
+#define MC_TICK_SECTIONS      160     // sections loaded for ticking (PSRAM, 5 KB each)
+#define MC_TICK_EDIT_SECTIONS 1024    // sections with block edits, power of two
+#define MC_FILL_MAX           32768   // blocks one fill command may cover
+#define MC_WORLD_BORDER       29999984 // |x| and |z| commands may reach (vanilla's border)
+#define MC_REACH              6.0     // blocks from the eyes a player can break
+#define MC_NBT_MAX_DEPTH      32      // nesting an inbound NBT payload may have
+#define MC_NBT_MAX_BYTES      32768   // bytes an inbound NBT payload may take
+
+// Light relit around changed blocks, kept per section. Past half the
+// table, the sections of columns no player has loaded are dropped and
+// rebuilt from the block edits when next needed.
+#define MC_LIGHT_SECTIONS     256     // sections with relit light, power of two (PSRAM, 2-4 KB each); 3/4 usable
+#define MC_LIGHT_QUEUE        4096    // cells waiting in each propagation queue (PSRAM, 12 bytes each)
+#define MC_LIGHT_EMITTERS     32      // blocks giving off light
+#define MC_LIGHT_STALE        256     // dropped columns awaiting a rebuild (8 bytes each)
+
+// Mob navigation: walkability per section from the collision masks, and
+// A* searches shared by the mobs heading for the same target
+#define MC_NAV_SECTIONS       128     // sections with walkability, power of two (PSRAM, 1.5 KB each)
+#define MC_NAV_FIELDS         4       // targets searched at once (PSRAM, 52 KB each)
+#define MC_NAV_NODES          2048    // cells one search may reach
+#define MC_NAV_BUDGET         512     // cells expanded per game tick, all searches together
+
+// World image baked offline by mc_bake: chunks inside it are read from this
+// data partition instead of generated
+#define MC_WORLD_PARTITION    "world"
+
+// Connection timers (ms)
+#define MC_KEEPALIVE_MS         10000
+#define MC_KEEPALIVE_TIMEOUT_MS 15000   // unanswered keep-alive drops the player
+#define MC_HANDSHAKE_TIMEOUT_MS 5000    // handshake and status exchange
+#define MC_LOGIN_TIMEOUT_MS     30000   // login through configuration
+
+// Network / simulation split: the network task owns the sockets and passes
+// decoded commands to the simulation task (its own core) over SPSC rings
+#define MC_SIM_CORE          1
+#define MC_SIM_STACK         32768
+#define MC_LINK_IN_LEN       16            // commands per connection (power of two)
+#define MC_LINK_OUT_LEN      256           // queued packets per connection (power of two)
+#define MC_LINK_STREAM_BYTES (32 * 1024)   // chunk streaming pauses above this backlog
+#define MC_NET_POLL_MS       1             // network task wake-up while clients are connected
+#define MC_ACCEPT_RETRY_MS   100           // listening pauses this long after a failed accept
+
+// Player persistence in NVS. Changes wait in RAM and are written at most
+// this often (and when the player leaves), to bound flash wear.
+#define MC_STORE_PLAYERS  32       // records cached in RAM
+#define MC_STORE_FLUSH_MS 60000
+
+// Sharding: with a coordinator host set, this node owns one band of chunk
+// columns and hands players over to the node that owns where they walk
+#define MC_SHARD_COORDINATOR ""      // mc_coordinator host; empty runs a single node
+#define MC_SHARD_COORD_PORT  25580
+#define MC_SHARD_NODE        0       // this node's index in the coordinator's table
+#define MC_SHARD_MAX_NODES   8
+#define MC_SHARD_MARGIN      8       // blocks into another band before a handoff
+#define MC_SHARD_TIMEOUT_MS  500     // coordinator and peer requests
+#define MC_SHARD_FETCHES     8       // chunks fetched from other nodes at once
+#define MC_SHARD_RETRY_MS    10000   // wait after a failed fetch (per node) or handoff (per player)
+
+// Sockets the server may hold at once: the game and metrics listeners, one
+// metrics client and every connection, plus on a sharded node the peer
+// listener, a connection from and to every other node and one to the
+// coordinator. Must fit CONFIG_LWIP_MAX_SOCKETS (checked in mc_server.cpp).
+#define MC_SOCKETS (3 + MC_MAX_CONNS + (MC_SHARD_COORDINATOR[0] ? 2 + 2 * MC_SHARD_MAX_NODES : 0))
+
+// Instrumentation: stage timers, packet counters, metrics endpoint (0 compiles it out)
+#define MC_METRICS        1
+#define MC_METRICS_PORT   25566
+#define MC_METRICS_LOG_MS 30000
+
+// Flight recorder: always-on ring of binary events (0 compiles it out)
+#define MC_TRACE            1
+#define MC_TRACE_EVENTS     2048    // ring length, power of two; 12 bytes each in internal RAM
+#define MC_TRACE_OVERRUN_US 50000   // simulation loop pass longer than a game tick
+
+// Frame capture for replay (host builds enable it with -DMC_CAPTURE=1)
+#ifndef MC_CAPTURE
+#define MC_CAPTURE        0
+#endif
+#define MC_CAPTURE_BYTES  (1024 * 1024)
 
 // Version info
 #define MC_PROTOCOL_VERSION 769   // 1.21.4
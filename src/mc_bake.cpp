@@ -0,0 +1,154 @@
+#include "mc_bake.h"
+#include "mc_world.h"
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "config.h"
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+
+static const char* TAG = "mc_bake";
+
+static const uint8_t* image;
+static uint32_t image_len;
+static int32_t min_cx, min_cz;
+static uint32_t side;
+static std::atomic<uint32_t> columns_read{0};
+static std::atomic<uint32_t> sections_read{0};
+static std::atomic<uint32_t> corrupt{0};
+
+// Flash-mapped bytes may sit at any alignment
+static uint16_t rd16(const uint8_t* p) { uint16_t v; memcpy(&v, p, 2); return v; }
+static uint32_t rd32(const uint8_t* p) { uint32_t v; memcpy(&v, p, 4); return v; }
+
+// Header and index fit the image, and every column fits after the index
+static bool valid(const uint8_t* p, size_t len) {
+    if (len < BAKE_HEADER || memcmp(p, "MCWB", 4) != 0) return false;
+    if (rd16(p + 4) != BAKE_VERSION || rd16(p + 6) != WORLD_SECTIONS) return false;
+    uint32_t n = rd32(p + 16), bytes = rd32(p + 20);
+    if (n == 0 || n > 4096 || bytes > len) return false;
+    size_t index_end = BAKE_HEADER + static_cast<size_t>(n) * n * 4;
+    if (index_end > bytes) return false;
+    size_t head = BAKE_COLUMN_HEAD + WORLD_SECTIONS * 4;
+    for (size_t i = 0; i < static_cast<size_t>(n) * n; i++) {
+        uint32_t off = rd32(p + BAKE_HEADER + i * 4);
+        if (off && (off < index_end || static_cast<size_t>(off) + head > bytes)) return false;
+    }
+    return true;
+}
+
+bool bake_open() {
+    const esp_partition_t* part =
+        esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, MC_WORLD_PARTITION);
+    if (!part) return false;
+    const void* ptr = nullptr;
+    esp_partition_mmap_handle_t handle;
+    if (esp_partition_mmap(part, 0, part->size, ESP_PARTITION_MMAP_DATA, &ptr, &handle) != ESP_OK) {
+        ESP_LOGW(TAG, "Cannot map partition %s", MC_WORLD_PARTITION);
+        return false;
+    }
+    auto* p = static_cast<const uint8_t*>(ptr);
+    if (!valid(p, part->size)) {
+        ESP_LOGI(TAG, "Partition %s holds no world image", MC_WORLD_PARTITION);
+        esp_partition_munmap(handle);
+        return false;
+    }
+    memcpy(&min_cx, p + 8, 4);
+    memcpy(&min_cz, p + 12, 4);
+    side = rd32(p + 16);
+    image_len = rd32(p + 20);
+    image = p;
+    ESP_LOGI(TAG, "World image: %ux%u chunks from %d,%d, %u bytes", static_cast<unsigned>(side),
+             static_cast<unsigned>(side), static_cast<int>(min_cx), static_cast<int>(min_cz),
+             static_cast<unsigned>(image_len));
+    return true;
+}
+
+const uint8_t* bake_column(int cx, int cz) {
+    if (!image) return nullptr;
+    uint32_t x = static_cast<uint32_t>(cx - min_cx), z = static_cast<uint32_t>(cz - min_cz);
+    if (x >= side || z >= side) return nullptr;
+    uint32_t off = rd32(image + BAKE_HEADER + (static_cast<size_t>(z) * side + x) * 4);
+    if (!off) return nullptr;
+    columns_read.fetch_add(1, std::memory_order_relaxed);
+    return image + off;
+}
+
+void bake_sky_heights(const uint8_t* col, int sky_h[16][16]) {
+    for (int z = 0; z < 16; z++)
+        for (int x = 0; x < 16; x++)
+            sky_h[x][z] = static_cast<int16_t>(rd16(col + (x + z * 16) * 2));
+}
+
+int bake_section(const uint8_t* col, int si, uint8_t* pis) {
+    const uint8_t* table = col + BAKE_COLUMN_HEAD;
+    size_t at = BAKE_COLUMN_HEAD + WORLD_SECTIONS * 4;
+    for (int s = 0; s < si; s++) at += rd16(table + s * 4 + 2);
+    int count = rd16(table + si * 4);
+    size_t len = rd16(table + si * 4 + 2);
+    if (count == 0) return 0;
+    sections_read.fetch_add(1, std::memory_order_relaxed);
+    // Whatever is left of a damaged section reads as air
+    if (col + at + len > image + image_len || !bake_unpack(col + at, len, pis, 4096)) {
+        corrupt.fetch_add(1, std::memory_order_relaxed);
+        memset(pis, 0, 4096);
+        return 0;
+    }
+    return count;
+}
+
+size_t bake_pack(const uint8_t* src, size_t n, uint8_t* out) {
+    size_t i = 0, o = 0;
+    while (i < n) {
+        size_t run = 1;
+        while (i + run < n && run < 128 && src[i + run] == src[i]) run++;
+        if (run >= 2) {
+            out[o++] = static_cast<uint8_t>(257 - run);
+            out[o++] = src[i];
+            i += run;
+            continue;
+        }
+        // Literals up to the next run of two or more
+        size_t lit = 1;
+        while (i + lit < n && lit < 128 && !(i + lit + 1 < n && src[i + lit] == src[i + lit + 1])) lit++;
+        out[o++] = static_cast<uint8_t>(lit - 1);
+        memcpy(out + o, src + i, lit);
+        o += lit;
+        i += lit;
+    }
+    return o;
+}
+
+bool bake_unpack(const uint8_t* src, size_t len, uint8_t* out, size_t n) {
+    size_t i = 0, o = 0;
+    while (i < len) {
+        uint8_t c = src[i++];
+        if (c < 128) {
+            size_t lit = c + 1;
+            if (i + lit > len || o + lit > n) return false;
+            memcpy(out + o, src + i, lit);
+            i += lit;
+            o += lit;
+        } else if (c > 128) {
+            size_t run = 257 - c;
+            if (i >= len || o + run > n) return false;
+            memset(out + o, src[i++], run);
+            o += run;
+        }
+    }
+    return o == n;
+}
+
+size_t bake_summary(char* buf, size_t cap) {
+    int n;
+    if (!image)
+        n = snprintf(buf, cap, "no world image, generating every chunk");
+    else
+        n = snprintf(buf, cap, "image=%ux%u at %d,%d bytes=%u columns=%u sections=%u corrupt=%u",
+                     static_cast<unsigned>(side), static_cast<unsigned>(side), static_cast<int>(min_cx),
+                     static_cast<int>(min_cz), static_cast<unsigned>(image_len),
+                     static_cast<unsigned>(columns_read.load(std::memory_order_relaxed)),
+                     static_cast<unsigned>(sections_read.load(std::memory_order_relaxed)),
+                     static_cast<unsigned>(corrupt.load(std::memory_order_relaxed)));
+    return n < 0 ? 0 : static_cast<size_t>(n) < cap ? n : cap - 1;
+}
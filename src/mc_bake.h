@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+// Pre-generated world image: the generator's blocks for a square of chunk
+// columns, baked offline by mc_bake and mapped read-only from flash.
+// Chunks inside it skip terrain and tree generation; everything else
+// (block edits, collision masks, light, the wire encoding) works on the
+// blocks as before, so a chunk reads the same whether baked or generated.
+//
+// Layout, little endian:
+//   header   "MCWB", u16 version, u16 sections, i32 min_cx, i32 min_cz,
+//            u32 side, u32 image bytes
+//   index    side * side u32 column offsets from the image start, x fastest;
+//            0 for a column left out
+//   column   256 i16 sky heights (highest block that stops sky light, at
+//            x + z*16), then per section u16 block count and u16 packed
+//            length, then the packed sections in order. A section with no
+//            blocks has no packed bytes.
+// Sections pack their 4096 palette indices (x + z*16 + y*256) with
+// PackBits: a control byte n < 128 copies the next n + 1 bytes, n > 128
+// repeats the next byte 257 - n times.
+
+static constexpr uint16_t BAKE_VERSION = 2;
+static constexpr size_t BAKE_HEADER = 24;
+static constexpr size_t BAKE_COLUMN_HEAD = 512;    // sky heights
+
+// Maps the MC_WORLD_PARTITION partition; false (and the world generates
+// as usual) when there is none or it holds no image
+bool bake_open();
+// Column record of chunk (cx, cz), or nullptr outside the image
+const uint8_t* bake_column(int cx, int cz);
+// Highest block of each column that stops sky light, at [x][z]
+void bake_sky_heights(const uint8_t* col, int sky_h[16][16]);
+// Block count of section si; fills pis only when it is not 0, like the
+// generator
+int bake_section(const uint8_t* col, int si, uint8_t* pis);
+
+// PackBits of n bytes into out (at least n + n / 128 + 1 bytes); returns
+// the packed length. For the baking tool.
+size_t bake_pack(const uint8_t* src, size_t n, uint8_t* out);
+// Unpacks into exactly n bytes; false if the input runs short or long
+bool bake_unpack(const uint8_t* src, size_t len, uint8_t* out, size_t n);
+
+size_t bake_summary(char* buf, size_t cap);
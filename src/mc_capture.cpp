@@ -0,0 +1,122 @@
+#include "mc_capture.h"
+
+#if MC_CAPTURE
+
+#include "mc_types.h"
+#include "mc_mem.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include <cstdio>
+#include <cstring>
+
+static const char* TAG = "mc_capture";
+
+static FILE* file = nullptr;
+static uint8_t* buf = nullptr;
+static size_t buf_cap = 0;
+static size_t buf_len = 0;
+static bool active = false;
+static int64_t last_us = 0;
+
+// In memory mode a record is written whole or not at all
+static bool reserve(size_t n) {
+    if (file || buf_len + n <= buf_cap) return true;
+    ESP_LOGW(TAG, "Capture buffer full after %u bytes, stopping", static_cast<unsigned>(buf_len));
+    active = false;
+    return false;
+}
+
+static void put(const uint8_t* src, size_t n) {
+    if (file) {
+        fwrite(src, 1, n, file);
+        return;
+    }
+    memcpy(buf + buf_len, src, n);
+    buf_len += n;
+}
+
+static void put_header() {
+    uint8_t hdr[13] = {'M', 'C', 'A', 'P', CAPTURE_VERSION};
+    last_us = esp_timer_get_time();
+    mc_write_i64(hdr + 5, last_us);
+    put(hdr, sizeof(hdr));
+}
+
+bool capture_start_file(const char* path) {
+    capture_stop();
+    file = fopen(path, "wb");
+    if (!file) {
+        ESP_LOGE(TAG, "Cannot open %s", path);
+        return false;
+    }
+    active = true;
+    put_header();
+    ESP_LOGI(TAG, "Capturing to %s", path);
+    return true;
+}
+
+bool capture_start_memory(size_t bytes) {
+    capture_stop();
+    buf = static_cast<uint8_t*>(mem_alloc(MEM_OTHER, bytes));
+    if (!buf) return false;
+    buf_cap = bytes;
+    buf_len = 0;
+    active = true;
+    put_header();
+    ESP_LOGI(TAG, "Capturing to a %u byte buffer", static_cast<unsigned>(bytes));
+    return true;
+}
+
+void capture_stop() {
+    active = false;
+    if (file) { fclose(file); file = nullptr; }
+    if (buf) { mem_free(buf); buf = nullptr; }
+    buf_cap = buf_len = 0;
+}
+
+static void put_record_head(int conn, CaptureKind kind) {
+    uint8_t tmp[11];
+    int64_t now = esp_timer_get_time();
+    int64_t dt = now - last_us;
+    last_us = now;
+    if (dt > INT32_MAX) dt = INT32_MAX;
+    tmp[0] = kind;
+    int n = 1;
+    n += mc_write_varint(tmp + n, conn);
+    n += mc_write_varint(tmp + n, static_cast<int32_t>(dt));
+    put(tmp, n);
+}
+
+void capture_frame(int conn, CaptureKind kind, const uint8_t* data, size_t len) {
+    if (!active || !reserve(16 + len)) return;
+    put_record_head(conn, kind);
+    uint8_t tmp[5];
+    put(tmp, mc_write_varint(tmp, static_cast<int32_t>(len)));
+    put(data, len);
+    // Host servers are usually stopped with Ctrl-C; keep the file whole
+    if (file) fflush(file);
+}
+
+void capture_frame_segs(int conn, CaptureKind kind, const NetSeg* segs, int count) {
+    size_t len = 0;
+    for (int i = 0; i < count; i++) len += segs[i].len;
+    if (!active || !reserve(16 + len)) return;
+    put_record_head(conn, kind);
+    uint8_t tmp[5];
+    put(tmp, mc_write_varint(tmp, static_cast<int32_t>(len)));
+    for (int i = 0; i < count; i++) put(static_cast<const uint8_t*>(segs[i].data), segs[i].len);
+    if (file) fflush(file);
+}
+
+void capture_event(int conn, CaptureKind kind) {
+    if (!active || !reserve(11)) return;
+    put_record_head(conn, kind);
+    if (file) fflush(file);
+}
+
+const uint8_t* capture_buffer(size_t& len) {
+    len = buf_len;
+    return buf;
+}
+
+#endif
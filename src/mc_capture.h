@@ -0,0 +1,54 @@
+#pragma once
+
+#include "config.h"
+#include "mc_net.h"
+#include <cstdint>
+#include <cstddef>
+
+// Binary capture of every frame the server reads or writes, for replay.
+//
+// Layout: "MCAP", u8 version, i64 start time (us), then records of
+//   u8 kind, varint conn, varint us since previous record,
+//   and for IN/OUT frames: varint length, frame bytes (id + payload).
+// conn is the socket the frame travelled on; OPEN/CLOSE bracket its use.
+// Records are written by the simulation task: IN when a frame is applied,
+// OUT when a frame is queued. POLL marks a server poll of that connection,
+// so replay runs it at the same point relative to the inbound frames.
+// TIMER records a connection timer firing; its one-byte payload says which.
+// TICK (conn -1) is a game tick of the block tick engine.
+
+enum CaptureKind : uint8_t {
+    CAPTURE_IN,
+    CAPTURE_OUT,
+    CAPTURE_OPEN,
+    CAPTURE_CLOSE,
+    CAPTURE_POLL,    // periodic work that may write frames
+    CAPTURE_TIMER,
+    CAPTURE_TICK
+};
+
+static constexpr uint8_t CAPTURE_VERSION = 5;
+
+#if MC_CAPTURE
+
+// Streams records to a file (host builds)
+bool capture_start_file(const char* path);
+// Records into a fixed PSRAM buffer; recording stops when it fills
+bool capture_start_memory(size_t bytes);
+void capture_stop();
+
+void capture_frame(int conn, CaptureKind kind, const uint8_t* data, size_t len);
+// capture_frame of a frame sent in pieces
+void capture_frame_segs(int conn, CaptureKind kind, const NetSeg* segs, int count);
+void capture_event(int conn, CaptureKind kind);
+
+// In-memory capture contents, or nullptr when recording to a file
+const uint8_t* capture_buffer(size_t& len);
+
+#else
+
+inline void capture_frame(int, CaptureKind, const uint8_t*, size_t) {}
+inline void capture_frame_segs(int, CaptureKind, const NetSeg*, int) {}
+inline void capture_event(int, CaptureKind) {}
+
+#endif
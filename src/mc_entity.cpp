@@ -0,0 +1,211 @@
+#include "mc_entity.h"
+#include "mc_mem.h"
+#include "config.h"
+#include <cfloat>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <type_traits>
+
+static_assert(MC_MAX_ENTITIES < 65536, "entity slots are 16-bit");
+
+static constexpr float GRAVITY[ENTITY_TYPE_COUNT] = { 0.0f, 32.0f, 16.0f };   // blocks/s^2
+static constexpr float DRAG[ENTITY_TYPE_COUNT]    = { 0.0f, 0.4f, 0.4f };     // velocity lost per second
+static constexpr float HALF_WIDTH[ENTITY_TYPE_COUNT] = { 0.3f, 0.3f, 0.125f };
+static constexpr float HEIGHT[ENTITY_TYPE_COUNT]     = { 1.8f, 1.95f, 0.25f };
+
+static constexpr size_t ALIGN = 16;
+
+static size_t align_up(size_t n) { return (n + ALIGN - 1) & ~(ALIGN - 1); }
+
+// Carves the arrays out of base (or only measures them when base is null)
+static size_t layout(EntityStore& s, uint8_t* base, uint32_t cap) {
+    size_t off = 0;
+    auto take = [&](auto*& ptr, size_t each) {
+        using T = std::remove_reference_t<decltype(*ptr)>;
+        if (base) ptr = reinterpret_cast<T*>(base + off);
+        off += align_up(each * cap);
+    };
+    take(s.x, sizeof(float));  take(s.y, sizeof(float));  take(s.z, sizeof(float));
+    take(s.vx, sizeof(float)); take(s.vy, sizeof(float)); take(s.vz, sizeof(float));
+    take(s.yaw, sizeof(float)); take(s.pitch, sizeof(float));
+    take(s.half_width, sizeof(float)); take(s.height, sizeof(float));
+    take(s.ground, sizeof(float));
+    take(s.cx, sizeof(int32_t)); take(s.cz, sizeof(int32_t));
+    take(s.born, sizeof(uint32_t));
+    take(s.type, sizeof(uint8_t));
+    take(s.slot_of, sizeof(uint16_t));
+    take(s.dense_of, sizeof(uint16_t));
+    take(s.gen, sizeof(uint16_t));
+    return off;
+}
+
+static constexpr float BORDER = MC_WORLD_BORDER;
+
+// x or z held to the world border; NaN goes to the negative side
+static float inside(float v) {
+    v = v > -BORDER ? v : -BORDER;
+    return v < BORDER ? v : BORDER;
+}
+
+// floor(v) >> 4 without a libm call, so the chunk pass vectorizes. v must
+// be inside the border: the cast is undefined for what an int cannot hold.
+static int chunk_of(float v) {
+    int i = static_cast<int>(v);
+    return (i - (v < static_cast<float>(i))) >> 4;
+}
+
+uint32_t entity_bytes_each() {
+    return 11 * sizeof(float) + 2 * sizeof(int32_t) + sizeof(uint32_t) + sizeof(uint8_t) + 3 * sizeof(uint16_t);
+}
+
+bool entity_store_init(EntityStore& s, uint32_t cap) {
+    memset(&s, 0, sizeof(s));
+    if (cap == 0 || cap >= 65536) return false;
+    size_t bytes = layout(s, nullptr, cap);
+    s.block = mem_alloc(MEM_ENTITY, bytes);
+    if (!s.block) return false;
+    layout(s, static_cast<uint8_t*>(s.block), cap);
+    s.cap = cap;
+    s.count = 0;
+    for (uint32_t i = 0; i < cap; i++) {
+        s.dense_of[i] = static_cast<uint16_t>(i + 1);
+        s.gen[i] = 1;
+    }
+    s.free_head = 0;
+    return true;
+}
+
+void entity_store_free(EntityStore& s) {
+    mem_free(s.block);
+    memset(&s, 0, sizeof(s));
+}
+
+EntityId entity_add(EntityStore& s, EntityType type, float x, float y, float z, float ground, uint32_t tick) {
+    if (s.free_head >= s.cap) return ENTITY_NONE;
+    uint16_t slot = s.free_head;
+    s.free_head = s.dense_of[slot];
+
+    uint32_t i = s.count++;
+    s.dense_of[slot] = static_cast<uint16_t>(i);
+    s.slot_of[i] = slot;
+    x = inside(x);
+    z = inside(z);
+    s.x[i] = x; s.y[i] = y; s.z[i] = z;
+    s.vx[i] = s.vy[i] = s.vz[i] = 0.0f;
+    s.yaw[i] = s.pitch[i] = 0.0f;
+    s.half_width[i] = HALF_WIDTH[type];
+    s.height[i] = HEIGHT[type];
+    s.ground[i] = type == ENTITY_PLAYER ? -FLT_MAX : ground;
+    s.cx[i] = chunk_of(x);
+    s.cz[i] = chunk_of(z);
+    s.born[i] = tick;
+    s.type[i] = type;
+    return static_cast<EntityId>(s.gen[slot]) << 16 | slot;
+}
+
+int entity_index(const EntityStore& s, EntityId id) {
+    uint32_t slot = id & 0xFFFF;
+    if (slot >= s.cap || s.gen[slot] != id >> 16) return -1;
+    return s.dense_of[slot];
+}
+
+// Moves the last entity into dense index i and frees i's slot
+static void remove_at(EntityStore& s, uint32_t i) {
+    uint16_t slot = s.slot_of[i];
+    uint32_t last = --s.count;
+    if (i != last) {
+        s.x[i] = s.x[last]; s.y[i] = s.y[last]; s.z[i] = s.z[last];
+        s.vx[i] = s.vx[last]; s.vy[i] = s.vy[last]; s.vz[i] = s.vz[last];
+        s.yaw[i] = s.yaw[last]; s.pitch[i] = s.pitch[last];
+        s.half_width[i] = s.half_width[last]; s.height[i] = s.height[last];
+        s.ground[i] = s.ground[last];
+        s.cx[i] = s.cx[last]; s.cz[i] = s.cz[last];
+        s.born[i] = s.born[last];
+        s.type[i] = s.type[last];
+        s.slot_of[i] = s.slot_of[last];
+        s.dense_of[s.slot_of[i]] = static_cast<uint16_t>(i);
+    }
+    // Generation 0 is skipped so no handle is ever ENTITY_NONE
+    if (++s.gen[slot] == 0) s.gen[slot] = 1;
+    s.dense_of[slot] = s.free_head;
+    s.free_head = slot;
+}
+
+bool entity_remove(EntityStore& s, EntityId id) {
+    int i = entity_index(s, id);
+    if (i < 0) return false;
+    remove_at(s, i);
+    return true;
+}
+
+void entity_move(EntityStore& s, int i, float x, float y, float z) {
+    x = inside(x);
+    z = inside(z);
+    s.x[i] = x; s.y[i] = y; s.z[i] = z;
+    s.cx[i] = chunk_of(x);
+    s.cz[i] = chunk_of(z);
+}
+
+void entity_physics(EntityStore& s, float dt) {
+    uint32_t n = s.count;
+    // Local restrict pointers: without them every store could alias the
+    // store's own fields and the loops would not vectorize
+    float* __restrict x = s.x;
+    float* __restrict y = s.y;
+    float* __restrict z = s.z;
+    float* __restrict vx = s.vx;
+    float* __restrict vy = s.vy;
+    float* __restrict vz = s.vz;
+    const float* __restrict ground = s.ground;
+    const uint8_t* __restrict type = s.type;
+    int32_t* __restrict cx = s.cx;
+    int32_t* __restrict cz = s.cz;
+
+    float keep[ENTITY_TYPE_COUNT], fall[ENTITY_TYPE_COUNT];
+    for (int t = 0; t < ENTITY_TYPE_COUNT; t++) {
+        keep[t] = 1.0f - DRAG[t] * dt;
+        fall[t] = GRAVITY[t] * dt;
+    }
+
+    // Branch free: players have no gravity, drag, velocity or floor, so
+    // the update leaves them where they are
+    for (uint32_t i = 0; i < n; i++) {
+        uint8_t t = type[i];
+        vx[i] *= keep[t];
+        vz[i] *= keep[t];
+        float v = vy[i] * keep[t] - fall[t];
+        x[i] = inside(x[i] + vx[i] * dt);
+        z[i] = inside(z[i] + vz[i] * dt);
+        float ny = y[i] + v * dt;
+        bool landed = ny <= ground[i];
+        y[i] = landed ? ground[i] : ny;
+        vy[i] = landed ? 0.0f : v;
+    }
+    // Separate pass: the float loop above stays free of int conversions
+    for (uint32_t i = 0; i < n; i++) {
+        cx[i] = chunk_of(x[i]);
+        cz[i] = chunk_of(z[i]);
+    }
+}
+
+int entity_despawn(EntityStore& s, uint32_t tick) {
+    int removed = 0;
+    // Walk down so the entity swapped into a hole has already been checked
+    for (uint32_t i = s.count; i-- > 0;) {
+        if (s.type[i] != ENTITY_ITEM || tick - s.born[i] < MC_ITEM_LIFETIME) continue;
+        remove_at(s, i);
+        removed++;
+    }
+    return removed;
+}
+
+int entity_track(const EntityStore& s, int cx, int cz, int radius, EntityId* out, int max) {
+    int n = 0;
+    for (uint32_t i = 0; i < s.count && n < max; i++) {
+        if (abs(s.cx[i] - cx) > radius || abs(s.cz[i] - cz) > radius) continue;
+        uint16_t slot = s.slot_of[i];
+        out[n++] = static_cast<EntityId>(s.gen[slot]) << 16 | slot;
+    }
+    return n;
+}
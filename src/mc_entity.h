@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+
+// Entity store: players, mobs and item drops as parallel arrays, so each
+// system streams through only the fields it reads.
+//
+// Live entities are packed into dense indices 0..count-1. Removal moves the
+// last entity into the hole. Handles go through a slot table that tracks
+// each entity's dense index, so they stay valid across moves. A handle goes
+// stale once its entity is removed: the slot's generation changes. Add,
+// remove and lookup are O(1).
+
+enum EntityType : uint8_t {
+    ENTITY_PLAYER,
+    ENTITY_ZOMBIE,
+    ENTITY_ITEM,
+    ENTITY_TYPE_COUNT
+};
+
+// Slot index in the low 16 bits, generation in the high 16; 0 is never valid
+using EntityId = uint32_t;
+static constexpr EntityId ENTITY_NONE = 0;
+
+struct EntityStore {
+    uint32_t cap;
+    uint32_t count;
+
+    // Dense arrays, indexed 0..count-1
+    float* x;  float* y;  float* z;
+    float* vx; float* vy; float* vz;
+    float* yaw; float* pitch;
+    float* half_width;      // bounding box, centred on x/z
+    float* height;          // bounding box, from y up
+    float* ground;          // y the entity comes to rest at
+    int32_t* cx;            // chunk holding the entity, within the world border
+    int32_t* cz;
+    uint32_t* born;         // tick of spawn
+    uint8_t* type;
+    uint16_t* slot_of;      // dense index -> slot
+
+    // Slot table, indexed by handle slot
+    uint16_t* dense_of;     // slot -> dense index; next free slot while free
+    uint16_t* gen;
+    uint16_t free_head;     // cap when no slot is free
+
+    void* block;            // single allocation behind every array
+};
+
+// Bytes one entity costs across all arrays
+uint32_t entity_bytes_each();
+
+bool entity_store_init(EntityStore& s, uint32_t cap);
+void entity_store_free(EntityStore& s);
+
+// Spawns at rest on `ground` below (x, y, z). ENTITY_NONE when full.
+// Here and in the systems, x and z are held to the world border.
+EntityId entity_add(EntityStore& s, EntityType type, float x, float y, float z, float ground, uint32_t tick);
+bool entity_remove(EntityStore& s, EntityId id);
+// Dense index of a live entity, or -1
+int  entity_index(const EntityStore& s, EntityId id);
+// Moves entity i and refreshes its chunk
+void entity_move(EntityStore& s, int i, float x, float y, float z);
+
+// Systems. Each walks the dense arrays once.
+
+// Gravity, drag and integration for everything but players (their
+// positions come from the client). Refreshes chunk indices.
+void entity_physics(EntityStore& s, float dt);
+// Removes item drops older than MC_ITEM_LIFETIME ticks; returns how many
+int  entity_despawn(EntityStore& s, uint32_t tick);
+// Handles of entities within `radius` chunks of (cx, cz), up to max
+int  entity_track(const EntityStore& s, int cx, int cz, int radius, EntityId* out, int max);
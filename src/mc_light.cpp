@@ -0,0 +1,606 @@
+#include "mc_light.h"
+#include "mc_play.h"
+#include "mc_tick.h"
+#include "mc_server.h"
+#include "mc_types.h"
+#include "mc_world.h"
+#include "mc_mem.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include <cstdio>
+#include <cstring>
+
+static const char* TAG = "mc_light";
+
+static_assert((MC_LIGHT_SECTIONS & (MC_LIGHT_SECTIONS - 1)) == 0, "MC_LIGHT_SECTIONS must be a power of two");
+static_assert((MC_LIGHT_QUEUE & (MC_LIGHT_QUEUE - 1)) == 0, "MC_LIGHT_QUEUE must be a power of two");
+
+static constexpr int WORLD_TOP = WORLD_MIN_Y + WORLD_SECTIONS * 16;
+static constexpr int UP = 4, DOWN = 5;
+
+// Light arrays of one section, nibbles at x + z*16 + y*256
+struct LightSection {
+    int32_t cx, cz;
+    int8_t si;              // -1 for a free slot
+    bool dirty;             // relit since the last flush
+    uint8_t* sky;           // 2048 bytes (PSRAM)
+    uint8_t* block;         // 2048 bytes, null until block light reaches it
+};
+
+struct LightCell {
+    int32_t x, z;
+    int16_t y;
+    uint8_t level;          // removal queue: the light the cell had
+};
+
+struct LightQueue {
+    LightCell* cells;       // MC_LIGHT_QUEUE ring
+    uint32_t head, tail;
+};
+
+struct Emitter {
+    int32_t x, z;
+    int16_t y;
+    uint8_t level;
+};
+
+// Generated sky heights of one column, for reads of sections without arrays
+struct SkyHeights {
+    int32_t cx, cz;
+    bool valid;
+    int h[16][16];
+};
+
+struct Column {
+    int32_t cx, cz;
+};
+
+static LightSection* table;         // MC_LIGHT_SECTIONS, open addressing
+static int16_t dirty_list[MC_LIGHT_SECTIONS];
+static int dirty_count = 0;
+static int used = 0;
+static int block_sections = 0;      // sections with a block light array
+static int last = 0;                // most recently found slot, checked first
+static LightQueue rm_queue, add_queue;
+static Emitter emitters[MC_LIGHT_EMITTERS];
+static int emitter_count = 0;
+static PacketBuf out;
+static LightStats stats;
+static bool ready = false;
+static bool full_logged = false;
+static SkyHeights* sky_cache;       // SKY_CACHE columns, reused in turn
+static int sky_next = 0;
+static Column stale[MC_LIGHT_STALE];  // dropped columns awaiting a rebuild
+static int stale_count = 0;
+static uint8_t* rebuild_pis;        // generated and edited blocks of a section
+
+static constexpr int SKY_CACHE = 4;
+
+static const int DIRS[6][3] = {{1, 0, 0}, {-1, 0, 0}, {0, 0, 1}, {0, 0, -1}, {0, 1, 0}, {0, -1, 0}};
+
+static bool init() {
+    if (ready) return true;
+    table = static_cast<LightSection*>(mem_alloc(MEM_CACHE, sizeof(LightSection) * MC_LIGHT_SECTIONS));
+    rm_queue.cells = static_cast<LightCell*>(mem_alloc(MEM_CACHE, sizeof(LightCell) * MC_LIGHT_QUEUE));
+    add_queue.cells = static_cast<LightCell*>(mem_alloc(MEM_CACHE, sizeof(LightCell) * MC_LIGHT_QUEUE));
+    sky_cache = static_cast<SkyHeights*>(mem_alloc(MEM_CACHE, sizeof(SkyHeights) * SKY_CACHE));
+    rebuild_pis = static_cast<uint8_t*>(mem_alloc(MEM_CACHE, 2 * 4096));
+    if (!table || !rm_queue.cells || !add_queue.cells || !sky_cache || !rebuild_pis) {
+        ESP_LOGE(TAG, "No memory for light");
+        mem_free(table);
+        mem_free(rm_queue.cells);
+        mem_free(add_queue.cells);
+        mem_free(sky_cache);
+        mem_free(rebuild_pis);
+        return false;
+    }
+    memset(table, 0, sizeof(LightSection) * MC_LIGHT_SECTIONS);
+    memset(sky_cache, 0, sizeof(SkyHeights) * SKY_CACHE);
+    for (int i = 0; i < MC_LIGHT_SECTIONS; i++) table[i].si = -1;
+    out.init(4096, MEM_SCRATCH);
+    ready = true;
+    return true;
+}
+
+// Lets light through; everything else stops it, as in generated sky light
+static bool clear(uint8_t pi) { return pi == PI_AIR || pi == PI_TALLGRASS; }
+
+static int cell_index(int x, int y, int z) {
+    return (x & 15) + (z & 15) * 16 + ((y - WORLD_MIN_Y) & 15) * 256;
+}
+
+static int nibble(const uint8_t* arr, int idx) {
+    return idx & 1 ? arr[idx >> 1] >> 4 : arr[idx >> 1] & 15;
+}
+
+static void set_nibble(uint8_t* arr, int idx, int v) {
+    uint8_t& b = arr[idx >> 1];
+    b = idx & 1 ? static_cast<uint8_t>((b & 0x0F) | v << 4) : static_cast<uint8_t>((b & 0xF0) | v);
+}
+
+// ---- Sections ----
+
+static uint32_t home(int cx, int cz, int si) {
+    return static_cast<uint32_t>(cx * 73856093 ^ cz * 19349663 ^ si * 83492791) & (MC_LIGHT_SECTIONS - 1);
+}
+
+// A section created here starts with the sky light its chunk data carried
+static LightSection* section(int cx, int cz, int si, bool create) {
+    LightSection& hot = table[last];
+    if (hot.si == si && hot.cx == cx && hot.cz == cz) return &hot;
+    const uint32_t mask = MC_LIGHT_SECTIONS - 1;
+    for (uint32_t i = home(cx, cz, si), n = 0; n <= mask; i = (i + 1) & mask, n++) {
+        LightSection& s = table[i];
+        if (s.si < 0) {
+            // Keep a quarter free so probes stay short
+            if (!create || used >= MC_LIGHT_SECTIONS * 3 / 4) return nullptr;
+            s.sky = static_cast<uint8_t*>(mem_alloc(MEM_CACHE, 2048));
+            if (!s.sky) return nullptr;
+            sky_light_section(s.sky, cx, cz, si);
+            s.cx = cx;
+            s.cz = cz;
+            s.si = static_cast<int8_t>(si);
+            s.dirty = false;
+            s.block = nullptr;
+            used++;
+            last = static_cast<int>(i);
+            return &s;
+        }
+        if (s.cx == cx && s.cz == cz && s.si == si) {
+            last = static_cast<int>(i);
+            return &s;
+        }
+    }
+    return nullptr;
+}
+
+static int emission(int x, int y, int z) {
+    for (int i = 0; i < emitter_count; i++)
+        if (emitters[i].x == x && emitters[i].y == y && emitters[i].z == z) return emitters[i].level;
+    return 0;
+}
+
+// Sky light of a block as its chunk data carried it: sections 2 and up
+// are full, as in sky_light_section
+static int generated_sky(int x, int y, int z) {
+    if (y >= WORLD_MIN_Y + 32) return 15;
+    int cx = x >> 4, cz = z >> 4;
+    SkyHeights* c = nullptr;
+    for (int i = 0; i < SKY_CACHE && !c; i++)
+        if (sky_cache[i].valid && sky_cache[i].cx == cx && sky_cache[i].cz == cz) c = &sky_cache[i];
+    if (!c) {
+        c = &sky_cache[sky_next++ % SKY_CACHE];
+        gen_sky_heights(cx, cz, c->h);
+        c->cx = cx;
+        c->cz = cz;
+        c->valid = true;
+    }
+    return y > c->h[x & 15][z & 15] ? 15 : 0;
+}
+
+// Light held at a block; sky above the world is full
+static int stored(LightChannel ch, int x, int y, int z) {
+    if (y >= WORLD_TOP) return ch == LIGHT_SKY ? 15 : 0;
+    if (y < WORLD_MIN_Y) return 0;
+    // No section means the light is as generated, with no block light
+    LightSection* s = section(x >> 4, z >> 4, (y - WORLD_MIN_Y) >> 4, false);
+    if (!s) return ch == LIGHT_SKY ? generated_sky(x, y, z) : 0;
+    const uint8_t* arr = ch == LIGHT_SKY ? s->sky : s->block;
+    return arr ? nibble(arr, cell_index(x, y, z)) : 0;
+}
+
+// Light a block passes on: what it holds if light goes through it, else
+// only what it gives off
+static int level(LightChannel ch, int x, int y, int z) {
+    if (clear(tick_block(x, y, z))) return stored(ch, x, y, z);
+    return ch == LIGHT_BLOCK ? emission(x, y, z) : 0;
+}
+
+static bool put(LightChannel ch, int x, int y, int z, int v) {
+    if (y < WORLD_MIN_Y || y >= WORLD_TOP) return false;
+    LightSection* s = section(x >> 4, z >> 4, (y - WORLD_MIN_Y) >> 4, true);
+    if (!s) {
+        if (!full_logged) ESP_LOGW(TAG, "Light table full (%d sections); relighting stops at new sections", used);
+        full_logged = true;
+        stats.full++;
+        return false;
+    }
+    uint8_t*& arr = ch == LIGHT_SKY ? s->sky : s->block;
+    if (!arr) {
+        if (v == 0) return true;
+        arr = static_cast<uint8_t*>(mem_alloc(MEM_CACHE, 2048));
+        if (!arr) {
+            stats.full++;
+            return false;
+        }
+        memset(arr, 0, 2048);
+        block_sections++;
+    }
+    set_nibble(arr, cell_index(x, y, z), v);
+    stats.cells++;
+    if (!s->dirty) {
+        s->dirty = true;
+        dirty_list[dirty_count++] = static_cast<int16_t>(s - table);
+    }
+    return true;
+}
+
+// ---- Propagation ----
+
+static void push(LightQueue& q, int x, int y, int z, int lv) {
+    if (q.tail - q.head >= MC_LIGHT_QUEUE) {
+        stats.overflow++;
+        return;
+    }
+    q.cells[q.tail++ & (MC_LIGHT_QUEUE - 1)] = {x, z, static_cast<int16_t>(y), static_cast<uint8_t>(lv)};
+}
+
+// Takes back the light that spread from the cells in the removal queue:
+// a neighbour holding less than the cell had (or sky light straight
+// below) got it from there and goes dark in turn; a brighter one has
+// its own supply and refills the region afterwards
+static void unlight(LightChannel ch) {
+    while (rm_queue.head != rm_queue.tail) {
+        LightCell c = rm_queue.cells[rm_queue.head++ & (MC_LIGHT_QUEUE - 1)];
+        for (int d = 0; d < 6; d++) {
+            int nx = c.x + DIRS[d][0], ny = c.y + DIRS[d][1], nz = c.z + DIRS[d][2];
+            if (ny < WORLD_MIN_Y || ny >= WORLD_TOP) continue;
+            if (!clear(tick_block(nx, ny, nz))) {
+                if (ch == LIGHT_BLOCK && emission(nx, ny, nz)) push(add_queue, nx, ny, nz, 0);
+                continue;
+            }
+            int nl = stored(ch, nx, ny, nz);
+            if (nl == 0) continue;
+            if (nl < c.level || (ch == LIGHT_SKY && d == DOWN && c.level == 15)) {
+                if (!put(ch, nx, ny, nz, 0)) continue;
+                stats.removed++;
+                push(rm_queue, nx, ny, nz, nl);
+                int e = ch == LIGHT_BLOCK ? emission(nx, ny, nz) : 0;
+                if (e && put(ch, nx, ny, nz, e)) push(add_queue, nx, ny, nz, 0);
+            } else {
+                push(add_queue, nx, ny, nz, 0);
+            }
+        }
+    }
+}
+
+// Spreads light from the cells in the add queue into darker neighbours
+static void spread(LightChannel ch) {
+    while (add_queue.head != add_queue.tail) {
+        LightCell c = add_queue.cells[add_queue.head++ & (MC_LIGHT_QUEUE - 1)];
+        int lv = level(ch, c.x, c.y, c.z);
+        if (lv <= 1) continue;
+        for (int d = 0; d < 6; d++) {
+            int nx = c.x + DIRS[d][0], ny = c.y + DIRS[d][1], nz = c.z + DIRS[d][2];
+            if (ny < WORLD_MIN_Y || ny >= WORLD_TOP || !clear(tick_block(nx, ny, nz))) continue;
+            int want = ch == LIGHT_SKY && d == DOWN && lv == 15 ? 15 : lv - 1;
+            if (want > stored(ch, nx, ny, nz) && put(ch, nx, ny, nz, want)) push(add_queue, nx, ny, nz, 0);
+        }
+    }
+}
+
+// Relights one channel after the block at (x, y, z) changed; old is the
+// light it passed on before
+static void relight(LightChannel ch, int x, int y, int z, int old) {
+    rm_queue.head = rm_queue.tail = 0;
+    add_queue.head = add_queue.tail = 0;
+    if (old > 0 && put(ch, x, y, z, 0)) {
+        push(rm_queue, x, y, z, old);
+        unlight(ch);
+    }
+    int best = ch == LIGHT_BLOCK ? emission(x, y, z) : 0;
+    if (clear(tick_block(x, y, z)))
+        for (int d = 0; d < 6; d++) {
+            int nl = level(ch, x + DIRS[d][0], y + DIRS[d][1], z + DIRS[d][2]);
+            int v = ch == LIGHT_SKY && d == UP && nl == 15 ? 15 : nl - 1;
+            if (v > best) best = v;
+        }
+    if (best > stored(ch, x, y, z) && put(ch, x, y, z, best)) push(add_queue, x, y, z, 0);
+    spread(ch);
+}
+
+// Relights one channel after many blocks of section si changed at once,
+// from before to after: the light that came through the changed blocks is
+// all taken back, then the new openings, dark to start with, fill in, each
+// queue draining every SEED_GROUP seeds so it never holds more than it can
+static void relight_section(LightChannel ch, int cx, int cz, int si, const uint8_t* before, const uint8_t* after) {
+    constexpr int SEED_GROUP = MC_LIGHT_QUEUE / 4;
+    const int bx = cx * 16, by = WORLD_MIN_Y + si * 16, bz = cz * 16;
+    rm_queue.head = rm_queue.tail = 0;
+    add_queue.head = add_queue.tail = 0;
+    int seeds = 0;
+    for (int idx = 0; idx < 4096; idx++) {
+        if (clear(before[idx]) == clear(after[idx])) continue;
+        int x = bx + (idx & 15), y = by + (idx >> 8), z = bz + ((idx >> 4) & 15);
+        int old = clear(before[idx]) ? stored(ch, x, y, z) : ch == LIGHT_BLOCK ? emission(x, y, z) : 0;
+        if (old > 0 && put(ch, x, y, z, 0)) push(rm_queue, x, y, z, old);
+        else if (!clear(before[idx]) && stored(ch, x, y, z) > 0) put(ch, x, y, z, 0);
+        if (++seeds % SEED_GROUP == 0) unlight(ch);
+    }
+    unlight(ch);
+    seeds = 0;
+    for (int idx = 0; idx < 4096; idx++) {
+        if (clear(before[idx]) == clear(after[idx])) continue;
+        int x = bx + (idx & 15), y = by + (idx >> 8), z = bz + ((idx >> 4) & 15);
+        int best = ch == LIGHT_BLOCK ? emission(x, y, z) : 0;
+        if (clear(after[idx]))
+            for (int d = 0; d < 6; d++) {
+                int nl = level(ch, x + DIRS[d][0], y + DIRS[d][1], z + DIRS[d][2]);
+                int v = ch == LIGHT_SKY && d == UP && nl == 15 ? 15 : nl - 1;
+                if (v > best) best = v;
+            }
+        if (best > stored(ch, x, y, z) && put(ch, x, y, z, best)) push(add_queue, x, y, z, 0);
+        if (++seeds % SEED_GROUP == 0) spread(ch);
+    }
+    spread(ch);
+}
+
+// ---- Dropped columns ----
+
+static int stale_index(int cx, int cz) {
+    for (int i = 0; i < stale_count; i++)
+        if (stale[i].cx == cx && stale[i].cz == cz) return i;
+    return -1;
+}
+
+// Relights a dropped column from the generated light: every edited section
+// as one region edit from its generated blocks, then its emitters, then
+// the light reaching across from the relit sections beside it
+static void rebuild(int cx, int cz) {
+    constexpr int SEED_GROUP = MC_LIGHT_QUEUE / 4;
+    uint8_t* before = rebuild_pis;
+    uint8_t* after = rebuild_pis + 4096;
+    // Top down, so no opening reads the light of one below that is not
+    // relit yet
+    for (int si = WORLD_SECTIONS - 1; si >= 0; si--) {
+        if (!tick_edited(cx, cz, si)) continue;
+        int n = gen_section_at(before, cx, cz, si);
+        memcpy(after, before, 4096);
+        tick_apply_edits(cx, cz, si, after, n);
+        for (int c = LIGHT_SKY; c <= LIGHT_BLOCK; c++) {
+            auto ch = static_cast<LightChannel>(c);
+            if (ch == LIGHT_BLOCK && !block_sections && !emitter_count) continue;
+            relight_section(ch, cx, cz, si, before, after);
+        }
+    }
+    for (int i = 0; i < emitter_count; i++)
+        if (emitters[i].x >> 4 == cx && emitters[i].z >> 4 == cz)
+            relight(LIGHT_BLOCK, emitters[i].x, emitters[i].y, emitters[i].z, 0);
+    for (int c = LIGHT_SKY; c <= LIGHT_BLOCK; c++) {
+        auto ch = static_cast<LightChannel>(c);
+        if (ch == LIGHT_BLOCK && !block_sections) continue;
+        add_queue.head = add_queue.tail = 0;
+        int seeds = 0;
+        for (int d = 0; d < 4; d++)
+            for (int si = 0; si < WORLD_SECTIONS; si++) {
+                if (!section(cx + DIRS[d][0], cz + DIRS[d][2], si, false)) continue;
+                // The neighbour's cells along the shared face
+                for (int i = 0; i < 256; i++) {
+                    int t = i & 15, y = WORLD_MIN_Y + si * 16 + (i >> 4);
+                    int x = DIRS[d][0] > 0 ? cx * 16 + 16 : DIRS[d][0] < 0 ? cx * 16 - 1 : cx * 16 + t;
+                    int z = DIRS[d][2] > 0 ? cz * 16 + 16 : DIRS[d][2] < 0 ? cz * 16 - 1 : cz * 16 + t;
+                    push(add_queue, x, y, z, 0);
+                    if (++seeds % SEED_GROUP == 0) spread(ch);
+                }
+            }
+        spread(ch);
+    }
+    stats.rebuilt++;
+}
+
+// Rebuilds the dropped columns around chunk (cx, cz) before its light is
+// used; light spreads at most one column across
+static void fresh(int cx, int cz) {
+    for (int dz = -1; dz <= 1 && stale_count; dz++)
+        for (int dx = -1; dx <= 1 && stale_count; dx++) {
+            int i = stale_index(cx + dx, cz + dz);
+            if (i < 0) continue;
+            stale[i] = stale[--stale_count];
+            rebuild(cx + dx, cz + dz);
+        }
+}
+
+// Frees slot i, moving the entries probed past it back so lookups still
+// reach them
+static void remove_slot(uint32_t i) {
+    const uint32_t mask = MC_LIGHT_SECTIONS - 1;
+    mem_free(table[i].sky);
+    if (table[i].block) {
+        mem_free(table[i].block);
+        block_sections--;
+    }
+    used--;
+    for (uint32_t j = (i + 1) & mask; table[j].si >= 0; j = (j + 1) & mask) {
+        uint32_t k = home(table[j].cx, table[j].cz, table[j].si);
+        // Stays put while its home lies cyclically in (i, j]
+        if (i <= j ? i < k && k <= j : i < k || k <= j) continue;
+        table[i] = table[j];
+        i = j;
+    }
+    table[i].si = -1;
+    table[i].sky = table[i].block = nullptr;
+}
+
+// Drops the sections of columns no player has loaded, remembering the
+// columns for a rebuild; a column stays if that list is full. Runs after
+// a flush, with no section dirty.
+static void evict() {
+    for (uint32_t i = 0; i < MC_LIGHT_SECTIONS;) {
+        const LightSection& s = table[i];
+        if (s.si < 0 || server_chunk_seen(s.cx, s.cz)) {
+            i++;
+            continue;
+        }
+        if (stale_index(s.cx, s.cz) < 0) {
+            if (stale_count == MC_LIGHT_STALE) {
+                i++;
+                continue;
+            }
+            stale[stale_count++] = {s.cx, s.cz};
+        }
+        // Slot i may now hold an entry moved back from later in its run
+        remove_slot(i);
+        stats.evicted++;
+    }
+    full_logged = false;
+}
+
+void light_block_changed(int x, int y, int z, uint8_t old_pi, uint8_t new_pi) {
+    if (clear(old_pi) == clear(new_pi) || y < WORLD_MIN_Y || y >= WORLD_TOP || !init()) return;
+    fresh(x >> 4, z >> 4);
+    int64_t start = esp_timer_get_time();
+    for (int c = LIGHT_SKY; c <= LIGHT_BLOCK; c++) {
+        auto ch = static_cast<LightChannel>(c);
+        // Nothing gives off light yet, so there is none to move
+        if (ch == LIGHT_BLOCK && !block_sections && !emitter_count) continue;
+        int old = clear(old_pi) ? stored(ch, x, y, z) : ch == LIGHT_BLOCK ? emission(x, y, z) : 0;
+        // Light held in an opaque block reached nothing, as with the full
+        // generated sky over buried blocks: the opening starts dark
+        if (!clear(old_pi) && stored(ch, x, y, z) > old) put(ch, x, y, z, 0);
+        relight(ch, x, y, z, old);
+    }
+    stats.relights++;
+    stats.last_us = static_cast<uint32_t>(esp_timer_get_time() - start);
+    if (stats.last_us > stats.max_us) stats.max_us = stats.last_us;
+}
+
+void light_section_changed(int cx, int cz, int si, const uint8_t* before, const uint8_t* after) {
+    if (si < 0 || si >= WORLD_SECTIONS || !init()) return;
+    fresh(cx, cz);
+    int64_t start = esp_timer_get_time();
+    for (int c = LIGHT_SKY; c <= LIGHT_BLOCK; c++) {
+        auto ch = static_cast<LightChannel>(c);
+        if (ch == LIGHT_BLOCK && !block_sections && !emitter_count) continue;
+        relight_section(ch, cx, cz, si, before, after);
+    }
+    stats.relights++;
+    stats.last_us = static_cast<uint32_t>(esp_timer_get_time() - start);
+    if (stats.last_us > stats.max_us) stats.max_us = stats.last_us;
+}
+
+bool light_set_emission(int x, int y, int z, int lv) {
+    if (y < WORLD_MIN_Y || y >= WORLD_TOP || !init()) return false;
+    fresh(x >> 4, z >> 4);
+    lv = lv < 0 ? 0 : lv > 15 ? 15 : lv;
+    int old = level(LIGHT_BLOCK, x, y, z);
+    int i = 0;
+    while (i < emitter_count && !(emitters[i].x == x && emitters[i].y == y && emitters[i].z == z)) i++;
+    if (i == emitter_count) {
+        if (lv == 0) return true;
+        if (emitter_count == MC_LIGHT_EMITTERS) return false;
+        emitter_count++;
+    }
+    if (lv) emitters[i] = {x, z, static_cast<int16_t>(y), static_cast<uint8_t>(lv)};
+    else emitters[i] = emitters[--emitter_count];
+    int64_t start = esp_timer_get_time();
+    relight(LIGHT_BLOCK, x, y, z, old);
+    stats.relights++;
+    stats.last_us = static_cast<uint32_t>(esp_timer_get_time() - start);
+    if (stats.last_us > stats.max_us) stats.max_us = stats.last_us;
+    return true;
+}
+
+int light_get(LightChannel ch, int x, int y, int z) {
+    if (!init()) return 0;
+    fresh(x >> 4, z >> 4);
+    return level(ch, x, y, z);
+}
+
+bool light_section(int cx, int cz, int si, const uint8_t*& sky, const uint8_t*& block) {
+    if (!ready) return false;
+    fresh(cx, cz);
+    LightSection* s = section(cx, cz, si, false);
+    if (!s) return false;
+    sky = s->sky;
+    block = s->block;
+    return true;
+}
+
+bool light_nonzero(const uint8_t* arr) {
+    uint8_t any = 0;
+    for (int i = 0; i < 2048; i++) any |= arr[i];
+    return any != 0;
+}
+
+// ---- Sending ----
+
+static void write_mask(PacketBuf& buf, int64_t mask) {
+    if (!mask) {
+        pkt_write_varint(buf, 0);
+        return;
+    }
+    pkt_write_varint(buf, 1);
+    pkt_write_i64(buf, mask);
+}
+
+void light_flush() {
+    for (int d = 0; d < dirty_count; d++) {
+        LightSection& first = table[dirty_list[d]];
+        // Already went out with an earlier section of its column
+        if (!first.dirty) continue;
+        int cx = first.cx, cz = first.cz;
+        LightSection* col[WORLD_SECTIONS] = {};
+        for (int e = d; e < dirty_count; e++) {
+            LightSection& s = table[dirty_list[e]];
+            if (!s.dirty || s.cx != cx || s.cz != cz) continue;
+            col[s.si] = &s;
+            s.dirty = false;
+        }
+        int64_t sky_mask = 0, block_mask = 0, empty_sky = 0, empty_block = 0;
+        for (int si = 0; si < WORLD_SECTIONS; si++) {
+            if (!col[si]) continue;
+            int64_t bit = 2LL << si;
+            if (light_nonzero(col[si]->sky)) sky_mask |= bit;
+            else empty_sky |= bit;
+            if (col[si]->block && light_nonzero(col[si]->block)) block_mask |= bit;
+            else empty_block |= bit;
+        }
+        out.reset();
+        pkt_write_varint(out, 0x2B);
+        pkt_write_varint(out, cx);
+        pkt_write_varint(out, cz);
+        write_mask(out, sky_mask);
+        write_mask(out, block_mask);
+        write_mask(out, empty_sky);
+        write_mask(out, empty_block);
+        pkt_write_varint(out, __builtin_popcountll(sky_mask));
+        for (int si = 0; si < WORLD_SECTIONS; si++)
+            if (sky_mask & (2LL << si)) {
+                pkt_write_varint(out, 2048);
+                out.append(col[si]->sky, 2048);
+            }
+        pkt_write_varint(out, __builtin_popcountll(block_mask));
+        for (int si = 0; si < WORLD_SECTIONS; si++)
+            if (block_mask & (2LL << si)) {
+                pkt_write_varint(out, 2048);
+                out.append(col[si]->block, 2048);
+            }
+        stats.updates++;
+        stats.bytes += static_cast<uint32_t>(out.len);
+        server_broadcast(out, audience_chunk(cx, cz));
+    }
+    dirty_count = 0;
+    if (used > MC_LIGHT_SECTIONS / 2) evict();
+}
+
+void light_stats(LightStats& st) {
+    st = stats;
+    st.sections = used;
+    st.emitters = emitter_count;
+}
+
+size_t light_summary(char* buf, size_t cap) {
+    LightStats st;
+    light_stats(st);
+    int n = snprintf(buf, cap,
+                     "relights=%u last=%uus max=%uus cells=%u removed=%u overflow=%u full=%u updates=%u "
+                     "bytes=%u sections=%u evicted=%u rebuilt=%u emitters=%u",
+                     static_cast<unsigned>(st.relights), static_cast<unsigned>(st.last_us),
+                     static_cast<unsigned>(st.max_us), static_cast<unsigned>(st.cells),
+                     static_cast<unsigned>(st.removed), static_cast<unsigned>(st.overflow),
+                     static_cast<unsigned>(st.full), static_cast<unsigned>(st.updates),
+                     static_cast<unsigned>(st.bytes), static_cast<unsigned>(st.sections),
+                     static_cast<unsigned>(st.evicted), static_cast<unsigned>(st.rebuilt),
+                     static_cast<unsigned>(st.emitters));
+    return n < 0 ? 0 : static_cast<size_t>(n) < cap ? n : cap - 1;
+}
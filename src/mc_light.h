@@ -0,0 +1,72 @@
+#pragma once
+
+#include "config.h"
+#include <cstdint>
+#include <cstddef>
+
+// Block and sky light kept up to date around changed blocks.
+//
+// Chunk data carries sky light as generated: full above the highest block
+// of each column, none below. A section only gets its own light arrays
+// once a change writes to it; they start as a copy of what the client was
+// sent and then hold the relit values. Reading light never creates them.
+//
+// The table holds MC_LIGHT_SECTIONS * 3/4 sections. Once it is more than
+// half full at a flush, the sections of columns no player has loaded are
+// dropped, up to MC_LIGHT_STALE columns. A dropped column is rebuilt from
+// the generated light the next time a change, chunk or read comes within
+// a column of it: its edited sections are relit as region edits, then the
+// light of the relit sections beside it spreads back in. Past the limit,
+// relit cells in new sections are left out and counted in `full`.
+//
+// A change relights from the changed block outwards, breadth first: light
+// that came through the block is taken back over the cells it reached,
+// and the light at the edge of that region, plus any new opening, spreads
+// back in. Sky light at 15 travels straight down without loss; every other
+// step costs one level. Air and tall grass let light through, every other
+// block stops it, as in the generated sky light. Only the cells whose
+// light depended on the change are visited, across section and chunk
+// borders as needed.
+//
+// Relit sections collect per column and go out with the block changes at
+// the end of the tick, one Update Light per column.
+
+enum LightChannel : uint8_t { LIGHT_SKY, LIGHT_BLOCK };
+
+struct LightStats {
+    uint32_t relights;          // block changes that relit
+    uint32_t cells;             // light values changed
+    uint32_t removed;           // cells darkened before refilling
+    uint32_t overflow;          // cells left out, queue full
+    uint32_t full;              // cells left out, section table full
+    uint32_t updates;           // Update Light packets
+    uint32_t bytes;             // Update Light payload bytes
+    uint32_t sections;          // sections with light arrays
+    uint32_t evicted;           // sections dropped, column out of view
+    uint32_t rebuilt;           // dropped columns relit from their edits
+    uint32_t emitters;
+    uint32_t last_us, max_us;   // last and longest relight
+};
+
+// A block changed from old_pi to new_pi (PI_* indices); relights when it
+// starts or stops letting light through. Called by the tick engine.
+void light_block_changed(int x, int y, int z, uint8_t old_pi, uint8_t new_pi);
+// Many blocks of section si of chunk (cx, cz) changed at once, from before
+// to after (4096 PI_* indices each); relights them in one pass rather than
+// block by block. Called by the tick engine for region edits.
+void light_section_changed(int cx, int cz, int si, const uint8_t* before, const uint8_t* after);
+// Sets the light a block gives off (0 to stop); false if the emitter table
+// is full. No block in the palette gives off light yet.
+bool light_set_emission(int x, int y, int z, int level);
+// Light level 0..15 at a block
+int light_get(LightChannel ch, int x, int y, int z);
+// Relit light arrays of section si of chunk (cx, cz); false if it still
+// has its generated light. block is null while it has no block light.
+bool light_section(int cx, int cz, int si, const uint8_t*& sky, const uint8_t*& block);
+// True if any of the 4096 nibbles of a light array is set
+bool light_nonzero(const uint8_t* arr);
+// Sends Update Light for the sections relit since the last flush
+void light_flush();
+
+void light_stats(LightStats& out);
+size_t light_summary(char* buf, size_t cap);
@@ -0,0 +1,502 @@
+#include "mc_link.h"
+#include "esp_log.h"
+#include "mc_types.h"
+#include "mc_net.h"
+#include "mc_nbt.h"
+#include "mc_metrics.h"
+#include "mc_spsc.h"
+#include "mc_trace.h"
+#include <atomic>
+#include <cstring>
+
+static const char* TAG = "mc_link";
+
+enum class LinkState : uint8_t { FREE, OPEN, CLOSING };
+enum class ProtoState : uint8_t { HANDSHAKE, STATUS, LOGIN, CONFIG, PLAY };
+
+struct Link {
+    // Network task
+    LinkState state;
+    ProtoState proto;       // decoder state, tracks the simulation's
+    int sock;
+    bool close_pending;     // CMD_CLOSE did not fit yet
+    bool send_failed;       // the close comes from a failed write, not the peer
+    bool stalled;           // socket buffer full since stall_start
+    uint32_t stall_start;   // trace cycles
+    PacketBuf in;           // frame being assembled; len is the bytes so far
+    uint32_t in_need;       // frame length, decoded so far from its prefix
+    uint8_t in_prefix;      // length prefix bytes read
+    bool in_body;           // prefix complete, reading the frame
+    SharedPacket* cur;      // packet being written
+    uint32_t cur_off;
+
+    // Simulation task
+    int sim_sock;           // send routing; -1 when closed
+    bool overflow;
+
+    // Both
+    std::atomic<bool> abandon;  // closed on an error; unsent output may be dropped
+    std::atomic<uint32_t> backlog;
+    SpscRing<NetCmd, MC_LINK_IN_LEN> cmds;
+    SpscRing<SharedPacket*, MC_LINK_OUT_LEN> out;
+};
+
+static Link links[MC_MAX_CONNS];
+static std::atomic<bool> active{false};
+
+void net_cmd_free(NetCmd& cmd) {
+    if (cmd.kind == CMD_CHAT || cmd.kind == CMD_COMMAND) mem_free(cmd.text);
+#if MC_CAPTURE
+    mem_free(cmd.frame);
+    cmd.frame = nullptr;
+#endif
+}
+
+static char* copy_text(const char* s) {
+    size_t n = strlen(s) + 1;
+    auto* t = static_cast<char*>(mem_alloc(MEM_PACKET, n));
+    if (t) memcpy(t, s, n);
+    return t;
+}
+
+// Bounds-checked varint at in.pos
+static bool read_varint(PacketBuf& in, int32_t& v) {
+    int n = in.pos < in.len ? mc_read_varint(in.data + in.pos, in.len - in.pos, v) : -1;
+    if (n <= 0) return false;
+    in.pos += n;
+    return true;
+}
+
+// Bounds-checked string at in.pos, cut to fit out unless whole is set.
+// Refused when its length is negative, runs past the frame, is over
+// max_chars in the protocol's measure (three bytes a character) or, with
+// whole, does not fit out.
+static bool read_string(PacketBuf& in, char* out, size_t cap, int32_t max_chars, bool whole = false) {
+    int32_t n;
+    if (!read_varint(in, n) || n < 0 || n > max_chars * 3 || static_cast<size_t>(n) > in.remaining()) return false;
+    if (whole && static_cast<size_t>(n) >= cap) return false;
+    size_t copy = static_cast<size_t>(n) < cap - 1 ? n : cap - 1;
+    memcpy(out, in.data + in.pos, copy);
+    out[copy] = '\0';
+    in.pos += n;
+    return true;
+}
+
+// Within the world border on each axis; false for NaN too
+static bool inside_border(double v) { return v >= -MC_WORLD_BORDER && v <= MC_WORLD_BORDER; }
+
+// Network NBT of any root type (custom data, text components), checked and
+// skipped in place
+static bool skip_nbt(PacketBuf& in) {
+    NbtReader r;
+    nbt_read_begin(r, in);
+    nbt_skip_any(r);
+    return nbt_read_end(r, in);
+}
+
+// Item components added to a stack. Only the ones whose layout is known
+// here can be stepped over; a stack with any other is refused.
+static bool skip_components(PacketBuf& in, int32_t add, int32_t remove) {
+    for (int32_t i = 0; i < add; i++) {
+        int32_t type, v;
+        if (!read_varint(in, type)) return false;
+        switch (type) {
+        case 0:                 // custom_data
+        case 5:                 // custom_name
+        case 6:                 // item_name
+            if (!skip_nbt(in)) return false;
+            break;
+        case 1:                 // max_stack_size
+        case 2:                 // max_damage
+        case 3:                 // damage
+        case 9:                 // rarity
+            if (!read_varint(in, v)) return false;
+            break;
+        case 4:                 // unbreakable: shown in tooltip
+            if (in.remaining() < 1) return false;
+            in.pos++;
+            break;
+        case 7:                 // item_model
+            if (!read_varint(in, v) || v < 0 || static_cast<size_t>(v) > in.remaining()) return false;
+            in.pos += v;
+            break;
+        case 8: {               // lore
+            int32_t lines;
+            if (!read_varint(in, lines) || lines < 0 || lines > 256) return false;
+            for (int32_t l = 0; l < lines; l++)
+                if (!skip_nbt(in)) return false;
+            break;
+        }
+        case 10: {              // enchantments: id and level pairs, shown in tooltip
+            int32_t n, id, level;
+            if (!read_varint(in, n) || n < 0 || n > 256) return false;
+            for (int32_t e = 0; e < n; e++)
+                if (!read_varint(in, id) || !read_varint(in, level)) return false;
+            if (in.remaining() < 1) return false;
+            in.pos++;
+            break;
+        }
+        default:
+            return false;
+        }
+    }
+    for (int32_t i = 0; i < remove; i++) {
+        int32_t type;
+        if (!read_varint(in, type)) return false;
+    }
+    return true;
+}
+
+// Set Creative Mode Slot: slot index, then the stack
+static bool read_slot(PacketBuf& in, NetCmd& cmd) {
+    if (in.remaining() < 2) return false;
+    cmd.slot.index = pkt_read_i16(in);
+    cmd.slot.item = 0;
+    if (!read_varint(in, cmd.slot.count) || cmd.slot.count < 0 || cmd.slot.count > 99) return false;
+    if (cmd.slot.count == 0) return true;
+    int32_t add, remove;
+    return read_varint(in, cmd.slot.item) && cmd.slot.item >= 0 && read_varint(in, add) && read_varint(in, remove) &&
+           add >= 0 && remove >= 0 && skip_components(in, add, remove) && in.remaining() == 0;
+}
+
+// Decodes the frame in l.in and follows the client through its protocol
+// states. Packets the simulation does not use, and frames too short for
+// their fields, produce no command.
+static bool decode(Link& l, NetCmd& cmd) {
+    PacketBuf& in = l.in;
+    int32_t packet_id;
+    if (!read_varint(in, packet_id)) return false;
+
+    switch (l.proto) {
+    case ProtoState::HANDSHAKE: {
+        if (packet_id != 0x00) return false;
+        int32_t proto_ver;
+        char server_addr[256];
+        if (!read_varint(in, proto_ver) || !read_string(in, server_addr, sizeof(server_addr), 255) ||
+            in.remaining() < 2)
+            return false;
+        uint16_t server_port = pkt_read_u16(in);
+        cmd.kind = CMD_HANDSHAKE;
+        if (!read_varint(in, cmd.next_state)) return false;
+
+        ESP_LOGI(TAG, "Handshake: proto=%d addr=%s port=%d next=%d",
+                 proto_ver, server_addr, server_port, cmd.next_state);
+
+        if (cmd.next_state == 1) l.proto = ProtoState::STATUS;
+        else if (cmd.next_state == 2 || cmd.next_state == 3) l.proto = ProtoState::LOGIN;  // 3: transfer
+        break;
+    }
+
+    case ProtoState::STATUS:
+        if (packet_id == 0x00) {
+            cmd.kind = CMD_STATUS;
+        } else if (packet_id == 0x01) {
+            if (in.remaining() < 8) return false;
+            cmd.kind = CMD_PING;
+            cmd.value = pkt_read_i64(in);
+        } else {
+            return false;
+        }
+        break;
+
+    case ProtoState::LOGIN:
+        if (packet_id == 0x00) {
+            cmd.kind = CMD_LOGIN_START;
+            if (!read_string(in, cmd.login.name, sizeof(cmd.login.name), 16) || in.remaining() < 16) return false;
+            pkt_read_uuid(in, cmd.login.uuid_hi, cmd.login.uuid_lo);
+        } else if (packet_id == 0x03) {
+            cmd.kind = CMD_LOGIN_ACK;
+            l.proto = ProtoState::CONFIG;
+        } else {
+            return false;
+        }
+        break;
+
+    case ProtoState::CONFIG:
+        if (packet_id != 0x03) return false;
+        cmd.kind = CMD_CONFIG_ACK;
+        l.proto = ProtoState::PLAY;
+        break;
+
+    case ProtoState::PLAY:
+        if (packet_id == 0x1c || packet_id == 0x1d) {
+            if (in.remaining() < (packet_id == 0x1d ? 28u : 24u)) return false;
+            cmd.kind = CMD_MOVE;
+            cmd.move.x = pkt_read_f64(in);
+            cmd.move.y = pkt_read_f64(in);
+            cmd.move.z = pkt_read_f64(in);
+            cmd.move.has_yaw = packet_id == 0x1d;
+            cmd.move.yaw = cmd.move.has_yaw ? pkt_read_f32(in) : 0.0f;
+            // Chunk and entity coordinates are cast from these
+            if (!inside_border(cmd.move.x) || !inside_border(cmd.move.y) || !inside_border(cmd.move.z)) return false;
+        } else if (packet_id == 0x1e) {
+            if (in.remaining() < 4) return false;
+            cmd.kind = CMD_LOOK;
+            cmd.move.yaw = pkt_read_f32(in);
+        } else if (packet_id == 0x1a) {
+            if (in.remaining() < 8) return false;
+            cmd.kind = CMD_KEEPALIVE;
+            cmd.value = pkt_read_i64(in);
+        } else if (packet_id == 0x27) {
+            // Player Action: only breaking a block matters
+            cmd.kind = CMD_DIG;
+            if (!read_varint(in, cmd.dig.status) || in.remaining() < 9) return false;
+            pkt_read_position(in, cmd.dig.x, cmd.dig.y, cmd.dig.z);
+            pkt_read_byte(in);  // face
+            if (!read_varint(in, cmd.dig.sequence)) return false;
+            if (cmd.dig.status != 0 && cmd.dig.status != 2) return false;
+        } else if (packet_id == 0x36) {
+            cmd.kind = CMD_SLOT;
+            if (!read_slot(in, cmd)) return false;
+        } else if (packet_id == 0x07 || packet_id == 0x05) {
+            // Chat: only the text is used; timestamp, salt and signature are
+            // ignored. Both are typed into the same 256-character box. A
+            // command cut short would run with other arguments, so one that
+            // does not fit is dropped instead.
+            char text[257];
+            if (!read_string(in, text, sizeof(text), 256, packet_id == 0x05)) return false;
+            cmd.kind = packet_id == 0x07 ? CMD_CHAT : CMD_COMMAND;
+            cmd.text = copy_text(text);
+            if (!cmd.text) return false;
+        } else {
+            return false;
+        }
+        break;
+    }
+
+#if MC_CAPTURE
+    cmd.frame = static_cast<uint8_t*>(mem_alloc(MEM_PACKET, in.len));
+    cmd.frame_len = cmd.frame ? static_cast<uint32_t>(in.len) : 0;
+    if (cmd.frame) memcpy(cmd.frame, in.data, in.len);
+#endif
+    return true;
+}
+
+static NetCmd make_cmd(NetCmdKind kind) {
+    NetCmd cmd;
+    memset(&cmd, 0, sizeof(cmd));
+    cmd.kind = kind;
+    return cmd;
+}
+
+// CMD_CLOSE; value is 1 when the connection is dropped on an error
+static NetCmd close_cmd(const Link& l) {
+    NetCmd cmd = make_cmd(CMD_CLOSE);
+    cmd.value = l.send_failed;
+    return cmd;
+}
+
+// Stops reading a dead socket and tells the simulation task
+static void link_fail(Link& l) {
+    if (l.state != LinkState::OPEN) return;
+    l.state = LinkState::CLOSING;
+    l.close_pending = !l.cmds.push(close_cmd(l));
+}
+
+static void link_free(Link& l) {
+    net_close(l.sock);
+    l.in.free();
+    l.sock = -1;
+    l.close_pending = false;
+    l.state = LinkState::FREE;
+}
+
+int link_open(int sock) {
+    for (int i = 0; i < MC_MAX_CONNS; i++) {
+        Link& l = links[i];
+        // Commands left from the previous connection are skipped by the
+        // simulation task, but CMD_OPEN has to fit behind them
+        if (l.state != LinkState::FREE || l.cmds.room() == 0) continue;
+        mem_set_conn(i);
+        l.in.init();
+        mem_set_conn(-1);
+        l.sock = sock;
+        l.proto = ProtoState::HANDSHAKE;
+        l.in_need = 0;
+        l.in_prefix = 0;
+        l.in_body = false;
+        l.close_pending = false;
+        l.send_failed = false;
+        l.stalled = false;
+        l.cur = nullptr;
+        l.abandon.store(false, std::memory_order_relaxed);
+        l.state = LinkState::OPEN;
+        NetCmd cmd = make_cmd(CMD_OPEN);
+        cmd.sock = sock;
+        l.cmds.push(cmd);
+        return i;
+    }
+    return -1;
+}
+
+bool link_in_use(int slot) { return links[slot].state != LinkState::FREE; }
+int link_sock(int slot) { return links[slot].sock; }
+
+// One command slot stays free for CMD_CLOSE
+bool link_wants_read(int slot) {
+    const Link& l = links[slot];
+    return l.state == LinkState::OPEN && l.cmds.room() >= 2;
+}
+
+bool link_wants_write(int slot) { return links[slot].cur != nullptr; }
+
+// Reads what the socket has of the current frame into l.in without
+// blocking. 1 once the frame is whole, 0 while more is to come, -1 when the
+// socket is closed or the length is invalid.
+static int read_frame(Link& l) {
+    if (l.in_prefix == 0) l.in.reset();
+    while (!l.in_body) {
+        uint8_t b;
+        int r = net_try_recv(l.sock, &b, 1);
+        if (r <= 0) return r;
+        // A fourth prefix byte would reach past the largest frame
+        if (l.in_prefix == 3) return -1;
+        l.in_need |= static_cast<uint32_t>(b & 0x7f) << (7 * l.in_prefix++);
+        if (b & 0x80) continue;
+        if (l.in_need == 0 || l.in_need > 65536 || !l.in.ensure(l.in_need)) return -1;
+        l.in_body = true;
+    }
+    int r = net_try_recv(l.sock, l.in.data + l.in.len, l.in_need - l.in.len);
+    if (r <= 0) return r;
+    l.in.len += r;
+    if (l.in.len < l.in_need) return 0;
+    l.in_need = 0;
+    l.in_prefix = 0;
+    l.in_body = false;
+    metrics_rx(l.in.data, l.in.len);
+    trace_frame(TRACE_PKT_IN, l.sock, l.in.data, l.in.len);
+    return 1;
+}
+
+bool link_recv(int slot) {
+    Link& l = links[slot];
+    bool queued = false;
+    while (link_wants_read(slot)) {
+        mem_set_conn(slot);
+        int r = read_frame(l);
+        mem_set_conn(-1);
+        if (r < 0) {
+            link_fail(l);
+            return true;
+        }
+        if (r == 0) break;
+        NetCmd cmd = make_cmd(CMD_CLOSE);
+        if (decode(l, cmd)) queued |= l.cmds.push(cmd);
+    }
+    return queued;
+}
+
+void link_flush(int slot) {
+    Link& l = links[slot];
+    if (l.state == LinkState::FREE) return;
+    if (l.close_pending) l.close_pending = !l.cmds.push(close_cmd(l));
+
+    while (true) {
+        if (!l.cur) {
+            if (!l.out.pop(l.cur)) return;
+            if (!l.cur) {           // close marker
+                link_free(l);
+                return;
+            }
+            l.cur_off = 0;
+        }
+        if (l.state == LinkState::OPEN) {
+            NetSeg segs[SHARED_SEGS];
+            int r = net_try_sendv(l.sock, segs, shared_segments(l.cur, l.cur_off, segs));
+            if (r == 0 && l.abandon.load(std::memory_order_relaxed)) {
+                // Nobody waits on a peer that stopped reading once the
+                // simulation has dropped it: the rest goes unsent
+                l.state = LinkState::CLOSING;
+                continue;
+            }
+            if (r == 0) {           // socket buffer full; select for writability
+                if (!l.stalled) l.stall_start = trace_cycles();
+                l.stalled = true;
+                return;
+            }
+            if (l.stalled) {
+                trace(TRACE_SEND_STALL, slot, 0, trace_cycles() - l.stall_start);
+                l.stalled = false;
+            }
+            if (r < 0) {
+                ESP_LOGW(TAG, "Send failed on slot %d", slot);
+                l.send_failed = true;
+                link_fail(l);
+            } else {
+                l.cur_off += r;
+                if (l.cur_off < l.cur->len) continue;
+            }
+        }
+        // Written, or dropped because the socket is gone
+        l.backlog.fetch_sub(l.cur->len, std::memory_order_relaxed);
+        shared_release(l.cur);
+        l.cur = nullptr;
+    }
+}
+
+bool link_decode(int slot, const uint8_t* frame, size_t len, NetCmd& cmd) {
+    Link& l = links[slot];
+    l.in.reset();
+    l.in.append(frame, len);
+    cmd = make_cmd(CMD_CLOSE);
+    return decode(l, cmd);
+}
+
+void link_init() {
+    for (auto& l : links) {
+        l.state = LinkState::FREE;
+        l.sock = -1;
+        l.sim_sock = -1;
+    }
+    active.store(true, std::memory_order_release);
+}
+
+bool link_active() { return active.load(std::memory_order_acquire); }
+
+bool link_pop(int slot, NetCmd& cmd) { return links[slot].cmds.pop(cmd); }
+
+void link_attach(int slot, int sock) {
+    links[slot].sim_sock = sock;
+    links[slot].overflow = false;
+}
+
+bool link_send(int sock, const PacketBuf& pkt) {
+    for (int i = 0; i < MC_MAX_CONNS; i++) {
+        if (links[i].sim_sock != sock) continue;
+        SharedPacket* p = shared_packet(pkt);
+        if (!p) return false;
+        bool ok = link_send_shared(i, p);
+        shared_release(p);
+        return ok;
+    }
+    return false;
+}
+
+// One packet slot stays free for the close marker
+bool link_send_shared(int slot, SharedPacket* p) {
+    Link& l = links[slot];
+    if (l.overflow) return false;
+    if (l.out.room() <= 1) {
+        ESP_LOGW(TAG, "Send queue full on slot %d", slot);
+        l.overflow = true;
+        return false;
+    }
+    shared_retain(p);
+    l.backlog.fetch_add(p->len, std::memory_order_relaxed);
+    l.out.push(p);
+    return true;
+}
+
+bool link_overflowed(int slot) { return links[slot].overflow; }
+
+uint32_t link_backlog(int slot) { return links[slot].backlog.load(std::memory_order_relaxed); }
+
+bool link_can_stream(int slot, uint32_t reserve) {
+    return link_backlog(slot) < MC_LINK_STREAM_BYTES && links[slot].out.room() > reserve;
+}
+
+void link_close(int slot, bool error) {
+    links[slot].sim_sock = -1;
+    links[slot].abandon.store(error, std::memory_order_relaxed);
+    links[slot].out.push(nullptr);
+}
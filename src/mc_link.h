@@ -0,0 +1,118 @@
+#pragma once
+
+#include "config.h"
+#include "mc_packet.h"
+#include "mc_shared.h"
+#include <cstdint>
+#include <cstddef>
+
+// Per-connection link between the network task and the simulation task.
+//
+// The network task reads frames, decodes them into NetCmds and pushes them
+// onto the link's inbound ring. The simulation task applies them and queues
+// framed packets on the outbound ring, which the network task writes out
+// without blocking. Each ring has one producer and one consumer (mc_spsc.h).
+//
+// Closing: the network task reports a dead socket with CMD_CLOSE and stops
+// reading it. The simulation task ends every connection it opened with a
+// close marker on the outbound ring. Only then does the network task close
+// the socket and free the slot, so a socket number is never reused while
+// either side still refers to it.
+
+enum NetCmdKind : uint8_t {
+    CMD_OPEN,           // sock
+    CMD_CLOSE,          // socket closed or failed
+    CMD_HANDSHAKE,      // next_state
+    CMD_STATUS,
+    CMD_PING,           // value = payload
+    CMD_LOGIN_START,    // login
+    CMD_LOGIN_ACK,
+    CMD_CONFIG_ACK,
+    CMD_MOVE,           // move (has_yaw for position+rotation)
+    CMD_LOOK,           // move.yaw
+    CMD_KEEPALIVE,      // value = id
+    CMD_CHAT,           // text
+    CMD_COMMAND,        // text
+    CMD_DIG,            // dig: a block broken (finished, or instantly in creative)
+    CMD_SLOT            // slot: a creative inventory slot set; count 0 empties it
+};
+
+// One decoded serverbound packet. Text is heap allocated by the decoder and
+// freed by net_cmd_free on the simulation side.
+struct NetCmd {
+    NetCmdKind kind;
+    union {
+        int sock;
+        int32_t next_state;
+        int64_t value;
+        struct {
+            char name[17];
+            uint64_t uuid_hi, uuid_lo;
+        } login;
+        struct {
+            double x, y, z;
+            float yaw;
+            bool has_yaw;
+        } move;
+        struct {
+            int x, y, z;
+            int32_t sequence;
+            int32_t status;     // 0 started (instant in creative), 2 finished
+        } dig;
+        struct {
+            int16_t index;      // player inventory window slot
+            int32_t item;
+            int32_t count;
+        } slot;
+        char* text;
+    };
+#if MC_CAPTURE
+    uint8_t* frame;     // copy of the inbound frame, recorded when applied
+    uint32_t frame_len;
+#endif
+};
+
+void net_cmd_free(NetCmd& cmd);
+
+// Network task side
+
+// Takes a free slot for an accepted socket and queues CMD_OPEN; -1 if none
+int  link_open(int sock);
+bool link_in_use(int slot);
+int  link_sock(int slot);
+bool link_wants_read(int slot);
+bool link_wants_write(int slot);
+// Reads whatever has arrived without blocking and queues a command for
+// each whole frame. True if anything was queued (a command or CMD_CLOSE)
+// so the caller can wake the simulation task.
+bool link_recv(int slot);
+// Writes queued packets until the socket would block, and frees the slot
+// once the simulation task has closed it
+void link_flush(int slot);
+// Decodes a frame with the link's protocol state; false for packets the
+// simulation does not use
+bool link_decode(int slot, const uint8_t* frame, size_t len, NetCmd& cmd);
+
+// Simulation task side
+
+void link_init();
+// True once the server has started; packets to connection sockets then go
+// through links instead of being written directly
+bool link_active();
+bool link_pop(int slot, NetCmd& cmd);
+// Binds a sock to the slot for send routing, after CMD_OPEN
+void link_attach(int slot, int sock);
+// Queues a copy of pkt on the link bound to sock
+bool link_send(int sock, const PacketBuf& pkt);
+// Queues a reference to p; false (and the link marked overflowed) when full
+bool link_send_shared(int slot, SharedPacket* p);
+bool link_overflowed(int slot);
+// Bytes queued but not yet written by the network task
+uint32_t link_backlog(int slot);
+// True while chunk streaming may queue more: the backlog is under
+// MC_LINK_STREAM_BYTES and more than `reserve` packets still fit
+bool link_can_stream(int slot, uint32_t reserve);
+// Queues the close marker; nothing more may be sent on this link. On an
+// error (a missed deadline, an overflow) output the peer is not reading is
+// dropped so the socket closes without waiting for it.
+void link_close(int slot, bool error);
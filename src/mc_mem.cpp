@@ -0,0 +1,150 @@
+#include "mc_mem.h"
+#include "config.h"
+#include "mc_trace.h"
+#include "esp_log.h"
+#include <cstdio>
+#include <cstring>
+#include <atomic>
+
+static const char* TAG = "mc_mem";
+
+static const char* TAG_NAMES[MEM_TAG_COUNT] = { "packet", "scratch", "cache", "entity", "other" };
+
+static constexpr int MAX_TASKS = 8;
+
+// Prefixed to every block so frees are charged back to the right owners
+struct MemHeader {
+    uint32_t size;
+    uint8_t tag;
+    int8_t conn;
+    uint16_t pad;
+};
+
+// Relaxed counters: the network and simulation tasks both allocate, and
+// each figure only has to be right on its own
+struct MemUsage {
+    std::atomic<size_t> cur;
+    std::atomic<size_t> peak;
+    std::atomic<uint32_t> allocs;
+    std::atomic<uint32_t> fails;
+};
+
+struct TaskEntry {
+    TaskHandle_t task;
+    const char* name;
+};
+
+static MemUsage tags[MEM_TAG_COUNT];
+static MemUsage conns[MC_MAX_CONNS];
+static TaskEntry tasks[MAX_TASKS];
+static int task_count = 0;
+// Each task has its own current connection
+static thread_local int cur_conn = -1;
+
+static void charge(MemUsage& u, size_t size) {
+    size_t cur = u.cur.fetch_add(size, std::memory_order_relaxed) + size;
+    u.allocs.fetch_add(1, std::memory_order_relaxed);
+    size_t peak = u.peak.load(std::memory_order_relaxed);
+    while (cur > peak && !u.peak.compare_exchange_weak(peak, cur, std::memory_order_relaxed)) {}
+}
+
+template <typename T>
+static unsigned val(const std::atomic<T>& v) {
+    return static_cast<unsigned>(v.load(std::memory_order_relaxed));
+}
+
+void* mem_alloc(MemTag tag, size_t size, uint32_t caps) {
+    auto* h = static_cast<MemHeader*>(heap_caps_malloc(sizeof(MemHeader) + size, caps));
+    if (!h) {
+        tags[tag].fails.fetch_add(1, std::memory_order_relaxed);
+        trace(TRACE_ALLOC_FAIL, cur_conn, tag, static_cast<uint32_t>(size));
+        ESP_LOGE(TAG, "Allocation of %u bytes for %s failed", static_cast<unsigned>(size), TAG_NAMES[tag]);
+        mem_report();
+        return nullptr;
+    }
+    h->size = static_cast<uint32_t>(size);
+    h->tag = tag;
+    h->conn = static_cast<int8_t>(cur_conn);
+    charge(tags[tag], size);
+    if (cur_conn >= 0) charge(conns[cur_conn], size);
+    return h + 1;
+}
+
+void mem_free(void* p) {
+    if (!p) return;
+    MemHeader* h = static_cast<MemHeader*>(p) - 1;
+    tags[h->tag].cur.fetch_sub(h->size, std::memory_order_relaxed);
+    if (h->conn >= 0) conns[h->conn].cur.fetch_sub(h->size, std::memory_order_relaxed);
+    heap_caps_free(h);
+}
+
+void mem_conn_open(int slot) {
+    if (slot < 0 || slot >= MC_MAX_CONNS) return;
+    conns[slot].peak.store(conns[slot].cur.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    conns[slot].allocs.store(0, std::memory_order_relaxed);
+}
+
+void mem_set_conn(int slot) {
+    cur_conn = (slot >= 0 && slot < MC_MAX_CONNS) ? slot : -1;
+}
+
+void mem_register_task(TaskHandle_t task, const char* name) {
+    if (task && task_count < MAX_TASKS) tasks[task_count++] = {task, name};
+}
+
+void mem_report() {
+    for (int t = 0; t < MEM_TAG_COUNT; t++)
+        ESP_LOGI(TAG, "tag %-8s cur=%u peak=%u allocs=%u fails=%u", TAG_NAMES[t],
+                 val(tags[t].cur), val(tags[t].peak),
+                 val(tags[t].allocs), val(tags[t].fails));
+    for (int c = 0; c < MC_MAX_CONNS; c++)
+        if (val(conns[c].peak))
+            ESP_LOGI(TAG, "conn %d cur=%u peak=%u", c,
+                     val(conns[c].cur), val(conns[c].peak));
+    for (int i = 0; i < task_count; i++)
+        ESP_LOGI(TAG, "task %-10s stack free min=%u", tasks[i].name,
+                 static_cast<unsigned>(uxTaskGetStackHighWaterMark(tasks[i].task)));
+    ESP_LOGI(TAG, "SRAM free=%u min=%u PSRAM free=%u min=%u",
+             static_cast<unsigned>(heap_caps_get_free_size(MALLOC_CAP_INTERNAL)),
+             static_cast<unsigned>(heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL)),
+             static_cast<unsigned>(heap_caps_get_free_size(MALLOC_CAP_SPIRAM)),
+             static_cast<unsigned>(heap_caps_get_minimum_free_size(MALLOC_CAP_SPIRAM)));
+}
+
+size_t mem_summary(char* buf, size_t cap) {
+    size_t n = 0;
+    for (int t = 0; t < MEM_TAG_COUNT && n < cap; t++)
+        n += snprintf(buf + n, cap - n, "%s=%u/%u ", TAG_NAMES[t],
+                      val(tags[t].cur), val(tags[t].peak));
+    if (n < cap)
+        n += snprintf(buf + n, cap - n, "sram_min=%u psram_min=%u",
+                      static_cast<unsigned>(heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL)),
+                      static_cast<unsigned>(heap_caps_get_minimum_free_size(MALLOC_CAP_SPIRAM)));
+    return n < cap ? n : cap - 1;
+}
+
+size_t mem_format_metrics(char* buf, size_t cap) {
+    size_t n = 0;
+    for (int t = 0; t < MEM_TAG_COUNT && n < cap; t++)
+        n += snprintf(buf + n, cap - n,
+                      "mc_mem_bytes{tag=\"%s\"} %u\nmc_mem_peak_bytes{tag=\"%s\"} %u\n"
+                      "mc_mem_alloc_failures_total{tag=\"%s\"} %u\n",
+                      TAG_NAMES[t], val(tags[t].cur),
+                      TAG_NAMES[t], val(tags[t].peak),
+                      TAG_NAMES[t], val(tags[t].fails));
+    for (int c = 0; c < MC_MAX_CONNS && n < cap; c++)
+        n += snprintf(buf + n, cap - n, "mc_mem_conn_bytes{conn=\"%d\"} %u\nmc_mem_conn_peak_bytes{conn=\"%d\"} %u\n",
+                      c, val(conns[c].cur), c, val(conns[c].peak));
+    for (int i = 0; i < task_count && n < cap; i++)
+        n += snprintf(buf + n, cap - n, "mc_task_stack_free_min_bytes{task=\"%s\"} %u\n", tasks[i].name,
+                      static_cast<unsigned>(uxTaskGetStackHighWaterMark(tasks[i].task)));
+    if (n < cap)
+        n += snprintf(buf + n, cap - n,
+                      "mc_heap_free_bytes{region=\"sram\"} %u\nmc_heap_free_min_bytes{region=\"sram\"} %u\n"
+                      "mc_heap_free_bytes{region=\"psram\"} %u\nmc_heap_free_min_bytes{region=\"psram\"} %u\n",
+                      static_cast<unsigned>(heap_caps_get_free_size(MALLOC_CAP_INTERNAL)),
+                      static_cast<unsigned>(heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL)),
+                      static_cast<unsigned>(heap_caps_get_free_size(MALLOC_CAP_SPIRAM)),
+                      static_cast<unsigned>(heap_caps_get_minimum_free_size(MALLOC_CAP_SPIRAM)));
+    return n < cap ? n : cap - 1;
+}
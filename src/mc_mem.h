@@ -0,0 +1,40 @@
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_heap_caps.h"
+#include <cstdint>
+#include <cstddef>
+
+// Subsystems that allocations are charged to
+enum MemTag : uint8_t {
+    MEM_PACKET,    // PacketBuf in/out buffers
+    MEM_SCRATCH,   // chunk encoding scratch
+    MEM_CACHE,     // world and chunk caches
+    MEM_ENTITY,    // entity store
+    MEM_OTHER,
+    MEM_TAG_COUNT
+};
+
+// Tagged heap_caps_malloc: charges the block to `tag` and to the current
+// connection. On failure a full report is logged and nullptr returned.
+void* mem_alloc(MemTag tag, size_t size, uint32_t caps = MALLOC_CAP_SPIRAM);
+void  mem_free(void* p);
+
+// Starts a fresh peak for a connection slot when a client takes it
+void mem_conn_open(int slot);
+
+// Connection slot that the calling task's allocations are charged to (-1 = none)
+void mem_set_conn(int slot);
+
+// Tasks whose stack high-water marks appear in reports
+void mem_register_task(TaskHandle_t task, const char* name);
+
+// Logs per-tag, per-connection, per-task and heap region usage
+void mem_report();
+
+// One compact line: per-tag current/peak and free SRAM/PSRAM
+size_t mem_summary(char* buf, size_t cap);
+
+// Plain-text metrics lines for the metrics endpoint
+size_t mem_format_metrics(char* buf, size_t cap);
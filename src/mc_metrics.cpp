@@ -0,0 +1,277 @@
+#include "mc_metrics.h"
+
+#if MC_METRICS
+
+#include "mc_types.h"
+#include "mc_mem.h"
+#include "mc_store.h"
+#include "mc_capture.h"
+#include "mc_trace.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "lwip/sockets.h"
+#include <cerrno>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+
+static const char* TAG = "mc_metrics";
+
+static constexpr int HIST_BUCKETS = 16;   // bucket i holds samples < 2^i us, last is overflow
+static constexpr int MAX_PACKET_ID = 256;
+
+static const char* STAGE_NAMES[STAGE_COUNT] = { "heightmap", "trees", "sections", "skylight", "send", "loop", "tick", "move" };
+
+struct StageStats {
+    uint32_t count;
+    uint64_t total_us;
+    uint32_t max_us;
+    uint32_t buckets[HIST_BUCKETS];
+};
+
+struct PacketStats {
+    uint32_t count[MAX_PACKET_ID];
+    uint64_t bytes[MAX_PACKET_ID];
+    uint32_t total_count;
+    uint64_t total_bytes;
+};
+
+struct PlayerStats {
+    bool active;
+    char name[17];
+    uint32_t rtt_ms;
+};
+
+static StageStats stages[STAGE_COUNT];
+static PacketStats rx, tx;
+static PlayerStats players[MC_MAX_PLAYERS];
+
+void metrics_stage(int stage, uint32_t us) {
+    StageStats& s = stages[stage];
+    s.count++;
+    s.total_us += us;
+    if (us > s.max_us) s.max_us = us;
+    int b = 0;
+    while (b < HIST_BUCKETS - 1 && us >= (1u << b)) b++;
+    s.buckets[b]++;
+}
+
+const char* metrics_stage_name(int stage) { return STAGE_NAMES[stage]; }
+
+void metrics_stage_total(int stage, uint32_t& count, uint64_t& total_us) {
+    count = stages[stage].count;
+    total_us = stages[stage].total_us;
+}
+
+void metrics_stage_reset() { memset(stages, 0, sizeof(stages)); }
+
+static void count_packet(PacketStats& p, const uint8_t* frame, size_t len) {
+    int32_t id = 0;
+    if (mc_read_varint(frame, len, id) < 0 || id < 0 || id >= MAX_PACKET_ID) id = MAX_PACKET_ID - 1;
+    p.count[id]++;
+    p.bytes[id] += len;
+    p.total_count++;
+    p.total_bytes += len;
+}
+
+std::atomic<size_t> metrics_copy_bytes{0};
+
+void metrics_rx(const uint8_t* frame, size_t len) { count_packet(rx, frame, len); }
+void metrics_tx(const uint8_t* frame, size_t len) { count_packet(tx, frame, len); }
+
+int metrics_player_join(const char* name) {
+    for (int i = 0; i < MC_MAX_PLAYERS; i++) {
+        if (players[i].active) continue;
+        players[i].active = true;
+        snprintf(players[i].name, sizeof(players[i].name), "%s", name);
+        players[i].rtt_ms = 0;
+        return i;
+    }
+    return -1;
+}
+
+void metrics_player_leave(int slot) {
+    if (slot >= 0) players[slot].active = false;
+}
+
+void metrics_player_rtt(int slot, uint32_t ms) {
+    if (slot >= 0) players[slot].rtt_ms = ms;
+}
+
+size_t metrics_summary(char* buf, size_t cap) {
+    size_t n = snprintf(buf, cap, "chunks=%u", static_cast<unsigned>(stages[STAGE_SEND].count));
+    for (int s = 0; s < STAGE_COUNT && n < cap; s++) {
+        uint32_t avg = stages[s].count ? static_cast<uint32_t>(stages[s].total_us / stages[s].count) : 0;
+        n += snprintf(buf + n, cap - n, " %s=%u/%uus", STAGE_NAMES[s],
+                      static_cast<unsigned>(avg), static_cast<unsigned>(stages[s].max_us));
+    }
+    if (n < cap)
+        n += snprintf(buf + n, cap - n, " rx=%u/%lluB tx=%u/%lluB",
+                      static_cast<unsigned>(rx.total_count), static_cast<unsigned long long>(rx.total_bytes),
+                      static_cast<unsigned>(tx.total_count), static_cast<unsigned long long>(tx.total_bytes));
+    for (int i = 0; i < MC_MAX_PLAYERS && n < cap; i++)
+        if (players[i].active)
+            n += snprintf(buf + n, cap - n, " rtt[%s]=%ums", players[i].name,
+                          static_cast<unsigned>(players[i].rtt_ms));
+    return n < cap ? n : cap - 1;
+}
+
+static bool send_line(int sock, const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+
+static bool send_line(int sock, const char* fmt, ...) {
+    char line[160];
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(line, sizeof(line), fmt, args);
+    va_end(args);
+    if (n < 0) return false;
+    if (n >= static_cast<int>(sizeof(line))) n = sizeof(line) - 1;
+    return send(sock, line, n, 0) == n;
+}
+
+static void write_packets(int sock, const char* dir, const PacketStats& p) {
+    for (int id = 0; id < MAX_PACKET_ID; id++) {
+        if (!p.count[id]) continue;
+        send_line(sock, "mc_packets_total{dir=\"%s\",id=\"0x%02x\"} %u\n", dir, id,
+                  static_cast<unsigned>(p.count[id]));
+        send_line(sock, "mc_packet_bytes_total{dir=\"%s\",id=\"0x%02x\"} %llu\n", dir, id,
+                  static_cast<unsigned long long>(p.bytes[id]));
+    }
+}
+
+static void write_metrics(int sock) {
+    send_line(sock, "HTTP/1.0 200 OK\r\nContent-Type: text/plain\r\n\r\n");
+
+    for (int s = 0; s < STAGE_COUNT; s++) {
+        const StageStats& st = stages[s];
+        uint32_t cum = 0;
+        for (int b = 0; b < HIST_BUCKETS - 1; b++) {
+            cum += st.buckets[b];
+            send_line(sock, "mc_stage_us_bucket{stage=\"%s\",le=\"%u\"} %u\n",
+                      STAGE_NAMES[s], 1u << b, static_cast<unsigned>(cum));
+        }
+        send_line(sock, "mc_stage_us_bucket{stage=\"%s\",le=\"+Inf\"} %u\n",
+                  STAGE_NAMES[s], static_cast<unsigned>(st.count));
+        send_line(sock, "mc_stage_us_sum{stage=\"%s\"} %llu\n",
+                  STAGE_NAMES[s], static_cast<unsigned long long>(st.total_us));
+        send_line(sock, "mc_stage_us_max{stage=\"%s\"} %u\n",
+                  STAGE_NAMES[s], static_cast<unsigned>(st.max_us));
+    }
+
+    write_packets(sock, "rx", rx);
+    write_packets(sock, "tx", tx);
+    send_line(sock, "mc_packet_copy_bytes_total %llu\n", static_cast<unsigned long long>(metrics_copy_bytes));
+
+    for (int i = 0; i < MC_MAX_PLAYERS; i++)
+        if (players[i].active)
+            send_line(sock, "mc_keepalive_rtt_ms{player=\"%s\"} %u\n",
+                      players[i].name, static_cast<unsigned>(players[i].rtt_ms));
+
+    static char mem[2048];   // only this task writes metrics
+    size_t n = mem_format_metrics(mem, sizeof(mem));
+    send(sock, mem, n, 0);
+    n = store_format_metrics(mem, sizeof(mem));
+    send(sock, mem, n, 0);
+}
+
+#if MC_CAPTURE
+static void write_capture(int sock) {
+    size_t len;
+    const uint8_t* data = capture_buffer(len);
+    send_line(sock, "HTTP/1.0 200 OK\r\nContent-Type: application/octet-stream\r\n\r\n");
+    size_t sent = 0;
+    while (data && sent < len) {
+        int r = send(sock, data + sent, len - sent, 0);
+        if (r <= 0) break;
+        sent += r;
+    }
+}
+#endif
+
+#if MC_TRACE
+static bool send_chunk(const void* data, size_t len, void* ctx) {
+    int sock = *static_cast<int*>(ctx);
+    const auto* p = static_cast<const uint8_t*>(data);
+    while (len > 0) {
+        int r = send(sock, p, len, 0);
+        if (r <= 0) return false;
+        p += r;
+        len -= r;
+    }
+    return true;
+}
+
+static void write_trace(int sock, bool saved) {
+    send_line(sock, "HTTP/1.0 200 OK\r\nContent-Type: application/octet-stream\r\n\r\n");
+    trace_dump(saved, send_chunk, &sock);
+}
+#endif
+
+void metrics_server_task(void* pvParameters) {
+    int listen_sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (listen_sock < 0) {
+        ESP_LOGE(TAG, "Failed to create socket: errno %d", errno);
+        vTaskDelete(nullptr);
+        return;
+    }
+
+    int opt = 1;
+    setsockopt(listen_sock, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(MC_METRICS_PORT);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+
+    if (bind(listen_sock, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 ||
+        listen(listen_sock, 1) < 0) {
+        ESP_LOGE(TAG, "Metrics bind/listen failed: errno %d", errno);
+        close(listen_sock);
+        vTaskDelete(nullptr);
+        return;
+    }
+
+    ESP_LOGI(TAG, "Metrics on port %d", MC_METRICS_PORT);
+
+    TickType_t last_log = xTaskGetTickCount();
+    while (true) {
+        fd_set fds;
+        FD_ZERO(&fds);
+        FD_SET(listen_sock, &fds);
+        struct timeval tv = {1, 0};
+        int ret = select(listen_sock + 1, &fds, nullptr, nullptr, &tv);
+
+        if (ret > 0) {
+            int sock = accept(listen_sock, nullptr, nullptr);
+            if (sock >= 0) {
+                // Drain an HTTP request if one arrives quickly; plain nc sends nothing
+                struct timeval rto = {0, 200000};
+                setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &rto, sizeof(rto));
+                char req[256];
+                int r = recv(sock, req, sizeof(req) - 1, 0);
+                req[r > 0 ? r : 0] = '\0';
+#if MC_TRACE
+                if (strncmp(req, "GET /trace", 10) == 0) write_trace(sock, strncmp(req + 10, "/saved", 6) == 0);
+                else
+#endif
+#if MC_CAPTURE
+                if (strncmp(req, "GET /capture", 12) == 0) write_capture(sock);
+                else
+#endif
+                write_metrics(sock);
+                close(sock);
+            }
+        }
+
+        TickType_t now = xTaskGetTickCount();
+        if ((now - last_log) * portTICK_PERIOD_MS >= MC_METRICS_LOG_MS) {
+            char line[256];
+            metrics_summary(line, sizeof(line));
+            ESP_LOGI(TAG, "%s", line);
+            last_log = now;
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "config.h"
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+// Stages of send_chunk, plus the server loop, timed by MC_STAGE. The
+// histograms belong to the simulation task; work on other tasks times
+// STAGE_NONE, which records nothing.
+enum MetricStage {
+    STAGE_NONE = -1,
+    STAGE_HEIGHTMAP,
+    STAGE_TREES,
+    STAGE_SECTIONS,
+    STAGE_SKYLIGHT,
+    STAGE_SEND,
+    STAGE_LOOP,     // busy time of one simulation loop pass
+    STAGE_TICK,     // one game tick of block ticks
+    STAGE_MOVE,     // movement input applied on one game tick
+    STAGE_COUNT
+};
+
+#if MC_METRICS
+
+#include "esp_timer.h"
+
+void metrics_stage(int stage, uint32_t us);
+const char* metrics_stage_name(int stage);
+// Samples and summed time of one stage since start or the last reset
+void metrics_stage_total(int stage, uint32_t& count, uint64_t& total_us);
+void metrics_stage_reset();
+
+struct StageTimer {
+    int stage;
+    int64_t start;
+    explicit StageTimer(int s) : stage(s), start(esp_timer_get_time()) {}
+    ~StageTimer() {
+        if (stage != STAGE_NONE) metrics_stage(stage, static_cast<uint32_t>(esp_timer_get_time() - start));
+    }
+};
+
+#define MC_STAGE_CAT2(a, b) a##b
+#define MC_STAGE_CAT(a, b) MC_STAGE_CAT2(a, b)
+// Times the rest of the enclosing scope into the given stage histogram
+#define MC_STAGE(s) StageTimer MC_STAGE_CAT(stage_timer_, __LINE__)(s)
+
+// Packet counters, keyed by the leading packet id varint of a frame
+void metrics_rx(const uint8_t* frame, size_t len);
+void metrics_tx(const uint8_t* frame, size_t len);
+
+// Bytes memcpy'd into packet buffers and shared packets, encoded fields
+// included. Every task with a packet buffer adds to it, so unlike the
+// packet counters it is a relaxed atomic, word-sized so it stays lock-free.
+extern std::atomic<size_t> metrics_copy_bytes;
+inline void metrics_copied(size_t n) { metrics_copy_bytes.fetch_add(n, std::memory_order_relaxed); }
+
+// Per-player keep-alive round trip; slot is returned by metrics_player_join
+int  metrics_player_join(const char* name);
+void metrics_player_leave(int slot);
+void metrics_player_rtt(int slot, uint32_t ms);
+
+// One compact line: chunk stage averages, packet totals, RTTs
+size_t metrics_summary(char* buf, size_t cap);
+
+// Plain-text endpoint on MC_METRICS_PORT, also logs the summary periodically
+void metrics_server_task(void* pvParameters);
+
+#else
+
+#define MC_STAGE(s) ((void)0)
+
+inline void metrics_rx(const uint8_t*, size_t) {}
+inline void metrics_tx(const uint8_t*, size_t) {}
+inline void metrics_copied(size_t) {}
+inline int  metrics_player_join(const char*) { return -1; }
+inline void metrics_player_leave(int) {}
+inline void metrics_player_rtt(int, uint32_t) {}
+
+#endif
@@ -0,0 +1,451 @@
+#include "mc_nav.h"
+#include "mc_play.h"
+#include "mc_world.h"
+#include "mc_mem.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+static const char* TAG = "mc_nav";
+
+static_assert((MC_NAV_SECTIONS & (MC_NAV_SECTIONS - 1)) == 0, "MC_NAV_SECTIONS must be a power of two");
+static_assert(MC_NAV_NODES <= 16384, "node links are int16_t");
+
+static constexpr int WORLD_TOP = WORLD_MIN_Y + WORLD_SECTIONS * 16;
+static constexpr int MAX_DROP = 3;
+static constexpr int MAX_STARTS = 8;        // starts one search heads for at once
+static constexpr int INDEX_SLOTS = 2 * MC_NAV_NODES;
+static constexpr int16_t CLOSED = -1;
+
+// Walkability of one section, bits at x + z*16 + y*256
+struct NavSection {
+    int32_t cx, cz;
+    int8_t si;              // -1 for a free slot
+    uint64_t open[64];      // not solid
+    uint64_t stand[64];     // a mob can stand (or swim) here
+    uint64_t wet[64];       // fluid
+};
+
+struct NavNode {
+    int32_t x, z;
+    int16_t y;
+    uint16_t g;             // cost from here to the target
+    int16_t next;           // one step closer to the target; -1 at the target
+    int16_t heap;           // place in the open heap, CLOSED once expanded
+    uint32_t f;
+};
+
+// One backwards search from a target
+struct NavField {
+    bool used;
+    bool exhausted;         // nothing left to expand
+    NavPos target;
+    NavPos origin;          // the start it was begun for
+    uint32_t stamp;
+    NavNode* nodes;         // MC_NAV_NODES
+    int16_t* heap;          // MC_NAV_NODES, by f
+    int16_t* index;         // INDEX_SLOTS, open addressing, -1 free
+    int count, heap_len;
+    NavPos starts[MAX_STARTS];
+    int start_count;
+    int lo[3], hi[3];       // bounds of the cells reached
+};
+
+static NavSection* sections;        // MC_NAV_SECTIONS, direct mapped
+static NavField fields[MC_NAV_FIELDS];
+static NavSection* hot = nullptr;   // most recently used section
+static uint32_t clock_stamp = 0;
+static int turn = 0;                // field nav_tick serves first
+static NavStats stats;
+static bool ready = false;
+
+static const int DIRS[8][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}, {1, 1}, {1, -1}, {-1, 1}, {-1, -1}};
+
+static bool init() {
+    if (ready) return true;
+    sections = static_cast<NavSection*>(mem_alloc(MEM_CACHE, sizeof(NavSection) * MC_NAV_SECTIONS));
+    bool ok = sections != nullptr;
+    for (auto& f : fields) {
+        f.nodes = static_cast<NavNode*>(mem_alloc(MEM_CACHE, sizeof(NavNode) * MC_NAV_NODES));
+        f.heap = static_cast<int16_t*>(mem_alloc(MEM_CACHE, sizeof(int16_t) * MC_NAV_NODES));
+        f.index = static_cast<int16_t*>(mem_alloc(MEM_CACHE, sizeof(int16_t) * INDEX_SLOTS));
+        ok = ok && f.nodes && f.heap && f.index;
+        f.used = false;
+    }
+    if (!ok) {
+        ESP_LOGE(TAG, "No memory for navigation");
+        mem_free(sections);
+        for (auto& f : fields) {
+            mem_free(f.nodes);
+            mem_free(f.heap);
+            mem_free(f.index);
+        }
+        return false;
+    }
+    for (int i = 0; i < MC_NAV_SECTIONS; i++) sections[i].si = -1;
+    ready = true;
+    return true;
+}
+
+// ---- Sections ----
+
+static uint32_t section_slot(int cx, int cz, int si) {
+    return static_cast<uint32_t>(cx * 73856093 ^ cz * 19349663 ^ si * 83492791) & (MC_NAV_SECTIONS - 1);
+}
+
+// Works out section si of chunk (cx, cz) from the collision masks, which
+// generates them if the column is not cached
+static void derive(NavSection& s, int cx, int cz, int si) {
+    if (s.si < 0) stats.sections++;
+    s.cx = cx;
+    s.cz = cz;
+    s.si = static_cast<int8_t>(si);
+    memset(s.open, 0, sizeof(s.open));
+    memset(s.stand, 0, sizeof(s.stand));
+    memset(s.wet, 0, sizeof(s.wet));
+    stats.derived++;
+    const WorldColumn* col = world_column(cx, cz);
+    if (!col) return;
+    int base_y = WORLD_MIN_Y + si * 16;
+    for (int y = 0; y < 16; y++)
+        for (int lz = 0; lz < 16; lz++) {
+            int wy = base_y + y;
+            uint32_t below = world_row_bits(*col, wy - 1, lz, false);
+            uint32_t solid = world_row_bits(*col, wy, lz, false);
+            uint32_t fluid = world_row_bits(*col, wy, lz, true);
+            uint32_t head = world_row_bits(*col, wy + 1, lz, false) | world_row_bits(*col, wy + 1, lz, true);
+            uint32_t open = ~solid & 0xFFFF;
+            uint32_t stand = open & ~head & (below | fluid) & 0xFFFF;
+            int bit = lz * 16 + y * 256;
+            s.open[bit >> 6] |= static_cast<uint64_t>(open) << (bit & 63);
+            s.stand[bit >> 6] |= static_cast<uint64_t>(stand) << (bit & 63);
+            s.wet[bit >> 6] |= static_cast<uint64_t>(fluid) << (bit & 63);
+        }
+}
+
+static const NavSection* section(int cx, int cz, int si) {
+    if (hot && hot->si == si && hot->cx == cx && hot->cz == cz) return hot;
+    NavSection& s = sections[section_slot(cx, cz, si)];
+    if (s.si != si || s.cx != cx || s.cz != cz) derive(s, cx, cz, si);
+    hot = &s;
+    return hot;
+}
+
+// Which mask of the cell's section, or `outside` beyond the world's height
+static bool test(uint64_t (NavSection::*mask)[64], int x, int y, int z, bool outside) {
+    if (y < WORLD_MIN_Y || y >= WORLD_TOP) return outside;
+    int sy = y - WORLD_MIN_Y;
+    const NavSection* s = section(x >> 4, z >> 4, sy >> 4);
+    int bit = (x & 15) + (z & 15) * 16 + (sy & 15) * 256;
+    return ((s->*mask)[bit >> 6] >> (bit & 63)) & 1;
+}
+
+static bool is_open(int x, int y, int z) { return test(&NavSection::open, x, y, z, y >= WORLD_TOP); }
+static bool is_stand(int x, int y, int z) { return test(&NavSection::stand, x, y, z, false); }
+static bool is_wet(int x, int y, int z) { return test(&NavSection::wet, x, y, z, false); }
+
+// Cost of moving from standing cell a to standing cell b, one column
+// across; -1 if the move is not allowed
+static int move_cost(int ax, int ay, int az, int bx, int by, int bz) {
+    int dx = bx - ax, dz = bz - az, dh = by - ay;
+    bool diag = dx && dz;
+    int cost;
+    if (dh == 0) {
+        if (diag && !(is_open(bx, ay, az) && is_open(bx, ay + 1, az) && is_open(ax, ay, bz) && is_open(ax, ay + 1, bz)))
+            return -1;
+        cost = diag ? 14 : 10;
+    } else if (dh == 1) {
+        if (diag || !is_open(ax, ay + 2, az)) return -1;
+        cost = 20;
+    } else {
+        if (diag || dh < -MAX_DROP) return -1;
+        for (int y = by + 2; y <= ay + 1; y++)
+            if (!is_open(bx, y, bz)) return -1;
+        cost = 10 - 4 * dh;
+    }
+    return is_wet(bx, by, bz) ? cost * 2 : cost;
+}
+
+// ---- Searches ----
+
+static uint32_t heuristic(const NavField& f, const NavNode& n) {
+    uint32_t best = UINT32_MAX;
+    for (int i = 0; i < f.start_count; i++) {
+        int dx = abs(n.x - f.starts[i].x), dz = abs(n.z - f.starts[i].z);
+        uint32_t h = dx > dz ? 10 * dx + 4 * dz : 10 * dz + 4 * dx;
+        if (h < best) best = h;
+    }
+    return f.start_count ? best : 0;
+}
+
+static uint32_t index_slot(int x, int y, int z) {
+    return static_cast<uint32_t>(x * 73856093 ^ y * 19349663 ^ z * 83492791) & (INDEX_SLOTS - 1);
+}
+
+static int find_node(const NavField& f, int x, int y, int z) {
+    for (uint32_t i = index_slot(x, y, z);; i = (i + 1) & (INDEX_SLOTS - 1)) {
+        int n = f.index[i];
+        if (n < 0) return -1;
+        const NavNode& node = f.nodes[n];
+        if (node.x == x && node.y == y && node.z == z) return n;
+    }
+}
+
+static void heap_swap(NavField& f, int i, int j) {
+    int16_t a = f.heap[i], b = f.heap[j];
+    f.heap[i] = b;
+    f.heap[j] = a;
+    f.nodes[b].heap = static_cast<int16_t>(i);
+    f.nodes[a].heap = static_cast<int16_t>(j);
+}
+
+static void sift_up(NavField& f, int i) {
+    while (i > 0) {
+        int p = (i - 1) / 2;
+        if (f.nodes[f.heap[p]].f <= f.nodes[f.heap[i]].f) break;
+        heap_swap(f, i, p);
+        i = p;
+    }
+}
+
+static void sift_down(NavField& f, int i) {
+    while (true) {
+        int l = 2 * i + 1, r = l + 1, m = i;
+        if (l < f.heap_len && f.nodes[f.heap[l]].f < f.nodes[f.heap[m]].f) m = l;
+        if (r < f.heap_len && f.nodes[f.heap[r]].f < f.nodes[f.heap[m]].f) m = r;
+        if (m == i) return;
+        heap_swap(f, i, m);
+        i = m;
+    }
+}
+
+// Adds a cell reached at cost g through next; -1 when the field is full
+static int add_node(NavField& f, int x, int y, int z, uint16_t g, int16_t next) {
+    if (f.count >= MC_NAV_NODES) return -1;
+    int n = f.count++;
+    NavNode& node = f.nodes[n];
+    node = {x, z, static_cast<int16_t>(y), g, next, static_cast<int16_t>(f.heap_len), 0};
+    node.f = g + heuristic(f, node);
+    uint32_t i = index_slot(x, y, z);
+    while (f.index[i] >= 0) i = (i + 1) & (INDEX_SLOTS - 1);
+    f.index[i] = static_cast<int16_t>(n);
+    f.heap[f.heap_len++] = static_cast<int16_t>(n);
+    sift_up(f, f.heap_len - 1);
+    const int p[3] = {x, y, z};
+    for (int a = 0; a < 3; a++) {
+        if (p[a] < f.lo[a]) f.lo[a] = p[a];
+        if (p[a] > f.hi[a]) f.hi[a] = p[a];
+    }
+    return n;
+}
+
+// Empties the field and seeds it with its target
+static void restart(NavField& f) {
+    f.count = 0;
+    f.heap_len = 0;
+    f.exhausted = false;
+    memset(f.index, 0xFF, sizeof(int16_t) * INDEX_SLOTS);
+    for (int a = 0; a < 3; a++) {
+        f.lo[a] = INT32_MAX;
+        f.hi[a] = INT32_MIN;
+    }
+    add_node(f, f.target.x, f.target.y, f.target.z, 0, -1);
+    stats.searches++;
+}
+
+// New heuristic for every open cell after the starts changed. Closed cells
+// keep their cost: with a consistent heuristic it is already the least.
+static void rekey(NavField& f) {
+    for (int i = 0; i < f.heap_len; i++) {
+        NavNode& n = f.nodes[f.heap[i]];
+        n.f = n.g + heuristic(f, n);
+    }
+    for (int i = f.heap_len / 2 - 1; i >= 0; i--) sift_down(f, i);
+}
+
+static bool same(const NavPos& a, int x, int y, int z) { return a.x == x && a.y == y && a.z == z; }
+
+// Closes the cheapest open cell and reaches the cells that can move onto it
+static void expand(NavField& f) {
+    int bi = f.heap[0];
+    f.heap[0] = f.heap[--f.heap_len];
+    if (f.heap_len) {
+        f.nodes[f.heap[0]].heap = 0;
+        sift_down(f, 0);
+    }
+    NavNode& b = f.nodes[bi];
+    b.heap = CLOSED;
+    stats.expanded++;
+    int bx = b.x, by = b.y, bz = b.z;
+    uint16_t bg = b.g;
+
+    bool rekeyed = false;
+    for (int i = 0; i < f.start_count; i++)
+        if (same(f.starts[i], bx, by, bz)) {
+            f.starts[i--] = f.starts[--f.start_count];
+            rekeyed = true;
+        }
+
+    for (const auto& d : DIRS) {
+        int ax = bx - d[0], az = bz - d[1];
+        for (int ay = by + MAX_DROP; ay >= by - 1; ay--) {
+            if (!is_stand(ax, ay, az)) continue;
+            int cost = move_cost(ax, ay, az, bx, by, bz);
+            if (cost < 0) continue;
+            uint32_t g = bg + cost;
+            if (g > UINT16_MAX) continue;
+            int n = find_node(f, ax, ay, az);
+            if (n < 0) {
+                add_node(f, ax, ay, az, static_cast<uint16_t>(g), static_cast<int16_t>(bi));
+                continue;
+            }
+            NavNode& a = f.nodes[n];
+            if (a.heap == CLOSED || g >= a.g) continue;
+            a.f -= a.g - g;
+            a.g = static_cast<uint16_t>(g);
+            a.next = static_cast<int16_t>(bi);
+            sift_up(f, a.heap);
+        }
+    }
+    if (rekeyed && f.start_count) rekey(f);
+    if (f.heap_len == 0) {
+        f.exhausted = true;
+        f.start_count = 0;
+    }
+}
+
+static NavField* field_for(const NavPos& t) {
+    NavField* victim = &fields[0];
+    for (auto& f : fields) {
+        if (f.used && same(f.target, t.x, t.y, t.z)) return &f;
+        if (!victim->used) continue;
+        if (!f.used || f.stamp - victim->stamp > 0x80000000u) victim = &f;   // older
+    }
+    victim->used = true;
+    victim->target = t;
+    victim->start_count = 0;
+    victim->origin = {INT32_MIN, 0, 0};
+    restart(*victim);
+    return victim;
+}
+
+// Moves p down onto the first place to stand within MAX_DROP blocks
+static bool snap(NavPos& p) {
+    for (int d = 0; d <= MAX_DROP; d++)
+        if (is_stand(p.x, p.y - d, p.z)) {
+            p.y -= d;
+            return true;
+        }
+    return false;
+}
+
+NavStatus nav_path(const NavPos& from, const NavPos& to, NavPos* path, int max, int& len) {
+    len = 0;
+    stats.requests++;
+    NavPos s = from, t = to;
+    if (!init() || !snap(s) || !snap(t)) {
+        stats.none++;
+        return NAV_NONE;
+    }
+    NavField& f = *field_for(t);
+    f.stamp = ++clock_stamp;
+    if (f.origin.x == INT32_MIN) f.origin = s;
+
+    int n = find_node(f, s.x, s.y, s.z);
+    if (n >= 0 && f.nodes[n].heap == CLOSED) {
+        for (; n >= 0 && len < max; n = f.nodes[n].next) path[len++] = {f.nodes[n].x, f.nodes[n].y, f.nodes[n].z};
+        stats.found++;
+        if (!same(f.origin, s.x, s.y, s.z)) stats.reused++;
+        return NAV_FOUND;
+    }
+    if (f.exhausted) {
+        stats.none++;
+        return NAV_NONE;
+    }
+    for (int i = 0; i < f.start_count; i++)
+        if (same(f.starts[i], s.x, s.y, s.z)) return NAV_PENDING;
+    // A full list gives up its oldest start; that mob asks again
+    if (f.start_count == MAX_STARTS) memmove(f.starts, f.starts + 1, sizeof(NavPos) * --f.start_count);
+    f.starts[f.start_count++] = s;
+    rekey(f);
+    return NAV_PENDING;
+}
+
+void nav_tick() {
+    if (!ready) return;
+    int64_t start = esp_timer_get_time();
+    int budget = MC_NAV_BUDGET;
+    // Turns of a few cells each, so every waiting target gets a share
+    bool waiting = true;
+    while (budget > 0 && waiting) {
+        waiting = false;
+        for (int k = 0; k < MC_NAV_FIELDS && budget > 0; k++) {
+            NavField& f = fields[(turn + k) % MC_NAV_FIELDS];
+            if (!f.used || f.exhausted || !f.start_count) continue;
+            for (int i = 0; i < 32 && budget > 0 && f.start_count && f.heap_len; i++, budget--) expand(f);
+            waiting |= f.start_count > 0 && !f.exhausted;
+        }
+    }
+    turn = (turn + 1) % MC_NAV_FIELDS;
+    stats.last_us = static_cast<uint32_t>(esp_timer_get_time() - start);
+    if (stats.last_us > stats.max_us) stats.max_us = stats.last_us;
+}
+
+void nav_block_changed(int x, int y, int z, uint8_t old_pi, uint8_t new_pi) {
+    if (block_occ(old_pi) != block_occ(new_pi)) nav_region_changed(x, y, z, x, y, z);
+}
+
+void nav_region_changed(int x0, int y0, int z0, int x1, int y1, int z1) {
+    if (!ready) return;
+    // Standing at y depends on the blocks at y - 1 .. y + 1
+    int lo = y0 - 1 < WORLD_MIN_Y ? WORLD_MIN_Y : y0 - 1;
+    int hi = y1 + 1 >= WORLD_TOP ? WORLD_TOP - 1 : y1 + 1;
+    for (int cz = z0 >> 4; cz <= z1 >> 4; cz++)
+        for (int cx = x0 >> 4; cx <= x1 >> 4; cx++)
+            for (int si = (lo - WORLD_MIN_Y) >> 4; si <= (hi - WORLD_MIN_Y) >> 4; si++) {
+                NavSection& s = sections[section_slot(cx, cz, si)];
+                if (s.si != si || s.cx != cx || s.cz != cz) continue;
+                s.si = -1;
+                stats.sections--;
+                stats.dropped++;
+                if (hot == &s) hot = nullptr;
+            }
+    // A search that reached near the blocks may have used them
+    for (auto& f : fields) {
+        if (!f.used || !f.count) continue;
+        if (x1 < f.lo[0] - 1 || x0 > f.hi[0] + 1 || z1 < f.lo[2] - 1 || z0 > f.hi[2] + 1) continue;
+        if (y1 < f.lo[1] - 2 || y0 > f.hi[1] + MAX_DROP + 1) continue;
+        restart(f);
+        if (f.start_count) rekey(f);
+        stats.resets++;
+    }
+}
+
+bool nav_standable(int x, int y, int z) { return init() && is_stand(x, y, z); }
+
+void nav_clear() {
+    if (!ready) return;
+    for (int i = 0; i < MC_NAV_SECTIONS; i++) sections[i].si = -1;
+    for (auto& f : fields) f.used = false;
+    hot = nullptr;
+    stats.sections = 0;
+}
+
+void nav_stats(NavStats& st) { st = stats; }
+
+size_t nav_summary(char* buf, size_t cap) {
+    NavStats st;
+    nav_stats(st);
+    int n = snprintf(buf, cap,
+                     "requests=%u found=%u reused=%u none=%u searches=%u expanded=%u derived=%u dropped=%u "
+                     "resets=%u sections=%u last=%uus max=%uus",
+                     static_cast<unsigned>(st.requests), static_cast<unsigned>(st.found),
+                     static_cast<unsigned>(st.reused), static_cast<unsigned>(st.none),
+                     static_cast<unsigned>(st.searches), static_cast<unsigned>(st.expanded),
+                     static_cast<unsigned>(st.derived), static_cast<unsigned>(st.dropped),
+                     static_cast<unsigned>(st.resets), static_cast<unsigned>(st.sections),
+                     static_cast<unsigned>(st.last_us), static_cast<unsigned>(st.max_us));
+    return n < 0 ? 0 : static_cast<size_t>(n) < cap ? n : cap - 1;
+}
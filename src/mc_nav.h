@@ -0,0 +1,70 @@
+#pragma once
+
+#include "config.h"
+#include <cstdint>
+#include <cstddef>
+
+// Paths for mobs over the collision masks.
+//
+// A mob stands at a cell when the cell and the one above it are not solid
+// and the block below holds it up, or when the cell is water with air above
+// it, where it swims. Per section, the walkability of every cell is worked
+// out once from the collision masks (mc_world) and cached: cells that are
+// open, that can be stood in and that are wet, one bit each. The tick
+// engine drops the sections around a block it changes.
+//
+// Moves go to the eight cells around at the same height, diagonals only
+// past two open corners; one up, straight only, with head room; or off an
+// edge, straight only, down to three blocks. Orthogonal steps cost 10,
+// diagonal 14, a step up 10 more and a swim twice as much.
+//
+// A search runs A* backwards from the target, so every cell it closes
+// knows its next step toward the target: a mob that asks for a path to a
+// target already being searched, from a cell the search has reached, gets
+// its path with no search at all, and a new start only turns the
+// remaining search toward it. Searches advance by at most MC_NAV_BUDGET
+// cells per game tick, shared between targets.
+
+struct NavPos { int x, y, z; };
+
+enum NavStatus : uint8_t {
+    NAV_FOUND,      // path written
+    NAV_PENDING,    // still searching; ask again next tick
+    NAV_NONE        // no path within the search limits
+};
+
+struct NavStats {
+    uint32_t requests;
+    uint32_t found;
+    uint32_t reused;            // found without expanding a cell for this start
+    uint32_t none;
+    uint32_t searches;          // targets searched from scratch
+    uint32_t expanded;          // cells expanded
+    uint32_t derived;           // section masks worked out
+    uint32_t dropped;           // section masks dropped for block changes
+    uint32_t resets;            // searches restarted for block changes
+    uint32_t sections;          // section masks cached
+    uint32_t last_us, max_us;   // nav_tick time
+};
+
+// Path from `from` to `to` (feet cells; each moved down onto the first
+// place to stand within a few blocks). On NAV_FOUND writes up to max cells,
+// from the start to the target; len < the full length when max runs out,
+// so ask again partway along.
+NavStatus nav_path(const NavPos& from, const NavPos& to, NavPos* path, int max, int& len);
+// Spends the game tick's MC_NAV_BUDGET on waiting searches
+void nav_tick();
+// A block changed from old_pi to new_pi (PI_* indices). Called by the tick
+// engine.
+void nav_block_changed(int x, int y, int z, uint8_t old_pi, uint8_t new_pi);
+// Any block of the box (inclusive corners) may have changed: drops its
+// sections and the searches near it once. Called by the tick engine for
+// region edits.
+void nav_region_changed(int x0, int y0, int z0, int x1, int y1, int z1);
+// True if a mob can stand at (x, y, z)
+bool nav_standable(int x, int y, int z);
+// Drops every cached mask and search
+void nav_clear();
+
+void nav_stats(NavStats& out);
+size_t nav_summary(char* buf, size_t cap);
@@ -23,6 +23,11 @@ void nbt_end(PacketBuf& b) {
     pkt_write_byte(b, 0x00);
 }
 
+void nbt_text(PacketBuf& b, const char* text) {
+    pkt_write_byte(b, 0x08);
+    write_name(b, text);
+}
+
 void nbt_compound(PacketBuf& b, const char* name) {
     tag_header(b, 0x0A, name);
 }
@@ -77,3 +82,211 @@ void nbt_long_array(PacketBuf& b, const char* name, const int64_t* vals, int32_t
         mc_write_i64(tmp, vals[i]); b.append(tmp, 8);
     }
 }
+
+bool NbtView::is(const char* s) const {
+    size_t n = strlen(s);
+    return n == len && memcmp(data, s, n) == 0;
+}
+
+void nbt_read_begin(NbtReader& r, const PacketBuf& b) {
+    size_t avail = b.pos < b.len ? b.len - b.pos : 0;
+    r.p = b.data + b.pos;
+    r.end = r.p + (avail < MC_NBT_MAX_BYTES ? avail : MC_NBT_MAX_BYTES);
+    r.depth = 0;
+    r.ok = b.pos <= b.len;
+}
+
+bool nbt_read_end(NbtReader& r, PacketBuf& b) {
+    if (r.ok) b.pos = static_cast<size_t>(r.p - b.data);
+    return r.ok;
+}
+
+static bool fail(NbtReader& r) {
+    r.ok = false;
+    return false;
+}
+
+static bool take(NbtReader& r, size_t n, const uint8_t*& at) {
+    if (!r.ok || static_cast<size_t>(r.end - r.p) < n) return fail(r);
+    at = r.p;
+    r.p += n;
+    return true;
+}
+
+static bool advance(NbtReader& r, size_t n) {
+    const uint8_t* at;
+    return take(r, n, at);
+}
+
+// count elements of size bytes each; a count of 32 bits times 8 overflows
+// a 32-bit size_t
+static bool take_n(NbtReader& r, int32_t count, size_t size, const uint8_t*& at) {
+    if (!r.ok || count < 0 || static_cast<size_t>(count) > static_cast<size_t>(r.end - r.p) / size) return fail(r);
+    return take(r, static_cast<size_t>(count) * size, at);
+}
+
+// Payload size of the fixed-width types, 0 for the rest
+static size_t fixed_size(uint8_t type) {
+    static const uint8_t SIZE[] = {0, 1, 2, 4, 8, 4, 8};
+    return type < sizeof(SIZE) ? SIZE[type] : 0;
+}
+
+static size_t array_elem(uint8_t type) {
+    return type == NBT_BYTE_ARRAY ? 1 : type == NBT_INT_ARRAY ? 4 : type == NBT_LONG_ARRAY ? 8 : 0;
+}
+
+// Payloads without nested tags
+static bool skip_flat(NbtReader& r, uint8_t type) {
+    const uint8_t* at;
+    if (size_t n = fixed_size(type)) return advance(r, n);
+    if (type == NBT_STRING) return take(r, 2, at) && advance(r, mc_read_u16(at));
+    if (size_t elem = array_elem(type)) {
+        return take(r, 4, at) && take_n(r, mc_read_i32(at), elem, at);
+    }
+    return fail(r);
+}
+
+bool nbt_root(NbtReader& r) {
+    const uint8_t* at;
+    if (!take(r, 1, at) || *at != NBT_COMPOUND) return fail(r);
+    r.depth = 1;
+    return true;
+}
+
+bool nbt_next(NbtReader& r, uint8_t& type, NbtView& name) {
+    const uint8_t* at;
+    if (r.depth <= 0 || !take(r, 1, at)) return fail(r);
+    type = *at;
+    if (type == NBT_END) {
+        r.depth--;
+        return false;
+    }
+    if (type > NBT_LONG_ARRAY || !take(r, 2, at)) return fail(r);
+    name.len = mc_read_u16(at);
+    if (!take(r, name.len, at)) return false;
+    name.data = reinterpret_cast<const char*>(at);
+    return true;
+}
+
+bool nbt_find(NbtReader& r, const char* name, uint8_t& type) {
+    NbtView n;
+    while (nbt_next(r, type, n)) {
+        if (n.is(name)) return true;
+        if (!nbt_skip(r, type)) return false;
+    }
+    return false;
+}
+
+bool nbt_enter(NbtReader& r) {
+    if (!r.ok || r.depth >= MC_NBT_MAX_DEPTH) return fail(r);
+    r.depth++;
+    return true;
+}
+
+bool nbt_skip(NbtReader& r, uint8_t type) {
+    if (type != NBT_LIST && type != NBT_COMPOUND) return skip_flat(r, type);
+
+    // One frame per open list or compound; a compound's left is -1
+    struct Frame { uint8_t elem; int32_t left; };
+    Frame stack[MC_NBT_MAX_DEPTH];
+    int sp = 0;
+    const uint8_t* at;
+    auto open = [&](uint8_t t) {
+        if (r.depth + sp >= MC_NBT_MAX_DEPTH) return fail(r);
+        if (t == NBT_COMPOUND) {
+            stack[sp++] = {NBT_COMPOUND, -1};
+            return true;
+        }
+        if (!take(r, 5, at)) return false;
+        uint8_t elem = at[0];
+        int32_t count = mc_read_i32(at + 1);
+        if (count < 0 || elem > NBT_LONG_ARRAY || (elem == NBT_END && count > 0)) return fail(r);
+        // Fixed-width elements go in one step
+        if (size_t n = fixed_size(elem)) return take_n(r, count, n, at);
+        stack[sp++] = {elem, count};
+        return true;
+    };
+    if (!open(type)) return false;
+    while (sp > 0) {
+        Frame& f = stack[sp - 1];
+        uint8_t t;
+        if (f.left < 0) {
+            if (!take(r, 1, at)) return false;
+            t = *at;
+            if (t == NBT_END) {
+                sp--;
+                continue;
+            }
+            if (t > NBT_LONG_ARRAY || !take(r, 2, at) || !advance(r, mc_read_u16(at))) return fail(r);
+        } else {
+            if (f.left == 0) {
+                sp--;
+                continue;
+            }
+            f.left--;
+            t = f.elem;
+        }
+        if (!(t == NBT_LIST || t == NBT_COMPOUND ? open(t) : skip_flat(r, t))) return false;
+    }
+    return true;
+}
+
+bool nbt_skip_any(NbtReader& r) {
+    const uint8_t* at;
+    if (!take(r, 1, at) || *at == NBT_END || *at > NBT_LONG_ARRAY) return fail(r);
+    return nbt_skip(r, *at);
+}
+
+bool nbt_get_int(NbtReader& r, uint8_t type, int64_t& out) {
+    const uint8_t* at;
+    size_t n = type <= NBT_LONG ? fixed_size(type) : 0;
+    if (!n) return fail(r);
+    if (!take(r, n, at)) return false;
+    out = n == 1 ? static_cast<int8_t>(*at) : n == 2 ? mc_read_i16(at) : n == 4 ? mc_read_i32(at) : mc_read_i64(at);
+    return true;
+}
+
+bool nbt_get_number(NbtReader& r, uint8_t type, double& out) {
+    const uint8_t* at;
+    if (type == NBT_FLOAT) {
+        if (!take(r, 4, at)) return false;
+        out = mc_read_f32(at);
+        return true;
+    }
+    if (type == NBT_DOUBLE) {
+        if (!take(r, 8, at)) return false;
+        out = mc_read_f64(at);
+        return true;
+    }
+    int64_t v;
+    if (!nbt_get_int(r, type, v)) return false;
+    out = static_cast<double>(v);
+    return true;
+}
+
+bool nbt_get_string(NbtReader& r, NbtView& out) {
+    const uint8_t* at;
+    if (!take(r, 2, at)) return false;
+    out.len = mc_read_u16(at);
+    if (!take(r, out.len, at)) return false;
+    out.data = reinterpret_cast<const char*>(at);
+    return true;
+}
+
+bool nbt_get_list(NbtReader& r, uint8_t& elem, int32_t& count) {
+    const uint8_t* at;
+    if (!take(r, 5, at)) return false;
+    elem = at[0];
+    count = mc_read_i32(at + 1);
+    if (count < 0 || elem > NBT_LONG_ARRAY || (elem == NBT_END && count > 0)) return fail(r);
+    return true;
+}
+
+bool nbt_get_array(NbtReader& r, uint8_t type, int32_t& count, const uint8_t*& data) {
+    const uint8_t* at;
+    size_t elem = array_elem(type);
+    if (!elem) return fail(r);
+    if (!take(r, 4, at)) return false;
+    count = mc_read_i32(at);
+    return take_n(r, count, elem, data);
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "mc_packet.h"
+#include "config.h"
 
 // Network NBT root compound (no name, just tag type 0x0A)
 void nbt_begin(PacketBuf& b);
@@ -15,3 +16,61 @@ void nbt_double(PacketBuf& b, const char* name, double val);
 void nbt_string(PacketBuf& b, const char* name, const char* val);
 void nbt_string_list(PacketBuf& b, const char* name, const char** items, int count);
 void nbt_long_array(PacketBuf& b, const char* name, const int64_t* vals, int32_t count);
+
+// Network NBT text component: a bare root string tag
+void nbt_text(PacketBuf& b, const char* text);
+
+// Reading network NBT in place. A reader walks a PacketBuf from its read
+// position without copying or allocating; names and strings come back as
+// views into the packet. Every read is bounds checked, nesting stops at
+// MC_NBT_MAX_DEPTH and a payload at MC_NBT_MAX_BYTES, so hostile input
+// fails the reader instead of running off the buffer. Once a reader has
+// failed every call returns false.
+
+enum NbtType : uint8_t {
+    NBT_END, NBT_BYTE, NBT_SHORT, NBT_INT, NBT_LONG, NBT_FLOAT, NBT_DOUBLE,
+    NBT_BYTE_ARRAY, NBT_STRING, NBT_LIST, NBT_COMPOUND, NBT_INT_ARRAY, NBT_LONG_ARRAY
+};
+
+// Modified UTF-8 bytes inside the packet, not terminated
+struct NbtView {
+    const char* data;
+    uint16_t len;
+
+    bool is(const char* s) const;
+};
+
+struct NbtReader {
+    const uint8_t* p;
+    const uint8_t* end;
+    int depth;              // compounds entered and not yet ended
+    bool ok;
+};
+
+void nbt_read_begin(NbtReader& r, const PacketBuf& b);
+// Moves b's read position past what was read; false if the reader failed
+bool nbt_read_end(NbtReader& r, PacketBuf& b);
+
+// Root compound: reads its type byte and enters it. False for any other
+// root, the empty one (a lone 0x00) included.
+bool nbt_root(NbtReader& r);
+// Next tag of the compound being read, leaving its payload next. False at
+// the compound's end, which is consumed, or on failure.
+bool nbt_next(NbtReader& r, uint8_t& type, NbtView& name);
+// Skips the current compound's tags up to the one called name
+bool nbt_find(NbtReader& r, const char* name, uint8_t& type);
+// Enters the compound whose payload is next
+bool nbt_enter(NbtReader& r);
+// Skips a payload, whole compounds and lists in one pass
+bool nbt_skip(NbtReader& r, uint8_t type);
+// A bare tag of any type (a text component): its type byte and payload
+bool nbt_skip_any(NbtReader& r);
+
+// Payload readers; integer and floating types convert to the wider form
+bool nbt_get_int(NbtReader& r, uint8_t type, int64_t& out);
+bool nbt_get_number(NbtReader& r, uint8_t type, double& out);
+bool nbt_get_string(NbtReader& r, NbtView& out);
+// List header; count elements of type elem follow
+bool nbt_get_list(NbtReader& r, uint8_t& elem, int32_t& count);
+// Byte, int or long array: count elements, big endian, at data
+bool nbt_get_array(NbtReader& r, uint8_t type, int32_t& count, const uint8_t*& data);
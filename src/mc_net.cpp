@@ -0,0 +1,41 @@
+#include "mc_net.h"
+#include "lwip/sockets.h"
+
+int net_recv(int sock, void* buf, size_t len) {
+    return recv(sock, buf, len, 0);
+}
+
+int net_try_recv(int sock, void* buf, size_t len) {
+    int r = recv(sock, buf, len, MSG_DONTWAIT);
+    if (r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return 0;
+    return r > 0 ? r : -1;
+}
+
+int net_send(int sock, const void* buf, size_t len) {
+    return send(sock, buf, len, 0);
+}
+
+int net_try_send(int sock, const void* buf, size_t len) {
+    int r = send(sock, buf, len, MSG_DONTWAIT);
+    if (r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return 0;
+    return r;
+}
+
+int net_try_sendv(int sock, const NetSeg* segs, int count) {
+    iovec iov[16];
+    if (count > 16) count = 16;
+    for (int i = 0; i < count; i++) {
+        iov[i].iov_base = const_cast<void*>(segs[i].data);
+        iov[i].iov_len = segs[i].len;
+    }
+    msghdr msg = {};
+    msg.msg_iov = iov;
+    msg.msg_iovlen = count;
+    int r = sendmsg(sock, &msg, MSG_DONTWAIT);
+    if (r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return 0;
+    return r;
+}
+
+void net_close(int sock) {
+    close(sock);
+}
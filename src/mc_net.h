@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+
+// A piece of a gathered send
+struct NetSeg {
+    const void* data;
+    size_t len;
+};
+
+// Socket calls made by the protocol code. The replay harness links its own
+// implementation so the server logic runs without sockets.
+int  net_recv(int sock, void* buf, size_t len);
+// Non-blocking receive: bytes read, 0 if nothing is there yet, -1 on error
+// or when the peer has closed
+int  net_try_recv(int sock, void* buf, size_t len);
+int  net_send(int sock, const void* buf, size_t len);
+// Non-blocking send: bytes written, 0 if the socket would block, -1 on error
+int  net_try_send(int sock, const void* buf, size_t len);
+// net_try_send of count pieces in order, in one call
+int  net_try_sendv(int sock, const NetSeg* segs, int count);
+void net_close(int sock);
@@ -1,47 +1,108 @@
 #include "mc_packet.h"
 #include "mc_types.h"
-#include "esp_heap_caps.h"
-#include "lwip/sockets.h"
+#include "mc_metrics.h"
+#include "mc_net.h"
+#include "mc_capture.h"
+#include "mc_trace.h"
+#include "mc_link.h"
 #include <cstring>
 
-void PacketBuf::init(size_t initial_cap) {
-    data = static_cast<uint8_t*>(heap_caps_malloc(initial_cap, MALLOC_CAP_SPIRAM));
-    cap = initial_cap;
+void PacketBuf::init(size_t initial_cap, MemTag mem_tag) {
+    tag = mem_tag;
+    data = static_cast<uint8_t*>(mem_alloc(tag, initial_cap));
+    cap = data ? initial_cap : 0;
     len = 0;
     pos = 0;
+    ref_count = 0;
+    ref_len = 0;
+    failed = false;
 }
 
 void PacketBuf::free() {
-    if (data) { heap_caps_free(data); data = nullptr; }
+    if (data) { mem_free(data); data = nullptr; }
     cap = len = pos = 0;
+    ref_count = 0;
+    ref_len = 0;
+    failed = false;
 }
 
 void PacketBuf::reset() {
     len = 0;
     pos = 0;
+    ref_count = 0;
+    ref_len = 0;
+    failed = false;
 }
 
-void PacketBuf::ensure(size_t additional) {
-    if (len + additional <= cap) return;
-    size_t new_cap = cap * 2;
+bool PacketBuf::ensure(size_t additional) {
+    if (len + additional <= cap) return true;
+    size_t new_cap = cap ? cap * 2 : 1024;
     while (new_cap < len + additional) new_cap *= 2;
-    auto* new_buf = static_cast<uint8_t*>(heap_caps_malloc(new_cap, MALLOC_CAP_SPIRAM));
-    std::memcpy(new_buf, data, len);
-    heap_caps_free(data);
+    auto* new_buf = static_cast<uint8_t*>(mem_alloc(tag, new_cap));
+    if (!new_buf) {
+        failed = true;
+        return false;
+    }
+    if (data) std::memcpy(new_buf, data, len);
+    metrics_copied(len);
+    mem_free(data);
     data = new_buf;
     cap = new_cap;
+    return true;
 }
 
 void PacketBuf::append(const uint8_t* src, size_t n) {
-    ensure(n);
+    if (!ensure(n)) return;
     std::memcpy(data + len, src, n);
+    metrics_copied(n);
     len += n;
 }
 
+void PacketBuf::append_ref(const uint8_t* src, size_t n) {
+    if (ref_count == PACKET_REFS) { append(src, n); return; }
+    refs[ref_count++] = {src, static_cast<uint32_t>(n), static_cast<uint32_t>(len)};
+    ref_len += n;
+}
+
+void PacketBuf::flatten() {
+    if (!ref_count || failed || !ensure(ref_len)) return;
+    // Back to front, so each owned run moves once
+    size_t end = len + ref_len, tail = len;
+    for (int i = ref_count - 1; i >= 0; i--) {
+        const PacketRef& r = refs[i];
+        end -= tail - r.at;
+        std::memmove(data + end, data + r.at, tail - r.at);
+        end -= r.len;
+        std::memcpy(data + end, r.data, r.len);
+        metrics_copied(tail - r.at + r.len);
+        tail = r.at;
+    }
+    len += ref_len;
+    ref_count = 0;
+    ref_len = 0;
+}
+
+int PacketBuf::segments(NetSeg* segs, const uint8_t* own) const {
+    int n = 0;
+    size_t at = 0;
+    auto put = [&](const uint8_t* p, size_t k) {
+        if (k == 0) return;
+        if (segs) segs[n] = {p, k};
+        n++;
+    };
+    for (int i = 0; i < ref_count; i++) {
+        put(own + at, refs[i].at - at);
+        put(refs[i].data, refs[i].len);
+        at = refs[i].at;
+    }
+    put(own + at, len - at);
+    return n;
+}
+
 static bool recv_exact(int sock, uint8_t* buf, size_t n) {
     size_t got = 0;
     while (got < n) {
-        int r = recv(sock, buf + got, n - got, 0);
+        int r = net_recv(sock, buf + got, n - got);
         if (r <= 0) return false;
         got += r;
     }
@@ -55,23 +116,37 @@ bool PacketBuf::recv_packet(int sock) {
     if (mc_read_varint_sock(sock, pkt_len) < 0 || pkt_len <= 0 || pkt_len > 65536)
         return false;
 
-    ensure(pkt_len);
+    if (!ensure(pkt_len)) return false;
     if (!recv_exact(sock, data, pkt_len)) return false;
     len = pkt_len;
     pos = 0;
+    metrics_rx(data, len);
+    trace_frame(TRACE_PKT_IN, sock, data, len);
     return true;
 }
 
 bool PacketBuf::send_packet(int sock) {
+    if (failed) return false;
+    NetSeg segs[PACKET_SEGS];
+    int n = segments(segs, data);
+    metrics_tx(data, total());
+    trace_frame(TRACE_PKT_OUT, sock, data, total());
+    capture_frame_segs(sock, CAPTURE_OUT, segs, n);
+    // Server connections are written by the network task
+    if (link_active()) return link_send(sock, *this);
+
     uint8_t hdr[5];
-    int hdr_len = mc_write_varint(hdr, static_cast<int32_t>(len));
+    int hdr_len = mc_write_varint(hdr, static_cast<int32_t>(total()));
 
-    if (send(sock, hdr, hdr_len, 0) != hdr_len) return false;
-    size_t sent = 0;
-    while (sent < len) {
-        int r = send(sock, data + sent, len - sent, 0);
-        if (r <= 0) return false;
-        sent += r;
+    if (net_send(sock, hdr, hdr_len) != hdr_len) return false;
+    for (int i = 0; i < n; i++) {
+        auto* p = static_cast<const uint8_t*>(segs[i].data);
+        size_t sent = 0;
+        while (sent < segs[i].len) {
+            int r = net_send(sock, p + sent, segs[i].len - sent);
+            if (r <= 0) return false;
+            sent += r;
+        }
     }
     return true;
 }
@@ -1,21 +1,53 @@
 #pragma once
 
+#include "mc_mem.h"
+#include "mc_net.h"
 #include <cstdint>
 #include <cstddef>
 
+// Constant bytes a packet points at instead of copying: they go out just
+// before owned byte `at`. They must outlive every queued copy of the
+// packet, so only static data qualifies.
+struct PacketRef {
+    const uint8_t* data;
+    uint32_t len;
+    uint32_t at;
+};
+
+static constexpr int PACKET_REFS = 4;
+// Most pieces a packet sends as: owned runs around each reference
+static constexpr int PACKET_SEGS = 2 * PACKET_REFS + 1;
+
 struct PacketBuf {
     uint8_t* data;
     size_t cap;
-    size_t len;
+    size_t len;             // owned bytes
     size_t pos;
+    MemTag tag;
+    PacketRef refs[PACKET_REFS];
+    uint8_t ref_count;
+    uint32_t ref_len;
+    bool failed;            // a grow failed and bytes were dropped; until reset
 
-    void init(size_t initial_cap = 1024);
+    void init(size_t initial_cap = 1024, MemTag mem_tag = MEM_PACKET);
     void free();
     void reset();
-    void ensure(size_t additional);
+    // False, and failed set, if the buffer cannot grow that far
+    bool ensure(size_t additional);
     void append(const uint8_t* src, size_t n);
+    // Adds static bytes at the end without copying them; copies once the
+    // reference slots are used up
+    void append_ref(const uint8_t* src, size_t n);
+    // Copies the referenced bytes in, leaving data whole; check failed after
+    void flatten();
     size_t remaining() const { return len - pos; }
+    // Packet length, referenced bytes included
+    size_t total() const { return len + ref_len; }
+    // Pieces in send order, owned runs read from own (data, or a copy of
+    // it). Counts them only when segs is null.
+    int segments(NetSeg* segs, const uint8_t* own) const;
 
     bool recv_packet(int sock);
+    // False without sending anything if the buffer failed
     bool send_packet(int sock);
 };
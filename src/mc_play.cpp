@@ -1,6 +1,13 @@
 #include "mc_play.h"
 #include "mc_types.h"
 #include "mc_nbt.h"
+#include "mc_metrics.h"
+#include "mc_world.h"
+#include "mc_shard.h"
+#include "mc_trace.h"
+#include "mc_tick.h"
+#include "mc_light.h"
+#include "mc_bake.h"
 #include "esp_log.h"
 #include "config.h"
 #include <cmath>
@@ -17,23 +24,19 @@ static constexpr int S_STONE = 1;
 static constexpr int S_GRASS = 8;
 static constexpr int S_DIRT  = 10;
 static constexpr int S_SAND  = 118;
+static constexpr int S_IRON  = 131;
+static constexpr int S_COAL  = 133;
 static constexpr int S_WATER = 86;
 static constexpr int S_LOG   = 137;
 static constexpr int S_LEAF  = 254;
 static constexpr int S_TALLGRASS = 2048;
 
-static constexpr int PI_AIR   = 0;
-static constexpr int PI_STONE = 1;
-static constexpr int PI_DIRT  = 2;
-static constexpr int PI_GRASS = 3;
-static constexpr int PI_WATER = 4;
-static constexpr int PI_LOG   = 5;
-static constexpr int PI_LEAF  = 6;
-static constexpr int PI_TALLGRASS = 7;
-static constexpr int PI_SAND  = 8;
-
-static const int PALETTE[] = { S_AIR, S_STONE, S_DIRT, S_GRASS, S_WATER, S_LOG, S_LEAF, S_TALLGRASS, S_SAND };
-static constexpr int PALETTE_SIZE = 9;
+static const int PALETTE[PI_COUNT] = {
+    S_AIR, S_STONE, S_DIRT, S_GRASS, S_WATER, S_LOG, S_LEAF, S_TALLGRASS, S_SAND, S_COAL, S_IRON,
+    S_WATER + 1, S_WATER + 2, S_WATER + 3, S_WATER + 4, S_WATER + 5, S_WATER + 6, S_WATER + 7, S_WATER + 8
+};
+// Generated terrain only uses the first PALETTE_SIZE entries
+static constexpr int PALETTE_SIZE = 11;
 
 // 0=ocean, 1=plains, 2=mountains
 static int biome_at(int bx, int bz) {
@@ -117,6 +120,13 @@ static int find_trees(int cx, int cz, TreeInfo* trees, int max_trees) {
     return count;
 }
 
+// Block at the top of a column of the given biome and terrain height
+static int top_block(int biome, int terrain_h) {
+    if (terrain_h >= SEA_LEVEL && terrain_h <= SEA_LEVEL + 2) return PI_SAND;
+    if (biome == 2 && terrain_h > -38) return PI_STONE;
+    return (terrain_h >= SEA_LEVEL) ? PI_GRASS : PI_DIRT;
+}
+
 static int get_block(int wx, int wy, int wz, int terrain_h, TreeInfo* trees, int tcnt) {
     for (int t = 0; t < tcnt; t++) {
         int pi = get_tree_pi(wx - trees[t].bx, wy - (trees[t].ground + 1), wz - trees[t].bz);
@@ -129,18 +139,162 @@ static int get_block(int wx, int wy, int wz, int terrain_h, TreeInfo* trees, int
         if (wy <= SEA_LEVEL && terrain_h < SEA_LEVEL) return PI_WATER;
         return PI_AIR;
     }
-    int biome = biome_at(wx, wz);
     bool beach = (terrain_h >= SEA_LEVEL && terrain_h <= SEA_LEVEL + 2);
-    if (wy == terrain_h) {
-        if (beach) return PI_SAND;
-        if (biome == 2 && terrain_h > -38) return PI_STONE;
-        return (terrain_h >= SEA_LEVEL) ? PI_GRASS : PI_DIRT;
-    }
+    if (wy == terrain_h) return top_block(biome_at(wx, wz), terrain_h);
     if (beach && wy > terrain_h - 4) return PI_SAND;
     if (wy > terrain_h - 4) return PI_DIRT;
     return PI_STONE;
 }
 
+// ---- Caves and ores ----
+//
+// Density is sampled on a lattice of 4 x 8 x 4 block cells and
+// interpolated in between with integer weights, so a section and a single
+// block looked up on its own carve the same. Stone where the cave density
+// is above zero becomes air; where the ore density is, one block in eight
+// becomes ore. Only stone at least one block under the dirt of its own
+// column and of the four around it is carved, so caves stay sealed and the
+// generated sky light holds.
+
+static constexpr int CELL_W = 4, CELL_H = 8;
+static constexpr int LAT_W = 16 / CELL_W + 1, LAT_H = 16 / CELL_H + 1;
+static constexpr int COVER = 5;     // blocks from the surface down to the first carved one
+static bool caves_on = true;
+
+void gen_set_caves(bool on) { caves_on = on; }
+
+struct Density { int16_t cave, ore; };
+
+static Density density_at(int x, int y, int z) {
+    float fx = static_cast<float>(x), fy = static_cast<float>(y), fz = static_cast<float>(z);
+    // Tunnels run where two smooth fields are both near zero
+    float a = sinf(fx * 0.071f + fy * 0.033f) * cosf(fz * 0.083f - fy * 0.027f)
+            + sinf(fx * 0.029f - fz * 0.037f + fy * 0.109f) * 0.5f;
+    float b = cosf(fx * 0.053f - fz * 0.077f) * sinf(fy * 0.127f + fz * 0.047f)
+            + cosf(fx * 0.097f + fz * 0.023f - fy * 0.061f) * 0.5f;
+    float ore = sinf(fx * 0.19f + fz * 0.13f) * cosf(fy * 0.23f - fz * 0.17f) - 0.5f;
+    return {static_cast<int16_t>((0.1f - (a * a + b * b)) * 1024.0f), static_cast<int16_t>(ore * 1024.0f)};
+}
+
+// Interpolated value in a cell from its corners c[dx + dz*2 + dy*4]; the
+// sign is what matters, the scale is CELL_W * CELL_W * CELL_H
+static int interpolate(const int c[8], int lx, int ly, int lz) {
+    int v = 0;
+    for (int k = 0; k < 8; k++) {
+        int wx = k & 1 ? lx : CELL_W - lx;
+        int wz = k & 2 ? lz : CELL_W - lz;
+        int wy = k & 4 ? ly : CELL_H - ly;
+        v += c[k] * wx * wz * wy;
+    }
+    return v;
+}
+
+static uint8_t ore_at(int x, int y, int z) {
+    uint32_t h = hash_pos(x + y * 7919, z - y * 104729);
+    if (h & 7) return PI_STONE;
+    return (h >> 3) % 3 ? PI_COAL : PI_IRON;
+}
+
+// Lowest surface of a column and the four around it
+static int cover_height(int x, int z, int h) {
+    static const int D[4][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+    for (const auto& d : D) {
+        int n = terrain_height(x + d[0], z + d[1]);
+        if (n < h) h = n;
+    }
+    return h;
+}
+
+// Carves the generated stone of section si; returns the blocks removed
+static int carve_section(uint8_t* pis, int cx, int cz, int si, int heights[16][16]) {
+    int base_y = si * 16 + MIN_Y;
+    int top = MIN_Y;
+    for (int z = 0; z < 16; z++)
+        for (int x = 0; x < 16; x++)
+            if (heights[x][z] > top) top = heights[x][z];
+    // Open: no stone deep enough in the section
+    if (base_y > top - COVER) return 0;
+
+    int cave[LAT_H][LAT_W][LAT_W], ore[LAT_H][LAT_W][LAT_W];
+    int cave_max = -32768, ore_max = -32768;
+    for (int j = 0; j < LAT_H; j++)
+        for (int k = 0; k < LAT_W; k++)
+            for (int i = 0; i < LAT_W; i++) {
+                Density d = density_at(cx * 16 + i * CELL_W, base_y + j * CELL_H, cz * 16 + k * CELL_W);
+                cave[j][k][i] = d.cave;
+                ore[j][k][i] = d.ore;
+                if (d.cave > cave_max) cave_max = d.cave;
+                if (d.ore > ore_max) ore_max = d.ore;
+            }
+    // Solid: no cave or ore reaches into the section
+    if (cave_max <= 0 && ore_max <= 0) return 0;
+
+    // Heights with a ring of the neighbouring chunks' columns around them
+    int ring[18][18];
+    for (int z = -1; z <= 16; z++)
+        for (int x = -1; x <= 16; x++) {
+            bool inside = x >= 0 && x < 16 && z >= 0 && z < 16;
+            bool corner = (x < 0 || x > 15) && (z < 0 || z > 15);
+            if (!corner) ring[x + 1][z + 1] = inside ? heights[x][z] : terrain_height(cx * 16 + x, cz * 16 + z);
+        }
+    int floor_h[16][16];
+    for (int z = 0; z < 16; z++)
+        for (int x = 0; x < 16; x++) {
+            int h = ring[x + 1][z + 1];
+            if (ring[x][z + 1] < h) h = ring[x][z + 1];
+            if (ring[x + 2][z + 1] < h) h = ring[x + 2][z + 1];
+            if (ring[x + 1][z] < h) h = ring[x + 1][z];
+            if (ring[x + 1][z + 2] < h) h = ring[x + 1][z + 2];
+            floor_h[x][z] = h - COVER;
+        }
+
+    int removed = 0;
+    for (int cy = 0; cy < LAT_H - 1; cy++)
+        for (int ck = 0; ck < LAT_W - 1; ck++)
+            for (int ci = 0; ci < LAT_W - 1; ci++) {
+                int c[8], o[8];
+                int c_min = 32767, c_max = -32768, o_max = -32768;
+                for (int k = 0; k < 8; k++) {
+                    c[k] = cave[cy + (k >> 2)][ck + (k >> 1 & 1)][ci + (k & 1)];
+                    o[k] = ore[cy + (k >> 2)][ck + (k >> 1 & 1)][ci + (k & 1)];
+                    if (c[k] < c_min) c_min = c[k];
+                    if (c[k] > c_max) c_max = c[k];
+                    if (o[k] > o_max) o_max = o[k];
+                }
+                if (c_max <= 0 && o_max <= 0) continue;
+                for (int ly = 0; ly < CELL_H; ly++)
+                    for (int lz = 0; lz < CELL_W; lz++)
+                        for (int lx = 0; lx < CELL_W; lx++) {
+                            int x = ci * CELL_W + lx, y = cy * CELL_H + ly, z = ck * CELL_W + lz;
+                            int idx = x + z * 16 + y * 256, wy = base_y + y;
+                            if (pis[idx] != PI_STONE || wy > floor_h[x][z] || wy == MIN_Y) continue;
+                            // Every corner above zero opens the whole cell
+                            if (c_min > 0 || (c_max > 0 && interpolate(c, lx, ly, lz) > 0)) {
+                                pis[idx] = PI_AIR;
+                                removed++;
+                            } else if (o_max > 0 && interpolate(o, lx, ly, lz) > 0) {
+                                pis[idx] = ore_at(cx * 16 + x, wy, cz * 16 + z);
+                            }
+                        }
+            }
+    return removed;
+}
+
+// The cave stage for one generated block, as carve_section does it
+static int carve_block(int x, int y, int z, int terrain_h, int pi) {
+    if (!caves_on || pi != PI_STONE || y == MIN_Y || y > cover_height(x, z, terrain_h) - COVER) return pi;
+    int x0 = x & ~(CELL_W - 1), z0 = z & ~(CELL_W - 1), y0 = MIN_Y + ((y - MIN_Y) & ~(CELL_H - 1));
+    int c[8], o[8];
+    for (int k = 0; k < 8; k++) {
+        Density d = density_at(x0 + (k & 1) * CELL_W, y0 + (k >> 2) * CELL_H, z0 + (k >> 1 & 1) * CELL_W);
+        c[k] = d.cave;
+        o[k] = d.ore;
+    }
+    if (interpolate(c, x - x0, y - y0, z - z0) > 0) return PI_AIR;
+    if (interpolate(o, x - x0, y - y0, z - z0) > 0) return ore_at(x, y, z);
+    return pi;
+}
+
 static void write_air_section(PacketBuf& buf) {
     pkt_write_i16(buf, 0);
     pkt_write_byte(buf, 0);
@@ -151,8 +305,22 @@ static void write_air_section(PacketBuf& buf) {
     pkt_write_varint(buf, 0);
 }
 
-static void write_section(PacketBuf& buf, int cx, int cz, int si,
-                           int heights[16][16], TreeInfo* trees, int tcnt) {
+// A section of stone throughout: a single-value palette and no data
+static void write_stone_section(PacketBuf& buf) {
+    pkt_write_i16(buf, 4096);
+    pkt_write_byte(buf, 0);
+    pkt_write_varint(buf, S_STONE);
+    pkt_write_varint(buf, 0);
+    pkt_write_byte(buf, 0);
+    pkt_write_varint(buf, 0);
+    pkt_write_varint(buf, 0);
+}
+
+// Palette index of every block in section si, at x + z*16 + y*256.
+// Returns the non-air count; 0 without filling pis when the section lies
+// wholly above the terrain and trees.
+static int gen_section(uint8_t* pis, int cx, int cz, int si,
+                       int heights[16][16], TreeInfo* trees, int tcnt) {
     int base_y = si * 16 + MIN_Y;
 
     int max_h = -999;
@@ -167,61 +335,87 @@ static void write_section(PacketBuf& buf, int cx, int cz, int si,
         if (top > max_h) max_h = top;
     }
 
-    if (base_y > max_h + 1) { write_air_section(buf); return; }
+    if (base_y > max_h + 1) return 0;
 
     int block_count = 0;
-    int64_t longs[256];
-    memset(longs, 0, sizeof(longs));
-
     for (int y = 0; y < 16; y++)
         for (int z = 0; z < 16; z++)
             for (int x = 0; x < 16; x++) {
                 int wx = cx * 16 + x, wy = base_y + y, wz = cz * 16 + z;
                 int pi = get_block(wx, wy, wz, heights[x][z], trees, tcnt);
                 if (pi != PI_AIR) block_count++;
-                int idx = x + z * 16 + y * 256;
-                longs[idx / 16] |= (static_cast<int64_t>(pi) & 0xF) << ((idx % 16) * 4);
+                pis[x + z * 16 + y * 256] = static_cast<uint8_t>(pi);
             }
+    if (caves_on) block_count -= carve_section(pis, cx, cz, si, heights);
+    return block_count;
+}
 
+static void write_section(PacketBuf& buf, const uint8_t* pis, int block_count) {
     if (block_count == 0) { write_air_section(buf); return; }
 
+    uint8_t top = 0;
+    for (int idx = 0; idx < 4096; idx++) top = pis[idx] > top ? pis[idx] : top;
+    // 4 bits cover the generated blocks; flowing water needs the full
+    // palette at 5 bits, 12 entries to a long
+    bool full = top >= PALETTE_SIZE;
+    int bits = full ? 5 : 4;
+    int per_long = 64 / bits;
+    int num_longs = (4096 + per_long - 1) / per_long;
+    int palette_size = full ? PI_COUNT : PALETTE_SIZE;
+
+    int64_t longs[342];
+    memset(longs, 0, sizeof(longs));
+    for (int idx = 0; idx < 4096; idx++)
+        longs[idx / per_long] |= static_cast<int64_t>(pis[idx]) << ((idx % per_long) * bits);
+
     pkt_write_i16(buf, static_cast<int16_t>(block_count));
-    pkt_write_byte(buf, 4);
-    pkt_write_varint(buf, PALETTE_SIZE);
-    for (int i = 0; i < PALETTE_SIZE; i++) pkt_write_varint(buf, PALETTE[i]);
-    pkt_write_varint(buf, 256);
-    for (int i = 0; i < 256; i++) pkt_write_i64(buf, longs[i]);
+    pkt_write_byte(buf, static_cast<uint8_t>(bits));
+    pkt_write_varint(buf, palette_size);
+    for (int i = 0; i < palette_size; i++) pkt_write_varint(buf, PALETTE[i]);
+    pkt_write_varint(buf, num_longs);
+    for (int i = 0; i < num_longs; i++) pkt_write_i64(buf, longs[i]);
 
     pkt_write_byte(buf, 0);
     pkt_write_varint(buf, 0);
     pkt_write_varint(buf, 0);
 }
 
-static void compute_sky_light(uint8_t* light, int cx, int cz, int si,
-                               int sky_h[16][16]) {
-    int base_y = si * 16 + MIN_Y;
-    memset(light, 0, 2048);
-    for (int y = 0; y < 16; y++)
-        for (int z = 0; z < 16; z++)
-            for (int x = 0; x < 16; x++) {
-                int wy = base_y + y;
-                int sky = (wy > sky_h[x][z]) ? 15 : 0;
-                int idx = x + z * 16 + y * 256;
-                if (idx & 1) light[idx / 2] |= (sky << 4);
-                else         light[idx / 2] |= sky;
-            }
+// Tall grass has no collision box, so it counts as empty
+static constexpr uint8_t OCC_OF[PI_COUNT] = {
+    OCC_EMPTY, OCC_SOLID, OCC_SOLID, OCC_SOLID, OCC_FLUID, OCC_SOLID, OCC_SOLID, OCC_EMPTY, OCC_SOLID, OCC_SOLID,
+    OCC_SOLID, OCC_FLUID, OCC_FLUID, OCC_FLUID, OCC_FLUID, OCC_FLUID, OCC_FLUID, OCC_FLUID, OCC_FLUID
+};
+
+BlockOcc block_occ(uint8_t pi) { return static_cast<BlockOcc>(OCC_OF[pi]); }
+int block_state(uint8_t pi) { return PALETTE[pi]; }
+
+void mask_section(SectionMask& m, const uint8_t* pis) {
+    for (int w = 0; w < 64; w++) {
+        uint64_t solid = 0, fluid = 0;
+        for (int b = 0; b < 64; b++) {
+            uint8_t occ = OCC_OF[pis[w * 64 + b]];
+            solid |= static_cast<uint64_t>(occ == OCC_SOLID) << b;
+            fluid |= static_cast<uint64_t>(occ == OCC_FLUID) << b;
+        }
+        m.solid[w] = solid;
+        m.fluid[w] = fluid;
+    }
 }
 
-void send_chunk(int sock, PacketBuf& out, PacketBuf& scratch, int cx, int cz) {
-    int heights[16][16];
+static void fill_section(WorldColumn& col, int si, const uint8_t* pis, int block_count) {
+    if (block_count == 0) { world_set_section(col, si, nullptr); return; }
+    SectionMask m;
+    mask_section(m, pis);
+    world_set_section(col, si, &m);
+}
+
+static void column_heights(int cx, int cz, int heights[16][16]) {
     for (int z = 0; z < 16; z++)
         for (int x = 0; x < 16; x++)
             heights[x][z] = terrain_height(cx * 16 + x, cz * 16 + z);
+}
 
-    TreeInfo trees[32];
-    int tcnt = find_trees(cx, cz, trees, 32);
-
-    int sky_h[16][16];
+static void sky_heights(int cx, int cz, int heights[16][16], TreeInfo* trees, int tcnt, int sky_h[16][16]) {
     for (int z = 0; z < 16; z++)
         for (int x = 0; x < 16; x++) {
             int h = heights[x][z];
@@ -237,19 +431,197 @@ void send_chunk(int sock, PacketBuf& out, PacketBuf& scratch, int cx, int cz) {
             }
             sky_h[x][z] = h;
         }
+}
+
+static void compute_sky_light(uint8_t* light, int cx, int cz, int si,
+                               int sky_h[16][16]) {
+    int base_y = si * 16 + MIN_Y;
+    memset(light, 0, 2048);
+    for (int y = 0; y < 16; y++)
+        for (int z = 0; z < 16; z++)
+            for (int x = 0; x < 16; x++) {
+                int wy = base_y + y;
+                int sky = (wy > sky_h[x][z]) ? 15 : 0;
+                int idx = x + z * 16 + y * 256;
+                if (idx & 1) light[idx / 2] |= (sky << 4);
+                else         light[idx / 2] |= sky;
+            }
+}
+
+// What write_air_section writes, for every section of a column
+static constexpr int AIR_SECTION_BYTES = 8;
+static const uint8_t AIR_SECTIONS[NUM_SECTIONS * AIR_SECTION_BYTES] = {};
+
+// A length-prefixed sky light array at full light
+struct FullSky {
+    uint8_t bytes[2 + 2048];
+    constexpr FullSky() : bytes{0x80, 0x10} {
+        for (int i = 2; i < 2 + 2048; i++) bytes[i] = 0xFF;
+    }
+};
+static constexpr FullSky FULL_SKY;
+
+// Writes a varint at a two-byte slot reserved at `at`, moving what follows
+// when it needs another width. A failed grow leaves out failed, unsent.
+static void set_size(PacketBuf& out, size_t at, size_t size) {
+    uint8_t v[5];
+    int n = mc_write_varint(v, static_cast<int32_t>(size));
+    if (n != 2) {
+        if (n > 2 && !out.ensure(n - 2)) return;
+        size_t tail = out.len - at - 2;
+        memmove(out.data + at + n, out.data + at + 2, tail);
+        metrics_copied(tail);
+        out.len = out.len + n - 2;
+    }
+    memcpy(out.data + at, v, n);
+}
+
+void build_chunk(PacketBuf& out, int cx, int cz, bool cache) {
+    trace(TRACE_CHUNK_BEGIN, 0, cx, cz);
+    // Builds off the simulation task (cache=false) leave the stage timers alone
+    // A baked column brings its blocks and sky heights from the world image
+    const uint8_t* baked = bake_column(cx, cz);
+    TreeInfo trees[32];
+    int tcnt = 0;
+    if (!baked) {
+        MC_STAGE(cache ? STAGE_TREES : STAGE_NONE);
+        tcnt = find_trees(cx, cz, trees, 32);
+    }
+
+    int heights[16][16];
+    int sky_h[16][16];
+    int64_t hm_longs[37];
+    {
+        MC_STAGE(cache ? STAGE_HEIGHTMAP : STAGE_NONE);
+        if (baked) {
+            bake_sky_heights(baked, sky_h);
+        } else {
+            column_heights(cx, cz, heights);
+            sky_heights(cx, cz, heights, trees, tcnt, sky_h);
+        }
 
-    scratch.reset();
+        memset(hm_longs, 0, sizeof(hm_longs));
+        for (int z = 0; z < 16; z++)
+            for (int x = 0; x < 16; x++) {
+                int col = x + z * 16;
+                int val = sky_h[x][z] - MIN_Y + 1;
+                if (val < 0) val = 0;
+                hm_longs[col / 7] |= (static_cast<int64_t>(val) & 0x1FF) << ((col % 7) * 9);
+            }
+    }
+
+    out.reset();
+    pkt_write_varint(out, 0x28);
+    pkt_write_i32(out, cx);
+    pkt_write_i32(out, cz);
+    nbt_begin(out);
+    nbt_long_array(out, "MOTION_BLOCKING", hm_longs, 37);
+    nbt_end(out);
+
+    // Sections go straight into out behind a size of the usual two bytes;
+    // the air sections above the terrain are referenced, not written
+    size_t size_at = out.len;
+    int air_run = 0;
+    {
+        MC_STAGE(cache ? STAGE_SECTIONS : STAGE_NONE);
+        pkt_write_u16(out, 0);
+        // Occupancy masks come from the same pass when the column is not cached
+        WorldColumn* col = cache ? world_claim(cx, cz) : nullptr;
+        uint8_t pis[4096];
+        for (int s = 0; s < NUM_SECTIONS; s++) {
+            int n = baked ? bake_section(baked, s, pis) : gen_section(pis, cx, cz, s, heights, trees, tcnt);
+            // Other nodes get the generated terrain; block edits live on the sim task
+            if (cache) n = tick_apply_edits(cx, cz, s, pis, n);
+            if (col) fill_section(*col, s, pis, n);
+            if (n == 0) {
+                air_run++;
+                continue;
+            }
+            for (; air_run > 0; air_run--) write_air_section(out);
+            write_section(out, pis, n);
+        }
+    }
+    set_size(out, size_at, out.len - size_at - 2 + air_run * AIR_SECTION_BYTES);
+    if (air_run) out.append_ref(AIR_SECTIONS, air_run * AIR_SECTION_BYTES);
+    pkt_write_varint(out, 0);
+
+    // Sky light: sections 0, 1, 2 (bits 1, 2, 3) as generated, plus any
+    // section relit since. Block light only where something relit it.
+    const uint8_t* sky[NUM_SECTIONS] = {};
+    const uint8_t* block[NUM_SECTIONS] = {};
+    int64_t sky_mask = 0x0E, block_mask = 0, empty_sky = 0x01;
+    if (cache)
+        for (int s = 0; s < NUM_SECTIONS; s++) {
+            if (!light_section(cx, cz, s, sky[s], block[s])) continue;
+            int64_t bit = 2LL << s;
+            if (light_nonzero(sky[s])) {
+                sky_mask |= bit;
+            } else {
+                sky_mask &= ~bit;
+                empty_sky |= bit;
+            }
+            if (block[s] && light_nonzero(block[s])) block_mask |= bit;
+        }
+    pkt_write_varint(out, 1);
+    pkt_write_i64(out, sky_mask);
+    if (block_mask) {
+        pkt_write_varint(out, 1);
+        pkt_write_i64(out, block_mask);
+    } else {
+        pkt_write_varint(out, 0);
+    }
+    pkt_write_varint(out, 1);
+    pkt_write_i64(out, empty_sky);
+    // Empty block light: every other section of the 26
+    pkt_write_varint(out, 1);
+    pkt_write_i64(out, 0x03FFFFFFLL & ~block_mask);
+
+    {
+        MC_STAGE(cache ? STAGE_SKYLIGHT : STAGE_NONE);
+        pkt_write_varint(out, __builtin_popcountll(sky_mask));
+        for (int s = 0; s < NUM_SECTIONS; s++) {
+            if (!(sky_mask & (2LL << s))) continue;
+            if (sky[s]) {
+                // Relit arrays keep changing after this packet is queued
+                pkt_write_varint(out, 2048);
+                out.append(sky[s], 2048);
+            } else if (s < 2) {
+                pkt_write_varint(out, 2048);
+                if (!out.ensure(2048)) break;   // out failed; it will not be sent
+                compute_sky_light(out.data + out.len, cx, cz, s, sky_h);
+                out.len += 2048;
+            } else {
+                // Section 2: all sky light 15
+                out.append_ref(FULL_SKY.bytes, sizeof(FULL_SKY.bytes));
+            }
+        }
+    }
+
+    pkt_write_varint(out, __builtin_popcountll(block_mask));
     for (int s = 0; s < NUM_SECTIONS; s++)
-        write_section(scratch, cx, cz, s, heights, trees, tcnt);
+        if (block_mask & (2LL << s)) {
+            pkt_write_varint(out, 2048);
+            out.append(block[s], 2048);
+        }
+    trace(TRACE_CHUNK_END, 0, cx, cz);
+}
 
+void build_lod_chunk(PacketBuf& out, int cx, int cz) {
+    int heights[16][16];
+    uint8_t top[256];
     int64_t hm_longs[37];
+    column_heights(cx, cz, heights);
+    int min_h = MIN_Y + NUM_SECTIONS * 16, max_h = MIN_Y;
     memset(hm_longs, 0, sizeof(hm_longs));
     for (int z = 0; z < 16; z++)
         for (int x = 0; x < 16; x++) {
+            int h = heights[x][z];
             int col = x + z * 16;
-            int val = sky_h[x][z] - MIN_Y + 1;
-            if (val < 0) val = 0;
-            hm_longs[col / 7] |= (static_cast<int64_t>(val) & 0x1FF) << ((col % 7) * 9);
+            top[col] = static_cast<uint8_t>(top_block(biome_at(cx * 16 + x, cz * 16 + z), h));
+            if (h < min_h) min_h = h;
+            int surface = h < SEA_LEVEL ? SEA_LEVEL : h;
+            if (surface > max_h) max_h = surface;
+            hm_longs[col / 7] |= (static_cast<int64_t>(surface - MIN_Y + 1) & 0x1FF) << ((col % 7) * 9);
         }
 
     out.reset();
@@ -259,38 +631,138 @@ void send_chunk(int sock, PacketBuf& out, PacketBuf& scratch, int cx, int cz) {
     nbt_begin(out);
     nbt_long_array(out, "MOTION_BLOCKING", hm_longs, 37);
     nbt_end(out);
-    pkt_write_varint(out, static_cast<int32_t>(scratch.len));
-    out.append(scratch.data, scratch.len);
+
+    // Stone below the lowest surface block, one palette section per
+    // section the surface crosses, air above
+    size_t size_at = out.len;
+    pkt_write_u16(out, 0);
+    int air_run = 0;
+    uint8_t pis[4096];
+    for (int s = 0; s < NUM_SECTIONS; s++) {
+        int base_y = s * 16 + MIN_Y;
+        if (base_y > max_h) {
+            air_run++;
+            continue;
+        }
+        if (base_y + 15 < min_h) {
+            write_stone_section(out);
+            continue;
+        }
+        int n = 0;
+        for (int y = 0; y < 16; y++)
+            for (int col = 0; col < 256; col++) {
+                int wy = base_y + y, h = heights[col & 15][col >> 4];
+                int pi = wy < h ? PI_STONE : wy == h ? static_cast<int>(top[col]) : wy <= SEA_LEVEL ? PI_WATER : PI_AIR;
+                n += pi != PI_AIR;
+                pis[col + y * 256] = static_cast<uint8_t>(pi);
+            }
+        write_section(out, pis, n);
+    }
+    set_size(out, size_at, out.len - size_at - 2 + air_run * AIR_SECTION_BYTES);
+    if (air_run) out.append_ref(AIR_SECTIONS, air_run * AIR_SECTION_BYTES);
     pkt_write_varint(out, 0);
 
-    // Sky light: sections 0, 1, 2 (bits 1, 2, 3)
+    // No light arrays: sections without any read as full sky, as those
+    // above section 2 of a full chunk do. No block light anywhere.
     pkt_write_varint(out, 1);
-    pkt_write_i64(out, 0x0ELL);
-    // Block light: none
+    pkt_write_i64(out, 0);
     pkt_write_varint(out, 0);
-    // Empty sky light: section -1 (bit 0)
     pkt_write_varint(out, 1);
-    pkt_write_i64(out, 0x01LL);
-    // Empty block light: all 26 sections
+    pkt_write_i64(out, 0x01);
     pkt_write_varint(out, 1);
     pkt_write_i64(out, 0x03FFFFFFLL);
+    pkt_write_varint(out, 0);
+    pkt_write_varint(out, 0);
+}
 
-    // Sky light arrays (3 sections)
-    pkt_write_varint(out, 3);
-    uint8_t light[2048];
-    for (int s = 0; s < 2; s++) {
-        compute_sky_light(light, cx, cz, s, sky_h);
-        pkt_write_varint(out, 2048);
-        out.append(light, 2048);
+void build_chunk_masks(int cx, int cz) {
+    WorldColumn* col = world_claim(cx, cz);
+    if (!col) return;
+    const uint8_t* baked = bake_column(cx, cz);
+    TreeInfo trees[32];
+    int tcnt = baked ? 0 : find_trees(cx, cz, trees, 32);
+    int heights[16][16];
+    if (!baked) column_heights(cx, cz, heights);
+    uint8_t pis[4096];
+    for (int s = 0; s < NUM_SECTIONS; s++) {
+        int n = baked ? bake_section(baked, s, pis) : gen_section(pis, cx, cz, s, heights, trees, tcnt);
+        fill_section(*col, s, pis, tick_apply_edits(cx, cz, s, pis, n));
     }
-    // Section 2: all sky light 15
-    memset(light, 0xFF, 2048);
-    pkt_write_varint(out, 2048);
-    out.append(light, 2048);
+}
 
-    // Block light arrays: none
-    pkt_write_varint(out, 0);
+int gen_section_at(uint8_t* pis, int cx, int cz, int si) {
+    int n;
+    if (const uint8_t* baked = bake_column(cx, cz)) {
+        n = bake_section(baked, si, pis);
+    } else {
+        TreeInfo trees[32];
+        int tcnt = find_trees(cx, cz, trees, 32);
+        int heights[16][16];
+        column_heights(cx, cz, heights);
+        n = gen_section(pis, cx, cz, si, heights, trees, tcnt);
+    }
+    if (n == 0) memset(pis, PI_AIR, 4096);
+    return n;
+}
+
+void gen_sky_heights(int cx, int cz, int sky_h[16][16]) {
+    if (const uint8_t* baked = bake_column(cx, cz)) {
+        bake_sky_heights(baked, sky_h);
+        return;
+    }
+    TreeInfo trees[32];
+    int tcnt = find_trees(cx, cz, trees, 32);
+    int heights[16][16];
+    column_heights(cx, cz, heights);
+    sky_heights(cx, cz, heights, trees, tcnt, sky_h);
+}
+
+void surface_sections(int cx, int cz, int& lo, int& hi) {
+    int min_h = WORLD_MIN_Y + WORLD_SECTIONS * 16, max_h = WORLD_MIN_Y;
+    for (int z = 0; z < 16; z++)
+        for (int x = 0; x < 16; x++) {
+            int h = terrain_height(cx * 16 + x, cz * 16 + z);
+            if (h < min_h) min_h = h;
+            if (h > max_h) max_h = h;
+        }
+    lo = (min_h - MIN_Y) >> 4;
+    hi = (max_h - MIN_Y) >> 4;
+}
+
+void sky_light_section(uint8_t* light, int cx, int cz, int si) {
+    if (si >= 2) {
+        memset(light, 0xFF, 2048);
+        return;
+    }
+    int sky_h[16][16];
+    gen_sky_heights(cx, cz, sky_h);
+    compute_sky_light(light, cx, cz, si, sky_h);
+}
 
+BlockOcc gen_block_occ(int x, int y, int z) {
+    if (y < MIN_Y || y >= MIN_Y + NUM_SECTIONS * 16) return OCC_EMPTY;
+    TreeInfo trees[32];
+    int tcnt = find_trees(x >> 4, z >> 4, trees, 32);
+    int h = terrain_height(x, z);
+    return static_cast<BlockOcc>(OCC_OF[carve_block(x, y, z, h, get_block(x, y, z, h, trees, tcnt))]);
+}
+
+bool load_chunk(PacketBuf& out, int cx, int cz) {
+    ShardChunk from = shard_chunk(cx, cz, out);
+    if (from == SHARD_CHUNK_WAIT) return false;
+    if (from == SHARD_CHUNK_LOCAL) build_chunk(out, cx, cz);
+    return true;
+}
+
+bool send_chunk(int sock, PacketBuf& out, int cx, int cz) {
+    if (!load_chunk(out, cx, cz)) return false;
+    MC_STAGE(STAGE_SEND);
+    out.send_packet(sock);
+    return true;
+}
+
+void send_lod_chunk(int sock, PacketBuf& out, int cx, int cz) {
+    build_lod_chunk(out, cx, cz);
     out.send_packet(sock);
 }
 
@@ -302,7 +774,31 @@ void send_center_chunk(int sock, PacketBuf& out, int cx, int cz) {
     out.send_packet(sock);
 }
 
-static void send_login(int sock, PacketBuf& out) {
+void send_unload_chunk(int sock, PacketBuf& out, int cx, int cz) {
+    out.reset();
+    pkt_write_varint(out, 0x22);
+    pkt_write_i32(out, cz);
+    pkt_write_i32(out, cx);
+    out.send_packet(sock);
+}
+
+void build_system_chat(PacketBuf& out, const char* text) {
+    out.reset();
+    pkt_write_varint(out, 0x73);
+    nbt_text(out, text);
+    pkt_write_bool(out, false);
+}
+
+void send_system_chat(int sock, PacketBuf& out, const char* text) {
+    build_system_chat(out, text);
+    out.send_packet(sock);
+}
+
+int spawn_height(int x, int z) {
+    return terrain_height(x, z) + 1;
+}
+
+static void send_login(int sock, PacketBuf& out, uint8_t game_mode) {
     out.reset();
     pkt_write_varint(out, 0x2C);
     pkt_write_i32(out, 1);
@@ -310,7 +806,9 @@ static void send_login(int sock, PacketBuf& out) {
     pkt_write_varint(out, 1);
     pkt_write_string(out, "minecraft:overworld");
     pkt_write_varint(out, MC_MAX_PLAYERS);
-    pkt_write_varint(out, MC_VIEW_DISTANCE);
+    // The client keeps chunks out to the view distance it is told, so tell
+    // it about the low-detail ring too
+    pkt_write_varint(out, VIEW_OUTER);
     pkt_write_varint(out, MC_SIM_DISTANCE);
     pkt_write_bool(out, false);
     pkt_write_bool(out, true);
@@ -318,7 +816,7 @@ static void send_login(int sock, PacketBuf& out) {
     pkt_write_varint(out, 0);
     pkt_write_string(out, "minecraft:overworld");
     pkt_write_i64(out, 0);
-    pkt_write_byte(out, 1);
+    pkt_write_byte(out, game_mode);
     pkt_write_byte(out, 0xFF);
     pkt_write_bool(out, false);
     pkt_write_bool(out, true);
@@ -338,21 +836,12 @@ static void send_game_event(int sock, PacketBuf& out) {
     out.send_packet(sock);
 }
 
-void send_play_packets(int sock, PacketBuf& out) {
-    send_login(sock, out);
-    send_game_event(sock, out);
-    send_center_chunk(sock, out, 0, 0);
+void send_play_packets(int sock, PacketBuf& out, const PlayerPose& pose) {
+    send_login(sock, out, pose.game_mode);
 
-    PacketBuf scratch;
-    scratch.init(8192);
-    int vd = MC_VIEW_DISTANCE;
-    for (int cx = -vd; cx <= vd; cx++)
-        for (int cz = -vd; cz <= vd; cz++)
-            send_chunk(sock, out, scratch, cx, cz);
-    scratch.free();
-    ESP_LOGI(TAG, "Sent %d chunks", (2 * vd + 1) * (2 * vd + 1));
-
-    int spawn_y = terrain_height(0, 0) + 1;
+    // Position straight after Login so the client places the player while
+    // the spawn chunks are still arriving
+    int spawn_y = spawn_height(0, 0);
 
     out.reset();
     pkt_write_varint(out, 0x5B);
@@ -363,15 +852,18 @@ void send_play_packets(int sock, PacketBuf& out) {
     out.reset();
     pkt_write_varint(out, 0x42);
     pkt_write_varint(out, 1);
-    pkt_write_f64(out, 0.5);
-    pkt_write_f64(out, static_cast<double>(spawn_y));
-    pkt_write_f64(out, 0.5);
+    pkt_write_f64(out, pose.x);
+    pkt_write_f64(out, pose.y);
+    pkt_write_f64(out, pose.z);
     pkt_write_f64(out, 0.0);
     pkt_write_f64(out, 0.0);
     pkt_write_f64(out, 0.0);
-    pkt_write_f32(out, 0.0f);
-    pkt_write_f32(out, 0.0f);
+    pkt_write_f32(out, pose.yaw);
+    pkt_write_f32(out, pose.pitch);
     pkt_write_i32(out, 0);
     out.send_packet(sock);
-    ESP_LOGI(TAG, "Sent spawn at Y=%d", spawn_y);
+    ESP_LOGI(TAG, "Sent position %.1f %.1f %.1f", pose.x, pose.y, pose.z);
+
+    send_game_event(sock, out);
+    send_center_chunk(sock, out, static_cast<int>(floor(pose.x)) >> 4, static_cast<int>(floor(pose.z)) >> 4);
 }
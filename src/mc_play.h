@@ -1,7 +1,62 @@
 #pragma once
 
 #include "mc_packet.h"
+#include "mc_view.h"
+#include "mc_world.h"
+#include "mc_store.h"
 
-void send_play_packets(int sock, PacketBuf& out);
-void send_chunk(int sock, PacketBuf& out, PacketBuf& scratch, int cx, int cz);
+// Palette indices of the blocks the world is made of; section arrays and
+// the chunk palette both use them. Flowing and falling water only appear
+// once the tick engine has moved water around.
+enum BlockPi : uint8_t {
+    PI_AIR, PI_STONE, PI_DIRT, PI_GRASS, PI_WATER, PI_LOG, PI_LEAF, PI_TALLGRASS, PI_SAND, PI_COAL, PI_IRON,
+    PI_FLOW,                    // flowing water level 1; level n is PI_FLOW + n - 1, down to 7
+    PI_FALLING = PI_FLOW + 7,   // level 8
+    PI_COUNT
+};
+
+// Login (Play), spawn position and the player's position and center chunk;
+// the chunks themselves follow from the connection's view
+void send_play_packets(int sock, PacketBuf& out, const PlayerPose& pose);
+// Feet height of a new player at block column (x, z)
+int spawn_height(int x, int z);
+// Writes a Chunk Data packet (id and payload) into out without sending it.
+// cache=false leaves the world cache alone, for builds off the sim task.
+void build_chunk(PacketBuf& out, int cx, int cz, bool cache = true);
+// Writes a low-detail Chunk Data packet for the ring beyond the view
+// distance: terrain from the heightmap and biomes only, stone below the
+// lowest surface block, no trees, tall grass or light arrays
+void build_lod_chunk(PacketBuf& out, int cx, int cz);
+// build_chunk, or the owning node's copy when another shard owns the chunk;
+// false while that copy is on its way, to be asked for again later
+bool load_chunk(PacketBuf& out, int cx, int cz);
+// Turns the cave and ore stage of the generator on or off (on by default),
+// for comparing generation speed
+void gen_set_caves(bool on);
+// Generates only the occupancy masks of a chunk into the world cache
+void build_chunk_masks(int cx, int cz);
+// Generated (or baked) blocks of section si (0 at the world floor) at
+// x + z*16 + y*256, air included; returns the non-air count
+int gen_section_at(uint8_t* pis, int cx, int cz, int si);
+// Highest block of each column that stops sky light, at [x][z], as
+// generated (or baked)
+void gen_sky_heights(int cx, int cz, int sky_h[16][16]);
+// Range of sections holding the terrain surface of a chunk
+void surface_sections(int cx, int cz, int& lo, int& hi);
+BlockOcc block_occ(uint8_t pi);
+// Occupancy masks of a section's blocks, given at x + z*16 + y*256
+void mask_section(SectionMask& m, const uint8_t* pis);
+// Protocol block state id of a palette index
+int block_state(uint8_t pi);
+// Sky light of section si as chunk data sends it before any block changes:
+// 2048 bytes of nibbles at x + z*16 + y*256
+void sky_light_section(uint8_t* light, int cx, int cz, int si);
+// One block straight from the generator, for checking the masks
+BlockOcc gen_block_occ(int x, int y, int z);
+// load_chunk and send; false if the chunk is not there yet
+bool send_chunk(int sock, PacketBuf& out, int cx, int cz);
+void send_lod_chunk(int sock, PacketBuf& out, int cx, int cz);
 void send_center_chunk(int sock, PacketBuf& out, int cx, int cz);
+void send_unload_chunk(int sock, PacketBuf& out, int cx, int cz);
+void build_system_chat(PacketBuf& out, const char* text);
+void send_system_chat(int sock, PacketBuf& out, const char* text);
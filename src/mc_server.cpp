@@ -0,0 +1,910 @@
+#include "mc_server.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_rom_sys.h"
+#include "lwip/sockets.h"
+#include "config.h"
+#include "mc_types.h"
+#include "mc_packet.h"
+#include "mc_registry.h"
+#include "mc_play.h"
+#include "mc_view.h"
+#include "mc_metrics.h"
+#include "mc_mem.h"
+#include "mc_capture.h"
+#include "mc_timer.h"
+#include "mc_shared.h"
+#include "mc_link.h"
+#include "mc_entity.h"
+#include "mc_store.h"
+#include "mc_shard.h"
+#include "mc_trace.h"
+#include "mc_tick.h"
+#include "mc_light.h"
+#include "mc_nav.h"
+#include "mc_bake.h"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+static const char* TAG = "mc_server";
+
+enum class ConnState { HANDSHAKE, STATUS, LOGIN, CONFIG, PLAY };
+
+// Timer ids as recorded in captures
+enum ConnTimer : uint8_t { CONN_TIMER_KEEPALIVE, CONN_TIMER_DEADLINE };
+
+// Latest movement input since the last game tick
+struct PendingMove {
+    double x, y, z;
+    float yaw;
+    bool moved;             // a position arrived
+    bool turned;            // a rotation arrived
+};
+
+// Simulation-side connection; the socket itself belongs to the network task
+struct Conn {
+    int sock;               // -1 when the slot is free
+    ConnState state;
+    PacketBuf out;
+    ChunkView view;
+    ViewPrep prep;          // spawn chunks built during login and configuration
+    Timer ka_timer;         // next keep-alive send
+    Timer deadline;         // state timeout, or the oldest unanswered keep-alive
+    int64_t ka_id;          // last keep-alive sent
+    EntityId entity;        // player entity while in play
+    PlayerRecord rec;       // persisted state, from Login Start on
+    PendingMove move;
+    int metrics_slot;
+    bool transferring;      // sent to another shard, waiting for the client to go
+    int transfer_to;        // node the handoff is queued for
+    uint32_t transfer_retry_ms;  // no new handoff before this, after one failed
+    bool claiming;          // waiting on the coordinator for a pose before Login Success
+    bool fetching;          // streaming waits on chunks from other nodes
+    char name[17];
+};
+
+static Conn conns[MC_MAX_CONNS];
+static PacketBuf scratch;
+static TimerWheel wheel;
+static EntityStore entities;
+static Timer store_timer;
+static Timer tick_timer;
+static TaskHandle_t sim_task = nullptr;
+static bool initialized = false;
+
+static uint32_t now_ms() {
+    return xTaskGetTickCount() * portTICK_PERIOD_MS;
+}
+
+// Hands every player's current state to the store and writes what changed
+static void on_store_timer(Timer& t, void*) {
+    for (auto& c : conns)
+        if (c.sock >= 0 && c.state == ConnState::PLAY) store_put(c.rec);
+    store_flush();
+    timer_schedule(wheel, t, now_ms() + MC_STORE_FLUSH_MS);
+}
+
+// Keeps the player here for now; the handoff is tried again after
+// MC_SHARD_RETRY_MS if they are still in another band
+static void handoff_failed(Conn& c, const char* why) {
+    ESP_LOGW(TAG, "Handoff of %s to node %d %s, retrying in %d ms", c.name, c.transfer_to, why, MC_SHARD_RETRY_MS);
+    c.transferring = false;
+    c.transfer_retry_ms = now_ms() + MC_SHARD_RETRY_MS;
+}
+
+// Queues leaving the player's pose with the coordinator; the client is
+// sent to node `to` once that is done (on_handoff)
+static void transfer(Conn& c, int to) {
+    c.transferring = true;
+    c.transfer_to = to;
+    if (!shard_handoff(static_cast<int>(&c - conns), c.rec)) handoff_failed(c, "not queued");
+}
+
+// Sends the client to the node its pose was left for. The client
+// reconnects there; this connection closes when it goes.
+static void on_handoff(Conn& c, bool ok) {
+    if (!ok) {
+        handoff_failed(c, "failed");
+        return;
+    }
+    const ShardNode& n = shard_node(c.transfer_to);
+    ESP_LOGI(TAG, "Transferring %s to node %d (%s:%u)", c.name, c.transfer_to, n.host, n.port);
+    c.out.reset();
+    pkt_write_varint(c.out, 0x7A);
+    pkt_write_string(c.out, n.host);
+    pkt_write_varint(c.out, n.port);
+    c.out.send_packet(c.sock);
+}
+
+// Applies the latest movement input: pose, player entity, chunk view and
+// shard handoff, once however many packets it came in
+static void apply_move(Conn& c) {
+    if (!c.move.moved && !c.move.turned) return;
+    if (c.move.turned) c.view.yaw = c.rec.pose.yaw = c.move.yaw;
+    int e = entity_index(entities, c.entity);
+    if (e >= 0) entities.yaw[e] = c.view.yaw;
+    if (c.move.moved) {
+        c.rec.pose.x = c.move.x;
+        c.rec.pose.y = c.move.y;
+        c.rec.pose.z = c.move.z;
+        if (e >= 0)
+            entity_move(entities, e, static_cast<float>(c.move.x), static_cast<float>(c.move.y),
+                        static_cast<float>(c.move.z));
+        int new_cx = static_cast<int>(floor(c.move.x)) >> 4;
+        int new_cz = static_cast<int>(floor(c.move.z)) >> 4;
+        view_move(c.sock, c.out, c.view, new_cx, new_cz);
+        if (!c.transferring && static_cast<int32_t>(now_ms() - c.transfer_retry_ms) >= 0) {
+            int to = shard_target(c.move.x);
+            if (to >= 0) transfer(c, to);
+        }
+    }
+    c.move.moved = c.move.turned = false;
+}
+
+// One game tick: movement input, then block ticks around every player in
+// play
+static void game_tick() {
+    MC_STAGE(STAGE_TICK);
+    {
+        MC_STAGE(STAGE_MOVE);
+        for (auto& c : conns)
+            if (c.sock >= 0 && c.state == ConnState::PLAY) {
+                mem_set_conn(static_cast<int>(&c - conns));
+                apply_move(c);
+                mem_set_conn(-1);
+            }
+    }
+    int centers[MC_MAX_CONNS][2];
+    int n = 0;
+    for (auto& c : conns)
+        if (c.sock >= 0 && c.state == ConnState::PLAY) {
+            centers[n][0] = c.view.center_cx;
+            centers[n][1] = c.view.center_cz;
+            n++;
+        }
+    tick_run(centers, n);
+    nav_tick();
+}
+
+static int players_online() {
+    int n = 0;
+    for (auto& c : conns)
+        if (c.sock >= 0 && c.state == ConnState::PLAY) n++;
+    return n;
+}
+
+// Runs while anyone is in play; the first player to arrive starts it
+static void on_tick_timer(Timer& t, void*) {
+    capture_event(-1, CAPTURE_TICK);
+    game_tick();
+    if (players_online()) timer_schedule(wheel, t, now_ms() + MC_TICK_MS);
+}
+
+static void server_init() {
+    if (initialized) return;
+    for (auto& c : conns) c.sock = -1;
+    link_init();
+    wheel_init(wheel, now_ms());
+    scratch.init(8192, MEM_SCRATCH);
+    if (!entity_store_init(entities, MC_MAX_ENTITIES))
+        ESP_LOGE(TAG, "No memory for %d entities", MC_MAX_ENTITIES);
+    store_init();
+    timer_init(store_timer, on_store_timer, nullptr);
+    timer_schedule(wheel, store_timer, now_ms() + MC_STORE_FLUSH_MS);
+    timer_init(tick_timer, on_tick_timer, nullptr);
+    initialized = true;
+}
+
+// Queues a reference to p, accounted and captured like send_packet
+static bool conn_send_shared(int slot, SharedPacket* p) {
+    const uint8_t* frame = p->data() + p->hdr_len;
+    uint32_t len = p->len - p->hdr_len;
+    metrics_tx(frame, len);
+    trace_frame(TRACE_PKT_OUT, conns[slot].sock, frame, len);
+#if MC_CAPTURE
+    NetSeg segs[SHARED_SEGS];
+    capture_frame_segs(conns[slot].sock, CAPTURE_OUT, segs, shared_segments(p, p->hdr_len, segs));
+#endif
+    return link_send_shared(slot, p);
+}
+
+int server_broadcast(const PacketBuf& pkt, const Audience& to) {
+    SharedPacket* p = shared_packet(pkt);
+    if (!p) return 0;
+    int n = 0;
+    for (int i = 0; i < MC_MAX_CONNS; i++) {
+        Conn& c = conns[i];
+        if (c.sock < 0 || c.state != ConnState::PLAY || i == to.except_slot) continue;
+        if (to.in_chunk && !c.view.is_loaded(to.cx, to.cz)) continue;
+        if (conn_send_shared(i, p)) n++;
+    }
+    shared_release(p);
+    return n;
+}
+
+bool server_chunk_seen(int cx, int cz) {
+    for (int i = 0; i < MC_MAX_CONNS; i++) {
+        const Conn& c = conns[i];
+        if (c.sock >= 0 && c.state == ConnState::PLAY && c.view.is_loaded(cx, cz)) return true;
+    }
+    return false;
+}
+
+static void send_status_response(int sock, PacketBuf& out) {
+    char json[256];
+    snprintf(json, sizeof(json),
+        "{\"version\":{\"name\":\"%s\",\"protocol\":%d},"
+        "\"players\":{\"max\":%d,\"online\":%d},"
+        "\"description\":{\"text\":\"ESP32-S3 Minecraft Server\"}}",
+        MC_VERSION_NAME, MC_PROTOCOL_VERSION, MC_MAX_PLAYERS, players_online());
+
+    out.reset();
+    pkt_write_varint(out, 0x00);
+    pkt_write_string(out, json);
+    out.send_packet(sock);
+}
+
+static void send_pong(int sock, PacketBuf& out, int64_t payload) {
+    out.reset();
+    pkt_write_varint(out, 0x01);
+    pkt_write_i64(out, payload);
+    out.send_packet(sock);
+}
+
+static void send_login_disconnect(int sock, PacketBuf& out, const char* reason) {
+    char json[128];
+    snprintf(json, sizeof(json), "{\"text\":\"%s\"}", reason);
+    out.reset();
+    pkt_write_varint(out, 0x00);
+    pkt_write_string(out, json);
+    out.send_packet(sock);
+}
+
+// Block names the fill command takes, by palette index
+static const char* const FILL_BLOCKS[] = {"air", "stone", "dirt", "grass_block", "water", "oak_log", "oak_leaves",
+                                          "short_grass", "sand", "coal_ore", "iron_ore"};
+static constexpr int FILL_BLOCK_COUNT = sizeof(FILL_BLOCKS) / sizeof(FILL_BLOCKS[0]);
+
+// fill x0 y0 z0 x1 y1 z1 block
+static void fill_command(int sock, PacketBuf& out, const char* args) {
+    int x0, y0, z0, x1, y1, z1;
+    char name[24];
+    if (sscanf(args, "%d %d %d %d %d %d %23s", &x0, &y0, &z0, &x1, &y1, &z1, name) != 7) {
+        send_system_chat(sock, out, "Usage: fill x0 y0 z0 x1 y1 z1 block");
+        return;
+    }
+    int pi = 0;
+    while (pi < FILL_BLOCK_COUNT && strcmp(name, FILL_BLOCKS[pi])) pi++;
+    if (pi == FILL_BLOCK_COUNT) {
+        send_system_chat(sock, out, "Unknown block");
+        return;
+    }
+    auto inside = [](int v, int lo, int hi) { return v >= lo && v <= hi; };
+    const int top = WORLD_MIN_Y + WORLD_SECTIONS * 16 - 1;
+    if (!inside(x0, -MC_WORLD_BORDER, MC_WORLD_BORDER) || !inside(x1, -MC_WORLD_BORDER, MC_WORLD_BORDER) ||
+        !inside(z0, -MC_WORLD_BORDER, MC_WORLD_BORDER) || !inside(z1, -MC_WORLD_BORDER, MC_WORLD_BORDER) ||
+        !inside(y0, WORLD_MIN_Y, top) || !inside(y1, WORLD_MIN_Y, top)) {
+        send_system_chat(sock, out, "Outside the world");
+        return;
+    }
+    // Extents in 64 bits: corners at opposite ends of the world are 6e7 apart
+    int64_t volume = (std::abs(static_cast<int64_t>(x1) - x0) + 1) * (std::abs(static_cast<int64_t>(y1) - y0) + 1) *
+                     (std::abs(static_cast<int64_t>(z1) - z0) + 1);
+    char line[96];
+    if (volume > MC_FILL_MAX) {
+        snprintf(line, sizeof(line), "Too many blocks (%lld > %d)", static_cast<long long>(volume), MC_FILL_MAX);
+        send_system_chat(sock, out, line);
+        return;
+    }
+    int n = tick_fill(x0, y0, z0, x1, y1, z1, static_cast<uint8_t>(pi));
+    snprintf(line, sizeof(line), "Filled %d blocks", n);
+    send_system_chat(sock, out, line);
+}
+
+static void handle_command(int sock, PacketBuf& out, const char* cmd) {
+    if (strcmp(cmd, "metrics") == 0) {
+#if MC_METRICS
+        char line[256];
+        metrics_summary(line, sizeof(line));
+        send_system_chat(sock, out, line);
+#else
+        send_system_chat(sock, out, "Metrics are compiled out");
+#endif
+        return;
+    }
+    if (strcmp(cmd, "mem") == 0) {
+        char line[256];
+        mem_summary(line, sizeof(line));
+        send_system_chat(sock, out, line);
+        mem_report();
+        return;
+    }
+    if (strcmp(cmd, "ticks") == 0) {
+        char line[256];
+        tick_summary(line, sizeof(line));
+        send_system_chat(sock, out, line);
+        return;
+    }
+    if (strcmp(cmd, "light") == 0) {
+        char line[256];
+        light_summary(line, sizeof(line));
+        send_system_chat(sock, out, line);
+        return;
+    }
+    if (strcmp(cmd, "nav") == 0) {
+        char line[256];
+        nav_summary(line, sizeof(line));
+        send_system_chat(sock, out, line);
+        return;
+    }
+    if (strcmp(cmd, "world") == 0) {
+        char line[256];
+        bake_summary(line, sizeof(line));
+        send_system_chat(sock, out, line);
+        return;
+    }
+    if (strcmp(cmd, "store") == 0) {
+        char line[256];
+        store_summary(line, sizeof(line));
+        send_system_chat(sock, out, line);
+        return;
+    }
+    if (strncmp(cmd, "fill ", 5) == 0) {
+        fill_command(sock, out, cmd + 5);
+        return;
+    }
+    send_system_chat(sock, out, "Unknown command");
+}
+
+// A first-time player: creative, at the world spawn
+static void new_record(PlayerRecord& rec, uint64_t uuid_hi, uint64_t uuid_lo) {
+    memset(&rec, 0, sizeof(rec));
+    rec.uuid_hi = uuid_hi;
+    rec.uuid_lo = uuid_lo;
+    rec.pose.x = 0.5;
+    rec.pose.y = spawn_height(0, 0);
+    rec.pose.z = 0.5;
+    rec.pose.health = 20.0f;
+    rec.pose.food = 20;
+    rec.pose.game_mode = 1;
+}
+
+// Queues the spawn chunks built so far, nearest first; the view streams
+// the rest
+static void send_prepared(Conn& c) {
+    int slot = static_cast<int>(&c - conns);
+    c.view.init(c.prep.center_cx, c.prep.center_cz);
+    int n = 0;
+    for (; n < c.prep.built; n++) {
+        int cx, cz;
+        prep_chunk(c.prep, n, cx, cz);
+        if (!conn_send_shared(slot, c.prep.chunks[n])) break;
+        c.view.set_loaded(cx, cz, true);
+    }
+    ESP_LOGI(TAG, "Sent %d of %d spawn chunks prepared during login", n, VIEW_SLOTS);
+    prep_free(c.prep);
+}
+
+// Starts building the spawn chunks, which build while the client works
+// through configuration, and sends Login Success
+static void login_success(Conn& c) {
+    prep_init(c.prep, static_cast<int>(floor(c.rec.pose.x)) >> 4, static_cast<int>(floor(c.rec.pose.z)) >> 4);
+    c.out.reset();
+    pkt_write_varint(c.out, 0x02);
+    pkt_write_uuid(c.out, c.rec.uuid_hi, c.rec.uuid_lo);
+    pkt_write_string(c.out, c.name);
+    pkt_write_varint(c.out, 0);
+    c.out.send_packet(c.sock);
+    ESP_LOGI(TAG, "Sent Login Success, waiting for ack");
+}
+
+static void on_claim(Conn& c, const ShardReply& r) {
+    c.claiming = false;
+    if (r.ok) {
+        c.rec.pose = r.pose;
+        ESP_LOGI(TAG, "%s handed over at %.1f %.1f %.1f", c.name, c.rec.pose.x, c.rec.pose.y, c.rec.pose.z);
+    }
+    login_success(c);
+}
+
+// Applies a coordinator reply to the connection it was asked for, if that
+// player is still there
+static void apply_shard_reply(const ShardReply& r) {
+    Conn& c = conns[r.slot];
+    if (c.sock < 0 || c.rec.uuid_hi != r.uuid_hi || c.rec.uuid_lo != r.uuid_lo) return;
+    mem_set_conn(r.slot);
+    if (r.kind == SHARD_CLAIM && c.claiming) on_claim(c, r);
+    else if (r.kind == SHARD_HANDOFF && c.transferring) on_handoff(c, r.ok);
+    mem_set_conn(-1);
+}
+
+// Applies one decoded packet. Returns false to drop the connection.
+static bool conn_apply(Conn& c, NetCmd& cmd) {
+    int sock = c.sock;
+    PacketBuf& out = c.out;
+
+    switch (cmd.kind) {
+    case CMD_HANDSHAKE:
+        if (c.state != ConnState::HANDSHAKE) return true;
+        if (cmd.next_state == 1) {
+            c.state = ConnState::STATUS;
+        } else if (cmd.next_state == 2 || cmd.next_state == 3) {
+            c.state = ConnState::LOGIN;
+            timer_schedule(wheel, c.deadline, now_ms() + MC_LOGIN_TIMEOUT_MS);
+        }
+        return true;
+
+    case CMD_STATUS:
+        ESP_LOGI(TAG, "Status request -> sending response");
+        send_status_response(sock, out);
+        return true;
+
+    case CMD_PING:
+        ESP_LOGI(TAG, "Ping -> pong");
+        send_pong(sock, out, cmd.value);
+        return false;
+
+    case CMD_LOGIN_START: {
+        memcpy(c.name, cmd.login.name, sizeof(c.name));
+        ESP_LOGI(TAG, "Login Start: user=%s", c.name);
+
+        if (players_online() >= MC_MAX_PLAYERS) {
+            send_login_disconnect(sock, out, "Server is full");
+            return false;
+        }
+        c.metrics_slot = metrics_player_join(c.name);
+        if (!store_find(cmd.login.uuid_hi, cmd.login.uuid_lo, c.rec))
+            new_record(c.rec, cmd.login.uuid_hi, cmd.login.uuid_lo);
+        // Arriving from another shard: that node's pose wins over ours, so
+        // Login Success waits for the coordinator (on_claim)
+        c.claiming = shard_active() && shard_claim(static_cast<int>(&c - conns), c.rec.uuid_hi, c.rec.uuid_lo);
+        if (!c.claiming) login_success(c);
+        return true;
+    }
+
+    case CMD_LOGIN_ACK:
+        if (c.claiming) return false;   // before Login Success
+        ESP_LOGI(TAG, "Login Acknowledged -> Configuration state");
+        c.state = ConnState::CONFIG;
+        send_config_packets(sock, out);
+        return true;
+
+    case CMD_CONFIG_ACK: {
+        ESP_LOGI(TAG, "Client acknowledged config -> Play state");
+        c.state = ConnState::PLAY;
+        send_play_packets(sock, out, c.rec.pose);
+        send_prepared(c);
+        c.view.yaw = c.rec.pose.yaw;
+        c.entity = entity_add(entities, ENTITY_PLAYER, static_cast<float>(c.rec.pose.x),
+                              static_cast<float>(c.rec.pose.y), static_cast<float>(c.rec.pose.z), 0.0f,
+                              now_ms() / 50);
+        timer_cancel(c.deadline);
+        timer_schedule(wheel, c.ka_timer, now_ms() + MC_KEEPALIVE_MS);
+        if (!timer_pending(tick_timer)) timer_schedule(wheel, tick_timer, now_ms() + MC_TICK_MS);
+
+        char line[64];
+        snprintf(line, sizeof(line), "%s joined the game", c.name);
+        build_system_chat(scratch, line);
+        server_broadcast(scratch, audience_all());
+        return true;
+    }
+
+    // Only the latest position and rotation count; the game tick applies
+    // them, so a client sending faster costs a copy per packet
+    case CMD_MOVE:
+        c.move.x = cmd.move.x;
+        c.move.y = cmd.move.y;
+        c.move.z = cmd.move.z;
+        c.move.moved = true;
+        if (cmd.move.has_yaw) {
+            c.move.yaw = cmd.move.yaw;
+            c.move.turned = true;
+        }
+        return true;
+
+    case CMD_LOOK:
+        c.move.yaw = cmd.move.yaw;
+        c.move.turned = true;
+        return true;
+
+    case CMD_KEEPALIVE:
+        if (cmd.value == c.ka_id) {
+            timer_cancel(c.deadline);
+            metrics_player_rtt(c.metrics_slot, now_ms() - static_cast<uint32_t>(cmd.value));
+        }
+        return true;
+
+    case CMD_CHAT: {
+        char line[300];
+        snprintf(line, sizeof(line), "<%s> %s", c.name, cmd.text);
+        build_system_chat(scratch, line);
+        server_broadcast(scratch, audience_all());
+        return true;
+    }
+
+    case CMD_COMMAND:
+        handle_command(sock, out, cmd.text);
+        return true;
+
+    case CMD_DIG: {
+        if (c.state != ConnState::PLAY) return true;
+        // Reach is checked from where the player is now
+        apply_move(c);
+        // Survival breaks on the finished dig, creative on the first hit
+        bool breaks = cmd.dig.status == (c.rec.pose.game_mode == 1 ? 0 : 2);
+        double dx = cmd.dig.x + 0.5 - c.rec.pose.x, dy = cmd.dig.y + 0.5 - (c.rec.pose.y + 1.62),
+               dz = cmd.dig.z + 0.5 - c.rec.pose.z;
+        if (breaks && dx * dx + dy * dy + dz * dz <= MC_REACH * MC_REACH)
+            tick_set_block(cmd.dig.x, cmd.dig.y, cmd.dig.z, PI_AIR);
+        // Acknowledge either way, so the client drops its prediction and
+        // takes the server's block
+        out.reset();
+        pkt_write_varint(out, 0x05);
+        pkt_write_varint(out, cmd.dig.sequence);
+        out.send_packet(sock);
+        return true;
+    }
+
+    case CMD_SLOT:
+        // Kept with the player record; the client already shows it
+        if (c.state == ConnState::PLAY && c.rec.pose.game_mode == 1 && cmd.slot.index >= 0 &&
+            cmd.slot.index < STORE_INV_SLOTS) {
+            ItemStack& st = c.rec.inv[cmd.slot.index];
+            st.item = static_cast<uint16_t>(cmd.slot.count ? cmd.slot.item : 0);
+            st.count = static_cast<uint8_t>(cmd.slot.count);
+        }
+        return true;
+
+    case CMD_OPEN:
+    case CMD_CLOSE:
+        break;
+    }
+    return false;
+}
+
+// True while the connection has spawn chunks to build or view chunks to send
+static bool conn_busy(const Conn& c) {
+    if (c.state == ConnState::PLAY) return !c.view.complete() || !c.view.outer_complete();
+    return c.prep.pending();
+}
+
+// Builds spawn chunks before Play and streams the view during it. Returns
+// false to drop the connection.
+static bool conn_poll(Conn& c) {
+    if (!conn_busy(c)) return true;
+    capture_event(c.sock, CAPTURE_POLL);
+    int sent = c.state == ConnState::PLAY ? view_stream(c.sock, c.out, c.view, MC_CHUNK_BUDGET)
+                                          : prep_build(c.prep, c.out, MC_CHUNK_BUDGET);
+    // Nothing could go: every chunk left is on its way from another node,
+    // whose arrival wakes the simulation task
+    c.fetching = sent == 0;
+    return true;
+}
+
+// A connection timer fired. Returns false to drop the connection.
+static bool conn_on_timer(Conn& c, uint8_t which) {
+    uint32_t now = now_ms();
+    if (which == CONN_TIMER_KEEPALIVE) {
+        c.ka_id = now;
+        c.out.reset();
+        pkt_write_varint(c.out, 0x27);
+        pkt_write_i64(c.out, c.ka_id);
+        if (!c.out.send_packet(c.sock)) return false;
+        if (!timer_pending(c.deadline))
+            timer_schedule(wheel, c.deadline, now + MC_KEEPALIVE_TIMEOUT_MS);
+        timer_schedule(wheel, c.ka_timer, now + MC_KEEPALIVE_MS);
+        return true;
+    }
+    ESP_LOGW(TAG, "%s timed out", c.name[0] ? c.name : "Connection");
+    return false;
+}
+
+// error marks a drop (timeout, failed send, client not keeping up) rather
+// than a disconnect or a deliberate close; the flight recorder keeps a copy
+// of what led up to it
+static void conn_close(Conn& c, bool error) {
+    capture_event(c.sock, CAPTURE_CLOSE);
+    trace(TRACE_CLOSE, c.sock, error, 0);
+    if (error) trace_save();
+    if (c.state == ConnState::PLAY) {
+        // Input that arrived after the last tick still counts for the record
+        if (c.move.moved) {
+            c.rec.pose.x = c.move.x;
+            c.rec.pose.y = c.move.y;
+            c.rec.pose.z = c.move.z;
+        }
+        if (c.move.turned) c.rec.pose.yaw = c.move.yaw;
+        char line[64];
+        snprintf(line, sizeof(line), "%s left the game", c.name);
+        build_system_chat(scratch, line);
+        server_broadcast(scratch, audience_all(static_cast<int>(&c - conns)));
+        store_put(c.rec);
+        store_flush();
+    }
+    timer_cancel(c.ka_timer);
+    timer_cancel(c.deadline);
+    prep_free(c.prep);
+    entity_remove(entities, c.entity);
+    metrics_player_leave(c.metrics_slot);
+    link_close(static_cast<int>(&c - conns), error);
+    c.sock = -1;
+    c.out.free();
+    ESP_LOGI(TAG, "Connection closed");
+}
+
+static void on_conn_timer(Timer& t, void* arg) {
+    Conn& c = *static_cast<Conn*>(arg);
+    uint8_t which = &t == &c.ka_timer ? CONN_TIMER_KEEPALIVE : CONN_TIMER_DEADLINE;
+    capture_frame(c.sock, CAPTURE_TIMER, &which, 1);
+    mem_set_conn(static_cast<int>(&c - conns));
+    if (!conn_on_timer(c, which)) conn_close(c, true);
+    mem_set_conn(-1);
+}
+
+static void conn_open(Conn& c, int sock, int slot) {
+    mem_conn_open(slot);
+    mem_set_conn(slot);
+    c.sock = sock;
+    c.state = ConnState::HANDSHAKE;
+    c.out.init();
+    c.metrics_slot = -1;
+    c.transferring = false;
+    c.transfer_retry_ms = now_ms();
+    c.claiming = false;
+    c.fetching = false;
+    c.name[0] = '\0';
+    c.ka_id = -1;
+    c.entity = ENTITY_NONE;
+    c.move.moved = c.move.turned = false;
+    c.prep.active = false;
+    timer_init(c.ka_timer, on_conn_timer, &c);
+    timer_init(c.deadline, on_conn_timer, &c);
+    timer_schedule(wheel, c.deadline, now_ms() + MC_HANDSHAKE_TIMEOUT_MS);
+    mem_set_conn(-1);
+    link_attach(slot, sock);
+    capture_event(sock, CAPTURE_OPEN);
+    trace(TRACE_OPEN, sock, 0, 0);
+}
+
+// Applies one command from the slot's inbound ring. Commands for a closed
+// connection (sent before the network task saw the close) are dropped.
+static void sim_apply(int slot, NetCmd& cmd) {
+    Conn& c = conns[slot];
+    if (cmd.kind == CMD_OPEN) {
+        if (c.sock < 0) conn_open(c, cmd.sock, slot);
+    } else if (c.sock >= 0) {
+        mem_set_conn(slot);
+#if MC_CAPTURE
+        if (cmd.frame) capture_frame(c.sock, CAPTURE_IN, cmd.frame, cmd.frame_len);
+#endif
+        if (cmd.kind == CMD_CLOSE) conn_close(c, cmd.value != 0);
+        else if (!conn_apply(c, cmd)) conn_close(c, false);
+        mem_set_conn(-1);
+    }
+    net_cmd_free(cmd);
+}
+
+// Drops a connection whose outbound ring overflowed
+static void sim_check_link(int slot) {
+    Conn& c = conns[slot];
+    if (c.sock < 0 || !link_overflowed(slot)) return;
+    ESP_LOGW(TAG, "%s is not keeping up, dropping", c.name[0] ? c.name : "Connection");
+    mem_set_conn(slot);
+    conn_close(c, true);
+    mem_set_conn(-1);
+}
+
+// Streaming leaves room in the packet ring to unload every held chunk at
+// once, should the player jump clear of the view
+static constexpr uint32_t STREAM_RESERVE = OUTER_SLOTS + MC_CHUNK_BUDGET + MC_LOD_BUDGET;
+static_assert(STREAM_RESERVE + 32 <= MC_LINK_OUT_LEN, "MC_LINK_OUT_LEN too small for the view");
+
+static void sim_task_main(void*) {
+    const uint32_t overrun_cycles = MC_TRACE_OVERRUN_US * esp_rom_get_cpu_ticks_per_us();
+    while (true) {
+        // Run again at once while any view can stream or spawn chunks are
+        // building, check back next tick while streaming waits for the
+        // network task, otherwise sleep until a command or fetched chunk
+        // arrives or the next timer slot
+        bool streaming = false, backlogged = false;
+        for (int i = 0; i < MC_MAX_CONNS; i++) {
+            const Conn& c = conns[i];
+            if (c.sock < 0 || c.fetching || !conn_busy(c)) continue;
+            if (link_can_stream(i, STREAM_RESERVE)) streaming = true;
+            else backlogged = true;
+        }
+        uint32_t wait_ms = streaming ? 0 : backlogged ? 1 : wheel_idle_ms(wheel, now_ms(), 1000);
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(wait_ms));
+
+        MC_STAGE(STAGE_LOOP);
+        trace_clock();
+        uint32_t pass_start = trace_cycles();
+
+        wheel_advance(wheel, now_ms());
+        ShardReply reply;
+        while (shard_reply(reply)) apply_shard_reply(reply);
+
+        for (int i = 0; i < MC_MAX_CONNS; i++) {
+            NetCmd cmd;
+            for (int n = 0; n < MC_LINK_IN_LEN && link_pop(i, cmd); n++) sim_apply(i, cmd);
+
+            Conn& c = conns[i];
+            if (c.sock >= 0 && link_can_stream(i, STREAM_RESERVE)) {
+                mem_set_conn(i);
+                if (!conn_poll(c)) conn_close(c, true);
+                mem_set_conn(-1);
+            }
+        }
+        for (int i = 0; i < MC_MAX_CONNS; i++) sim_check_link(i);
+
+        uint32_t pass = trace_cycles() - pass_start;
+        if (pass > overrun_cycles) trace(TRACE_OVERRUN, 0, 0, pass);
+    }
+}
+
+#ifdef CONFIG_LWIP_MAX_SOCKETS
+static_assert(MC_SOCKETS <= CONFIG_LWIP_MAX_SOCKETS, "raise CONFIG_LWIP_MAX_SOCKETS or lower MC_MAX_PLAYERS");
+#endif
+
+// Listening resumes at this time after a failed accept; the pending
+// connection stays queued and would otherwise wake select at once again
+static uint32_t accept_resume_ms = 0;
+
+static bool accept_client(int listen_sock) {
+    sockaddr_in client_addr{};
+    socklen_t addr_len = sizeof(client_addr);
+    int client_sock = accept(listen_sock, reinterpret_cast<sockaddr*>(&client_addr), &addr_len);
+
+    if (client_sock < 0) {
+        ESP_LOGE(TAG, "Accept failed errno %d, pausing %d ms", errno, MC_ACCEPT_RETRY_MS);
+        accept_resume_ms = now_ms() + MC_ACCEPT_RETRY_MS;
+        return false;
+    }
+
+    int slot = link_open(client_sock);
+    if (slot < 0) {
+        ESP_LOGW(TAG, "No free connection slot, rejecting");
+        close(client_sock);
+        return false;
+    }
+
+    char addr_str[INET_ADDRSTRLEN];
+    inet_ntoa_r(client_addr.sin_addr, addr_str, sizeof(addr_str));
+    ESP_LOGI(TAG, "New connection from %s:%d", addr_str, ntohs(client_addr.sin_port));
+
+    int nodelay = 1;
+    setsockopt(client_sock, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+    // Frames are assembled from whatever has arrived, so a client that
+    // stops mid-frame cannot hold up the others
+    fcntl(client_sock, F_SETFL, fcntl(client_sock, F_GETFL, 0) | O_NONBLOCK);
+    return true;
+}
+
+void server_run(uint16_t port) {
+    int listen_sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (listen_sock < 0) {
+        ESP_LOGE(TAG, "Failed to create socket: errno %d", errno);
+        return;
+    }
+
+    int opt = 1;
+    setsockopt(listen_sock, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    setsockopt(listen_sock, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+
+    sockaddr_in server_addr{};
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_port = htons(port);
+    server_addr.sin_addr.s_addr = htonl(INADDR_ANY);
+
+    if (bind(listen_sock, reinterpret_cast<sockaddr*>(&server_addr), sizeof(server_addr)) < 0) {
+        ESP_LOGE(TAG, "Bind failed: errno %d", errno);
+        close(listen_sock);
+        return;
+    }
+
+    if (listen(listen_sock, 2) < 0) {
+        ESP_LOGE(TAG, "Listen failed: errno %d", errno);
+        close(listen_sock);
+        return;
+    }
+
+    server_init();
+    xTaskCreatePinnedToCore(sim_task_main, "mc_sim", MC_SIM_STACK, nullptr, 5, &sim_task, MC_SIM_CORE);
+    shard_set_waiter(sim_task);
+    mem_register_task(sim_task, "mc_sim");
+
+    ESP_LOGI(TAG, "Server listening on port %d", port);
+
+    while (true) {
+        trace_clock();
+        fd_set rfds, wfds;
+        FD_ZERO(&rfds);
+        FD_ZERO(&wfds);
+        bool listening = static_cast<int32_t>(now_ms() - accept_resume_ms) >= 0;
+        if (listening) FD_SET(listen_sock, &rfds);
+        int max_fd = listen_sock;
+        bool any = false;
+        for (int i = 0; i < MC_MAX_CONNS; i++) {
+            link_flush(i);
+            if (!link_in_use(i)) continue;
+            any = true;
+            int sock = link_sock(i);
+            if (link_wants_read(i)) FD_SET(sock, &rfds);
+            if (link_wants_write(i)) FD_SET(sock, &wfds);
+            if (sock > max_fd) max_fd = sock;
+        }
+
+        // The simulation task queues output without waking this one, so
+        // poll briefly while anyone is connected
+        uint32_t wait_ms = any ? MC_NET_POLL_MS : listening ? 1000 : MC_ACCEPT_RETRY_MS;
+        struct timeval tv = {0, static_cast<suseconds_t>(wait_ms * 1000)};
+        int ret = select(max_fd + 1, &rfds, &wfds, nullptr, &tv);
+        if (ret < 0) {
+            ESP_LOGE(TAG, "select failed: errno %d", errno);
+            vTaskDelay(pdMS_TO_TICKS(100));
+            continue;
+        }
+        if (ret == 0) continue;
+
+        bool queued = false;
+        if (FD_ISSET(listen_sock, &rfds)) queued |= accept_client(listen_sock);
+        for (int i = 0; i < MC_MAX_CONNS; i++)
+            if (link_in_use(i) && FD_ISSET(link_sock(i), &rfds)) queued |= link_recv(i);
+        if (queued) xTaskNotifyGive(sim_task);
+    }
+}
+
+int server_conn_open(int sock) {
+    server_init();
+    int slot = link_open(sock);
+    NetCmd cmd;
+    if (slot >= 0)
+        while (link_pop(slot, cmd)) sim_apply(slot, cmd);
+    return slot;
+}
+
+bool server_conn_packet(int slot, const uint8_t* frame, size_t len) {
+    NetCmd cmd;
+    if (conns[slot].sock >= 0 && link_decode(slot, frame, len, cmd)) sim_apply(slot, cmd);
+    sim_check_link(slot);
+    return conns[slot].sock >= 0;
+}
+
+bool server_conn_poll(int slot) {
+    Conn& c = conns[slot];
+    if (c.sock < 0) return false;
+    mem_set_conn(slot);
+    if (!conn_poll(c)) conn_close(c, true);
+    mem_set_conn(-1);
+    sim_check_link(slot);
+    return c.sock >= 0;
+}
+
+bool server_conn_timer(int slot, uint8_t which) {
+    Conn& c = conns[slot];
+    if (c.sock < 0) return false;
+    timer_cancel(which == CONN_TIMER_KEEPALIVE ? c.ka_timer : c.deadline);
+    mem_set_conn(slot);
+    if (!conn_on_timer(c, which)) conn_close(c, true);
+    mem_set_conn(-1);
+    sim_check_link(slot);
+    return c.sock >= 0;
+}
+
+void server_conn_close(int slot) {
+    if (conns[slot].sock < 0) return;
+    mem_set_conn(slot);
+    conn_close(conns[slot], false);
+    mem_set_conn(-1);
+}
+
+void server_tick() {
+    game_tick();
+}
+
+void server_conn_drain(int slot) {
+    link_flush(slot);
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "mc_packet.h"
+#include <cstdint>
+#include <cstddef>
+
+// Binds the game port and runs the network loop on the calling task: it
+// accepts, reads and writes every socket, and hands decoded packets to the
+// simulation task it starts on MC_SIM_CORE. Only returns if the socket
+// setup fails.
+void server_run(uint16_t port);
+
+// Players a broadcast goes to. Only connections in play are considered.
+struct Audience {
+    int except_slot;    // -1 for nobody
+    bool in_chunk;      // only players whose view holds chunk (cx, cz)
+    int cx, cz;
+};
+
+inline Audience audience_all(int except_slot = -1) { return {except_slot, false, 0, 0}; }
+inline Audience audience_chunk(int cx, int cz, int except_slot = -1) { return {except_slot, true, cx, cz}; }
+
+// Frames pkt once and queues the same bytes to every matching player, in
+// order with any other packets sent to them. Returns the number of
+// recipients.
+int server_broadcast(const PacketBuf& pkt, const Audience& to);
+// True if any player in play has chunk (cx, cz) loaded
+bool server_chunk_seen(int cx, int cz);
+
+// Socket-free entry points for the replay harness, which stands in for the
+// network task and runs the simulation on its own thread. `sock` only
+// identifies the connection to the net_* functions; slots index the
+// connection table. The bool results are false once the connection is
+// closed; server_conn_drain then writes its remaining packets and frees it.
+int  server_conn_open(int sock);
+bool server_conn_packet(int slot, const uint8_t* frame, size_t len);
+bool server_conn_poll(int slot);
+bool server_conn_timer(int slot, uint8_t which);
+void server_conn_close(int slot);
+// One game tick of the block tick engine
+void server_tick();
+// Writes everything queued for the slot through net_try_send
+void server_conn_drain(int slot);
@@ -0,0 +1,450 @@
+#include "mc_shard.h"
+#include "mc_play.h"
+#include "mc_mem.h"
+#include "mc_spsc.h"
+#include "config.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "lwip/sockets.h"
+#include "lwip/netdb.h"
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+static const char* TAG = "mc_shard";
+
+static constexpr uint32_t MAX_CHUNK_BYTES = 256 * 1024;
+
+static ShardNode nodes[MC_SHARD_MAX_NODES];
+static int node_count = 0;
+static int self_id = 0;
+static bool active = false;
+static char coord_host[40];
+static uint16_t coord_port;
+
+enum ShardOp : uint8_t { OP_FETCH, OP_HANDOFF, OP_CLAIM };
+
+// Queued by the simulation task for the I/O task
+struct ShardRequest {
+    ShardOp op;
+    int16_t slot;           // connection (coordinator calls) or fetch entry
+    int32_t cx, cz;         // OP_FETCH
+    uint64_t uuid_hi, uuid_lo;
+    PlayerPose pose;        // OP_HANDOFF
+};
+
+// Handed back by the I/O task
+struct ShardResult {
+    ShardOp op;
+    bool ok;
+    int16_t slot;
+    uint64_t uuid_hi, uuid_lo;
+    PlayerPose pose;        // OP_CLAIM
+    uint8_t* data;          // OP_FETCH: Chunk Data, freed by the simulation task
+    uint32_t len;
+};
+
+// Coordinator calls hold up a login or a handoff, so they go ahead of any
+// queued fetches
+static SpscRing<ShardRequest, 16> coord_requests;
+static SpscRing<ShardRequest, 16> fetch_requests;
+static SpscRing<ShardResult, 32> results;
+static TaskHandle_t io_task = nullptr;
+static TaskHandle_t waiter = nullptr;
+
+// Simulation task: chunks being fetched, and fetched but not yet taken
+enum class FetchState : uint8_t { FREE, WAIT, DONE, FAILED };
+
+struct Fetch {
+    FetchState state;
+    int32_t cx, cz;
+    uint32_t stamp;         // when requested, for evicting unclaimed entries
+    uint8_t* data;
+    uint32_t len;
+};
+
+static Fetch fetches[MC_SHARD_FETCHES];
+static uint32_t retry_at[MC_SHARD_MAX_NODES];   // ms; no fetches from the node before this
+
+static uint32_t now_ms() {
+    return xTaskGetTickCount() * portTICK_PERIOD_MS;
+}
+
+// Connected socket with send and receive timeouts, or -1
+static int dial(const char* host, uint16_t port) {
+    addrinfo hints{}, *res = nullptr;
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    char port_str[8];
+    snprintf(port_str, sizeof(port_str), "%u", port);
+    if (getaddrinfo(host, port_str, &hints, &res) != 0 || !res) return -1;
+    int sock = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+    if (sock >= 0) {
+        timeval tv = {MC_SHARD_TIMEOUT_MS / 1000, (MC_SHARD_TIMEOUT_MS % 1000) * 1000};
+        setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+        int one = 1;
+        setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        if (connect(sock, res->ai_addr, res->ai_addrlen) < 0) {
+            close(sock);
+            sock = -1;
+        }
+    }
+    freeaddrinfo(res);
+    return sock;
+}
+
+static bool send_all(int sock, const void* buf, size_t len) {
+    const auto* p = static_cast<const uint8_t*>(buf);
+    while (len > 0) {
+        int r = send(sock, p, len, 0);
+        if (r <= 0) return false;
+        p += r;
+        len -= r;
+    }
+    return true;
+}
+
+static bool recv_all(int sock, void* buf, size_t len) {
+    auto* p = static_cast<uint8_t*>(buf);
+    while (len > 0) {
+        int r = recv(sock, p, len, 0);
+        if (r <= 0) return false;
+        p += r;
+        len -= r;
+    }
+    return true;
+}
+
+// Sends one request line and reads the reply until the coordinator closes
+static bool coord_request(const char* line, char* reply, size_t cap) {
+    int sock = dial(coord_host, coord_port);
+    if (sock < 0) {
+        ESP_LOGW(TAG, "Coordinator %s:%u unreachable", coord_host, coord_port);
+        return false;
+    }
+    bool ok = send_all(sock, line, strlen(line));
+    size_t n = 0;
+    while (ok && n + 1 < cap) {
+        int r = recv(sock, reply + n, cap - 1 - n, 0);
+        if (r < 0) ok = false;
+        if (r <= 0) break;
+        n += r;
+    }
+    reply[n] = '\0';
+    close(sock);
+    return ok && n > 0;
+}
+
+// Answers one chunk request: 8 bytes (cx, cz) in, a 4-byte length and the
+// Chunk Data packet out. False once the connection is done.
+static bool serve_chunk(int sock, PacketBuf& out) {
+    uint32_t req[2];
+    if (!recv_all(sock, req, sizeof(req))) return false;
+    int cx = static_cast<int32_t>(ntohl(req[0])), cz = static_cast<int32_t>(ntohl(req[1]));
+    build_chunk(out, cx, cz, false);
+    out.flatten();
+    // Out of memory: the asking node builds the chunk itself
+    if (out.failed) return false;
+    uint32_t len = htonl(static_cast<uint32_t>(out.len));
+    return send_all(sock, &len, sizeof(len)) && send_all(sock, out.data, out.len);
+}
+
+// Serves chunk requests from other nodes, each of which keeps its
+// connection open between requests. Builds into its own buffers and
+// leaves the simulation's world cache alone.
+static void peer_task(void*) {
+    int listen_sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    int opt = 1;
+    setsockopt(listen_sock, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(nodes[self_id].peer_port);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (bind(listen_sock, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || listen(listen_sock, 2) < 0) {
+        ESP_LOGE(TAG, "Peer port %u unavailable: errno %d", nodes[self_id].peer_port, errno);
+        close(listen_sock);
+        vTaskDelete(nullptr);
+        return;
+    }
+
+    PacketBuf out;
+    out.init(16384, MEM_SCRATCH);
+    int clients[MC_SHARD_MAX_NODES];
+    for (int& c : clients) c = -1;
+    int next = 0;           // replaced when every slot is taken
+    while (true) {
+        fd_set rfds;
+        FD_ZERO(&rfds);
+        FD_SET(listen_sock, &rfds);
+        int max_fd = listen_sock;
+        for (int c : clients)
+            if (c >= 0) {
+                FD_SET(c, &rfds);
+                if (c > max_fd) max_fd = c;
+            }
+        if (select(max_fd + 1, &rfds, nullptr, nullptr, nullptr) <= 0) continue;
+
+        for (int& c : clients)
+            if (c >= 0 && FD_ISSET(c, &rfds) && !serve_chunk(c, out)) {
+                close(c);
+                c = -1;
+            }
+        if (!FD_ISSET(listen_sock, &rfds)) continue;
+        int sock = accept(listen_sock, nullptr, nullptr);
+        if (sock < 0) continue;
+        timeval tv = {MC_SHARD_TIMEOUT_MS / 1000, (MC_SHARD_TIMEOUT_MS % 1000) * 1000};
+        setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+        // Replies go out as the length and then the packet on a kept
+        // connection; without this the packet waits on the length's ACK
+        int one = 1;
+        setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        int i = 0;
+        while (i < MC_SHARD_MAX_NODES && clients[i] >= 0) i++;
+        if (i == MC_SHARD_MAX_NODES) {
+            i = next;
+            next = (next + 1) % MC_SHARD_MAX_NODES;
+            close(clients[i]);
+        }
+        clients[i] = sock;
+    }
+}
+
+// One chunk request on a connection to a peer; data is allocated here
+static bool request_chunk(int sock, int cx, int cz, uint8_t*& data, uint32_t& len) {
+    uint32_t req[2] = {htonl(static_cast<uint32_t>(cx)), htonl(static_cast<uint32_t>(cz))};
+    if (!send_all(sock, req, sizeof(req)) || !recv_all(sock, &len, sizeof(len))) return false;
+    len = ntohl(len);
+    if (len == 0 || len > MAX_CHUNK_BYTES) return false;
+    data = static_cast<uint8_t*>(mem_alloc(MEM_PACKET, len));
+    if (data && recv_all(sock, data, len)) return true;
+    mem_free(data);
+    data = nullptr;
+    return false;
+}
+
+// Fetches over the connection kept to the owner, dialling again once if
+// the peer has dropped it since the last request
+static bool fetch_chunk(int* socks, int cx, int cz, uint8_t*& data, uint32_t& len) {
+    int owner = shard_owner(cx);
+    int& sock = socks[owner];
+    for (int attempt = 0; attempt < 2; attempt++) {
+        bool fresh = sock < 0;
+        if (fresh) sock = dial(nodes[owner].host, nodes[owner].peer_port);
+        if (sock < 0) return false;
+        if (request_chunk(sock, cx, cz, data, len)) return true;
+        close(sock);
+        sock = -1;
+        if (fresh) return false;
+    }
+    return false;
+}
+
+static bool coord_handoff(uint64_t uuid_hi, uint64_t uuid_lo, const PlayerPose& p) {
+    char line[256], reply[32];
+    snprintf(line, sizeof(line), "PUT %llx %llx %.17g %.17g %.17g %.9g %.9g %.9g %u %u\n",
+             static_cast<unsigned long long>(uuid_hi), static_cast<unsigned long long>(uuid_lo),
+             p.x, p.y, p.z, p.yaw, p.pitch, p.health, p.food, p.game_mode);
+    return coord_request(line, reply, sizeof(reply)) && strncmp(reply, "OK", 2) == 0;
+}
+
+static bool coord_claim(uint64_t uuid_hi, uint64_t uuid_lo, PlayerPose& pose) {
+    char line[64], reply[256];
+    snprintf(line, sizeof(line), "TAKE %llx %llx\n", static_cast<unsigned long long>(uuid_hi),
+             static_cast<unsigned long long>(uuid_lo));
+    if (!coord_request(line, reply, sizeof(reply))) return false;
+    unsigned food, mode;
+    if (sscanf(reply, "POSE %lf %lf %lf %f %f %f %u %u", &pose.x, &pose.y, &pose.z, &pose.yaw, &pose.pitch,
+               &pose.health, &food, &mode) != 8)
+        return false;
+    pose.food = static_cast<uint8_t>(food);
+    pose.game_mode = static_cast<uint8_t>(mode);
+    return true;
+}
+
+// Runs the simulation task's requests one at a time; every blocking socket
+// call of a sharded node other than the peer port's happens here
+static void io_task_main(void*) {
+    int socks[MC_SHARD_MAX_NODES];
+    for (int& s : socks) s = -1;
+    while (true) {
+        ShardRequest req;
+        if (!coord_requests.pop(req) && !fetch_requests.pop(req)) {
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(1000));
+            continue;
+        }
+        ShardResult res{};
+        res.op = req.op;
+        res.slot = req.slot;
+        res.uuid_hi = req.uuid_hi;
+        res.uuid_lo = req.uuid_lo;
+        if (req.op == OP_FETCH) {
+            res.ok = fetch_chunk(socks, req.cx, req.cz, res.data, res.len);
+            if (!res.ok) ESP_LOGW(TAG, "Fetching chunk %d,%d from node %d failed", req.cx, req.cz, shard_owner(req.cx));
+        } else if (req.op == OP_HANDOFF) {
+            res.ok = coord_handoff(req.uuid_hi, req.uuid_lo, req.pose);
+        } else {
+            res.ok = coord_claim(req.uuid_hi, req.uuid_lo, res.pose);
+        }
+        // The simulation task drains every pass; wait for it if it is behind
+        while (!results.push(res)) vTaskDelay(pdMS_TO_TICKS(1));
+        if (waiter) xTaskNotifyGive(waiter);
+    }
+}
+
+bool shard_start(const char* host, uint16_t port, int self) {
+    snprintf(coord_host, sizeof(coord_host), "%s", host);
+    coord_port = port;
+
+    char reply[1024];
+    if (!coord_request("MAP\n", reply, sizeof(reply))) return false;
+    int count = 0;
+    char* save = nullptr;
+    char* line = strtok_r(reply, "\n", &save);
+    if (!line || sscanf(line, "NODES %d", &count) != 1 || count < 1 || count > MC_SHARD_MAX_NODES) {
+        ESP_LOGE(TAG, "Bad node table from coordinator");
+        return false;
+    }
+    for (int i = 0; i < count; i++) {
+        line = strtok_r(nullptr, "\n", &save);
+        ShardNode& n = nodes[i];
+        unsigned p = 0, pp = 0;
+        if (!line || sscanf(line, "%39s %u %u %d %d", n.host, &p, &pp, &n.cx_min, &n.cx_max) != 5) {
+            ESP_LOGE(TAG, "Bad node %d in table", i);
+            return false;
+        }
+        n.port = static_cast<uint16_t>(p);
+        n.peer_port = static_cast<uint16_t>(pp);
+    }
+    if (self < 0 || self >= count) {
+        ESP_LOGE(TAG, "Node %d not in a table of %d", self, count);
+        return false;
+    }
+    node_count = count;
+    self_id = self;
+    active = true;
+    ESP_LOGI(TAG, "Node %d of %d, chunk columns x %d..%d", self, count, nodes[self].cx_min, nodes[self].cx_max);
+    xTaskCreatePinnedToCore(peer_task, "mc_shard", 8192, nullptr, 4, nullptr, 0);
+    xTaskCreatePinnedToCore(io_task_main, "mc_shard_io", 8192, nullptr, 4, &io_task, 0);
+    return true;
+}
+
+bool shard_active() { return active; }
+int  shard_self() { return self_id; }
+const ShardNode& shard_node(int id) { return nodes[id]; }
+
+int shard_owner(int cx) {
+    for (int i = 0; i < node_count; i++)
+        if (cx >= nodes[i].cx_min && cx <= nodes[i].cx_max) return i;
+    return self_id;
+}
+
+int shard_target(double x) {
+    if (!active) return -1;
+    int bx = static_cast<int>(floor(x));
+    int to = shard_owner(bx >> 4);
+    if (to == self_id) return -1;
+    if (shard_owner((bx - MC_SHARD_MARGIN) >> 4) != to || shard_owner((bx + MC_SHARD_MARGIN) >> 4) != to) return -1;
+    return to;
+}
+
+void shard_set_waiter(TaskHandle_t task) { waiter = task; }
+
+static bool queue(const ShardRequest& req) {
+    if (!active || !(req.op == OP_FETCH ? fetch_requests : coord_requests).push(req)) return false;
+    xTaskNotifyGive(io_task);
+    return true;
+}
+
+bool shard_handoff(int slot, const PlayerRecord& rec) {
+    ShardRequest req{};
+    req.op = OP_HANDOFF;
+    req.slot = static_cast<int16_t>(slot);
+    req.uuid_hi = rec.uuid_hi;
+    req.uuid_lo = rec.uuid_lo;
+    req.pose = rec.pose;
+    return queue(req);
+}
+
+bool shard_claim(int slot, uint64_t uuid_hi, uint64_t uuid_lo) {
+    ShardRequest req{};
+    req.op = OP_CLAIM;
+    req.slot = static_cast<int16_t>(slot);
+    req.uuid_hi = uuid_hi;
+    req.uuid_lo = uuid_lo;
+    return queue(req);
+}
+
+bool shard_reply(ShardReply& r) {
+    ShardResult res;
+    while (results.pop(res)) {
+        if (res.op != OP_FETCH) {
+            r.kind = res.op == OP_HANDOFF ? SHARD_HANDOFF : SHARD_CLAIM;
+            r.ok = res.ok;
+            r.slot = res.slot;
+            r.uuid_hi = res.uuid_hi;
+            r.uuid_lo = res.uuid_lo;
+            r.pose = res.pose;
+            return true;
+        }
+        Fetch& f = fetches[res.slot];
+        f.state = res.ok ? FetchState::DONE : FetchState::FAILED;
+        f.data = res.data;
+        f.len = res.len;
+        if (!res.ok) retry_at[shard_owner(f.cx)] = now_ms() + MC_SHARD_RETRY_MS;
+    }
+    return false;
+}
+
+static void fetch_release(Fetch& f) {
+    mem_free(f.data);
+    f.data = nullptr;
+    f.state = FetchState::FREE;
+}
+
+ShardChunk shard_chunk(int cx, int cz, PacketBuf& out) {
+    int owner = shard_owner(cx);
+    if (!active || owner == self_id) return SHARD_CHUNK_LOCAL;
+    for (auto& f : fetches) {
+        if (f.state == FetchState::FREE || f.cx != cx || f.cz != cz) continue;
+        if (f.state == FetchState::WAIT) return SHARD_CHUNK_WAIT;
+        bool ok = f.state == FetchState::DONE;
+        if (ok) {
+            out.reset();
+            out.append(f.data, f.len);
+        }
+        fetch_release(f);
+        return ok ? SHARD_CHUNK_READY : SHARD_CHUNK_LOCAL;
+    }
+    uint32_t now = now_ms();
+    if (static_cast<int32_t>(retry_at[owner] - now) > 0) return SHARD_CHUNK_LOCAL;
+
+    // A free entry, or else the oldest fetched chunk nobody came back for
+    Fetch* slot = nullptr;
+    for (auto& f : fetches) {
+        if (f.state == FetchState::WAIT) continue;
+        if (f.state == FetchState::FREE) {
+            slot = &f;
+            break;
+        }
+        if (!slot || static_cast<int32_t>(f.stamp - slot->stamp) < 0) slot = &f;
+    }
+    if (!slot) return SHARD_CHUNK_WAIT;
+    if (slot->state != FetchState::FREE) fetch_release(*slot);
+
+    ShardRequest req{};
+    req.op = OP_FETCH;
+    req.slot = static_cast<int16_t>(slot - fetches);
+    req.cx = cx;
+    req.cz = cz;
+    if (!queue(req)) return SHARD_CHUNK_WAIT;
+    slot->state = FetchState::WAIT;
+    slot->cx = cx;
+    slot->cz = cz;
+    slot->stamp = now;
+    return SHARD_CHUNK_WAIT;
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "mc_packet.h"
+#include "mc_store.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <cstdint>
+
+// One world served by several nodes. Each node owns a band of chunk columns
+// [cx_min, cx_max] (every cz); together the bands cover all x. The
+// coordinator (host/coordinator.cpp) holds the band table and carries a
+// player's pose from the node they leave to the node they join, which the
+// client is sent to with a Transfer packet.
+//
+// Chunks owned by another node are fetched from that node's peer port. The
+// owner builds them from the generator on its own task, so both nodes show
+// the same terrain, but block edits are not shared: an edit stays on the
+// node where it was made. A failed fetch falls back to generating the chunk
+// locally. Until shard_start succeeds the server is a single node that owns
+// everything.
+//
+// Coordinator calls and fetches never run on the simulation task: it queues
+// them for the shard I/O task, which waits on the sockets (at most
+// MC_SHARD_TIMEOUT_MS a request) and hands the results back through a ring.
+
+struct ShardNode {
+    char host[40];
+    uint16_t port;          // Minecraft clients
+    uint16_t peer_port;     // chunk requests from other nodes
+    int32_t cx_min, cx_max;
+};
+
+// Fetches the band table from the coordinator and starts the peer and I/O
+// tasks
+bool shard_start(const char* coord_host, uint16_t coord_port, int self);
+bool shard_active();
+int  shard_self();
+const ShardNode& shard_node(int id);
+// Node owning chunk column cx
+int  shard_owner(int cx);
+// Node a player at block x should move to, or -1 to stay. A player is only
+// moved once MC_SHARD_MARGIN blocks inside another band, so walking along
+// an edge does not bounce between nodes.
+int  shard_target(double x);
+
+// Simulation task side
+
+// Task woken whenever a reply or a fetched chunk is ready
+void shard_set_waiter(TaskHandle_t task);
+// Queues leaving rec's pose for the player's next node; false if the queue
+// is full. The reply carries slot and the uuid back.
+bool shard_handoff(int slot, const PlayerRecord& rec);
+// Queues taking the pose left by the player's previous node, if any
+bool shard_claim(int slot, uint64_t uuid_hi, uint64_t uuid_lo);
+
+enum ShardReplyKind : uint8_t { SHARD_HANDOFF, SHARD_CLAIM };
+
+struct ShardReply {
+    ShardReplyKind kind;
+    bool ok;
+    int slot;
+    uint64_t uuid_hi, uuid_lo;
+    PlayerPose pose;        // SHARD_CLAIM
+};
+
+// Files fetched chunks for shard_chunk and returns the next coordinator
+// reply; false once there is none
+bool shard_reply(ShardReply& r);
+
+enum ShardChunk : uint8_t {
+    SHARD_CHUNK_LOCAL,      // build it here
+    SHARD_CHUNK_READY,      // out holds the owner's Chunk Data
+    SHARD_CHUNK_WAIT        // on its way; ask again after the next reply
+};
+
+// Chunk Data (id and payload) for (cx, cz) from the node that owns it,
+// requested the first time it is asked for. LOCAL when this node owns it
+// or the owner failed within MC_SHARD_RETRY_MS.
+ShardChunk shard_chunk(int cx, int cz, PacketBuf& out);
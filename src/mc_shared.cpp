@@ -0,0 +1,53 @@
+#include "mc_shared.h"
+#include "mc_types.h"
+#include "mc_metrics.h"
+#include <cstring>
+#include <new>
+
+SharedPacket* shared_packet(const PacketBuf& pkt) {
+    if (pkt.failed) return nullptr;
+    uint8_t hdr[5];
+    int hdr_len = mc_write_varint(hdr, static_cast<int32_t>(pkt.total()));
+    size_t own = sizeof(SharedPacket) + hdr_len + pkt.len;
+    size_t seg_at = (own + alignof(NetSeg) - 1) & ~(alignof(NetSeg) - 1);
+    int max_segs = 1 + pkt.segments(nullptr, pkt.data);
+    void* mem = mem_alloc(MEM_PACKET, seg_at + max_segs * sizeof(NetSeg));
+    if (!mem) return nullptr;
+    auto* p = new (mem) SharedPacket;
+    p->refs.store(1, std::memory_order_relaxed);
+    p->len = hdr_len + pkt.total();
+    p->hdr_len = hdr_len;
+    memcpy(p->data(), hdr, hdr_len);
+    memcpy(p->data() + hdr_len, pkt.data, pkt.len);
+    metrics_copied(hdr_len + pkt.len);
+
+    // The prefix joins the packet's first owned run
+    p->segs = reinterpret_cast<NetSeg*>(static_cast<uint8_t*>(mem) + seg_at);
+    p->segs[0] = {p->data(), static_cast<size_t>(hdr_len)};
+    int n = pkt.segments(p->segs + 1, p->data() + hdr_len);
+    if (n > 0 && p->segs[1].data == p->data() + hdr_len) {
+        p->segs[0].len += p->segs[1].len;
+        memmove(p->segs + 1, p->segs + 2, (n - 1) * sizeof(NetSeg));
+        n--;
+    }
+    p->seg_count = static_cast<uint8_t>(1 + n);
+    return p;
+}
+
+void shared_release(SharedPacket* p) {
+    if (p->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) mem_free(p);
+}
+
+int shared_segments(const SharedPacket* p, uint32_t from, NetSeg* out) {
+    int n = 0;
+    for (int i = 0; i < p->seg_count; i++) {
+        const NetSeg& s = p->segs[i];
+        if (from >= s.len) {
+            from -= s.len;
+            continue;
+        }
+        out[n++] = {static_cast<const uint8_t*>(s.data) + from, s.len - from};
+        from = 0;
+    }
+    return n;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "mc_packet.h"
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+// Most pieces a shared packet sends as: the length prefix, then the packet's
+static constexpr int SHARED_SEGS = PACKET_SEGS + 1;
+
+// Immutable, reference-counted packet: framed once (length prefix, id,
+// payload) and queued to any number of connections without copying. The
+// simulation task takes references and the network task drops them, so the
+// count is atomic. Bytes the packet referenced stay where they are; segs
+// lists the framed bytes in order, owned ones pointing into data().
+struct SharedPacket {
+    std::atomic<uint32_t> refs;
+    uint32_t len;       // framed length
+    uint8_t hdr_len;    // bytes of length prefix before the frame
+    uint8_t seg_count;
+    NetSeg* segs;       // in the same allocation, after the owned bytes
+
+    // Owned bytes (length prefix, then the packet's own) follow the header
+    uint8_t* data() { return reinterpret_cast<uint8_t*>(this + 1); }
+};
+
+// Frames pkt (id + payload) into a new shared packet with one reference;
+// nullptr when out of memory or pkt failed
+SharedPacket* shared_packet(const PacketBuf& pkt);
+inline void shared_retain(SharedPacket* p) { p->refs.fetch_add(1, std::memory_order_relaxed); }
+void shared_release(SharedPacket* p);
+// Pieces of the framed bytes from offset `from` on; returns their count
+int shared_segments(const SharedPacket* p, uint32_t from, NetSeg* out);
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// Bounded single-producer, single-consumer ring. One task pushes and one
+// task pops; neither blocks or takes a lock. The producer publishes an item
+// with a release store of tail, and the consumer frees its slot with a
+// release store of head.
+//
+// N must be a power of two. Indices run freely and wrap with uint32_t.
+template <typename T, uint32_t N>
+struct SpscRing {
+    static_assert(N > 0 && (N & (N - 1)) == 0, "ring size must be a power of two");
+
+    alignas(64) std::atomic<uint32_t> head{0};   // next item to pop, owned by the consumer
+    alignas(64) std::atomic<uint32_t> tail{0};   // next slot to fill, owned by the producer
+    T items[N];
+
+    // Producer side
+    bool push(const T& v) {
+        uint32_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) == N) return false;
+        items[t & (N - 1)] = v;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    uint32_t room() const {
+        return N - (tail.load(std::memory_order_relaxed) - head.load(std::memory_order_acquire));
+    }
+
+    // Consumer side
+    bool pop(T& v) {
+        uint32_t h = head.load(std::memory_order_relaxed);
+        if (tail.load(std::memory_order_acquire) == h) return false;
+        v = items[h & (N - 1)];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool empty() const {
+        return tail.load(std::memory_order_acquire) == head.load(std::memory_order_relaxed);
+    }
+};
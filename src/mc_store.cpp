@@ -0,0 +1,246 @@
+#include "mc_store.h"
+#include "mc_mem.h"
+#include "config.h"
+#include "esp_log.h"
+#include "nvs.h"
+#include <cstdio>
+#include <cstring>
+
+static const char* TAG = "mc_store";
+
+static constexpr const char* NAMESPACE = "players";
+static constexpr uint8_t POSE_VERSION = 1;
+
+// NVS stores blobs in 32-byte entries plus an index and a chunk header
+static constexpr uint32_t NVS_ENTRY = 32;
+
+struct PoseBlob {
+    uint8_t version;
+    uint8_t pad[7];
+    uint64_t uuid_hi, uuid_lo;
+    PlayerPose pose;
+};
+
+struct Entry {
+    bool used;
+    bool pose_dirty;
+    bool inv_dirty;
+    uint32_t last_use;
+    PlayerRecord rec;
+};
+
+static Entry* entries = nullptr;
+static nvs_handle_t nvs;
+static bool nvs_ok = false;
+static uint32_t use_clock = 0;
+static StoreStats stats;
+
+// 12 hex digits of a UUID hash plus 'p' (pose) or 'i' (inventory); NVS
+// keys are at most 15 characters
+static void key_for(uint64_t hi, uint64_t lo, char kind, char key[16]) {
+    uint64_t h = hi ^ (lo * 0x9E3779B97F4A7C15ULL);
+    h ^= h >> 29;
+    snprintf(key, 16, "%012llx%c", static_cast<unsigned long long>(h & 0xFFFFFFFFFFFFULL), kind);
+}
+
+static Entry* find(uint64_t hi, uint64_t lo) {
+    for (int i = 0; i < MC_STORE_PLAYERS; i++)
+        if (entries[i].used && entries[i].rec.uuid_hi == hi && entries[i].rec.uuid_lo == lo) return &entries[i];
+    return nullptr;
+}
+
+// A free entry, or the least recently used clean one
+static Entry* claim() {
+    Entry* best = nullptr;
+    for (int i = 0; i < MC_STORE_PLAYERS; i++) {
+        Entry& e = entries[i];
+        if (!e.used) return &e;
+        if (e.pose_dirty || e.inv_dirty) continue;
+        if (!best || use_clock - e.last_use > use_clock - best->last_use) best = &e;
+    }
+    return best;
+}
+
+// Reads a record from NVS given its pose key
+static bool load(const char* pose_key, PlayerRecord& rec) {
+    PoseBlob blob;
+    size_t len = sizeof(blob);
+    if (nvs_get_blob(nvs, pose_key, &blob, &len) != ESP_OK || len != sizeof(blob) ||
+        blob.version != POSE_VERSION)
+        return false;
+    memset(&rec, 0, sizeof(rec));
+    rec.uuid_hi = blob.uuid_hi;
+    rec.uuid_lo = blob.uuid_lo;
+    rec.pose = blob.pose;
+
+    char inv_key[16];
+    memcpy(inv_key, pose_key, 16);
+    inv_key[12] = 'i';
+    len = sizeof(rec.inv);
+    if (nvs_get_blob(nvs, inv_key, rec.inv, &len) != ESP_OK || len != sizeof(rec.inv))
+        memset(rec.inv, 0, sizeof(rec.inv));
+    return true;
+}
+
+void store_init() {
+    if (entries) return;
+    entries = static_cast<Entry*>(mem_alloc(MEM_CACHE, sizeof(Entry) * MC_STORE_PLAYERS));
+    if (!entries) {
+        ESP_LOGE(TAG, "No memory for %d player records", MC_STORE_PLAYERS);
+        return;
+    }
+    memset(entries, 0, sizeof(Entry) * MC_STORE_PLAYERS);
+
+    esp_err_t err = nvs_open(NAMESPACE, NVS_READWRITE, &nvs);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "NVS unavailable (%d), player state will not persist", err);
+        return;
+    }
+    nvs_ok = true;
+
+    // Warm the cache so logins never wait on flash
+    int loaded = 0;
+    nvs_iterator_t it = nullptr;
+    for (err = nvs_entry_find(NVS_DEFAULT_PART_NAME, NAMESPACE, NVS_TYPE_BLOB, &it);
+         err == ESP_OK && loaded < MC_STORE_PLAYERS; err = nvs_entry_next(&it)) {
+        nvs_entry_info_t info;
+        nvs_entry_info(it, &info);
+        if (strlen(info.key) != 13 || info.key[12] != 'p') continue;
+        if (load(info.key, entries[loaded].rec)) entries[loaded++].used = true;
+    }
+    nvs_release_iterator(it);
+    ESP_LOGI(TAG, "Loaded %d player records", loaded);
+}
+
+bool store_find(uint64_t uuid_hi, uint64_t uuid_lo, PlayerRecord& out) {
+    if (!entries) return false;
+    Entry* e = find(uuid_hi, uuid_lo);
+    if (!e && nvs_ok) {
+        // Evicted earlier; one NVS read brings it back
+        char key[16];
+        key_for(uuid_hi, uuid_lo, 'p', key);
+        PlayerRecord rec;
+        if (!load(key, rec) || rec.uuid_hi != uuid_hi || rec.uuid_lo != uuid_lo) return false;
+        e = claim();
+        if (!e) {
+            out = rec;
+            return true;
+        }
+        memset(e, 0, sizeof(*e));
+        e->used = true;
+        e->rec = rec;
+    }
+    if (!e) return false;
+    e->last_use = ++use_clock;
+    out = e->rec;
+    return true;
+}
+
+void store_put(const PlayerRecord& rec) {
+    if (!entries) return;
+    Entry* e = find(rec.uuid_hi, rec.uuid_lo);
+    if (!e) {
+        e = claim();
+        if (!e) {
+            // Every cached record is dirty: write them out to make room
+            store_flush();
+            e = claim();
+            if (!e) return;
+        }
+        memset(e, 0, sizeof(*e));
+        e->used = true;
+        e->pose_dirty = e->inv_dirty = true;
+        e->rec = rec;
+    } else {
+        bool pose = memcmp(&e->rec.pose, &rec.pose, sizeof(rec.pose)) != 0;
+        bool inv = memcmp(e->rec.inv, rec.inv, sizeof(rec.inv)) != 0;
+        if (!pose && !inv) stats.unchanged++;
+        e->pose_dirty |= pose;
+        e->inv_dirty |= inv;
+        e->rec = rec;
+    }
+    e->last_use = ++use_clock;
+}
+
+static bool write_blob(const char* key, const void* data, size_t len) {
+    esp_err_t err = nvs_set_blob(nvs, key, data, len);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Writing %s failed (%d)", key, err);
+        stats.failures++;
+        return false;
+    }
+    stats.entries += 2 + (len + NVS_ENTRY - 1) / NVS_ENTRY;
+    return true;
+}
+
+bool store_flush() {
+    if (!entries || !nvs_ok) return false;
+    bool ok = true, wrote = false;
+    for (int i = 0; i < MC_STORE_PLAYERS; i++) {
+        Entry& e = entries[i];
+        if (!e.used) continue;
+        char key[16];
+        if (e.pose_dirty) {
+            PoseBlob blob;
+            memset(&blob, 0, sizeof(blob));
+            blob.version = POSE_VERSION;
+            blob.uuid_hi = e.rec.uuid_hi;
+            blob.uuid_lo = e.rec.uuid_lo;
+            blob.pose = e.rec.pose;
+            key_for(e.rec.uuid_hi, e.rec.uuid_lo, 'p', key);
+            if (write_blob(key, &blob, sizeof(blob))) {
+                e.pose_dirty = false;
+                stats.pose_writes++;
+                wrote = true;
+            } else {
+                ok = false;
+            }
+        }
+        if (e.inv_dirty) {
+            key_for(e.rec.uuid_hi, e.rec.uuid_lo, 'i', key);
+            if (write_blob(key, e.rec.inv, sizeof(e.rec.inv))) {
+                e.inv_dirty = false;
+                stats.inv_writes++;
+                wrote = true;
+            } else {
+                ok = false;
+            }
+        }
+    }
+    if (!wrote) return ok;
+    if (nvs_commit(nvs) != ESP_OK) {
+        stats.failures++;
+        return false;
+    }
+    stats.flushes++;
+    return ok;
+}
+
+const StoreStats& store_stats() {
+    return stats;
+}
+
+size_t store_summary(char* buf, size_t cap) {
+    int cached = 0, dirty = 0;
+    for (int i = 0; entries && i < MC_STORE_PLAYERS; i++) {
+        cached += entries[i].used;
+        dirty += entries[i].used && (entries[i].pose_dirty || entries[i].inv_dirty);
+    }
+    int n = snprintf(buf, cap, "players=%d dirty=%d flushes=%u pose=%u inv=%u unchanged=%u entries=%u failed=%u%s",
+                     cached, dirty, static_cast<unsigned>(stats.flushes), static_cast<unsigned>(stats.pose_writes),
+                     static_cast<unsigned>(stats.inv_writes), static_cast<unsigned>(stats.unchanged),
+                     static_cast<unsigned>(stats.entries), static_cast<unsigned>(stats.failures),
+                     nvs_ok ? "" : " (no NVS)");
+    return n < 0 ? 0 : (static_cast<size_t>(n) < cap ? n : cap - 1);
+}
+
+size_t store_format_metrics(char* buf, size_t cap) {
+    int n = snprintf(buf, cap,
+                     "mc_store_flushes_total %u\nmc_store_writes_total{blob=\"pose\"} %u\n"
+                     "mc_store_writes_total{blob=\"inv\"} %u\nmc_store_unchanged_total %u\n"
+                     "mc_store_nvs_entries_total %u\nmc_store_failures_total %u\n",
+                     static_cast<unsigned>(stats.flushes), static_cast<unsigned>(stats.pose_writes),
+                     static_cast<unsigned>(stats.inv_writes), static_cast<unsigned>(stats.unchanged),
+                     static_cast<unsigned>(stats.entries), static_cast<unsigned>(stats.failures));
+    return n < 0 ? 0 : (static_cast<size_t>(n) < cap ? n : cap - 1);
+}
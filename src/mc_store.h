@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Persistent player state keyed by UUID, kept in the "players" NVS
+// namespace. Records known to NVS are loaded into RAM at start, so a login
+// looks its player up without touching flash.
+//
+// store_put only changes RAM. A record whose bytes did not change is not
+// marked dirty, and dirty records are written together by store_flush,
+// which the server calls every MC_STORE_FLUSH_MS and when a player leaves.
+// Pose and inventory are separate blobs, so moving around never rewrites
+// the inventory.
+
+static constexpr int STORE_INV_SLOTS = 46;     // player inventory window, crafting grid to offhand
+
+struct ItemStack {
+    uint16_t item;      // registry id; count 0 means empty
+    uint8_t count;
+    uint8_t pad;
+};
+
+struct PlayerPose {
+    double x, y, z;
+    float yaw, pitch;
+    float health;
+    uint8_t food;
+    uint8_t game_mode;  // 0 survival, 1 creative, 2 adventure, 3 spectator
+    uint8_t pad[2];     // explicit, so records compare bytewise
+};
+
+struct PlayerRecord {
+    uint64_t uuid_hi, uuid_lo;
+    PlayerPose pose;
+    ItemStack inv[STORE_INV_SLOTS];
+};
+
+struct StoreStats {
+    uint32_t flushes;       // NVS commits
+    uint32_t pose_writes;
+    uint32_t inv_writes;
+    uint32_t unchanged;     // puts that matched the stored bytes
+    uint32_t failures;
+    uint32_t entries;       // 32-byte NVS entries written, the wear measure
+};
+
+void store_init();
+// Record for the UUID, from RAM or (after an eviction) NVS; false if the
+// player has never been stored
+bool store_find(uint64_t uuid_hi, uint64_t uuid_lo, PlayerRecord& out);
+// Caches rec; it reaches NVS on the next flush if it changed
+void store_put(const PlayerRecord& rec);
+// Writes every dirty record and commits. False if any write failed.
+bool store_flush();
+const StoreStats& store_stats();
+size_t store_summary(char* buf, size_t cap);
+size_t store_format_metrics(char* buf, size_t cap);
@@ -0,0 +1,715 @@
+#include "mc_tick.h"
+#include "mc_play.h"
+#include "mc_light.h"
+#include "mc_nav.h"
+#include "mc_server.h"
+#include "mc_types.h"
+#include "mc_world.h"
+#include "mc_mem.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include <cstdio>
+#include <cstring>
+#include <utility>
+
+static const char* TAG = "mc_tick";
+
+static_assert((MC_TICK_EDIT_SECTIONS & (MC_TICK_EDIT_SECTIONS - 1)) == 0,
+              "MC_TICK_EDIT_SECTIONS must be a power of two");
+
+static constexpr int WORLD_HEIGHT = WORLD_SECTIONS * 16;
+static constexpr uint32_t WATER_DELAY = 5;     // game ticks between water updates
+
+// One loaded section (PSRAM)
+struct TickSection {
+    uint8_t pis[4096];      // blocks at x + z*16 + y*256, edits applied
+    uint64_t dirty[64];     // changed since the last flush
+    uint64_t queued[64];    // has a scheduled tick waiting
+    uint16_t changed;       // bits set in dirty
+    uint16_t grass;         // blocks that take random ticks
+};
+
+struct TickColumn {
+    int cx, cz;
+    bool used;
+    bool active;            // within MC_SIM_DISTANCE of a player this tick
+    bool surfaced;          // surface sections loaded for random ticks
+    bool resend;            // a section became all one block; the flush sends the chunk
+    uint32_t stamp;         // last use, for eviction
+    TickSection* sec[WORLD_SECTIONS];
+};
+
+// Edits of one section, sorted by block index
+struct EditList {
+    int32_t cx, cz;
+    int8_t si;              // -1 for a free slot
+    uint16_t count, cap;
+    uint32_t* entries;      // block index << 8 | pi
+};
+
+struct Scheduled {
+    uint32_t due;
+    uint32_t seq;
+    int32_t x, z;
+    int16_t y;
+};
+
+struct DirtyRef {
+    int16_t col;
+    int8_t si;
+};
+
+static TickColumn* columns;         // MC_TICK_COLUMNS
+static EditList* edits;             // MC_TICK_EDIT_SECTIONS, open addressing
+static Scheduled* heap;             // MC_TICK_SCHEDULED, min-heap on (due, seq)
+static uint8_t* region_before;      // 4096, a section before a region edit
+static uint8_t* region_after;       // 4096, and after it
+static uint32_t heap_len = 0;
+static DirtyRef dirty_list[MC_TICK_SECTIONS];
+static int dirty_count = 0;
+static int loaded = 0;
+static int edit_count = 0;
+static int last = 0;                // most recently used column, checked first
+static uint32_t clock_stamp = 0;
+static uint32_t now_tick = 0;
+static uint32_t next_seq = 0;
+static uint32_t rng = 0x9E3779B9u;
+static PacketBuf out;
+static TickStats stats;
+static bool ready = false;
+static bool edits_full_logged = false;
+
+static const int DIRS[6][3] = {{1, 0, 0}, {-1, 0, 0}, {0, 0, 1}, {0, 0, -1}, {0, 1, 0}, {0, -1, 0}};
+
+static bool init() {
+    if (ready) return true;
+    columns = static_cast<TickColumn*>(mem_alloc(MEM_CACHE, sizeof(TickColumn) * MC_TICK_COLUMNS));
+    edits = static_cast<EditList*>(mem_alloc(MEM_CACHE, sizeof(EditList) * MC_TICK_EDIT_SECTIONS));
+    heap = static_cast<Scheduled*>(mem_alloc(MEM_CACHE, sizeof(Scheduled) * MC_TICK_SCHEDULED));
+    region_before = static_cast<uint8_t*>(mem_alloc(MEM_CACHE, 2 * 4096));
+    region_after = region_before ? region_before + 4096 : nullptr;
+    if (!columns || !edits || !heap || !region_before) {
+        ESP_LOGE(TAG, "No memory for the tick engine");
+        mem_free(columns);
+        mem_free(edits);
+        mem_free(heap);
+        mem_free(region_before);
+        return false;
+    }
+    memset(columns, 0, sizeof(TickColumn) * MC_TICK_COLUMNS);
+    memset(edits, 0, sizeof(EditList) * MC_TICK_EDIT_SECTIONS);
+    for (int i = 0; i < MC_TICK_EDIT_SECTIONS; i++) edits[i].si = -1;
+    out.init(2048, MEM_SCRATCH);
+    ready = true;
+    return true;
+}
+
+static uint32_t next_random() {
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return rng;
+}
+
+static bool is_water(uint8_t pi) { return pi == PI_WATER || pi >= PI_FLOW; }
+// Water washes these away
+static bool replaceable(uint8_t pi) { return pi == PI_AIR || pi == PI_TALLGRASS; }
+// Blocks that smother grass under them
+static bool opaque(uint8_t pi) {
+    return pi == PI_STONE || pi == PI_DIRT || pi == PI_GRASS || pi == PI_LOG || pi == PI_SAND || pi == PI_COAL ||
+           pi == PI_IRON;
+}
+// Distance from a source: 0 for sources and falling water, 1..7 flowing
+static int water_level(uint8_t pi) {
+    return pi >= PI_FLOW && pi < PI_FALLING ? pi - PI_FLOW + 1 : 0;
+}
+
+static int block_index(int x, int y, int z) {
+    return (x & 15) + (z & 15) * 16 + ((y - WORLD_MIN_Y) & 15) * 256;
+}
+
+// ---- Edits ----
+
+static EditList* edit_list(int cx, int cz, int si, bool create) {
+    uint32_t h = static_cast<uint32_t>(cx * 73856093 ^ cz * 19349663 ^ si * 83492791);
+    const uint32_t mask = MC_TICK_EDIT_SECTIONS - 1;
+    for (uint32_t i = h & mask, n = 0; n <= mask; i = (i + 1) & mask, n++) {
+        EditList& e = edits[i];
+        if (e.si < 0) {
+            // Keep a quarter free so probes stay short
+            if (!create || edit_count >= MC_TICK_EDIT_SECTIONS * 3 / 4) return nullptr;
+            e.cx = cx;
+            e.cz = cz;
+            e.si = static_cast<int8_t>(si);
+            edit_count++;
+            return &e;
+        }
+        if (e.cx == cx && e.cz == cz && e.si == si) return &e;
+    }
+    return nullptr;
+}
+
+static bool record_edit(int cx, int cz, int si, int idx, uint8_t pi) {
+    EditList* e = edit_list(cx, cz, si, true);
+    if (!e) {
+        if (!edits_full_logged) ESP_LOGW(TAG, "Edit table full (%d sections); further edits refused", edit_count);
+        edits_full_logged = true;
+        return false;
+    }
+    int lo = 0, hi = e->count;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (static_cast<int>(e->entries[mid] >> 8) < idx) lo = mid + 1;
+        else hi = mid;
+    }
+    uint32_t entry = static_cast<uint32_t>(idx) << 8 | pi;
+    if (lo < e->count && static_cast<int>(e->entries[lo] >> 8) == idx) {
+        e->entries[lo] = entry;
+        return true;
+    }
+    if (e->count == e->cap) {
+        uint16_t cap = e->cap ? e->cap * 2 : 16;
+        auto* grown = static_cast<uint32_t*>(mem_alloc(MEM_CACHE, cap * sizeof(uint32_t)));
+        if (!grown) return false;
+        if (e->count) memcpy(grown, e->entries, e->count * sizeof(uint32_t));
+        mem_free(e->entries);
+        e->entries = grown;
+        e->cap = cap;
+    }
+    memmove(e->entries + lo + 1, e->entries + lo, (e->count - lo) * sizeof(uint32_t));
+    e->entries[lo] = entry;
+    e->count++;
+    return true;
+}
+
+int tick_apply_edits(int cx, int cz, int si, uint8_t* pis, int block_count) {
+    if (!ready) return block_count;
+    EditList* e = edit_list(cx, cz, si, false);
+    if (!e || !e->count) return block_count;
+    if (block_count == 0) memset(pis, PI_AIR, 4096);
+    for (int i = 0; i < e->count; i++) {
+        int idx = e->entries[i] >> 8;
+        auto pi = static_cast<uint8_t>(e->entries[i]);
+        block_count += (pi != PI_AIR) - (pis[idx] != PI_AIR);
+        pis[idx] = pi;
+    }
+    return block_count;
+}
+
+bool tick_edited(int cx, int cz, int si) {
+    if (!ready) return false;
+    EditList* e = edit_list(cx, cz, si, false);
+    return e && e->count;
+}
+
+// ---- Loaded columns and sections ----
+
+static TickColumn* find(int cx, int cz) {
+    TickColumn& hot = columns[last];
+    if (hot.used && hot.cx == cx && hot.cz == cz) return &hot;
+    for (int i = 0; i < MC_TICK_COLUMNS; i++) {
+        TickColumn& c = columns[i];
+        if (c.used && c.cx == cx && c.cz == cz) {
+            last = i;
+            return &c;
+        }
+    }
+    return nullptr;
+}
+
+static int section_count(const TickColumn& c) {
+    int n = 0;
+    for (auto* s : c.sec) n += s != nullptr;
+    return n;
+}
+
+static void release(TickColumn& c) {
+    // The dirty list points into columns; send it before one goes
+    for (auto* s : c.sec)
+        if (s && s->changed) {
+            tick_flush();
+            break;
+        }
+    for (auto& s : c.sec) {
+        if (!s) continue;
+        mem_free(s);
+        s = nullptr;
+        loaded--;
+    }
+    c.used = false;
+}
+
+// Least recently used column outside the simulation area, other than keep,
+// optionally only among those holding sections; -1 if none
+static int victim(const TickColumn* keep, bool with_sections) {
+    int v = -1;
+    for (int i = 0; i < MC_TICK_COLUMNS; i++) {
+        const TickColumn& c = columns[i];
+        if (!c.used || c.active || &c == keep || (with_sections && !section_count(c))) continue;
+        if (v < 0 || c.stamp - columns[v].stamp > 0x80000000u) v = i;   // older
+    }
+    return v;
+}
+
+static TickColumn* column_at(int cx, int cz) {
+    TickColumn* c = find(cx, cz);
+    if (!c) {
+        int slot = -1;
+        for (int i = 0; i < MC_TICK_COLUMNS && slot < 0; i++)
+            if (!columns[i].used) slot = i;
+        if (slot < 0) slot = victim(nullptr, false);
+        if (slot < 0) return nullptr;
+        c = &columns[slot];
+        release(*c);
+        memset(c, 0, sizeof(*c));
+        c->cx = cx;
+        c->cz = cz;
+        c->used = true;
+        last = slot;
+    }
+    c->stamp = ++clock_stamp;
+    return c;
+}
+
+static TickSection* section_at(TickColumn& c, int si) {
+    if (c.sec[si]) return c.sec[si];
+    while (loaded >= MC_TICK_SECTIONS) {
+        int v = victim(&c, true);
+        if (v < 0) return nullptr;
+        release(columns[v]);
+    }
+    auto* s = static_cast<TickSection*>(mem_alloc(MEM_CACHE, sizeof(TickSection)));
+    if (!s) return nullptr;
+    tick_apply_edits(c.cx, c.cz, si, s->pis, gen_section_at(s->pis, c.cx, c.cz, si));
+    memset(s->dirty, 0, sizeof(s->dirty));
+    memset(s->queued, 0, sizeof(s->queued));
+    s->changed = 0;
+    s->grass = 0;
+    for (uint8_t pi : s->pis) s->grass += pi == PI_GRASS;
+    c.sec[si] = s;
+    loaded++;
+    return s;
+}
+
+// Section holding a block, loaded on demand; col is its column's index
+static TickSection* locate(int x, int y, int z, int& col) {
+    if (y < WORLD_MIN_Y || y >= WORLD_MIN_Y + WORLD_HEIGHT || !init()) return nullptr;
+    TickColumn* c = column_at(x >> 4, z >> 4);
+    if (!c) return nullptr;
+    col = static_cast<int>(c - columns);
+    return section_at(*c, (y - WORLD_MIN_Y) >> 4);
+}
+
+uint8_t tick_block(int x, int y, int z) {
+    if (y >= WORLD_MIN_Y + WORLD_HEIGHT) return PI_AIR;
+    int col;
+    TickSection* s = locate(x, y, z, col);
+    return s ? s->pis[block_index(x, y, z)] : static_cast<uint8_t>(PI_STONE);
+}
+
+// ---- Scheduled ticks ----
+
+static bool earlier(const Scheduled& a, const Scheduled& b) {
+    if (a.due != b.due) return static_cast<int32_t>(a.due - b.due) < 0;
+    return static_cast<int32_t>(a.seq - b.seq) < 0;
+}
+
+static void heap_push(const Scheduled& t) {
+    uint32_t i = heap_len++;
+    while (i > 0) {
+        uint32_t parent = (i - 1) / 2;
+        if (!earlier(t, heap[parent])) break;
+        heap[i] = heap[parent];
+        i = parent;
+    }
+    heap[i] = t;
+}
+
+static Scheduled heap_pop() {
+    Scheduled top = heap[0];
+    Scheduled t = heap[--heap_len];
+    uint32_t i = 0;
+    while (true) {
+        uint32_t child = i * 2 + 1;
+        if (child >= heap_len) break;
+        if (child + 1 < heap_len && earlier(heap[child + 1], heap[child])) child++;
+        if (!earlier(heap[child], t)) break;
+        heap[i] = heap[child];
+        i = child;
+    }
+    if (heap_len) heap[i] = t;
+    return top;
+}
+
+// Schedules a water update; a block already waiting keeps its earlier one
+static void schedule(int x, int y, int z) {
+    int col;
+    TickSection* s = locate(x, y, z, col);
+    int idx = block_index(x, y, z);
+    uint64_t bit = 1ULL << (idx & 63);
+    if (s && (s->queued[idx >> 6] & bit)) return;
+    if (!s || heap_len >= MC_TICK_SCHEDULED) {
+        stats.dropped++;
+        return;
+    }
+    s->queued[idx >> 6] |= bit;
+    heap_push({now_tick + WATER_DELAY, next_seq++, x, z, static_cast<int16_t>(y)});
+}
+
+// A block changed: its water neighbours re-check their level, and the
+// block itself runs an update if water is next to it or it is water
+static void wake(int x, int y, int z, uint8_t pi, bool self) {
+    bool near_water = false;
+    for (const auto& d : DIRS) {
+        int nx = x + d[0], ny = y + d[1], nz = z + d[2];
+        if (!is_water(tick_block(nx, ny, nz))) continue;
+        schedule(nx, ny, nz);
+        near_water = true;
+    }
+    if (self && (near_water || is_water(pi))) schedule(x, y, z);
+}
+
+static bool change(int x, int y, int z, uint8_t pi, bool wake_self) {
+    int col;
+    TickSection* s = locate(x, y, z, col);
+    if (!s) return false;
+    int idx = block_index(x, y, z);
+    uint8_t old = s->pis[idx];
+    if (old == pi) return true;
+    int si = (y - WORLD_MIN_Y) >> 4;
+    if (!record_edit(x >> 4, z >> 4, si, idx, pi)) return false;
+    s->pis[idx] = pi;
+    s->grass += (pi == PI_GRASS) - (old == PI_GRASS);
+    uint64_t bit = 1ULL << (idx & 63);
+    if (!(s->dirty[idx >> 6] & bit)) {
+        s->dirty[idx >> 6] |= bit;
+        if (s->changed++ == 0) dirty_list[dirty_count++] = {static_cast<int16_t>(col), static_cast<int8_t>(si)};
+    }
+    world_set_block(x, y, z, block_occ(pi));
+    stats.changes++;
+    light_block_changed(x, y, z, old, pi);
+    nav_block_changed(x, y, z, old, pi);
+    wake(x, y, z, pi, wake_self);
+    return true;
+}
+
+bool tick_set_block(int x, int y, int z, uint8_t pi) {
+    return pi < PI_COUNT && change(x, y, z, pi, true);
+}
+
+// ---- Region edits ----
+
+// Edits the part of a region inside section si of chunk (cx, cz), local
+// corners lo..hi; returns the blocks changed
+static int edit_section(int cx, int cz, int si, const int lo[3], const int hi[3], TickEditFn fn, void* arg) {
+    const int bx = cx * 16, by = WORLD_MIN_Y + si * 16, bz = cz * 16;
+    int col;
+    TickSection* s = locate(bx, by, bz, col);
+    if (!s) return 0;
+    memcpy(region_before, s->pis, 4096);
+    uint64_t touched[64] = {};
+    int n = 0;
+    for (int y = lo[1]; y <= hi[1]; y++)
+        for (int z = lo[2]; z <= hi[2]; z++)
+            for (int x = lo[0]; x <= hi[0]; x++) {
+                int idx = x + z * 16 + y * 256;
+                uint8_t old = s->pis[idx];
+                uint8_t pi = fn(bx + x, by + y, bz + z, old, arg);
+                // Ascending indices append to the edit list
+                if (pi == old || pi >= PI_COUNT || !record_edit(cx, cz, si, idx, pi)) continue;
+                s->pis[idx] = pi;
+                s->grass += (pi == PI_GRASS) - (old == PI_GRASS);
+                uint64_t bit = 1ULL << (idx & 63);
+                touched[idx >> 6] |= bit;
+                if (!(s->dirty[idx >> 6] & bit)) {
+                    s->dirty[idx >> 6] |= bit;
+                    if (s->changed++ == 0)
+                        dirty_list[dirty_count++] = {static_cast<int16_t>(col), static_cast<int8_t>(si)};
+                }
+                n++;
+            }
+    if (!n) return 0;
+    stats.changes += n;
+    bool uniform = true;
+    for (int i = 1; i < 4096 && uniform; i++) uniform = s->pis[i] == s->pis[0];
+    if (uniform) columns[col].resend = true;
+    SectionMask m;
+    mask_section(m, s->pis);
+    world_update_section(cx, cz, si, m);
+    memcpy(region_after, s->pis, 4096);
+
+    // Light, paths and water reach into other columns, which may evict
+    // this one; only the copies are used from here
+    light_section_changed(cx, cz, si, region_before, region_after);
+    nav_region_changed(bx + lo[0], by + lo[1], bz + lo[2], bx + hi[0], by + hi[1], bz + hi[2]);
+    // Water only needs waking at the edges of the changed blocks: inside,
+    // every neighbour changed too and is either water, scheduled here, or
+    // not water
+    for (int w = 0; w < 64; w++)
+        for (uint64_t bits = touched[w]; bits; bits &= bits - 1) {
+            int idx = w * 64 + __builtin_ctzll(bits);
+            int x = idx & 15, z = (idx >> 4) & 15, y = idx >> 8;
+            bool inside = x > 0 && x < 15 && z > 0 && z < 15 && y > 0 && y < 15;
+            for (int d : {1, 16, 256}) {
+                if (!inside) break;
+                inside = (touched[(idx + d) >> 6] >> ((idx + d) & 63) & 1) &&
+                         (touched[(idx - d) >> 6] >> ((idx - d) & 63) & 1);
+            }
+            if (!inside) wake(bx + x, by + y, bz + z, region_after[idx], true);
+            else if (is_water(region_after[idx])) schedule(bx + x, by + y, bz + z);
+        }
+    return n;
+}
+
+int tick_edit_region(int x0, int y0, int z0, int x1, int y1, int z1, TickEditFn fn, void* arg) {
+    if (!init()) return 0;
+    if (x0 > x1) std::swap(x0, x1);
+    if (y0 > y1) std::swap(y0, y1);
+    if (z0 > z1) std::swap(z0, z1);
+    if (y0 < WORLD_MIN_Y) y0 = WORLD_MIN_Y;
+    if (y1 >= WORLD_MIN_Y + WORLD_HEIGHT) y1 = WORLD_MIN_Y + WORLD_HEIGHT - 1;
+    int n = 0;
+    for (int cz = z0 >> 4; cz <= z1 >> 4; cz++)
+        for (int cx = x0 >> 4; cx <= x1 >> 4; cx++)
+            for (int si = (y0 - WORLD_MIN_Y) >> 4; si <= (y1 - WORLD_MIN_Y) >> 4; si++) {
+                const int base[3] = {cx * 16, WORLD_MIN_Y + si * 16, cz * 16};
+                const int from[3] = {x0, y0, z0}, to[3] = {x1, y1, z1};
+                int lo[3], hi[3];
+                for (int a = 0; a < 3; a++) {
+                    lo[a] = from[a] > base[a] ? from[a] - base[a] : 0;
+                    hi[a] = to[a] < base[a] + 15 ? to[a] - base[a] : 15;
+                }
+                n += edit_section(cx, cz, si, lo, hi, fn, arg);
+            }
+    return n;
+}
+
+static uint8_t fill_with(int, int, int, uint8_t, void* arg) { return *static_cast<const uint8_t*>(arg); }
+
+int tick_fill(int x0, int y0, int z0, int x1, int y1, int z1, uint8_t pi) {
+    return pi < PI_COUNT ? tick_edit_region(x0, y0, z0, x1, y1, z1, fill_with, &pi) : 0;
+}
+
+// ---- Water ----
+
+// Open below: water there falls rather than spreading sideways
+static bool open_below(int x, int y, int z) {
+    uint8_t b = tick_block(x, y - 1, z);
+    return replaceable(b) || (is_water(b) && b != PI_WATER);
+}
+
+// What a non-source block at (x, y, z) should hold given its neighbours
+static uint8_t water_target(int x, int y, int z, uint8_t cur) {
+    if (is_water(tick_block(x, y + 1, z))) return PI_FALLING;
+    int sources = 0, best = 8;
+    for (int d = 0; d < 4; d++) {
+        int nx = x + DIRS[d][0], nz = z + DIRS[d][2];
+        uint8_t n = tick_block(nx, y, nz);
+        if (!is_water(n)) continue;
+        if (n == PI_WATER) sources++;
+        // Flowing water over a drop only feeds the block under it
+        if (n != PI_WATER && open_below(nx, y, nz)) continue;
+        int level = water_level(n);
+        if (level < best) best = level;
+    }
+    uint8_t below = tick_block(x, y - 1, z);
+    if (sources >= 2 && (below == PI_WATER || (!replaceable(below) && !is_water(below)))) return PI_WATER;
+    if (best + 1 <= 7) return static_cast<uint8_t>(PI_FLOW + best);
+    return is_water(cur) ? static_cast<uint8_t>(PI_AIR) : cur;
+}
+
+// Down first; sideways from a source, or when the way down is blocked
+static void water_spread(int x, int y, int z, uint8_t pi) {
+    if (open_below(x, y, z)) {
+        if (replaceable(tick_block(x, y - 1, z))) change(x, y - 1, z, PI_FALLING, true);
+        if (pi != PI_WATER) return;
+    }
+    int level = water_level(pi);
+    if (level >= 7) return;
+    auto next = static_cast<uint8_t>(PI_FLOW + level);
+    for (int d = 0; d < 4; d++) {
+        int nx = x + DIRS[d][0], nz = z + DIRS[d][2];
+        if (replaceable(tick_block(nx, y, nz))) change(nx, y, nz, next, true);
+    }
+}
+
+static void water_tick(int x, int y, int z) {
+    uint8_t cur = tick_block(x, y, z);
+    if (cur != PI_WATER) {
+        if (!is_water(cur) && !replaceable(cur)) return;
+        uint8_t want = water_target(x, y, z, cur);
+        if (want != cur) change(x, y, z, want, false);
+        if (!is_water(want)) return;
+        cur = want;
+    }
+    water_spread(x, y, z, cur);
+}
+
+// ---- Random ticks ----
+
+// Grass dies under an opaque block or water, otherwise spreads onto dirt
+// nearby that has open air above
+static void grass_tick(int x, int y, int z) {
+    uint8_t above = tick_block(x, y + 1, z);
+    if (opaque(above) || is_water(above)) {
+        change(x, y, z, PI_DIRT, true);
+        return;
+    }
+    for (int i = 0; i < 4; i++) {
+        uint32_t r = next_random();
+        int tx = x + static_cast<int>(r % 3) - 1;
+        int ty = y + static_cast<int>((r >> 8) % 5) - 3;
+        int tz = z + static_cast<int>((r >> 16) % 3) - 1;
+        if (tick_block(tx, ty, tz) != PI_DIRT) continue;
+        uint8_t over = tick_block(tx, ty + 1, tz);
+        if (!opaque(over) && !is_water(over)) change(tx, ty, tz, PI_GRASS, true);
+    }
+}
+
+// Marks the columns around the players active. Their surface sections
+// load the first time, so random ticks find their grass, at most
+// MC_TICK_LOADS columns a tick to keep a newly arrived player from
+// stalling the tick.
+static void activate(const int (*centers)[2], int count) {
+    for (int i = 0; i < MC_TICK_COLUMNS; i++) columns[i].active = false;
+    int loads = MC_TICK_LOADS;
+    for (int p = 0; p < count; p++)
+        for (int dz = -MC_SIM_DISTANCE; dz <= MC_SIM_DISTANCE; dz++)
+            for (int dx = -MC_SIM_DISTANCE; dx <= MC_SIM_DISTANCE; dx++) {
+                TickColumn* c = column_at(centers[p][0] + dx, centers[p][1] + dz);
+                if (!c) continue;
+                c->active = true;
+                if (c->surfaced || loads == 0) continue;
+                int lo, hi;
+                surface_sections(c->cx, c->cz, lo, hi);
+                for (int si = lo; si <= hi && si < WORLD_SECTIONS; si++) section_at(*c, si);
+                c->surfaced = true;
+                loads--;
+            }
+}
+
+void tick_run(const int (*centers)[2], int count) {
+    if (!init()) return;
+    int64_t start = esp_timer_get_time();
+    now_tick++;
+    stats.ticks++;
+    activate(centers, count);
+
+    for (int budget = MC_TICK_BUDGET; heap_len && static_cast<int32_t>(heap[0].due - now_tick) <= 0 && budget > 0;
+         budget--) {
+        Scheduled t = heap_pop();
+        TickColumn* c = find(t.x >> 4, t.z >> 4);
+        TickSection* s = c ? c->sec[(t.y - WORLD_MIN_Y) >> 4] : nullptr;
+        int idx = block_index(t.x, t.y, t.z);
+        uint64_t bit = 1ULL << (idx & 63);
+        // Gone with an evicted column, or a stale entry from before it
+        // was loaded again
+        if (!s || !(s->queued[idx >> 6] & bit)) continue;
+        s->queued[idx >> 6] &= ~bit;
+        if (!c->active) {
+            stats.dropped++;
+            continue;
+        }
+        water_tick(t.x, t.y, t.z);
+        stats.scheduled++;
+    }
+
+    for (int i = 0; i < MC_TICK_COLUMNS; i++) {
+        TickColumn& c = columns[i];
+        if (!c.used || !c.active) continue;
+        for (int si = 0; si < WORLD_SECTIONS; si++) {
+            TickSection* s = c.sec[si];
+            if (!s || !s->grass) continue;
+            for (int n = 0; n < MC_TICK_RANDOM; n++) {
+                int idx = static_cast<int>(next_random() & 4095);
+                if (s->pis[idx] != PI_GRASS) continue;
+                grass_tick(c.cx * 16 + (idx & 15), WORLD_MIN_Y + si * 16 + (idx >> 8), c.cz * 16 + ((idx >> 4) & 15));
+                stats.random++;
+            }
+        }
+    }
+
+    tick_flush();
+    stats.last_us = static_cast<uint32_t>(esp_timer_get_time() - start);
+    if (stats.last_us > stats.max_us) stats.max_us = stats.last_us;
+}
+
+// ---- Sending changes ----
+
+void tick_flush() {
+    for (int d = 0; d < dirty_count; d++) {
+        TickColumn& c = columns[dirty_list[d].col];
+        int si = dirty_list[d].si;
+        TickSection* s = c.sec[si];
+        int sy = si + WORLD_MIN_Y / 16;
+        if (c.resend) {
+            // Goes out with the whole chunk below
+            memset(s->dirty, 0, sizeof(s->dirty));
+            s->changed = 0;
+            continue;
+        }
+        out.reset();
+        if (s->changed == 1) {
+            int idx = 0;
+            while (!s->dirty[idx >> 6]) idx += 64;
+            idx += __builtin_ctzll(s->dirty[idx >> 6]);
+            pkt_write_varint(out, 0x09);
+            pkt_write_position(out, c.cx * 16 + (idx & 15), sy * 16 + (idx >> 8), c.cz * 16 + ((idx >> 4) & 15));
+            pkt_write_varint(out, block_state(s->pis[idx]));
+            stats.block_updates++;
+        } else {
+            pkt_write_varint(out, 0x4E);
+            pkt_write_i64(out, (static_cast<int64_t>(c.cx & 0x3FFFFF) << 42) |
+                                   (static_cast<int64_t>(c.cz & 0x3FFFFF) << 20) | (sy & 0xFFFFF));
+            pkt_write_varint(out, s->changed);
+            for (int w = 0; w < 64; w++)
+                for (uint64_t bits = s->dirty[w]; bits; bits &= bits - 1) {
+                    int idx = w * 64 + __builtin_ctzll(bits);
+                    int64_t entry = static_cast<int64_t>(block_state(s->pis[idx])) << 12 | (idx & 15) << 8 |
+                                    ((idx >> 4) & 15) << 4 | (idx >> 8);
+                    pkt_write_varlong(out, entry);
+                }
+            stats.section_updates++;
+        }
+        memset(s->dirty, 0, sizeof(s->dirty));
+        s->changed = 0;
+        stats.bytes += out.total();
+        server_broadcast(out, audience_chunk(c.cx, c.cz));
+    }
+    // A section that became all one block makes a chunk smaller than its
+    // list of changes
+    for (int d = 0; d < dirty_count; d++) {
+        TickColumn& c = columns[dirty_list[d].col];
+        if (!c.resend) continue;
+        c.resend = false;
+        build_chunk(out, c.cx, c.cz);
+        stats.chunks++;
+        stats.bytes += out.total();
+        server_broadcast(out, audience_chunk(c.cx, c.cz));
+    }
+    dirty_count = 0;
+    light_flush();
+}
+
+void tick_stats(TickStats& st) {
+    st = stats;
+    st.pending = heap_len;
+    st.sections = loaded;
+    st.edit_sections = edit_count;
+}
+
+size_t tick_summary(char* buf, size_t cap) {
+    TickStats st;
+    tick_stats(st);
+    int n = snprintf(buf, cap,
+                     "ticks=%u last=%uus max=%uus scheduled=%u pending=%u random=%u changes=%u "
+                     "packets=%u+%u+%u sections=%u edited=%u",
+                     static_cast<unsigned>(st.ticks), static_cast<unsigned>(st.last_us),
+                     static_cast<unsigned>(st.max_us), static_cast<unsigned>(st.scheduled),
+                     static_cast<unsigned>(st.pending), static_cast<unsigned>(st.random),
+                     static_cast<unsigned>(st.changes), static_cast<unsigned>(st.block_updates),
+                     static_cast<unsigned>(st.section_updates), static_cast<unsigned>(st.chunks),
+                     static_cast<unsigned>(st.sections),
+                     static_cast<unsigned>(st.edit_sections));
+    return n < 0 ? 0 : static_cast<size_t>(n) < cap ? n : cap - 1;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "config.h"
+#include <cstdint>
+#include <cstddef>
+
+// Block ticks for the chunks within MC_SIM_DISTANCE of a player.
+//
+// The engine owns the block edits made on top of the generator (per
+// section, kept for the life of the server) and, for the chunks it ticks,
+// the full block arrays of the sections it has needed so far. Every game
+// tick runs the scheduled ticks that are due, in the order they were
+// scheduled, then MC_TICK_RANDOM random ticks in each active section that
+// holds a block reacting to them (grass); a section with nothing to tick
+// costs one counter check.
+//
+// Water moves incrementally. A changed block schedules an update of itself
+// and of its water neighbours; an update looks at six neighbours, settles
+// its own level and spreads to open neighbours, which schedule theirs.
+// Nothing scans for fluids.
+//
+// Changes collect per section and go out at the end of the tick: a Block
+// Update for a lone change, one Update Section Blocks for the rest.
+// Light follows the changes through mc_light.
+//
+// Region edits (fills, explosions) go a section at a time: the edits,
+// collision masks, light and paths are updated once per section instead
+// of once per block. A section they leave all one block resends its whole
+// chunk at the flush, in place of that chunk's block changes.
+
+struct TickStats {
+    uint32_t ticks;
+    uint32_t scheduled;         // scheduled ticks run
+    uint32_t random;            // random ticks that hit a tickable block
+    uint32_t changes;           // blocks changed
+    uint32_t block_updates;     // Block Update packets
+    uint32_t section_updates;   // Update Section Blocks packets
+    uint32_t chunks;            // chunks resent whole after a region edit
+    uint32_t bytes;             // bytes of those three, one player's worth
+    uint32_t pending;           // scheduled ticks waiting
+    uint32_t dropped;           // schedules refused, queue full or chunk unloaded
+    uint32_t sections;          // sections loaded
+    uint32_t edit_sections;     // sections with edits
+    uint32_t last_us, max_us;   // tick_run time
+};
+
+// Changes one block (a PI_* index): records the edit, updates the
+// collision masks and wakes the water around it. False if the section
+// cannot be loaded or the edit table is full.
+bool tick_set_block(int x, int y, int z, uint8_t pi);
+// New block for one cell of a region edit, given the block there now;
+// returning old leaves it. Must not call into the tick engine.
+using TickEditFn = uint8_t (*)(int x, int y, int z, uint8_t old, void* arg);
+// Changes the blocks fn picks in the box between two corners (inclusive);
+// returns the blocks changed. Blocks whose section cannot be loaded, or
+// past a full edit table, are left.
+int tick_edit_region(int x0, int y0, int z0, int x1, int y1, int z1, TickEditFn fn, void* arg);
+// tick_edit_region setting every block of the box to pi
+int tick_fill(int x0, int y0, int z0, int x1, int y1, int z1, uint8_t pi);
+// Block at a position with edits applied; unloadable sections read as stone
+uint8_t tick_block(int x, int y, int z);
+// One game tick for the chunks around the given player chunks (cx, cz),
+// then tick_flush
+void tick_run(const int (*centers)[2], int count);
+// Sends the block changes collected so far, then the light they changed,
+// to the players that see them
+void tick_flush();
+// Applies the edits of section si of chunk (cx, cz) to generated blocks
+// (pis left unfilled when block_count is 0); returns the new non-air count
+int tick_apply_edits(int cx, int cz, int si, uint8_t* pis, int block_count);
+// True if section si of chunk (cx, cz) has edits
+bool tick_edited(int cx, int cz, int si);
+
+void tick_stats(TickStats& out);
+size_t tick_summary(char* buf, size_t cap);
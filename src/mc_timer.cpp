@@ -0,0 +1,123 @@
+#include "mc_timer.h"
+
+static constexpr int SLOT_BITS = 6;
+static constexpr uint32_t SLOT_MASK = TIMER_SLOTS - 1;
+
+static void list_init(TimerLink& head) {
+    head.next = &head;
+    head.prev = &head;
+}
+
+static void list_push(TimerLink& head, TimerLink& t) {
+    t.prev = head.prev;
+    t.next = &head;
+    head.prev->next = &t;
+    head.prev = &t;
+}
+
+static void list_unlink(TimerLink& t) {
+    t.prev->next = t.next;
+    t.next->prev = t.prev;
+    t.next = nullptr;
+    t.prev = nullptr;
+}
+
+// Moves every entry of src onto the (empty) dst list
+static void list_take(TimerLink& dst, TimerLink& src) {
+    if (src.next == &src) {
+        list_init(dst);
+        return;
+    }
+    dst.next = src.next;
+    dst.prev = src.prev;
+    dst.next->prev = &dst;
+    dst.prev->next = &dst;
+    list_init(src);
+}
+
+static void file_timer(TimerWheel& w, Timer& t) {
+    uint32_t delta = t.expires - w.cur;
+    if (static_cast<int32_t>(delta) < 0) {
+        t.expires = w.cur;
+        delta = 0;
+    }
+    int level = 0;
+    while (level < TIMER_LEVELS - 1 && delta >= (1u << (SLOT_BITS * (level + 1)))) level++;
+    if (level == TIMER_LEVELS - 1 && delta >= (1u << (SLOT_BITS * TIMER_LEVELS)))
+        t.expires = w.cur + (1u << (SLOT_BITS * TIMER_LEVELS)) - 1;
+    uint32_t slot = (t.expires >> (SLOT_BITS * level)) & SLOT_MASK;
+    list_push(w.slots[level][slot], t);
+}
+
+// Re-files one higher-level slot into the levels below; returns its index
+static uint32_t cascade(TimerWheel& w, int level) {
+    uint32_t slot = (w.cur >> (SLOT_BITS * level)) & SLOT_MASK;
+    TimerLink pending;
+    list_take(pending, w.slots[level][slot]);
+    while (pending.next != &pending) {
+        Timer& t = static_cast<Timer&>(*pending.next);
+        list_unlink(t);
+        file_timer(w, t);
+    }
+    return slot;
+}
+
+void wheel_init(TimerWheel& w, uint32_t now_ms) {
+    w.cur = 0;
+    w.cur_ms = now_ms;
+    for (auto& level : w.slots)
+        for (auto& slot : level) list_init(slot);
+}
+
+void wheel_advance(TimerWheel& w, uint32_t now_ms) {
+    while (static_cast<int32_t>(now_ms - w.cur_ms) >= 0) {
+        if ((w.cur & SLOT_MASK) == 0) {
+            for (int level = 1; level < TIMER_LEVELS; level++)
+                if (cascade(w, level) != 0) break;
+        }
+
+        // Detach the slot first so callbacks can re-arm into it safely
+        TimerLink due;
+        list_take(due, w.slots[0][w.cur & SLOT_MASK]);
+        w.cur++;
+        w.cur_ms += TIMER_TICK_MS;
+        while (due.next != &due) {
+            Timer& t = static_cast<Timer&>(*due.next);
+            list_unlink(t);
+            t.fn(t, t.arg);
+        }
+    }
+}
+
+uint32_t wheel_idle_ms(const TimerWheel& w, uint32_t now_ms, uint32_t cap_ms) {
+    uint32_t ticks = 0;
+    for (; ticks < TIMER_SLOTS; ticks++) {
+        uint32_t tick = w.cur + ticks;
+        if (ticks > 0 && (tick & SLOT_MASK) == 0) break;   // next cascade
+        const TimerLink& slot = w.slots[0][tick & SLOT_MASK];
+        if (slot.next != &slot) break;
+    }
+    uint32_t due_ms = w.cur_ms + ticks * TIMER_TICK_MS;
+    uint32_t wait = static_cast<int32_t>(due_ms - now_ms) > 0 ? due_ms - now_ms : 0;
+    return wait < cap_ms ? wait : cap_ms;
+}
+
+void timer_init(Timer& t, TimerFn fn, void* arg) {
+    t.next = nullptr;
+    t.prev = nullptr;
+    t.expires = 0;
+    t.fn = fn;
+    t.arg = arg;
+}
+
+void timer_schedule(TimerWheel& w, Timer& t, uint32_t at_ms) {
+    if (timer_pending(t)) list_unlink(t);
+    int32_t ahead = static_cast<int32_t>(at_ms - w.cur_ms);
+    if (ahead < 0) ahead = 0;
+    t.expires = w.cur + (static_cast<uint32_t>(ahead) + TIMER_TICK_MS - 1) / TIMER_TICK_MS;
+    file_timer(w, t);
+}
+
+void timer_cancel(Timer& t) {
+    if (timer_pending(t)) list_unlink(t);
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+
+// Hierarchical timer wheel: 4 levels of 64 slots at 16 ms resolution,
+// covering about 74 hours. Schedule, cancel and per-timer expiry are O(1);
+// a timer is re-filed at most once per level on its way down.
+//
+// Timers are intrusive and owned by the caller; a pending timer must be
+// cancelled before its storage goes away.
+
+static constexpr int      TIMER_LEVELS  = 4;
+static constexpr int      TIMER_SLOTS   = 64;
+static constexpr uint32_t TIMER_TICK_MS = 16;
+
+struct TimerLink {
+    TimerLink* next;
+    TimerLink* prev;
+};
+
+struct Timer;
+using TimerFn = void (*)(Timer& t, void* arg);
+
+struct Timer : TimerLink {
+    uint32_t expires;   // wheel ticks
+    TimerFn fn;
+    void* arg;
+};
+
+struct TimerWheel {
+    uint32_t cur;       // next tick to run
+    uint32_t cur_ms;    // clock time at which cur is due; wraps with the clock
+    TimerLink slots[TIMER_LEVELS][TIMER_SLOTS];
+};
+
+void wheel_init(TimerWheel& w, uint32_t now_ms);
+// Runs every timer due at or before now_ms. Callbacks may schedule or
+// cancel any timer, including the one being run.
+void wheel_advance(TimerWheel& w, uint32_t now_ms);
+// Time until the next occupied level-0 slot or cascade, at most cap_ms
+uint32_t wheel_idle_ms(const TimerWheel& w, uint32_t now_ms, uint32_t cap_ms);
+
+void timer_init(Timer& t, TimerFn fn, void* arg);
+// (Re)arms t to fire at at_ms; times already past fire on the next advance
+void timer_schedule(TimerWheel& w, Timer& t, uint32_t at_ms);
+void timer_cancel(Timer& t);
+inline bool timer_pending(const Timer& t) { return t.next != nullptr; }
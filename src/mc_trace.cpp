@@ -0,0 +1,84 @@
+#include "mc_trace.h"
+
+#if MC_TRACE
+
+#include "mc_mem.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_rom_sys.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include <cstring>
+
+static const char* TAG = "mc_trace";
+
+static constexpr uint32_t RING_MAGIC = 0x5452434D;   // "MCTR"
+
+__NOINIT_ATTR TraceEvent trace_ring[MC_TRACE_EVENTS];
+__NOINIT_ATTR uint32_t trace_head;
+static __NOINIT_ATTR uint32_t ring_magic;
+
+static TraceEvent* saved = nullptr;     // PSRAM, events oldest first
+static uint32_t saved_count = 0;
+static TickType_t last_clock[2];
+static bool clock_started[2];
+
+// Copies the ring, oldest first, into the saved buffer
+static void save_ring() {
+    uint32_t head = __atomic_load_n(&trace_head, __ATOMIC_RELAXED);
+    uint32_t count = head < MC_TRACE_EVENTS ? head : MC_TRACE_EVENTS;
+    uint32_t first = (head - count) & (MC_TRACE_EVENTS - 1);
+    uint32_t part = MC_TRACE_EVENTS - first < count ? MC_TRACE_EVENTS - first : count;
+    memcpy(saved, trace_ring + first, part * sizeof(TraceEvent));
+    memcpy(saved + part, trace_ring, (count - part) * sizeof(TraceEvent));
+    saved_count = count;
+}
+
+void trace_init() {
+    saved = static_cast<TraceEvent*>(mem_alloc(MEM_OTHER, sizeof(TraceEvent) * MC_TRACE_EVENTS));
+
+    esp_reset_reason_t reason = esp_reset_reason();
+    bool crashed = reason == ESP_RST_PANIC || reason == ESP_RST_INT_WDT || reason == ESP_RST_TASK_WDT ||
+                   reason == ESP_RST_WDT;
+    if (saved && crashed && ring_magic == RING_MAGIC) {
+        save_ring();
+        ESP_LOGW(TAG, "Kept %u events from before the reset (%d), see /trace/saved",
+                 static_cast<unsigned>(saved_count), reason);
+    }
+    __atomic_store_n(&trace_head, 0, __ATOMIC_RELAXED);
+    ring_magic = RING_MAGIC;
+}
+
+void trace_clock() {
+    int core = esp_cpu_get_core_id();
+    TickType_t now = xTaskGetTickCount();
+    if (clock_started[core] && (now - last_clock[core]) * portTICK_PERIOD_MS < 1000) return;
+    clock_started[core] = true;
+    last_clock[core] = now;
+    trace(TRACE_CLOCK, 0, 0, static_cast<uint32_t>(esp_timer_get_time()));
+}
+
+void trace_save() {
+    if (saved) save_ring();
+}
+
+bool trace_dump(bool from_saved, bool (*write)(const void* data, size_t len, void* ctx), void* ctx) {
+    TraceHeader hdr = {{'M', 'C', 'T', 'R'}, TRACE_VERSION, {0, 0, 0}, esp_rom_get_cpu_ticks_per_us(), 0};
+    if (from_saved) {
+        hdr.count = saved_count;
+        return write(&hdr, sizeof(hdr), ctx) && (!hdr.count || write(saved, hdr.count * sizeof(TraceEvent), ctx));
+    }
+    // The ring keeps recording while it is written out, so the oldest few
+    // events may already have been replaced by newer ones
+    uint32_t head = __atomic_load_n(&trace_head, __ATOMIC_RELAXED);
+    hdr.count = head < MC_TRACE_EVENTS ? head : MC_TRACE_EVENTS;
+    uint32_t first = (head - hdr.count) & (MC_TRACE_EVENTS - 1);
+    uint32_t part = MC_TRACE_EVENTS - first < hdr.count ? MC_TRACE_EVENTS - first : hdr.count;
+    if (!write(&hdr, sizeof(hdr), ctx)) return false;
+    if (part && !write(trace_ring + first, part * sizeof(TraceEvent), ctx)) return false;
+    return hdr.count == part || write(trace_ring, (hdr.count - part) * sizeof(TraceEvent), ctx);
+}
+
+#endif
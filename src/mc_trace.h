@@ -0,0 +1,107 @@
+#pragma once
+
+#include "config.h"
+#include <cstdint>
+#include <cstddef>
+
+// Flight recorder: a fixed ring of 12-byte binary events, always on, for
+// working out what happened before a stall or a disconnect. Recording an
+// event is a cycle counter read, one atomic add and a 12-byte store.
+//
+// Timestamps are CPU cycles of the recording core (bit 7 of kind). Each
+// task calls trace_clock from its loop, which at most once a second
+// records that core's cycle count next to esp_timer microseconds; the
+// timeline tool (host/timeline.cpp) puts every core on one clock from
+// these and unwraps the 32-bit counter.
+//
+// Dump layout: "MCTR", u8 version, u8 pad[3], u32 cycles per us,
+// u32 event count, then the events oldest first.
+//
+// The live ring sits in memory a software reset leaves alone, so after a
+// panic or watchdog reset it is kept as the saved dump; an error
+// disconnect also saves a copy. Both are served by the metrics endpoint,
+// /trace (live) and /trace/saved.
+
+enum TraceKind : uint8_t {
+    TRACE_CLOCK,        // a: 0, b: esp_timer us (low 32 bits)
+    TRACE_PKT_IN,       // conn: socket, a: packet id, b: frame bytes
+    TRACE_PKT_OUT,      // conn: socket, a: packet id, b: frame bytes (queued)
+    TRACE_CHUNK_BEGIN,  // a: cx, b: cz
+    TRACE_CHUNK_END,    // a: cx, b: cz
+    TRACE_SEND_STALL,   // conn: link slot, b: cycles the socket buffer stayed full
+    TRACE_OVERRUN,      // b: cycles of a simulation loop pass over MC_TRACE_OVERRUN_US
+    TRACE_ALLOC_FAIL,   // a: MemTag, b: bytes
+    TRACE_OPEN,         // conn: socket
+    TRACE_CLOSE,        // conn: socket, a: 1 if dropped on an error
+    TRACE_KIND_COUNT
+};
+
+static constexpr uint8_t TRACE_CORE_BIT = 0x80;
+static constexpr uint8_t TRACE_VERSION = 1;
+
+struct TraceEvent {
+    uint32_t cycles;
+    uint8_t kind;       // TraceKind | TRACE_CORE_BIT on core 1
+    uint8_t conn;
+    uint16_t a;
+    uint32_t b;
+};
+static_assert(sizeof(TraceEvent) == 12, "trace events are 12 bytes");
+
+struct TraceHeader {
+    char magic[4];
+    uint8_t version;
+    uint8_t pad[3];
+    uint32_t cycles_per_us;
+    uint32_t count;
+};
+
+#if MC_TRACE
+
+#include "esp_cpu.h"
+
+static_assert((MC_TRACE_EVENTS & (MC_TRACE_EVENTS - 1)) == 0, "MC_TRACE_EVENTS must be a power of two");
+
+// Both live in no-init memory, hence a plain word and the atomic builtin
+// rather than std::atomic
+extern TraceEvent trace_ring[MC_TRACE_EVENTS];
+extern uint32_t trace_head;
+
+inline uint32_t trace_cycles() { return esp_cpu_get_cycle_count(); }
+
+inline void trace(TraceKind kind, int conn, uint32_t a, uint32_t b) {
+    uint32_t i = __atomic_fetch_add(&trace_head, 1, __ATOMIC_RELAXED) & (MC_TRACE_EVENTS - 1);
+    TraceEvent& e = trace_ring[i];
+    e.cycles = esp_cpu_get_cycle_count();
+    e.kind = kind | (esp_cpu_get_core_id() ? TRACE_CORE_BIT : 0);
+    e.conn = static_cast<uint8_t>(conn);
+    e.a = static_cast<uint16_t>(a);
+    e.b = b;
+}
+
+// Packet event for a frame (id and payload); every id in this protocol
+// version fits the first byte
+inline void trace_frame(TraceKind kind, int conn, const uint8_t* frame, size_t len) {
+    trace(kind, conn, len ? frame[0] : 0, static_cast<uint32_t>(len));
+}
+
+// Keeps a panic-surviving ring from the previous boot, then starts afresh
+void trace_init();
+// Clock anchor for the calling core; call at least once a second
+void trace_clock();
+// Copies the live ring into the saved dump
+void trace_save();
+// Writes a dump (header, then events oldest first) through write; false if
+// write failed. There is no saved dump until trace_save or a reset.
+bool trace_dump(bool saved, bool (*write)(const void* data, size_t len, void* ctx), void* ctx);
+
+#else
+
+inline uint32_t trace_cycles() { return 0; }
+inline void trace(TraceKind, int, uint32_t, uint32_t) {}
+inline void trace_frame(TraceKind, int, const uint8_t*, size_t) {}
+inline void trace_init() {}
+inline void trace_clock() {}
+inline void trace_save() {}
+
+#endif
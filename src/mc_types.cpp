@@ -1,7 +1,7 @@
 #include "mc_types.h"
 #include "mc_packet.h"
 #include <cstring>
-#include "lwip/sockets.h"
+#include "mc_net.h"
 
 int mc_read_varint(const uint8_t* buf, size_t buf_len, int32_t& out_value) {
     out_value = 0;
@@ -38,7 +38,7 @@ int mc_read_varint_sock(int sock, int32_t& out_value) {
     int shift = 0;
     for (int i = 0; i < 5; i++) {
         uint8_t b;
-        int r = recv(sock, &b, 1, 0);
+        int r = net_recv(sock, &b, 1);
         if (r <= 0) return -1;
         out_value |= (static_cast<int32_t>(b & 0x7F)) << shift;
         if ((b & 0x80) == 0) return i + 1;
@@ -152,6 +152,17 @@ void pkt_write_f64(PacketBuf& b, double val) {
 void pkt_write_varint(PacketBuf& b, int32_t val) {
     uint8_t tmp[5]; int n = mc_write_varint(tmp, val); b.append(tmp, n);
 }
+void pkt_write_varlong(PacketBuf& b, int64_t val) {
+    uint8_t tmp[10];
+    int n = 0;
+    auto v = static_cast<uint64_t>(val);
+    do {
+        uint8_t byte = v & 0x7F;
+        v >>= 7;
+        tmp[n++] = v ? byte | 0x80 : byte;
+    } while (v);
+    b.append(tmp, n);
+}
 void pkt_write_string(PacketBuf& b, const char* str) {
     auto slen = static_cast<int32_t>(strlen(str));
     pkt_write_varint(b, slen);
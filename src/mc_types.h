@@ -35,6 +35,7 @@ void pkt_write_i64(PacketBuf& b, int64_t val);
 void pkt_write_f32(PacketBuf& b, float val);
 void pkt_write_f64(PacketBuf& b, double val);
 void pkt_write_varint(PacketBuf& b, int32_t val);
+void pkt_write_varlong(PacketBuf& b, int64_t val);
 void pkt_write_string(PacketBuf& b, const char* str);
 void pkt_write_position(PacketBuf& b, int x, int y, int z);
 void pkt_write_uuid(PacketBuf& b, uint64_t hi, uint64_t lo);
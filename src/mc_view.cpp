@@ -0,0 +1,193 @@
+#include "mc_view.h"
+#include "mc_play.h"
+#include <cmath>
+#include <cstring>
+
+struct ViewOffset { int8_t dx, dz; };
+
+// Outer square offsets in spiral order: nearest ring first, then by
+// distance, so the first VIEW_SLOTS are the view square.
+static ViewOffset spiral[OUTER_SLOTS];
+static bool spiral_ready = false;
+
+static int offset_key(const ViewOffset& o) {
+    int ring = abs(o.dx) > abs(o.dz) ? abs(o.dx) : abs(o.dz);
+    return ring * 4096 + o.dx * o.dx + o.dz * o.dz;
+}
+
+static void build_spiral() {
+    int n = 0;
+    for (int dx = -VIEW_OUTER; dx <= VIEW_OUTER; dx++)
+        for (int dz = -VIEW_OUTER; dz <= VIEW_OUTER; dz++)
+            spiral[n++] = {static_cast<int8_t>(dx), static_cast<int8_t>(dz)};
+    for (int i = 1; i < n; i++) {
+        ViewOffset o = spiral[i];
+        int key = offset_key(o);
+        int j = i - 1;
+        while (j >= 0 && offset_key(spiral[j]) > key) { spiral[j + 1] = spiral[j]; j--; }
+        spiral[j + 1] = o;
+    }
+    spiral_ready = true;
+}
+
+static int slot_of(int cx, int cz) {
+    int sx = cx % OUTER_WIDTH; if (sx < 0) sx += OUTER_WIDTH;
+    int sz = cz % OUTER_WIDTH; if (sz < 0) sz += OUTER_WIDTH;
+    return sx + sz * OUTER_WIDTH;
+}
+
+static bool get_bit(const uint32_t* bits, int s) { return (bits[s >> 5] >> (s & 31)) & 1; }
+
+// Sets or clears bit s, keeping count
+static void put_bit(uint32_t* bits, int& count, int s, bool on) {
+    uint32_t bit = 1u << (s & 31);
+    bool was = bits[s >> 5] & bit;
+    if (on == was) return;
+    if (on) { bits[s >> 5] |= bit; count++; }
+    else    { bits[s >> 5] &= ~bit; count--; }
+}
+
+void ChunkView::init(int cx, int cz) {
+    center_cx = cx;
+    center_cz = cz;
+    yaw = 0.0f;
+    loaded_count = 0;
+    held_count = 0;
+    memset(loaded, 0, sizeof(loaded));
+    memset(held, 0, sizeof(held));
+    if (!spiral_ready) build_spiral();
+}
+
+bool ChunkView::in_range(int cx, int cz) const {
+    return abs(cx - center_cx) <= MC_VIEW_DISTANCE && abs(cz - center_cz) <= MC_VIEW_DISTANCE;
+}
+
+bool ChunkView::in_outer(int cx, int cz) const {
+    return abs(cx - center_cx) <= VIEW_OUTER && abs(cz - center_cz) <= VIEW_OUTER;
+}
+
+bool ChunkView::is_loaded(int cx, int cz) const {
+    return in_range(cx, cz) && get_bit(loaded, slot_of(cx, cz));
+}
+
+bool ChunkView::is_held(int cx, int cz) const {
+    return in_outer(cx, cz) && get_bit(held, slot_of(cx, cz));
+}
+
+void ChunkView::set_loaded(int cx, int cz, bool on) {
+    int s = slot_of(cx, cz);
+    put_bit(loaded, loaded_count, s, on);
+    put_bit(held, held_count, s, on);
+}
+
+void ChunkView::set_low(int cx, int cz) {
+    int s = slot_of(cx, cz);
+    put_bit(loaded, loaded_count, s, false);
+    put_bit(held, held_count, s, true);
+}
+
+void view_move(int sock, PacketBuf& out, ChunkView& v, int cx, int cz) {
+    if (cx == v.center_cx && cz == v.center_cz) return;
+
+    int old_cx = v.center_cx, old_cz = v.center_cz;
+    for (int i = 0; i < OUTER_SLOTS; i++) {
+        int ox = old_cx + spiral[i].dx, oz = old_cz + spiral[i].dz;
+        if (!v.is_held(ox, oz)) continue;
+        int rx = abs(ox - cx), rz = abs(oz - cz);
+        if (rx > VIEW_OUTER || rz > VIEW_OUTER) {
+            send_unload_chunk(sock, out, ox, oz);
+            v.set_loaded(ox, oz, false);
+        } else if (rx > MC_VIEW_DISTANCE || rz > MC_VIEW_DISTANCE) {
+            v.set_low(ox, oz);
+        }
+    }
+
+    v.center_cx = cx;
+    v.center_cz = cz;
+    send_center_chunk(sock, out, cx, cz);
+}
+
+// Low-detail chunks for the ring beyond the view, nearest first
+static int stream_outer(int sock, PacketBuf& out, ChunkView& v, int budget) {
+    int sent = 0;
+    for (int i = VIEW_SLOTS; i < OUTER_SLOTS && sent < budget; i++) {
+        int cx = v.center_cx + spiral[i].dx, cz = v.center_cz + spiral[i].dz;
+        if (v.is_held(cx, cz)) continue;
+        send_lod_chunk(sock, out, cx, cz);
+        v.set_low(cx, cz);
+        sent++;
+    }
+    return sent;
+}
+
+int view_stream(int sock, PacketBuf& out, ChunkView& v, int budget) {
+    if (budget <= 0) return 0;
+    if (v.complete()) return v.outer_complete() ? 0 : stream_outer(sock, out, v, MC_LOD_BUDGET);
+
+    // Yaw 0 faces +Z, 90 faces -X. Chunks ahead score up to half a ring closer.
+    float rad = v.yaw * 0.017453292f;
+    float dir_x = -sinf(rad), dir_z = cosf(rad);
+
+    int cand[VIEW_SLOTS];
+    float score[VIEW_SLOTS];
+    int n = 0;
+    for (int i = 0; i < VIEW_SLOTS; i++) {
+        int cx = v.center_cx + spiral[i].dx, cz = v.center_cz + spiral[i].dz;
+        if (v.is_loaded(cx, cz)) continue;
+        float d = sqrtf(static_cast<float>(spiral[i].dx * spiral[i].dx + spiral[i].dz * spiral[i].dz));
+        float ahead = spiral[i].dx * dir_x + spiral[i].dz * dir_z;
+        cand[n] = i;
+        score[n] = d - (d > 0.0f ? 0.5f * ahead / d : 0.0f);
+        n++;
+    }
+
+    // Chunks still on their way from the node that owns them are passed over
+    int sent = 0;
+    for (int k = 0; sent < budget && k < n; k++) {
+        int best = k;
+        for (int j = k + 1; j < n; j++)
+            if (score[j] < score[best]) best = j;
+        int ci = cand[best]; cand[best] = cand[k]; cand[k] = ci;
+        float cs = score[best]; score[best] = score[k]; score[k] = cs;
+
+        int cx = v.center_cx + spiral[ci].dx, cz = v.center_cz + spiral[ci].dz;
+        if (!send_chunk(sock, out, cx, cz)) continue;
+        v.set_loaded(cx, cz, true);
+        sent++;
+    }
+    return sent;
+}
+
+void prep_init(ViewPrep& p, int cx, int cz) {
+    if (!spiral_ready) build_spiral();
+    p.active = true;
+    p.center_cx = cx;
+    p.center_cz = cz;
+    p.built = 0;
+}
+
+int prep_build(ViewPrep& p, PacketBuf& out, int budget) {
+    int n = 0;
+    while (n < budget && p.pending()) {
+        int cx, cz;
+        prep_chunk(p, p.built, cx, cz);
+        if (!load_chunk(out, cx, cz)) break;
+        SharedPacket* sp = shared_packet(out);
+        if (!sp) break;
+        p.chunks[p.built++] = sp;
+        n++;
+    }
+    return n;
+}
+
+void prep_chunk(const ViewPrep& p, int i, int& cx, int& cz) {
+    cx = p.center_cx + spiral[i].dx;
+    cz = p.center_cz + spiral[i].dz;
+}
+
+void prep_free(ViewPrep& p) {
+    if (!p.active) return;
+    for (int i = 0; i < p.built; i++) shared_release(p.chunks[i]);
+    p.active = false;
+    p.built = 0;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "mc_packet.h"
+#include "mc_shared.h"
+#include "config.h"
+#include <cstdint>
+
+static constexpr int VIEW_WIDTH = 2 * MC_VIEW_DISTANCE + 1;
+static constexpr int VIEW_SLOTS = VIEW_WIDTH * VIEW_WIDTH;
+// Low-detail chunks fill the ring between the view distance and this one
+static constexpr int VIEW_OUTER = MC_LOD_DISTANCE > MC_VIEW_DISTANCE ? MC_LOD_DISTANCE : MC_VIEW_DISTANCE;
+static constexpr int OUTER_WIDTH = 2 * VIEW_OUTER + 1;
+static constexpr int OUTER_SLOTS = OUTER_WIDTH * OUTER_WIDTH;
+
+// Chunks the client currently holds. Bits are indexed by (cx mod W, cz mod W)
+// over the outer square, which is unique for any W-wide window, so
+// recentering never moves bits. `held` covers every chunk sent, `loaded`
+// only full chunks within the view distance; a held chunk that is not
+// loaded is low-detail, or a full one that has since left the view and no
+// longer gets block changes.
+struct ChunkView {
+    int center_cx;
+    int center_cz;
+    float yaw;
+    int loaded_count;
+    int held_count;
+    uint32_t loaded[(OUTER_SLOTS + 31) / 32];
+    uint32_t held[(OUTER_SLOTS + 31) / 32];
+
+    void init(int cx, int cz);
+    bool in_range(int cx, int cz) const;
+    bool in_outer(int cx, int cz) const;
+    bool is_loaded(int cx, int cz) const;
+    bool is_held(int cx, int cz) const;
+    // A full chunk was sent (on) or the chunk unloaded (off)
+    void set_loaded(int cx, int cz, bool on);
+    // A low-detail chunk was sent, or a full one left the view
+    void set_low(int cx, int cz);
+    bool complete() const { return loaded_count == VIEW_SLOTS; }
+    bool outer_complete() const { return held_count == OUTER_SLOTS; }
+};
+
+// Recenters the view and unloads every held chunk that left the outer
+// square. Full chunks that left the view distance stay with the client.
+void view_move(int sock, PacketBuf& out, ChunkView& v, int cx, int cz);
+
+// Sends up to `budget` missing full chunks, nearest first and biased toward
+// yaw, replacing low-detail ones as they come into view. Once the view is
+// complete, sends up to MC_LOD_BUDGET low-detail chunks beyond it, nearest
+// first. Chunks another node is still sending are left for a later call.
+// Returns the number of chunks sent.
+int view_stream(int sock, PacketBuf& out, ChunkView& v, int budget);
+
+// Chunks around a spawn point built before the client reaches Play, nearest
+// first, so they can be queued the moment it does. Offset i is the i-th
+// nearest chunk to the center.
+struct ViewPrep {
+    bool active;
+    int center_cx;
+    int center_cz;
+    int built;                          // chunks[0, built) are ready
+    SharedPacket* chunks[VIEW_SLOTS];
+
+    bool pending() const { return active && built < VIEW_SLOTS; }
+};
+
+void prep_init(ViewPrep& p, int cx, int cz);
+// Builds up to `budget` more chunks, using out as the work buffer, and
+// stops at one another node is still sending. Returns the number built.
+int prep_build(ViewPrep& p, PacketBuf& out, int budget);
+void prep_chunk(const ViewPrep& p, int i, int& cx, int& cz);
+// Drops every built chunk and deactivates p
+void prep_free(ViewPrep& p);
@@ -0,0 +1,239 @@
+#include "mc_world.h"
+#include "mc_play.h"
+#include "mc_mem.h"
+#include "config.h"
+#include "esp_log.h"
+#include <cmath>
+#include <cstring>
+
+static const char* TAG = "mc_world";
+
+static constexpr float EPS = 1e-4f;
+static constexpr int WORLD_HEIGHT = WORLD_SECTIONS * 16;
+
+static WorldColumn columns[MC_WORLD_COLUMNS];
+static uint32_t clock_stamp = 0;
+static int last = 0;    // most recently used column, checked first
+
+static WorldColumn* find(int cx, int cz) {
+    WorldColumn& hot = columns[last];
+    if (hot.used && hot.cx == cx && hot.cz == cz) return &hot;
+    for (int i = 0; i < MC_WORLD_COLUMNS; i++) {
+        WorldColumn& c = columns[i];
+        if (c.used && c.cx == cx && c.cz == cz) {
+            last = i;
+            return &c;
+        }
+    }
+    return nullptr;
+}
+
+static void release(WorldColumn& c) {
+    for (auto& m : c.mask) {
+        mem_free(m);
+        m = nullptr;
+    }
+    c.used = false;
+}
+
+WorldColumn* world_claim(int cx, int cz) {
+    if (find(cx, cz)) return nullptr;
+    int victim = 0;
+    for (int i = 0; i < MC_WORLD_COLUMNS; i++) {
+        if (!columns[i].used) { victim = i; break; }
+        if (columns[i].stamp - columns[victim].stamp > 0x80000000u) victim = i;   // older
+    }
+    WorldColumn& c = columns[victim];
+    release(c);
+    c.used = true;
+    c.cx = cx;
+    c.cz = cz;
+    c.stamp = ++clock_stamp;
+    memset(c.kind, SECTION_EMPTY, sizeof(c.kind));
+    last = victim;
+    return &c;
+}
+
+void world_set_section(WorldColumn& col, int si, const SectionMask* mask) {
+    mem_free(col.mask[si]);
+    col.mask[si] = nullptr;
+    col.kind[si] = SECTION_EMPTY;
+    if (!mask) return;
+
+    uint64_t any = 0, all = ~0ULL;
+    for (int w = 0; w < 64; w++) {
+        any |= mask->solid[w] | mask->fluid[w];
+        all &= mask->solid[w] & ~mask->fluid[w];
+    }
+    if (!any) return;
+    if (all == ~0ULL) {
+        col.kind[si] = SECTION_FULL;
+        return;
+    }
+    auto* m = static_cast<SectionMask*>(mem_alloc(MEM_CACHE, sizeof(SectionMask)));
+    if (!m) {
+        ESP_LOGW(TAG, "No memory for section %d of (%d, %d); treating it as empty", si, col.cx, col.cz);
+        return;
+    }
+    memcpy(m, mask, sizeof(*m));
+    col.mask[si] = m;
+    col.kind[si] = SECTION_MIXED;
+}
+
+const WorldColumn* world_column(int cx, int cz) {
+    WorldColumn* c = find(cx, cz);
+    if (!c) {
+        build_chunk_masks(cx, cz);
+        c = find(cx, cz);
+    }
+    if (c) c->stamp = ++clock_stamp;
+    return c;
+}
+
+void world_set_block(int x, int y, int z, BlockOcc occ) {
+    int sy = y - WORLD_MIN_Y;
+    if (sy < 0 || sy >= WORLD_HEIGHT) return;
+    WorldColumn* c = find(x >> 4, z >> 4);
+    if (!c) return;
+    int si = sy >> 4;
+    if ((c->kind[si] == SECTION_EMPTY && occ == OCC_EMPTY) || (c->kind[si] == SECTION_FULL && occ == OCC_SOLID))
+        return;
+    if (c->kind[si] != SECTION_MIXED) {
+        auto* m = static_cast<SectionMask*>(mem_alloc(MEM_CACHE, sizeof(SectionMask)));
+        if (!m) return;
+        memset(m->solid, c->kind[si] == SECTION_FULL ? 0xFF : 0x00, sizeof(m->solid));
+        memset(m->fluid, 0, sizeof(m->fluid));
+        c->mask[si] = m;
+        c->kind[si] = SECTION_MIXED;
+    }
+    int bit = (x & 15) + (z & 15) * 16 + (sy & 15) * 256;
+    uint64_t b = 1ULL << (bit & 63);
+    SectionMask& m = *c->mask[si];
+    m.solid[bit >> 6] = occ == OCC_SOLID ? m.solid[bit >> 6] | b : m.solid[bit >> 6] & ~b;
+    m.fluid[bit >> 6] = occ == OCC_FLUID ? m.fluid[bit >> 6] | b : m.fluid[bit >> 6] & ~b;
+}
+
+void world_update_section(int cx, int cz, int si, const SectionMask& mask) {
+    if (si < 0 || si >= WORLD_SECTIONS) return;
+    if (WorldColumn* c = find(cx, cz)) world_set_section(*c, si, &mask);
+}
+
+void world_clear() {
+    for (auto& c : columns) release(c);
+}
+
+uint32_t world_row_bits(const WorldColumn& c, int y, int lz, bool fluid) {
+    int sy = y - WORLD_MIN_Y;
+    if (sy < 0 || sy >= WORLD_HEIGHT) return 0;
+    int si = sy >> 4;
+    switch (c.kind[si]) {
+    case SECTION_EMPTY: return 0;
+    case SECTION_FULL:  return fluid ? 0 : 0xFFFF;
+    default: break;
+    }
+    const uint64_t* words = fluid ? c.mask[si]->fluid : c.mask[si]->solid;
+    int bit = lz * 16 + (sy & 15) * 256;
+    return static_cast<uint32_t>(words[bit >> 6] >> (bit & 63)) & 0xFFFF;
+}
+
+BlockOcc world_block(int x, int y, int z) {
+    const WorldColumn* c = world_column(x >> 4, z >> 4);
+    if (!c) return OCC_EMPTY;
+    uint32_t bit = 1u << (x & 15);
+    if (world_row_bits(*c, y, z & 15, false) & bit) return OCC_SOLID;
+    if (world_row_bits(*c, y, z & 15, true) & bit) return OCC_FLUID;
+    return OCC_EMPTY;
+}
+
+static int lo_block(float v) { return static_cast<int>(floorf(v)); }
+static int hi_block(float v) { return static_cast<int>(floorf(v - EPS)); }
+
+static bool box_hits(const Aabb& b, bool fluid) {
+    int x0 = lo_block(b.min[0]), x1 = hi_block(b.max[0]);
+    int y0 = lo_block(b.min[1]), y1 = hi_block(b.max[1]);
+    int z0 = lo_block(b.min[2]), z1 = hi_block(b.max[2]);
+    if (y1 < WORLD_MIN_Y || y0 >= WORLD_MIN_Y + WORLD_HEIGHT) return false;
+
+    // One column at a time; within it, one row AND per (y, z)
+    for (int cz = z0 >> 4; cz <= z1 >> 4; cz++)
+        for (int cx = x0 >> 4; cx <= x1 >> 4; cx++) {
+            const WorldColumn* c = world_column(cx, cz);
+            if (!c) continue;
+            int lx0 = x0 > cx * 16 ? x0 - cx * 16 : 0;
+            int lx1 = x1 < cx * 16 + 15 ? x1 - cx * 16 : 15;
+            uint32_t xmask = ((1u << (lx1 - lx0 + 1)) - 1) << lx0;
+            int lz0 = z0 > cz * 16 ? z0 - cz * 16 : 0;
+            int lz1 = z1 < cz * 16 + 15 ? z1 - cz * 16 : 15;
+            for (int y = y0; y <= y1; y++)
+                for (int lz = lz0; lz <= lz1; lz++)
+                    if (world_row_bits(*c, y, lz, fluid) & xmask) return true;
+        }
+    return false;
+}
+
+bool world_box_solid(const Aabb& box) { return box_hits(box, false); }
+bool world_box_fluid(const Aabb& box) { return box_hits(box, true); }
+
+float world_sweep(Aabb& box, int axis, float d) {
+    if (d == 0.0f) return 0.0f;
+    // Each block layer the box would enter is tested as a one-block slab
+    Aabb slab = box;
+    if (d > 0) {
+        int from = hi_block(box.max[axis]) + 1, to = hi_block(box.max[axis] + d);
+        for (int l = from; l <= to; l++) {
+            slab.min[axis] = static_cast<float>(l);
+            slab.max[axis] = static_cast<float>(l + 1);
+            if (!box_hits(slab, false)) continue;
+            d = l - box.max[axis];
+            if (d < 0) d = 0;
+            break;
+        }
+    } else {
+        int from = lo_block(box.min[axis]) - 1, to = lo_block(box.min[axis] + d);
+        for (int l = from; l >= to; l--) {
+            slab.min[axis] = static_cast<float>(l);
+            slab.max[axis] = static_cast<float>(l + 1);
+            if (!box_hits(slab, false)) continue;
+            d = (l + 1) - box.min[axis];
+            if (d > 0) d = 0;
+            break;
+        }
+    }
+    box.min[axis] += d;
+    box.max[axis] += d;
+    return d;
+}
+
+bool world_raycast(const float origin[3], const float dir[3], float max_dist, int hit[3]) {
+    int p[3], step[3];
+    float t_max[3], t_delta[3];
+    for (int a = 0; a < 3; a++) {
+        p[a] = lo_block(origin[a]);
+        if (dir[a] > 0) {
+            step[a] = 1;
+            t_delta[a] = 1.0f / dir[a];
+            t_max[a] = (p[a] + 1 - origin[a]) * t_delta[a];
+        } else if (dir[a] < 0) {
+            step[a] = -1;
+            t_delta[a] = -1.0f / dir[a];
+            t_max[a] = (origin[a] - p[a]) * t_delta[a];
+        } else {
+            step[a] = 0;
+            t_delta[a] = t_max[a] = INFINITY;
+        }
+    }
+    // Amanatides-Woo: step into whichever block face the ray reaches first
+    for (float t = 0; t <= max_dist;) {
+        if (world_block(p[0], p[1], p[2]) == OCC_SOLID) {
+            hit[0] = p[0];
+            hit[1] = p[1];
+            hit[2] = p[2];
+            return true;
+        }
+        int a = t_max[0] < t_max[1] ? (t_max[0] < t_max[2] ? 0 : 2) : (t_max[1] < t_max[2] ? 1 : 2);
+        t = t_max[a];
+        p[a] += step[a];
+        t_max[a] += t_delta[a];
+    }
+    return false;
+}
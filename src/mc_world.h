@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstdint>
+
+// Block occupancy for collision and movement checks, without touching the
+// terrain generator. Each cached chunk column keeps, per 16^3 section, one
+// bit per block for "solid" and one for "fluid". The masks are filled while
+// the chunk is generated and updated by world_set_block.
+//
+// Bit i of a mask is block (x, y, z) with i = x + z*16 + y*256, so a row
+// along x is 16 contiguous bits: box and sweep tests check a whole row with
+// one shift and AND. Sections that are all air or all solid carry no mask.
+
+static constexpr int WORLD_MIN_Y = -64;
+static constexpr int WORLD_SECTIONS = 24;
+
+enum SectionKind : uint8_t {
+    SECTION_EMPTY,      // no solid or fluid blocks
+    SECTION_FULL,       // every block solid
+    SECTION_MIXED
+};
+
+enum BlockOcc : uint8_t { OCC_EMPTY, OCC_SOLID, OCC_FLUID };
+
+struct SectionMask {
+    uint64_t solid[64];
+    uint64_t fluid[64];
+};
+
+struct WorldColumn {
+    int cx, cz;
+    bool used;
+    uint32_t stamp;                         // last use, for eviction
+    uint8_t kind[WORLD_SECTIONS];
+    SectionMask* mask[WORLD_SECTIONS];      // MIXED sections only
+};
+
+// Axis-aligned box in block coordinates; max is exclusive
+struct Aabb {
+    float min[3];
+    float max[3];
+};
+
+// Generator side: a cleared column to fill for (cx, cz), or nullptr if it
+// is already cached. mask == nullptr means an all-air section.
+WorldColumn* world_claim(int cx, int cz);
+void world_set_section(WorldColumn& col, int si, const SectionMask* mask);
+
+// Cached column, generated on a miss; nullptr only when out of memory
+const WorldColumn* world_column(int cx, int cz);
+// Records a block change in a cached column (uncached columns regenerate
+// from the generator, so there is nothing to update)
+void world_set_block(int x, int y, int z, BlockOcc occ);
+// Replaces the masks of section si in a cached column after many of its
+// blocks changed at once; nothing to do for uncached columns either
+void world_update_section(int cx, int cz, int si, const SectionMask& mask);
+// Drops every cached column
+void world_clear();
+
+BlockOcc world_block(int x, int y, int z);
+// The 16 x-bits of row (y, local z) of a column: its solid blocks, or its
+// fluid blocks
+uint32_t world_row_bits(const WorldColumn& c, int y, int lz, bool fluid);
+// True if any solid block overlaps the box
+bool world_box_solid(const Aabb& box);
+// True if any fluid block overlaps the box
+bool world_box_fluid(const Aabb& box);
+// Moves box by up to d along axis (0 = x, 1 = y, 2 = z), stopping flush
+// against the first solid block. Returns the distance actually moved.
+float world_sweep(Aabb& box, int axis, float d);
+// First solid block along the ray within max_dist; writes its coordinates
+bool world_raycast(const float origin[3], const float dir[3], float max_dist, int hit[3]);